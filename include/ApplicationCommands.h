@@ -2,20 +2,31 @@
 #define SLATE_APPLICATION_COMMANDS_H
 
 #include "crow.h"
+#include "ChartCache.h"
 #include "Entities.h"
+#include "HelmCatalog.h"
 #include "PersistentStore.h"
 
 ///List currently known applications
-crow::response listApplications(PersistentStore& store, const crow::request& req);
+///\param catalog the index of the charts in the application repositories
+crow::response listApplications(PersistentStore& store, const HelmCatalog& catalog, const crow::request& req);
 ///Obtain the configuration for an application
+///\param catalog the index of the charts in the application repositories
 ///\param appName the application whose configuration should be returned
-crow::response fetchApplicationConfig(PersistentStore& store, const crow::request& req, const std::string& appName);
+crow::response fetchApplicationConfig(PersistentStore& store, HelmCatalog& catalog, const crow::request& req, const std::string& appName);
 ///Install an instance of an application
+///\param catalog the index of the charts in the application repositories
 ///\param appName the application to install
-crow::response installApplication(PersistentStore& store, const crow::request& req, const std::string& appName);
+crow::response installApplication(PersistentStore& store, HelmCatalog& catalog, const crow::request& req, const std::string& appName);
 ///Install an instance of an application from outside the catalog
-crow::response installAdHocApplication(PersistentStore& store, const crow::request& req);
+///\param maxChartSize the maximum size, in bytes, of the uncompressed chart
+///                    tarball, or zero for no limit
+///\param chartCache where to keep charts for reuse if they are uploaded 
+///                  again, or null if they should not be kept
+crow::response installAdHocApplication(PersistentStore& store, const crow::request& req, unsigned long long maxChartSize, ChartCache* chartCache);
 ///Update the application catalog
-crow::response updateCatalog(PersistentStore& store, const crow::request& req);
+///\param catalog the index of the charts in the application repositories,
+///               which is reloaded once the repositories have been updated
+crow::response updateCatalog(PersistentStore& store, HelmCatalog& catalog, const crow::request& req);
 
 #endif //SLATE_APPLICATION_COMMANDS_H
@@ -5,13 +5,32 @@
 #include <map>
 #include <memory>
 #include <ostream>
+#include <streambuf>
 #include <string>
 
-///Decode base64 encoded data
-std::string decodeBase64(const std::string& coded);
+///The character sets which may be used for base64 encoding (RFC 4648)
+enum class Base64Alphabet{
+	///The standard alphabet, using '+' and '/', with '=' padding
+	Standard,
+	///The URL and filename safe alphabet, using '-' and '_', without padding, 
+	///so that encoded data can be placed in URLs without escaping
+	URLSafe
+};
+
+///Decode base64 encoded data. Padding is optional, but if present must be 
+///correct. 
+///\param coded the encoded data
+///\param alphabet the alphabet with which the data was encoded
+///\throws std::runtime_error if \p coded contains characters outside the 
+///        alphabet, is not a possible length for encoded data, has incorrect
+///        padding, or has nonzero bits in the unused part of its last 
+///        character
+std::string decodeBase64(const std::string& coded, Base64Alphabet alphabet=Base64Alphabet::Standard);
 
 ///Encode data to base64
-std::string encodeBase64(const std::string& raw);
+///\param raw the data to encode
+///\param alphabet the alphabet with which to encode the data
+std::string encodeBase64(const std::string& raw, Base64Alphabet alphabet=Base64Alphabet::Standard);
 
 ///decompress gzipped data from one stream to another
 void gzipDecompress(std::istream& src, std::ostream& dest);
@@ -19,6 +38,62 @@ void gzipDecompress(std::istream& src, std::ostream& dest);
 ///compress gzipped data from one stream to another
 void gzipCompress(std::istream& src, std::ostream& dest);
 
+struct z_stream_s;
+
+///An input stream buffer which decodes base64 data as it is read, so that the
+///decoded data never needs to be held in memory all at once
+class Base64DecodingBuffer : public std::streambuf{
+public:
+	///\param data the encoded data, which must remain valid for the lifetime of
+	///            the buffer
+	///\param length the length of the encoded data
+	///\param alphabet the alphabet with which the data was encoded
+	///\throws std::runtime_error if the data's length or padding is invalid
+	Base64DecodingBuffer(const char* data, std::size_t length, 
+	                     Base64Alphabet alphabet=Base64Alphabet::Standard);
+protected:
+	///\throws std::runtime_error if the data contains an invalid character
+	int_type underflow() override;
+private:
+	const Base64Alphabet alphabet;
+	const char* next;
+	///The end of the data which forms complete groups of four characters
+	const char* groupsEnd;
+	///The number of characters in the final, partial group, excluding padding
+	unsigned int tailLength;
+	char buffer[3*1024];
+};
+
+///An input stream buffer which decompresses gzipped data from another stream
+///as it is read, so that the decompressed data never needs to be held in 
+///memory all at once. Because errors are reported by throwing from within 
+///the buffer, streams which read from it should set badbit in 
+///std::ios::exceptions so that the errors are not converted into end of file. 
+class GzipDecompressingBuffer : public std::streambuf{
+public:
+	///\param src the stream of compressed data
+	///\param limit the maximum number of bytes of decompressed data which may
+	///             be read, or zero for no limit
+	///\throws std::runtime_error if the gzip header is invalid
+	explicit GzipDecompressingBuffer(std::istream& src, unsigned long long limit=0);
+	~GzipDecompressingBuffer();
+	GzipDecompressingBuffer(const GzipDecompressingBuffer&)=delete;
+	GzipDecompressingBuffer& operator=(const GzipDecompressingBuffer&)=delete;
+protected:
+	///\throws std::runtime_error if the compressed data is corrupt or ends 
+	///        early
+	///\throws std::length_error if the decompressed data exceeds the limit
+	int_type underflow() override;
+private:
+	std::istream& src;
+	const unsigned long long limit;
+	unsigned long long total;
+	bool finished;
+	std::unique_ptr<z_stream_s> zs;
+	std::unique_ptr<char[]> inBuffer;
+	std::unique_ptr<char[]> outBuffer;
+};
+
 //A simple interface for reading a tarball
 //files are read in on demand, and can be dropped from memory when no longer needed
 //Once dropped, a file cannot be retrieved again
@@ -79,10 +154,28 @@ public:
 	std::string nextFileOfType(FileRecord::fileType type);
 	void dropFile(const std::string& name);
 	bool eof() const;
-	void extractToFileSystem(const std::string& prefix, bool dropAfterExtracting=true);
+	///Write all files in the archive beneath a directory. Files' data is 
+	///copied from the source stream as it is read, rather than being held in 
+	///memory, so the files cannot afterwards be retrieved from the reader. 
+	void extractToFileSystem(const std::string& prefix);
 	
 private:
+	///The metadata from the header of an entry in the archive
+	struct EntryHeader{
+		std::string name;
+		FileRecord::fileType type;
+		unsigned long long size;
+		int mode;
+		std::string linkTarget;
+	};
+	
 	std::string readFiles(const std::string& target);
+	///Read the header of the next entry, leaving the source stream positioned
+	///at the start of the entry's data
+	///\return false if the end of the archive was reached
+	bool readHeader(EntryHeader& header);
+	///Skip the padding which follows an entry's data
+	void skipPadding(const EntryHeader& header);
 	
 	std::istream& src;
 	std::map<std::string,FileRecord> files;
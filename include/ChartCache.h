@@ -0,0 +1,88 @@
+#ifndef SLATE_CHART_CACHE_H
+#define SLATE_CHART_CACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "FileHandle.h"
+
+///Keeps charts uploaded for ad-hoc installation extracted on disk after they
+///have been validated, keyed by a digest of the upload, so that uploading the
+///same chart again does not require extracting and inspecting it again.
+///The least recently used charts are discarded to keep the total size of the
+///cache within a bound.
+class ChartCache{
+public:
+	///A chart which has been extracted and validated
+	struct Chart{
+		///The chart's directory
+		std::string path;
+		///The chart's name, as reported by helm
+		std::string name;
+	};
+
+	///\param directory the directory in which to keep charts. It is created
+	///                 if it does not exist, and anything already in it is
+	///                 discarded, since it cannot be known to be valid.
+	///\param capacity the maximum total size, in bytes, of the cached charts
+	ChartCache(const std::string& directory, unsigned long long capacity);
+	ChartCache(const ChartCache&)=delete;
+	ChartCache& operator=(const ChartCache&)=delete;
+
+	///Compute the key under which an uploaded chart is cached
+	///\param data the chart, as uploaded
+	///\param length the length of the uploaded data
+	static std::string key(const char* data, std::size_t length);
+
+	///Create a directory into which to extract a chart which may then be
+	///inserted. It is on the same filesystem as the cache, so that inserting
+	///does not need to copy the chart.
+	FileHandle makeStagingDir() const;
+
+	///Look up a chart
+	///\return the chart, or null if it is not cached. The chart's files will
+	///        not be removed while the pointer is held, even if it is
+	///        discarded from the cache.
+	std::shared_ptr<const Chart> find(const std::string& key);
+
+	///Add a chart to the cache
+	///\param key the key computed for the uploaded chart
+	///\param stagingDir the directory made by makeStagingDir into which the
+	///                  chart was extracted, which the cache takes over
+	///\param chartSubDir the name of the chart's directory within stagingDir
+	///\param name the chart's name
+	///\return the cached chart. If the chart is too large to cache, it is
+	///        returned anyway, and its files are removed when the pointer is
+	///        released.
+	std::shared_ptr<const Chart> insert(const std::string& key, FileHandle&& stagingDir,
+	                                    const std::string& chartSubDir, const std::string& name);
+
+private:
+	///A cached chart and the directory which holds it, which is removed when
+	///the entry is destroyed
+	struct Entry{
+		~Entry();
+		std::string directory;
+		unsigned long long size;
+		Chart chart;
+	};
+	struct Slot{
+		std::shared_ptr<Entry> entry;
+		///The entry's position in the recency list
+		std::list<std::string>::iterator position;
+	};
+
+	const std::string directory;
+	const unsigned long long capacity;
+	std::mutex mutex;
+	std::unordered_map<std::string,Slot> entries;
+	///Keys of the cached charts, most recently used first
+	std::list<std::string> recency;
+	///The total size of the cached charts
+	unsigned long long size;
+};
+
+#endif //SLATE_CHART_CACHE_H
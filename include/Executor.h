@@ -0,0 +1,58 @@
+#ifndef SLATE_EXECUTOR_H
+#define SLATE_EXECUTOR_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///A fixed-size pool of worker threads which run submitted tasks in FIFO
+///order. The number of tasks which may be waiting for a worker is bounded, so
+///that a burst of expensive work is refused rather than queued without limit.
+class Executor{
+public:
+	///\param threads the number of worker threads to run
+	///\param maxQueued the maximum number of tasks which may be waiting for a
+	///                 worker at any time
+	Executor(std::size_t threads, std::size_t maxQueued);
+
+	///Waits for all already queued tasks to finish, then stops the workers
+	~Executor();
+
+	Executor(const Executor&)=delete;
+	Executor& operator=(const Executor&)=delete;
+
+	///Queue a task to be run by one of the worker threads.
+	///Exceptions escaping from the task are logged and discarded.
+	///\param task the work to be done
+	///\return true if the task was queued, false if the queue was full
+	bool submit(std::function<void()> task);
+
+	///\return the number of tasks currently waiting for a worker
+	std::size_t queued() const;
+	///\return the number of worker threads
+	std::size_t size() const{ return workers.size(); }
+
+private:
+	const std::size_t maxQueued;
+	mutable std::mutex mut;
+	std::condition_variable cond;
+	std::deque<std::function<void()>> tasks;
+	std::vector<std::thread> workers;
+	bool stopping;
+
+	void work();
+};
+
+///Call body(i) for each i in [0,count), with at most concurrency calls in
+///progress at once. The other calls are made by a shared pool of helper 
+///threads, when they are free; the calling thread makes whichever calls the 
+///helpers do not, and does not return until all have finished. Each call should store its result by
+///index so that the outcome does not depend on the order in which calls finish.
+///\throws the first exception thrown by any call, after all calls have finished
+void parallelFor(std::size_t count, std::size_t concurrency,
+                 const std::function<void(std::size_t)>& body);
+
+#endif //SLATE_EXECUTOR_H
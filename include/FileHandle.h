@@ -37,6 +37,13 @@ public:
 	const std::string& path() const{ return filePath; }
 	///\return the path to the file
 	operator std::string() const{ return filePath; }
+	///Give up ownership of the file, so that it is not destroyed
+	///\return the path to the file
+	std::string release(){
+		std::string path;
+		std::swap(path,filePath);
+		return path;
+	}
 private:
 	///the path to the owned file
 	std::string filePath;
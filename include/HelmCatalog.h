@@ -0,0 +1,110 @@
+#ifndef SLATE_HELM_CATALOG_H
+#define SLATE_HELM_CATALOG_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "single_flight.h"
+
+///Remove all text contained between the strings
+///"### SLATE-START ###" and "### SLATE-END ###"
+std::string filterValuesFile(std::string data);
+
+///Find the instance tag set by a configuration. If several documents in the 
+///configuration set it, the last one is used.
+///\param config the configuration, as YAML
+///\param gotTag set to true if the configuration sets a tag, otherwise left 
+///              unchanged
+///\param tag set to the tag, if the configuration sets one
+///\return false if the configuration could not be parsed as YAML
+bool extractInstanceTag(const std::string& config, bool& gotTag, std::string& tag);
+
+///An in-memory index of the charts in the helm repositories known to the local
+///helm installation, read from the repository index files which helm keeps in
+///its data directory. This answers the questions which would otherwise need
+///`helm search` to be run for each request.
+///The index is replaced as a whole when it is reloaded, so lookups never see a
+///partially updated catalog and never wait for a reload.
+class HelmCatalog{
+public:
+	///The latest version of a chart in a repository
+	struct Chart{
+		std::string name;
+		std::string version;
+		std::string appVersion;
+		std::string description;
+	};
+
+	///What installing or configuring a chart needs to know about its default
+	///values
+	struct ChartDefaults{
+		///The chart's values file, with SLATE-internal sections removed
+		std::string values;
+		///Whether the values file could be parsed as YAML
+		bool valid;
+		///Whether the values file sets an instance tag
+		bool hasTag;
+		///The default instance tag
+		std::string tag;
+	};
+
+	///\param helmHome helm's data directory
+	explicit HelmCatalog(std::string helmHome);
+	HelmCatalog(const HelmCatalog&)=delete;
+	HelmCatalog& operator=(const HelmCatalog&)=delete;
+
+	///Reread the index files of all configured repositories. This should be
+	///called after the repositories have been updated.
+	void reload();
+
+	///\param repo the name of the repository
+	///\return the charts in the repository, sorted by name, or an empty list if
+	///        the repository is not known
+	std::shared_ptr<const std::vector<Chart>> listCharts(const std::string& repo) const;
+
+	///\param repo the name of the repository
+	///\param name the name of the chart
+	///\return the chart, or null if it is not in the repository
+	std::shared_ptr<const Chart> findChart(const std::string& repo, const std::string& name) const;
+
+	///Get the default values of a chart. These are fetched using helm and 
+	///parsed the first time they are requested for each version of the chart,
+	///and thereafter served from memory until the catalog is reloaded.
+	///\param repo the name of the repository containing the chart
+	///\param chart the chart, as found in this catalog
+	///\throws std::runtime_error if helm fails to produce the values
+	std::shared_ptr<const ChartDefaults> getDefaults(const std::string& repo, const Chart& chart);
+
+	///Fetch and parse the default values of a chart, without caching them
+	///\param source the chart's location, in any form helm accepts
+	///\param version the version of the chart, or empty if source identifies 
+	///               a single version
+	///\throws std::runtime_error if helm fails to produce the values
+	static std::shared_ptr<const ChartDefaults> readDefaults(const std::string& source, const std::string& version="");
+
+private:
+	///A complete snapshot of the catalog
+	struct Index{
+		///Charts of each repository, sorted by name
+		std::map<std::string,std::shared_ptr<const std::vector<Chart>>> repositories;
+
+		///Default values already fetched, keyed by repository, chart, and version
+		std::mutex defaultsMutex;
+		std::unordered_map<std::string,std::shared_ptr<const ChartDefaults>> defaults;
+		single_flight<std::shared_ptr<const ChartDefaults>> defaultsFetches;
+	};
+
+	const std::string helmHome;
+	///Guards replacing the index (but not reading it, which uses atomic
+	///operations on the pointer)
+	std::mutex reloadMutex;
+	std::shared_ptr<Index> index;
+
+	std::shared_ptr<Index> currentIndex() const;
+};
+
+#endif //SLATE_HELM_CATALOG_H
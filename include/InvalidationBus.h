@@ -0,0 +1,85 @@
+#ifndef SLATE_INVALIDATION_BUS_H
+#define SLATE_INVALIDATION_BUS_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+///A notice that a record has changed, so that any cached copies of it, and any
+///cached collections which may include it, are stale
+struct Invalidation{
+	///The kind of record: "user", "vo", "cluster", "instance", or "secret", 
+	///or, for the records which relate two entities, "membership" (of a user 
+	///in a VO), "access" (of a VO to a cluster), or "applications" (which a 
+	///VO may use on a cluster)
+	std::string kind;
+	///The ID of the record, or for relations, of the user or cluster
+	std::string id;
+	///Further keys under which the record may be cached, such as the ID of
+	///the VO which owns it, or for relations, the ID of the VO. Their meaning
+	///depends on the kind of record.
+	std::vector<std::string> related;
+};
+
+///Encode an invalidation as a single message. Fields are separated by NUL 
+///characters, which cannot appear in IDs or names.
+std::string serializeInvalidation(const Invalidation& invalidation);
+
+///Decode a message produced by serializeInvalidation
+///\param message the encoded invalidation
+///\param invalidation the invalidation into which to decode
+///\return false if \p message lacks a kind or an ID
+bool deserializeInvalidation(const std::string& message, Invalidation& invalidation);
+
+///A channel over which server replicas which share a database tell one another
+///when they change records, so that each can discard its stale cache entries.
+///Delivery is best effort; an invalidation which is lost leaves a stale entry
+///only until it expires.
+class InvalidationBus{
+public:
+	using Handler=std::function<void(const Invalidation&)>;
+
+	virtual ~InvalidationBus(){}
+
+	///Announce a change to all other replicas
+	virtual void publish(const Invalidation& invalidation)=0;
+
+	///Begin delivering the invalidations published by other replicas.
+	///This may be called only once.
+	///\param handler the function to call with each invalidation. It is
+	///               called from a thread belonging to the bus, until the bus
+	///               is destroyed.
+	virtual void subscribe(Handler handler)=0;
+};
+
+///Connects replicas running on the same host, each of which binds a unix
+///datagram socket in a shared directory, and publishes by sending to all of
+///the other sockets found there. Publishing waits briefly for a replica whose
+///queue of invalidations is full to catch up, rather than dropping the message.
+class LocalInvalidationBus : public InvalidationBus{
+public:
+	///\param directory the directory in which replicas place their sockets,
+	///                 which is created if it does not exist
+	///\throws std::runtime_error if the socket cannot be created
+	explicit LocalInvalidationBus(const std::string& directory);
+	~LocalInvalidationBus();
+	LocalInvalidationBus(const LocalInvalidationBus&)=delete;
+	LocalInvalidationBus& operator=(const LocalInvalidationBus&)=delete;
+
+	void publish(const Invalidation& invalidation) override;
+	void subscribe(Handler handler) override;
+
+private:
+	const std::string directory;
+	///The path to which this replica's socket is bound
+	std::string socketPath;
+	int socketFD;
+	std::atomic<bool> stopping;
+	std::thread receiver;
+
+	void receive(Handler handler);
+};
+
+#endif //SLATE_INVALIDATION_BUS_H
@@ -0,0 +1,63 @@
+#ifndef SLATE_KUBE_API_CLIENT_H
+#define SLATE_KUBE_API_CLIENT_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Process.h"
+
+namespace kubernetes{
+
+///Performs simple, read-only kubectl operations by making requests directly to
+///a cluster's API server, instead of starting a kubectl process. Authenticated
+///connections are kept open and reused, so that repeated queries against the
+///same cluster do not each pay for process startup, kubeconfig parsing, API
+///discovery, and fresh TLS handshakes.
+///Operations which are not understood, and clusters whose credentials are of
+///a kind which is not supported, are declined so that the caller can fall back
+///to running kubectl.
+class APIClient{
+public:
+	APIClient();
+	~APIClient();
+	APIClient(const APIClient&)=delete;
+	APIClient& operator=(const APIClient&)=delete;
+
+	///Attempt to perform a kubectl operation directly
+	///\param configPath the path to the kubeconfig for the target cluster
+	///\param arguments the arguments which would be passed to kubectl
+	///\param result the object into which to place the outcome of the
+	///              operation, formatted as kubectl would produce it
+	///\return true if the operation was performed (whether or not it
+	///        succeeded), false if it must instead be performed with kubectl
+	bool tryRequest(const std::string& configPath,
+	                const std::vector<std::string>& arguments,
+	                commandResult& result);
+
+private:
+	struct Connection;
+	struct Request;
+
+	///The maximum number of clusters for which connection state is retained
+	///before state for clusters whose configurations no longer exist is pruned
+	const std::size_t connectionLimit;
+
+	std::mutex connectionsMutex;
+	///Connection state for each cluster, indexed by kubeconfig path
+	std::map<std::string,std::shared_ptr<Connection>> connections;
+
+	///Get or create the connection state for the cluster with the given config
+	std::shared_ptr<Connection> getConnection(const std::string& configPath);
+
+	///Work out what API request corresponds to a set of kubectl arguments
+	///\return false if the arguments do not describe a supported operation
+	static bool translateArguments(const std::vector<std::string>& arguments,
+	                               Request& request);
+};
+
+}
+
+#endif //SLATE_KUBE_API_CLIENT_H
@@ -2,9 +2,15 @@
 #define SLATE_PERSISTENT_STORE_H
 
 #include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <aws/core/Aws.h>
 #include <aws/core/auth/AWSCredentialsProvider.h>
@@ -12,9 +18,13 @@
 
 #include <libcuckoo/cuckoohash_map.hh>
 
-#include <concurrent_multimap.h>
 #include <Entities.h>
+#include <Executor.h>
 #include <FileHandle.h>
+#include <InvalidationBus.h>
+#include <single_flight.h>
+#include <snapshot_multimap.h>
+#include <TokenIndex.h>
 
 //In libstdc++ versions < 5 std::atomic seems to be broken for non-integral types
 //In that case, we must use our own, minimal replacement
@@ -106,8 +116,41 @@ struct hash<std::set<T>>{
 };
 }
 
+///The outcome of a request for a page of a listing
+enum class PageStatus{
+	///The page was fetched
+	Fetched,
+	///The cursor from which the page was requested was not valid
+	InvalidCursor,
+	///The database request failed, so whether the listing continues is unknown
+	DatabaseError,
+};
+
+///A portion of a listing, fetched with a single database request
+template <typename RecordType>
+struct ListPage{
+	ListPage():status(PageStatus::Fetched){}
+	
+	///Indicates whether the requested page could be fetched, and if not, why
+	PageStatus status;
+	///The records on this page. Because the page limit is applied before 
+	///records which do not belong in the listing are filtered out, there may 
+	///be fewer of these than were requested, even if the listing continues.
+	std::vector<RecordType> items;
+	///An opaque position from which the next page of the listing may be 
+	///fetched, or empty if the listing is complete
+	std::string nextCursor;
+	
+	explicit operator bool() const{ return status==PageStatus::Fetched; }
+};
+
 class PersistentStore{
 public:
+	///The largest number of segments into which a scan may be divided. Each 
+	///segment is fetched by its own request, and the segments of a scan are 
+	///fetched at once, so more than this would only flood the database.
+	static const unsigned int maxScanSegments=64;
+	
 	///\param credentials the AWS credentials used for authenitcation with the 
 	///                   database
 	///\param clientConfig specification of the database endpoint to contact
@@ -119,12 +162,30 @@ public:
 	///                            send monitoring data
 	///\param appLoggingServerPort port to which application instances should 
 	///                            send monitoring data
+	///\param scanSegments the number of segments into which full table scans 
+	///                    are divided, to be scanned concurrently; at most 
+	///                    maxScanSegments
+	///\param mirrorSyncInterval if nonzero, the users, VOs, clusters, and 
+	///                          instances tables are loaded into memory at 
+	///                          startup and listed from there, without being 
+	///                          rescanned; changes made by other servers are 
+	///                          picked up every this many seconds
+	///\param invalidationBus if not null, the channel over which this server 
+	///                       and others sharing the database announce the 
+	///                       records they change. Since other servers' changes 
+	///                       then invalidate cached records promptly, records 
+	///                       are cached for longer. 
 	PersistentStore(Aws::Auth::AWSCredentials credentials, 
 	                Aws::Client::ClientConfiguration clientConfig,
 	                std::string bootstrapUserFile,
 	                std::string encryptionKeyFile,
 	                std::string appLoggingServerName,
-	                unsigned int appLoggingServerPort);
+	                unsigned int appLoggingServerPort,
+	                unsigned int scanSegments=4,
+	                unsigned int mirrorSyncInterval=0,
+	                std::unique_ptr<InvalidationBus> invalidationBus=nullptr);
+	
+	~PersistentStore();
 	
 	///Store a record for a new user
 	///\return Whether the user record was successfully added to the database
@@ -135,12 +196,27 @@ public:
 	///\return the corresponding user or an invalid user object if the id is not known
 	User getUser(const std::string& id);
 	
+	///Find information about many users at once
+	///\param ids the IDs of the users to look up
+	///\return the users, in the same order as \p ids. Any which are not known 
+	///        are represented by invalid user objects. 
+	std::vector<User> getUsers(const std::vector<std::string>& ids);
+	
 	///Find the user who owns the given access token. Currently does not bother 
 	///to retreive the user's name, email address, or globus ID. 
 	///\param token access token
 	///\return the token owner or an invalid user object if the token is not known
 	User findUserByToken(const std::string& token);
 	
+	///Find the owner of an access token, for authorizing a request. This is 
+	///cheaper than findUserByToken, since once the token has been seen it 
+	///neither copies the user's record nor allocates. Entries which will soon 
+	///expire are reloaded in the background, like cached records. 
+	///\param token access token
+	///\return the owner's ID and admin flag, or an empty entry if the token is 
+	///        not known
+	TokenIndex::Entry authenticateToken(const char* token);
+	
 	///Find the user corresponding to the given Globus ID. Currently does not bother 
 	///to retreive the user's name, email address, or admin status. 
 	///\param globusID Globus ID to look up
@@ -161,6 +237,14 @@ public:
 	///Compile a list of all current user records
 	///\return all users, but with only IDs, names, and email addresses
 	std::vector<User> listUsers();
+	
+	///Fetch a portion of the list of all user records
+	///\param limit the maximum number of records to examine, or zero to 
+	///             examine as many as fit in one database response
+	///\param cursor the position at which to start, as returned with a 
+	///              previous page, or empty to start at the beginning
+	///\return the page of users, which will be invalid if \p cursor is not
+	ListPage<User> listUsersPage(std::size_t limit, const std::string& cursor);
 
 	///Compile a list of all current user records for the given VO
 	///\return all users from the given VO, but with only IDs, names, and email addresses
@@ -217,6 +301,14 @@ public:
 	///Find all current VOs
 	///\return all recorded VOs
 	std::vector<VO> listVOs();
+	
+	///Fetch a portion of the list of all VOs
+	///\param limit the maximum number of records to examine, or zero to 
+	///             examine as many as fit in one database response
+	///\param cursor the position at which to start, as returned with a 
+	///              previous page, or empty to start at the beginning
+	///\return the page of VOs, which will be invalid if \p cursor is not
+	ListPage<VO> listVOsPage(std::size_t limit, const std::string& cursor);
 
 	///Find all current VOs for the current user
 	///\return all recorded VOs for the current user
@@ -227,6 +319,18 @@ public:
 	///\return the VO corresponding to the ID, or an invalid VO if none exists
 	VO findVOByID(const std::string& id);
 	
+	///Find information about many VOs at once
+	///\param ids the IDs of the VOs to look up
+	///\return the VOs, in the same order as \p ids. Any which are not known 
+	///        are represented by invalid VO objects. 
+	std::vector<VO> getVOs(const std::vector<std::string>& ids);
+	
+	///Find the names of many VOs at once, for use when producing listings
+	///\param ids the IDs of the VOs to look up, which may contain duplicates
+	///\return a mapping from each distinct ID in \p ids to the name of the 
+	///        corresponding VO, or to an empty string if the VO is not known
+	std::unordered_map<std::string,std::string> getVONames(const std::vector<std::string>& ids);
+	
 	///Find the VO, if any, with the given name
 	///\param name the name to look up
 	///\return the VO corresponding to the name, or an invalid VO if none exists
@@ -258,6 +362,14 @@ public:
 	///Find all current clusters
 	///\return all recorded clusters
 	std::vector<Cluster> listClusters();
+	
+	///Fetch a portion of the list of all clusters
+	///\param limit the maximum number of records to examine, or zero to 
+	///             examine as many as fit in one database response
+	///\param cursor the position at which to start, as returned with a 
+	///              previous page, or empty to start at the beginning
+	///\return the page of clusters, which will be invalid if \p cursor is not
+	ListPage<Cluster> listClustersPage(std::size_t limit, const std::string& cursor);
 
 	///Find all current clusters the given VO is allowed to access
 	///\return recorded clusters associated with given VO
@@ -274,6 +386,19 @@ public:
 	///        none exists
 	Cluster findClusterByID(const std::string& id);
 	
+	///Find information about many clusters at once
+	///\param ids the IDs of the clusters to look up
+	///\return the clusters, in the same order as \p ids. Any which are not 
+	///        known are represented by invalid cluster objects. 
+	std::vector<Cluster> getClusters(const std::vector<std::string>& ids);
+	
+	///Find the names of many clusters at once, for use when producing listings
+	///\param ids the IDs of the clusters to look up, which may contain duplicates
+	///\return a mapping from each distinct ID in \p ids to the name of the 
+	///        corresponding cluster, or to an empty string if the cluster is 
+	///        not known
+	std::unordered_map<std::string,std::string> getClusterNames(const std::vector<std::string>& ids);
+	
 	///Find the cluster, if any, with the given name
 	///\param name the name to look up
 	///\return the cluster corresponding to the name, or an invalid cluster if 
@@ -387,6 +512,14 @@ public:
 	///\return all instances, but with only IDs, names, owning VOs, clusters, 
 	///        and creation times
 	std::vector<ApplicationInstance> listApplicationInstances();
+	
+	///Fetch a portion of the list of all application instances
+	///\param limit the maximum number of records to examine, or zero to 
+	///             examine as many as fit in one database response
+	///\param cursor the position at which to start, as returned with a 
+	///              previous page, or empty to start at the beginning
+	///\return the page of instances, which will be invalid if \p cursor is not
+	ListPage<ApplicationInstance> listApplicationInstancesPage(std::size_t limit, const std::string& cursor);
 
 	///Compile a list of all current application instance records with given owningVO or cluster
 	///\return all instances with given owningVO or cluster, but with only IDs, names, owning VOs, clusters, 
@@ -463,6 +596,8 @@ private:
 	const std::string instanceTableName;
 	///Name of the secrets instances table in the database
 	const std::string secretTableName;
+	///Name of the table in which changes to mirrored tables are journaled
+	const std::string changeTableName;
 	
 	///Path to the temporary directory where cluster config files are written 
 	///in order for kubectl and helm to read
@@ -474,36 +609,243 @@ private:
 	cuckoohash_map<std::string,CacheRecord<User>> userCache;
 	cuckoohash_map<std::string,CacheRecord<User>> userByTokenCache;
 	cuckoohash_map<std::string,CacheRecord<User>> userByGlobusIDCache;
-	concurrent_multimap<std::string,CacheRecord<std::string>> userByVOCache;
+	snapshot_multimap<std::string,CacheRecord<std::string>> userByVOCache;
+	///The owners of access tokens, for authenticating requests. Entries expire 
+	///with the cached user records from which they are made.
+	TokenIndex tokenIndex;
 	///duration for which cached VO records should remain valid
 	const std::chrono::seconds voCacheValidity;
 	slate_atomic<std::chrono::steady_clock::time_point> voCacheExpirationTime;
 	cuckoohash_map<std::string,CacheRecord<VO>> voCache;
 	cuckoohash_map<std::string,CacheRecord<VO>> voByNameCache;
-	concurrent_multimap<std::string,CacheRecord<VO>> voByUserCache;
+	snapshot_multimap<std::string,CacheRecord<VO>> voByUserCache;
 	///duration for which cached cluster records should remain valid
 	const std::chrono::seconds clusterCacheValidity;
 	slate_atomic<std::chrono::steady_clock::time_point> clusterCacheExpirationTime;
 	cuckoohash_map<std::string,CacheRecord<Cluster>> clusterCache;
 	cuckoohash_map<std::string,CacheRecord<Cluster>> clusterByNameCache;
-	concurrent_multimap<std::string,CacheRecord<Cluster>> clusterByVOCache;
+	snapshot_multimap<std::string,CacheRecord<Cluster>> clusterByVOCache;
 	cuckoohash_map<std::string,SharedFileHandle> clusterConfigs;
-	concurrent_multimap<std::string,CacheRecord<std::string>> clusterVOAccessCache;
+	snapshot_multimap<std::string,CacheRecord<std::string>> clusterVOAccessCache;
+	///The reverse of clusterVOAccessCache: IDs of clusters to which each VO 
+	///(or the wildcard) has been granted access, keyed by VO ID
+	snapshot_multimap<std::string,CacheRecord<std::string>> voClusterAccessCache;
 	cuckoohash_map<std::string,CacheRecord<std::set<std::string>>> clusterVOApplicationCache;
 	///duration for which cached instance records should remain valid
 	const std::chrono::seconds instanceCacheValidity;
 	slate_atomic<std::chrono::steady_clock::time_point> instanceCacheExpirationTime;
 	cuckoohash_map<std::string,CacheRecord<ApplicationInstance>> instanceCache;
 	cuckoohash_map<std::string,CacheRecord<std::string>> instanceConfigCache;
-	concurrent_multimap<std::string,CacheRecord<ApplicationInstance>> instanceByVOCache;
-	concurrent_multimap<std::string,CacheRecord<ApplicationInstance>> instanceByNameCache;
-	concurrent_multimap<std::string,CacheRecord<ApplicationInstance>> instanceByClusterCache;
-	concurrent_multimap<std::string,CacheRecord<ApplicationInstance>> instanceByVOAndClusterCache;
+	snapshot_multimap<std::string,CacheRecord<ApplicationInstance>> instanceByVOCache;
+	snapshot_multimap<std::string,CacheRecord<ApplicationInstance>> instanceByNameCache;
+	snapshot_multimap<std::string,CacheRecord<ApplicationInstance>> instanceByClusterCache;
+	snapshot_multimap<std::string,CacheRecord<ApplicationInstance>> instanceByVOAndClusterCache;
 	///duration for which cached secret records should remain valid
 	const std::chrono::seconds secretCacheValidity;
 	cuckoohash_map<std::string,CacheRecord<Secret>> secretCache;
-	concurrent_multimap<std::string,CacheRecord<Secret>> secretByVOCache;
-	concurrent_multimap<std::string,CacheRecord<Secret>> secretByVOAndClusterCache;
+	snapshot_multimap<std::string,CacheRecord<Secret>> secretByVOCache;
+	snapshot_multimap<std::string,CacheRecord<Secret>> secretByVOAndClusterCache;
+	///duration for which records of failed membership/access checks should 
+	///remain valid
+	const std::chrono::seconds negativeCacheValidity;
+	///maximum number of records kept in each negative cache
+	const std::size_t negativeCacheLimit;
+	///records of users known not to belong to VOs, keyed by userID:voID
+	cuckoohash_map<std::string,CacheRecord<std::string>> userNotInVOCache;
+	///records of VOs known not to have access to clusters, keyed by 
+	///clusterID:voID, and of clusters known not to grant access to all VOs,
+	///keyed by clusterID:*
+	cuckoohash_map<std::string,CacheRecord<std::string>> voNotOnClusterCache;
+	///Cached records are reloaded in the background when they are used while 
+	///less than 1/refreshAheadFraction of their validity remains
+	const unsigned int refreshAheadFraction;
+	///The number of segments into which full table scans are divided
+	const unsigned int scanSegments;
+	///How often changes journaled by other servers are applied to the 
+	///mirrored tables, or zero if the tables are not mirrored
+	const std::chrono::seconds mirrorSyncInterval;
+	///Distinguishes changes journaled by this server from those of others
+	const std::string changeOrigin;
+	///Counter which keeps the journal keys of this server's changes distinct
+	std::atomic<unsigned long> changeSequence;
+	///The time from which the next synchronization must look for changes
+	std::chrono::system_clock::time_point changeSyncStart;
+	///Keys of journaled changes which have been applied, but which may be 
+	///returned again by the next synchronization
+	std::set<std::string> appliedChanges;
+	std::thread mirrorSyncThread;
+	std::mutex mirrorSyncMutex;
+	std::condition_variable mirrorSyncCond;
+	bool stopMirrorSync;
+	///Channel for announcing changes to other servers, and learning of theirs
+	std::unique_ptr<InvalidationBus> invalidationBus;
+	///When records were last changed, by this server or as announced by 
+	///others, keyed by kind:ID, so that a load which was already reading a 
+	///record does not cache the stale version it read. Entries are discarded 
+	///after a few minutes.
+	cuckoohash_map<std::string,std::chrono::steady_clock::time_point> invalidatedRecords;
+	///When the most recent change was remembered
+	slate_atomic<std::chrono::steady_clock::time_point> lastInvalidation;
+	///Held while old entries are discarded from invalidatedRecords
+	std::mutex invalidationPruneMutex;
+	///When old entries were last discarded from invalidatedRecords; guarded 
+	///by invalidationPruneMutex
+	std::chrono::steady_clock::time_point lastInvalidationPrune;
+	///records which are currently waiting to be reloaded, keyed by kind:key
+	cuckoohash_map<std::string,bool> pendingRefreshes;
+	///database fetches in progress, so that concurrent cache misses for the 
+	///same record share a single query
+	single_flight<User> userFetches;
+	single_flight<VO> voFetches;
+	single_flight<Cluster> clusterFetches;
+	single_flight<ApplicationInstance> instanceFetches;
+	single_flight<std::string> instanceConfigFetches;
+	single_flight<Secret> secretFetches;
+	
+	///Fetch records from the database, bypassing but then updating the caches
+	User loadUser(const std::string& id);
+	User loadUserByToken(const std::string& token);
+	User loadUserByGlobusID(const std::string& globusID);
+	VO loadVOByID(const std::string& id);
+	VO loadVOByName(const std::string& name);
+	Cluster loadClusterByID(const std::string& cID);
+	Cluster loadClusterByName(const std::string& name);
+	ApplicationInstance loadApplicationInstance(const std::string& id);
+	std::string loadApplicationInstanceConfig(const std::string& id);
+	Secret loadSecret(const std::string& id);
+	
+	///Fetch the primary records with the given IDs from a table, using as few 
+	///BatchGetItem requests as possible
+	///\param ids the IDs of the records, which may contain repetitions
+	///\return the items which were found, each once, in no particular order
+	std::vector<Aws::Map<Aws::String,Aws::DynamoDB::Model::AttributeValue>> 
+	batchGetItems(const std::string& tableName, const std::vector<std::string>& ids);
+	
+	///Find the clusters to which a VO has been explicitly granted access, 
+	///using the VOAccess index
+	///\param voID the ID of the VO, or the wildcard to find clusters which 
+	///            allow all VOs
+	///\return the IDs of the clusters
+	std::set<std::string> clustersAccessibleByVO(const std::string& voID);
+	
+	///Perform a query, following LastEvaluatedKey until all pages of results 
+	///have been fetched
+	///\return the outcome of the query, with the items from all pages, or the 
+	///        error from the first request which failed
+	Aws::DynamoDB::Model::QueryOutcome queryAllPages(Aws::DynamoDB::Model::QueryRequest request);
+	
+	///Scan an entire table, dividing it into segments which are scanned 
+	///concurrently
+	///\param request the scan to perform
+	///\param handleItem function called with the index of the segment in which 
+	///                  each item was found and the item itself. It is called 
+	///                  concurrently for items from different segments, but 
+	///                  sequentially for those from the same segment. 
+	///\return false if any segment could not be completely scanned
+	bool parallelScan(Aws::DynamoDB::Model::ScanRequest request, 
+	                  const std::function<void(std::size_t,const Aws::Map<Aws::String,Aws::DynamoDB::Model::AttributeValue>&)>& handleItem);
+	
+	///Fetch a single page of a table scan
+	///\param request the scan to perform
+	///\param limit the maximum number of items to examine, or zero for no limit
+	///\param cursor the encoded key at which to start, or empty to start at the
+	///              beginning of the table
+	///\param items the vector to which the items found are appended
+	///\param nextCursor set to the encoded key from which to continue, or empty
+	///                  if the scan is complete
+	///\return whether the page was fetched, or why it was not
+	PageStatus scanPage(Aws::DynamoDB::Model::ScanRequest request, std::size_t limit, 
+	              const std::string& cursor,
+	              std::vector<Aws::Map<Aws::String,Aws::DynamoDB::Model::AttributeValue>>& items,
+	              std::string& nextCursor);
+	
+	///Fetch a record from the database, unless a fetch of the same record is 
+	///already in progress, in which case wait for and return its result. If 
+	///any record was changed after that fetch began, fetch again, so that 
+	///the result reflects every change made before the call.
+	///\param fetches the record fetches in progress for this type of record
+	///\param kind a name for the lookup, to distinguish its keys from others
+	///\param key the key to look up
+	///\param load the function which fetches the record from the database
+	template <typename RecordType>
+	RecordType fetchOnce(single_flight<RecordType>& fetches, const char* kind, 
+	                     const std::string& key, 
+	                     RecordType (PersistentStore::*load)(const std::string&));
+	
+	///If a cached record which is being used will soon expire, arrange for it 
+	///to be reloaded in the background, so that later lookups continue to hit 
+	///the cache rather than waiting for the database. 
+	///\param record the cached record which was found
+	///\param validity the total validity period for records of this kind
+	///\param fetches the record fetches in progress for this type of record
+	///\param kind a name for the cache, to distinguish its keys from others
+	///\param key the key under which the record was found
+	///\param load the function which fetches the record from the database
+	template <typename RecordType>
+	void refreshIfExpiring(const CacheRecord<RecordType>& record, 
+	                       std::chrono::seconds validity, 
+	                       single_flight<RecordType>& fetches,
+	                       const char* kind, const std::string& key, 
+	                       RecordType (PersistentStore::*load)(const std::string&));
+	
+	///Replace the token index entry for a token with the owner's cached 
+	///record, or remove it if the cache does not hold a valid record. Only 
+	///cached records are indexed, since invalidations find index entries 
+	///through the cache. 
+	///\return the entry as stored, or an empty entry if none was stored
+	TokenIndex::Entry indexToken(const TokenIndex::Digest& digest, const std::string& token);
+	
+	///Queue a background reload, unless one is already pending for the same 
+	///record or the queue is full
+	void scheduleRefresh(const std::string& refreshKey, std::function<void()> load);
+	
+	///\return the time until which a freshly scanned listing of a table may 
+	///        be served from the cache; if tables are mirrored this is forever
+	std::chrono::steady_clock::time_point listingExpiration(std::chrono::seconds validity) const;
+	
+	///Erase all cache entries for a record
+	void uncacheUser(const std::string& id);
+	void uncacheVO(const std::string& voID);
+	void uncacheCluster(const std::string& cID);
+	void uncacheApplicationInstance(const std::string& id);
+	void uncacheSecret(const std::string& id);
+	
+	///If there is an invalidation bus, announce a change to other servers
+	void publishInvalidation(Invalidation invalidation);
+	
+	///Discard cache entries made stale by a change announced by another server
+	void applyInvalidation(const Invalidation& invalidation);
+	
+	///Note that a record has changed. This must be called for every change 
+	///this server makes, once the database has been written but before the 
+	///caches are updated, as well as for changes announced by other servers. 
+	void rememberInvalidation(const std::string& kind, const std::string& id);
+	
+	///\param kind the kind of record, as named in invalidations
+	///\param id the ID of the record
+	///\param start when the database read which returned the record began
+	///\return whether the record was changed after the read began, in which
+	///        case the version read may be stale and must not be cached
+	bool invalidatedSince(const std::string& kind, const std::string& id, 
+	                      std::chrono::steady_clock::time_point start) const;
+	
+	///If tables are mirrored, journal a change to a record so that other 
+	///servers will apply it to their mirrors
+	///\param tableName the table containing the record
+	///\param id the ID of the record which was added, updated, or removed
+	void recordChange(const std::string& tableName, const std::string& id);
+	
+	///Periodically apply changes journaled by other servers, until stopped
+	void runMirrorSync();
+	
+	///Apply the changes which other servers have journaled since the last 
+	///synchronization
+	void syncMirror();
+	
+	///Bring the caches up to date with a record which has changed, reloading 
+	///it or, if it no longer exists, discarding it
+	///\return false if the record could not be fetched
+	bool reloadChangedRecord(const std::string& tableName, const std::string& id);
 	
 	///Check that all necessary tables exist in the database, and create them if 
 	///they do not
@@ -514,6 +856,7 @@ private:
 	void InitializeClusterTable();
 	void InitializeInstanceTable();
 	void InitializeSecretTable();
+	void InitializeChangeTable();
 	
 	void loadEncyptionKey(const std::string& fileName);
 	
@@ -536,6 +879,14 @@ private:
 	///        could not be because it was neither a valid cluster ID nor name. 
 	bool normalizeClusterID(std::string& cID);
 	
+	///Record that a membership or access check had a negative result. 
+	///If the cache has reached its size limit it is emptied first, so that 
+	///it cannot grow without bound when probed with many distinct keys. 
+	///\param cache the negative cache to update
+	///\param key the composite key of the failed check
+	void cacheNegativeResult(cuckoohash_map<std::string,CacheRecord<std::string>>& cache,
+	                         const std::string& key);
+	
 	///The encryption key used for secrets
 	SecretData secretKey;
 	
@@ -544,7 +895,13 @@ private:
 	///The port to which application instances should send monitoring data
 	unsigned int appLoggingServerPort;
 	
-	std::atomic<size_t> cacheHits, databaseQueries, databaseScans;
+	std::atomic<size_t> cacheHits, negativeCacheHits, databaseQueries, databaseScans;
+	std::atomic<size_t> cacheRefreshes, cacheRefreshesDropped;
+	
+	///Thread which reloads cached records before they expire. 
+	///This must be the last member, so that it is destroyed first, while the 
+	///caches its tasks update still exist.
+	Executor refresher;
 };
 
 ///\param store the database in which to look up the user
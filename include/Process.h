@@ -2,6 +2,7 @@
 #define SLATE_PROCESS_H
 
 #include <cerrno>
+#include <chrono>
 #include <istream>
 #include <map>
 #include <ostream>
@@ -53,6 +54,11 @@ public:
 	///been called. 
 	void endInput();
 	
+	///\return the file descriptor to which xsputn writes, or -1
+	int writeFD() const{ return fd_in; }
+	///\return the file descriptor from which underflow reads, or -1
+	int readFD() const{ return fd_out; }
+	
 private:
 	const static std::size_t bufferSize=4096;
 
@@ -127,6 +133,13 @@ public:
 	std::istream& getStderr(){ return(err); }
 	///Close the stream to the child process's stdin
 	void endInput(){ inoutBuf.endInput(); }
+	///Get the raw file descriptors connected to the child process, for callers
+	///which need to multiplex I/O. These should not be mixed with use of the 
+	///corresponding streams, and are not valid if the child was launched 
+	///detachably. 
+	int getStdinFD() const{ return inoutBuf.writeFD(); }
+	int getStdoutFD() const{ return inoutBuf.readFD(); }
+	int getStderrFD() const{ return errBuf.readFD(); }
 	///Give up responsibility for stopping the child process
 	void detach(){
 		child=0;
@@ -138,6 +151,18 @@ public:
 	bool done() const;
 	///Only valid if the child process has not been detached and done() is true
 	char exitStatus() const;
+	///Block until the child process has exited and been reaped. 
+	///Only valid if the child process has not been detached, and requires 
+	///that the reaper is running. 
+	///\return the child process's exit status
+	char wait() const;
+	///Block until the child process has exited and been reaped, or until a 
+	///deadline passes. 
+	///Only valid if the child process has not been detached, and requires 
+	///that the reaper is running. 
+	///\return whether the child process exited before the deadline, in which
+	///        case its exit status is available from exitStatus()
+	bool waitUntil(std::chrono::steady_clock::time_point deadline) const;
 private:
 	pid_t child;
 	ProcessIOBuffer inoutBuf, errBuf;
@@ -152,7 +177,8 @@ private:
 
 ///Reap any child processes which have exited
 void reapProcesses();
-///Spawn a separate thread to periodically run reapProcesses()
+///Spawn a separate thread to run reapProcesses() each time a child process
+///exits
 void startReaper();
 //Stop the background reaping thread
 void stopReaper();
@@ -187,6 +213,19 @@ struct commandResult{
 	int status;
 };
 
+///Optional limits on the resources used by a command run by runCommand
+struct commandOptions{
+	commandOptions():outputLimit(0),timeout(0){}
+	
+	///The maximum total number of bytes which the command may write to its
+	///standard output and error together. A command exceeding this will be
+	///killed. Zero means no limit. 
+	std::size_t outputLimit;
+	///The maximum time the command may run before being killed. Zero means no
+	///limit. 
+	std::chrono::milliseconds timeout;
+};
+
 ///Run an external command
 ///\param command the command to be run. If \p command contains no slashes, a  
 ///               search will be performed in all entries of $PATH (or 
@@ -196,11 +235,15 @@ struct commandResult{
 ///\param env additions and changes to the child command's environment. These 
 ///           are added to the current process's environment to form the full
 ///           child environment. 
+///\param options limits on the command's output and run time. If either is 
+///               exceeded the child is killed, the status is -1, and a note is
+///               appended to the error output. 
 ///\return a structure containing all data written by the child process to its
 ///        standard ouput and error and the child process's exit status
 commandResult runCommand(const std::string& command, 
                          const std::vector<std::string>& args={}, 
-                         const std::map<std::string,std::string>& env={});
+                         const std::map<std::string,std::string>& env={},
+                         const commandOptions& options=commandOptions());
 
 ///Run an external command, sending given data to its standard input
 ///\param command the command to be run. If \p command contains no slashes, a  
@@ -212,11 +255,13 @@ commandResult runCommand(const std::string& command,
 ///\param env additions and changes to the child command's environment. These 
 ///           are added to the current process's environment to form the full
 ///           child environment. 
+///\param options limits on the command's output and run time
 ///\return a structure containing all data written by the child process to its
 ///        standard ouput and error and the child process's exit status
 commandResult runCommandWithInput(const std::string& command, 
                                   const std::string& input,
                                   const std::vector<std::string>& args={}, 
-                                  const std::map<std::string,std::string>& env={});
+                                  const std::map<std::string,std::string>& env={},
+                                  const commandOptions& options=commandOptions());
 
 #endif //SLATE_PROCESS_H
\ No newline at end of file
@@ -0,0 +1,132 @@
+#ifndef SLATE_TOKEN_INDEX_H
+#define SLATE_TOKEN_INDEX_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+///Maps digests of access tokens to the little which is needed to authorize a
+///request: who the user is and whether they are an administrator.
+///Lookups neither lock nor allocate: entries are fixed-size and each is
+///guarded by a sequence counter, so a reader which overlaps a write simply
+///reads again. Writers are serialized by a mutex. When the table is replaced,
+///the old one is freed as soon as no lookup which began before the 
+///replacement is still in progress.
+class TokenIndex{
+public:
+	///A SHA-256 digest of a token
+	using Digest=std::array<uint8_t,32>;
+
+	///What is known about the owner of a token
+	struct Entry{
+		///The longest user ID which can be indexed
+		static const std::size_t maxUserIDLength=64;
+
+		Entry():admin(false),userIDLength(0){}
+		///Construct an entry which is not stored in any index
+		///\throws std::length_error if userID is longer than maxUserIDLength
+		Entry(const std::string& userID, bool admin, 
+		      std::chrono::steady_clock::time_point expirationTime);
+
+		///\return the owning user's ID, or an empty string if no user was 
+		///        found
+		std::string userID() const{ return std::string(userIDData,userIDLength); }
+		bool admin;
+		///The time after which the entry must not be used
+		std::chrono::steady_clock::time_point expirationTime;
+
+		explicit operator bool() const{ return userIDLength; }
+	private:
+		friend class TokenIndex;
+		///The ID is copied out of the index, so the entry stays valid however
+		///the index changes afterwards
+		char userIDData[maxUserIDLength];
+		std::size_t userIDLength;
+	};
+
+	TokenIndex();
+	TokenIndex(const TokenIndex&)=delete;
+	TokenIndex& operator=(const TokenIndex&)=delete;
+
+	///Compute the digest of a token
+	static Digest digest(const char* token, std::size_t length);
+	static Digest digest(const std::string& token){ return digest(token.data(),token.size()); }
+
+	///Look up a token
+	///\param digest the digest of the token
+	///\return the entry for the token, which is empty if it is not indexed
+	///        or has expired
+	Entry find(const Digest& digest) const;
+
+	///Add or replace the entry for a token
+	///\return the entry as stored
+	///\throws std::length_error if userID is longer than 
+	///        Entry::maxUserIDLength
+	Entry insert(const Digest& digest, const std::string& userID, bool admin,
+	            std::chrono::steady_clock::time_point expirationTime);
+
+	///Remove the entry for a token, if there is one
+	void erase(const Digest& digest);
+
+private:
+	static const uint32_t empty=0, full=1, removed=2;
+	static const std::size_t userIDWords=Entry::maxUserIDLength/sizeof(uint64_t);
+
+	///Slots are made of atomic words so that readers may copy them while
+	///they are being overwritten, detecting this with the version counter
+	struct Slot{
+		///Odd while the slot is being written
+		std::atomic<uint32_t> version;
+		///One of the slot states above
+		std::atomic<uint32_t> state;
+		std::atomic<uint64_t> digest[4];
+		///The user ID is stored in the slot, so that nothing outside the 
+		///table needs to be kept alive for readers
+		std::atomic<uint64_t> userID[userIDWords];
+		std::atomic<uint32_t> userIDLength;
+		std::atomic<bool> admin;
+		std::atomic<std::chrono::steady_clock::rep> expiration;
+
+		Slot():version(0),state(empty),digest{},userID{},userIDLength(0),admin(false),expiration(0){}
+	};
+
+	struct Table{
+		explicit Table(std::size_t capacity):capacity(capacity),slots(new Slot[capacity]){}
+		const std::size_t capacity;
+		std::unique_ptr<Slot[]> slots;
+	};
+
+	///The table which lookups should use
+	std::atomic<const Table*> current;
+	///The table which writers modify, which is the same as current
+	std::unique_ptr<Table> table;
+	///Incremented each time a table is retired
+	std::atomic<uint32_t> epoch;
+	///The numbers of lookups in progress which began in even and odd epochs
+	mutable std::atomic<uint32_t> readers[2];
+	///Serializes writers
+	std::mutex writeMutex;
+	///Number of full and removed slots in the current table
+	std::size_t used, live;
+
+	///Write a slot of a table. Must be called with writeMutex held.
+	static void writeSlot(Slot& slot, uint32_t state, const uint64_t* words,
+	                      const uint64_t* userID, uint32_t userIDLength, bool admin,
+	                      std::chrono::steady_clock::rep expiration);
+	///Find the slot in which a digest is stored, or should be stored
+	///\return the slot index, or the capacity if there is none
+	static std::size_t probe(const Table& table, const uint64_t* words, bool forInsertion);
+	///Replace the current table with one large enough for the live entries
+	///and at least one more, dropping any which have expired. Must be called
+	///with writeMutex held.
+	void rebuild();
+	///Wait until no lookup can still be using a table which has been replaced,
+	///so that it can be freed. Must be called with writeMutex held.
+	void waitForReaders();
+};
+
+#endif //SLATE_TOKEN_INDEX_H
@@ -6,7 +6,9 @@
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
 
+#include <memory>
 #include <sstream>
+#include <vector>
 #include "Entities.h"
 
 ///\return a timestamp rendered as a string with format "YYYY-mmm-DD HH:MM:SS UTC"
@@ -93,6 +95,17 @@ std::vector<std::string> string_split_columns(const std::string& line, char deli
 ///Remove leading an trailing whitespace from a string
 std::string trim(const std::string& s);
 
+///Extract the URL parameters with which a client requests a single page of a 
+///listing: 'limit', the maximum number of records to examine, and 'cursor', 
+///the position at which the previous page ended
+///\param req the request
+///\param paged set to whether either parameter was given
+///\param limit set to the requested limit, or zero if none was given
+///\param cursor set to the requested cursor, or empty if none was given
+///\return false if the limit is not a valid, positive number
+bool getPageParameters(const crow::request& req, bool& paged, std::size_t& limit, 
+                       std::string& cursor);
+
 ///Construct a compacted YAML string with whitespace only lines and comments
 ///removed
 std::string reduceYAML(const std::string& input);
@@ -105,5 +118,66 @@ std::string to_string(const JSONDocument& json){
 	return buf.GetString();
 }
 
+///The type of JSON writer with which items are written to streamed responses
+using JSONWriter=rapidjson::Writer<rapidjson::StringBuffer>;
+
+///Construct a response containing a list of items, of the form
+///{"apiVersion":"v1alpha1","items":[...]}, which is serialized only as it is 
+///sent, using chunked transfer encoding. The serialized list is therefore never
+///held in memory all at once, and the start of it can be sent before the rest 
+///has been produced. 
+///\param items the items to list
+///\param nextCursor if not empty, included as the list's 'nextCursor', the 
+///                  position from which a client may request the next page
+///\param writeItem a function with signature void(JSONWriter&, const Item&) 
+///                 which writes a single item as a JSON object. It is called 
+///                 after the handler which constructed the response returns, 
+///                 so it must not refer to any of that handler's local 
+///                 variables.
+template<typename Item, typename ItemWriter>
+crow::response streamJSONList(std::vector<Item> items, std::string nextCursor, 
+                              ItemWriter writeItem){
+	struct State{
+		State(std::vector<Item>&& items, std::string&& nextCursor, ItemWriter&& writeItem):
+		items(std::move(items)),nextCursor(std::move(nextCursor)),
+		writeItem(std::move(writeItem)),next(0),writer(buffer){}
+		
+		std::vector<Item> items;
+		std::string nextCursor;
+		ItemWriter writeItem;
+		///the index of the next item to be written
+		std::size_t next;
+		rapidjson::StringBuffer buffer;
+		JSONWriter writer;
+	};
+	auto state=std::make_shared<State>(std::move(items),std::move(nextCursor),std::move(writeItem));
+	state->writer.StartObject();
+	state->writer.Key("apiVersion");
+	state->writer.String("v1alpha1");
+	state->writer.Key("items");
+	state->writer.StartArray();
+	
+	crow::response res;
+	res.set_body_source([state](std::string& chunk)->bool{
+		//serialize items until a reasonable amount of data is ready to send
+		const std::size_t chunkSize=64*1024;
+		while(state->next<state->items.size() && state->buffer.GetSize()<chunkSize)
+			state->writeItem(state->writer,state->items[state->next++]);
+		bool more=state->next<state->items.size();
+		if(!more){
+			state->writer.EndArray();
+			if(!state->nextCursor.empty()){
+				state->writer.Key("nextCursor");
+				state->writer.String(state->nextCursor);
+			}
+			state->writer.EndObject();
+		}
+		chunk.append(state->buffer.GetString(),state->buffer.GetSize());
+		state->buffer.Clear();
+		return more;
+	});
+	return res;
+}
+
 
 #endif //SLATE_UTILITIES_H
@@ -191,6 +191,19 @@ public:
 		return updated;
 	}
 
+	///Sets the expiration time of the category associated with \p key,
+	///creating an empty category if the key is not in the table. This allows
+	///the knowledge that a key maps to no values to be cached.
+	///\tparam K type of the key
+	///\param key the key for which to set expiration time
+	///\param time the expiration time to set
+	template <typename K>
+	void set_expiration(K&& key, steady_clock::time_point time){
+		data.upsert(std::forward<K>(key),
+		            [&](category_type& cat){ cat.second=time; },
+		            set_type(),time);
+	}
+
 	///Returns whether or not \p key is in the table.
 	///\tparam K type of the key
 	///\param k the key for which to search
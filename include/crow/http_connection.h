@@ -5,6 +5,7 @@
 #include <boost/array.hpp>
 #include <atomic>
 #include <chrono>
+#include <sstream>
 #include <vector>
 
 #include "crow/http_parser_merged.h"
@@ -250,12 +251,22 @@ namespace crow
 
         void handle()
         {
+            if (stream_source_)
+            {
+                // a pipelined request arrived while a streamed body is still 
+                // being written; it cannot be answered on this connection, so 
+                // close it once the body is complete, and let the client retry
+                close_connection_ = true;
+                return;
+            }
             cancel_deadline_timer();
             bool is_invalid_request = false;
             add_keep_alive_ = false;
 
             req_ = std::move(parser_.to_request());
             request& req = req_;
+            // chunked transfer encoding is only understood by HTTP/1.1 clients
+            chunked_allowed_ = parser_.check_version(1, 1);
 
             if (parser_.check_version(1, 0))
             {
@@ -402,7 +413,17 @@ namespace crow
                 buffers_.emplace_back(status.data(), status.size());
             }
 
-            if (res.code >= 400 && res.body.empty())
+            if (res.body_source_ && !chunked_allowed_)
+            {
+                // the client cannot receive the body in pieces, so collect 
+                // all of it to send at once
+                while (res.body_source_(res.body));
+                res.body_source_ = nullptr;
+            }
+            stream_source_ = std::move(res.body_source_);
+            res.body_source_ = nullptr;
+
+            if (res.code >= 400 && res.body.empty() && !stream_source_)
                 res.body = statusCodes[res.code].substr(9);
 
             for(auto& kv : res.headers)
@@ -414,7 +435,13 @@ namespace crow
 
             }
 
-            if (!res.headers.count("content-length"))
+            if (stream_source_)
+            {
+                static std::string transfer_encoding_tag = "Transfer-Encoding: chunked";
+                buffers_.emplace_back(transfer_encoding_tag.data(), transfer_encoding_tag.size());
+                buffers_.emplace_back(crlf.data(), crlf.size());
+            }
+            else if (!res.headers.count("content-length"))
             {
                 content_length_ = std::to_string(res.body.size());
                 static std::string content_length_tag = "Content-Length: ";
@@ -450,7 +477,9 @@ namespace crow
 
             do_write();
 
-            if (need_to_start_read_after_complete_)
+            // if the body is being streamed, reading resumes once all of it 
+            // has been written
+            if (need_to_start_read_after_complete_ && !stream_source_)
             {
                 need_to_start_read_after_complete_ = false;
                 start_deadline();
@@ -490,10 +519,13 @@ namespace crow
                         cancel_deadline_timer();
                         parser_.done();
                         is_reading = false;
-                        check_destroy();
+                        // if the response will be completed later by the user
+                        // the connection must survive until it is written
+                        if (!need_to_call_after_handlers_)
+                            check_destroy();
                         // adaptor will close after write
                     }
-                    else if (!need_to_call_after_handlers_)
+                    else if (!need_to_call_after_handlers_ && !stream_source_)
                     {
                         start_deadline();
                         do_read();
@@ -514,6 +546,12 @@ namespace crow
                 [&](const boost::system::error_code& ec, std::size_t /*bytes_transferred*/)
                 {
                     is_writing = false;
+                    if (!ec && stream_source_)
+                    {
+                        do_write_chunk();
+                        return;
+                    }
+                    stream_source_ = nullptr;
                     res.clear();
                     res_body_copy_.clear();
                     if (!ec)
@@ -524,6 +562,13 @@ namespace crow
                             CROW_LOG_DEBUG << this << " from write(1)";
                             check_destroy();
                         }
+                        else if (need_to_start_read_after_complete_ && !need_to_call_after_handlers_)
+                        {
+                            // a streamed body has been completely written
+                            need_to_start_read_after_complete_ = false;
+                            start_deadline();
+                            do_read();
+                        }
                     }
                     else
                     {
@@ -533,6 +578,50 @@ namespace crow
                 });
         }
 
+        void do_write_chunk()
+        {
+            static std::string crlf = "\r\n";
+            static std::string last_chunk = "0\r\n\r\n";
+
+            res_body_copy_.clear();
+            bool more = true;
+            try
+            {
+                // an empty piece would be taken as the end of the body
+                while (more && res_body_copy_.empty())
+                    more = stream_source_(res_body_copy_);
+            }
+            catch (std::exception& e)
+            {
+                // the status has already been sent, so the only way to report
+                // failure is to cut the body short
+                CROW_LOG_ERROR << "An uncaught exception occurred while streaming a response: " << e.what();
+                stream_source_ = nullptr;
+                res.clear();
+                res_body_copy_.clear();
+                adaptor_.close();
+                check_destroy();
+                return;
+            }
+
+            buffers_.clear();
+            if (!res_body_copy_.empty())
+            {
+                std::ostringstream size;
+                size << std::hex << res_body_copy_.size() << "\r\n";
+                chunk_size_ = size.str();
+                buffers_.emplace_back(chunk_size_.data(), chunk_size_.size());
+                buffers_.emplace_back(res_body_copy_.data(), res_body_copy_.size());
+                buffers_.emplace_back(crlf.data(), crlf.size());
+            }
+            if (!more)
+            {
+                stream_source_ = nullptr;
+                buffers_.emplace_back(last_chunk.data(), last_chunk.size());
+            }
+            do_write();
+        }
+
         void check_destroy()
         {
             CROW_LOG_DEBUG << this << " is_reading " << is_reading << " is_writing " << is_writing;
@@ -582,6 +671,8 @@ namespace crow
         std::string content_length_;
         std::string date_str_;
         std::string res_body_copy_;
+        std::string chunk_size_;
+        std::function<bool(std::string&)> stream_source_;
 
         //boost::asio::deadline_timer deadline_;
         detail::dumb_timer_queue::key timer_cancel_key_;
@@ -591,6 +682,7 @@ namespace crow
         bool need_to_call_after_handlers_{};
         bool need_to_start_read_after_complete_{};
         bool add_keep_alive_{};
+        bool chunked_allowed_{};
 
         std::tuple<Middlewares...>* middlewares_;
         detail::context<Middlewares...> ctx_;
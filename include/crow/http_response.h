@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <string>
 #include <unordered_map>
 
@@ -69,6 +70,7 @@ namespace crow
             code = r.code;
             headers = std::move(r.headers);
             completed_ = r.completed_;
+            body_source_ = std::move(r.body_source_);
             return *this;
         }
 
@@ -84,6 +86,7 @@ namespace crow
             code = 200;
             headers.clear();
             completed_ = false;
+            body_source_ = nullptr;
         }
 
         void redirect(const std::string& location)
@@ -97,6 +100,21 @@ namespace crow
             body += body_part;
         }
 
+        // Instead of sending `body', obtain the body piece by piece from 
+        // `source' as it is sent, using chunked transfer encoding. `source' 
+        // is called on the connection's thread each time the previous piece 
+        // has been written; it should append the next piece to its argument 
+        // and return false once the body is complete. 
+        void set_body_source(std::function<bool(std::string&)> source)
+        {
+            body_source_ = std::move(source);
+        }
+
+        bool is_streamed() const noexcept
+        {
+            return static_cast<bool>(body_source_);
+        }
+
         void end()
         {
             if (!completed_)
@@ -125,6 +143,7 @@ namespace crow
             bool completed_{};
             std::function<void()> complete_request_handler_;
             std::function<bool()> is_alive_helper_;
+            std::function<bool(std::string&)> body_source_;
 
             //In case of a JSON object, set the Content-Type header
             void json_mode()
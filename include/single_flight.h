@@ -0,0 +1,90 @@
+#ifndef SLATE_SINGLE_FLIGHT_H
+#define SLATE_SINGLE_FLIGHT_H
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+///Coalesces concurrent requests for the same key, so that only one caller
+///performs the (expensive) fetch while any others which arrive before it
+///finishes wait for and share its result.
+///Nothing is retained once a fetch completes; this is not a cache, but a way
+///to prevent many simultaneous cache misses from all going to the backing store.
+template<typename Value>
+class single_flight{
+public:
+	single_flight():coalesced(0){}
+	single_flight(const single_flight&)=delete;
+	single_flight& operator=(const single_flight&)=delete;
+
+	///Obtain the value for a key, either by calling fetch or, if another
+	///thread is already fetching the same key, by waiting for its result.
+	///\param key the key being looked up
+	///\param fetch callable which produces the value for the key
+	///\param started if not null, set to the time at which the fetch whose 
+	///               result is returned began. When this is earlier than the 
+	///               call, the result may predate changes made before the call.
+	///\return the fetched value
+	///\throws whatever fetch throws, to the caller which ran it and to all
+	///        callers which waited for it
+	template<typename Fetch>
+	Value run(const std::string& key, Fetch fetch, 
+	          std::chrono::steady_clock::time_point* started=nullptr){
+		std::promise<Value> promise;
+		Flight flight;
+		bool joined=false;
+		{
+			std::lock_guard<std::mutex> lock(mut);
+			auto it=inFlight.find(key);
+			if(it!=inFlight.end()){
+				flight=it->second;
+				joined=true;
+			}
+			else{
+				flight=Flight{promise.get_future().share(),std::chrono::steady_clock::now()};
+				inFlight.emplace(key,flight);
+			}
+		}
+		if(started)
+			*started=flight.started;
+		if(joined){ //someone else is already fetching this key
+			coalesced++;
+			return flight.result.get();
+		}
+		try{
+			Value value=fetch();
+			promise.set_value(value);
+			finish(key);
+			return value;
+		}catch(...){
+			promise.set_exception(std::current_exception());
+			finish(key);
+			throw;
+		}
+	}
+
+	///\return the number of calls which were satisfied by waiting for another
+	///        caller's fetch
+	std::size_t coalescedCount() const{ return coalesced.load(); }
+
+private:
+	struct Flight{
+		std::shared_future<Value> result;
+		std::chrono::steady_clock::time_point started;
+	};
+	
+	std::mutex mut;
+	std::unordered_map<std::string,Flight> inFlight;
+	std::atomic<std::size_t> coalesced;
+
+	void finish(const std::string& key){
+		std::lock_guard<std::mutex> lock(mut);
+		inFlight.erase(key);
+	}
+};
+
+#endif //SLATE_SINGLE_FLIGHT_H
@@ -0,0 +1,325 @@
+#ifndef SLATE_SNAPSHOT_MULTIMAP_H
+#define SLATE_SNAPSHOT_MULTIMAP_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <unordered_set>
+
+#include <libcuckoo/cuckoohash_map.hh>
+
+///A multimap with the same interface as concurrent_multimap, except that
+///looking up a key yields a shared, immutable snapshot of the values to which
+///it maps, rather than a copy of them. This makes reading a large category
+///cost one reference count increment, instead of allocating and copying every
+///value while holding the bucket lock.
+///The values for each key are copied on write: a modification replaces the
+///set with a modified copy if any reader still holds a snapshot of it, and
+///otherwise modifies it in place, so filling a category which nobody is
+///reading does not repeatedly copy it.
+///Like concurrent_multimap, operations on the same key contend for the same
+///bucket lock.
+template<typename Key, typename Value,
+         typename KeyHash=std::hash<Key>, typename KeyEqual=std::equal_to<Key>,
+         typename ValueHash=std::hash<Value>, typename ValueEqual=std::equal_to<Value>>
+class snapshot_multimap{
+public:
+	using steady_clock=std::chrono::steady_clock;
+	///The collection of values to which a key maps
+	using set_type=std::unordered_set<Value,ValueHash,ValueEqual>;
+	///A read-only view of the values to which a key mapped at the time of a
+	///lookup, which later modifications do not affect. Never null.
+	using snapshot_type=std::shared_ptr<const set_type>;
+	///The set of values the key maps to with its associated expiration time
+	using category_type=std::pair<snapshot_type,steady_clock::time_point>;
+	using key_type=Key;
+	using mapped_type=Value;
+private:
+	struct empty_bucket{};
+	struct bucket_type{
+		explicit bucket_type(const Value& val):
+		items(std::make_shared<set_type>()),expiration(steady_clock::now()){
+			items->emplace(val);
+		}
+		bucket_type(empty_bucket, steady_clock::time_point expiration):
+		items(std::make_shared<set_type>()),expiration(expiration){}
+		std::shared_ptr<set_type> items;
+		steady_clock::time_point expiration;
+	};
+public:
+	///The underlying hash table type
+	using Table=cuckoohash_map<Key,bucket_type,KeyHash,KeyEqual>;
+	using size_type=typename Table::size_type;
+
+	snapshot_multimap(){}
+	///Snapshots are shared between the copies until either is modified.
+	///If other is being modified concurrently, behavior is unspecified.
+	snapshot_multimap(const snapshot_multimap& other):data(other.data){}
+	///If other is being modified concurrently, behavior is unspecified.
+	snapshot_multimap(snapshot_multimap&& other):data(std::move(other.data)){}
+	~snapshot_multimap(){}
+
+	///If this or other is being modified concurrently, behavior is unspecified.
+	snapshot_multimap& operator=(const snapshot_multimap& other){
+		if(&other!=this)
+			data=other.data;
+		return *this;
+	}
+	///If this or other is being modified concurrently, behavior is unspecified.
+	snapshot_multimap& operator=(snapshot_multimap&& other){
+		if(&other!=this)
+			data=std::move(other.data);
+		return *this;
+	}
+
+	//concurrency-safe access and manipulation functions
+
+	///Removes all elements in the table. Outstanding snapshots remain valid.
+	void clear(){ data.clear(); }
+
+	///Reserve enough space in the table for the given number of keys.
+	///\param n	the number of keys to reserve space for
+	///\return true if the size of the table changed, false otherwise
+	bool reserve(size_type n){ return data.reserve(n); }
+
+	///Resizes the table to the given hashpower.
+	///\param n	the hashpower to set for the table
+	///\return true if the table changed size, false otherwise
+	bool rehash(size_type n){ return data.rehash(n); }
+
+	///Erases the key from the table.
+	///\tparam K type of the key
+	///\param k the key to be removed
+	///\return the number of items to which the key mapped which were removed
+	template <typename K>
+	size_type erase(const K& k){
+		size_type erased=0;
+		data.erase_fn(k,[&erased](const bucket_type& bucket){
+			erased=bucket.items->size();
+			return true;
+		});
+		return erased;
+	}
+
+	///Erases the mapping of the key to a single value from the table, leaving
+	///any other values to which that key may map.
+	///\tparam K type of the key
+	template <typename K>
+	size_type erase(const K& k, const mapped_type& v){
+		size_type erased=0;
+		data.erase_fn(k,[&erased,&v](bucket_type& bucket){
+			if(bucket.items->count(v))
+				erased=writable(bucket).erase(v);
+			return bucket.items->empty(); //only erase whole category if empty
+		});
+		return erased;
+	}
+
+	///Searches the table for \p k and returns a snapshot of the values
+	///associated with it.
+	///\tparam K type of the key
+	///\param k the key for which to search
+	///\return the collection of values associated with the key and its
+	///        expiration time, or an empty collection which is already expired
+	///        if the key is not found
+	template <typename K>
+	category_type find(const K& key) const{
+		category_type items(empty_snapshot(),steady_clock::time_point());
+		data.find_fn(key,[&items](const bucket_type& bucket){
+			items.first=bucket.items;
+			items.second=bucket.expiration;
+		});
+		return items;
+	}
+
+	///Calls \p fn with each value associated with \p key, while holding the
+	///bucket lock. \p fn must not access this map.
+	///\tparam K type of the key
+	///\tparam F a callable taking a const mapped_type&
+	///\return true if the key was found
+	template <typename K, typename F>
+	bool visit(const K& key, F fn) const{
+		return data.find_fn(key,[&fn](const bucket_type& bucket){
+			for(const auto& item : *bucket.items)
+				fn(item);
+		});
+	}
+
+	///Inserts the key-value pair into the table. If the pair is already in the
+	///table, the version of \p val which was already present is replaced with
+	///the new one.
+	///\tparam K type of the key
+	///\param key the key for which to search
+	///\param val the value for which to search
+	///\return true if the pair was newly inserted, false if it was already present
+	template<typename K, typename V>
+	bool insert_or_assign(K&& key, V&& val){
+		bool inserted=true;
+		//the bucket is constructed only if the key is new
+		data.upsert(std::forward<K>(key),
+		            [&](bucket_type& bucket){
+		            	set_type& items=writable(bucket);
+		            	if(items.count(val)){
+		            		inserted=false;
+		            		//ensure replacement
+		            		items.erase(val);
+		            	}
+		            	items.emplace(val);
+		            },val);
+		return inserted;
+	}
+
+	///Inserts the key-value pair into the table.
+	///\returns true if the pair was newly inserted, false if it was already present
+	template<typename K, typename V>
+	bool insert(K&& key, V&& val){
+		bool inserted=true;
+		data.upsert(std::forward<K>(key),
+		            [&](bucket_type& bucket){
+		            	if(!bucket.items->count(val))
+		            		writable(bucket).emplace(val);
+		            	else
+		            		inserted=false;
+		            },val);
+		return inserted;
+	}
+
+	///Updates the key-value pair in the table. If the pair is already in the
+	///table, the version of \p val which was already present is replaced with
+	///the new one, otherwise does nothing.
+	///\tparam K type of the key
+	///\tparam V type of the value
+	///\param key the key for which to search
+	///\param val the value for which to search
+	///\return true if the entry was updated, false if it was not found
+	template<typename K, typename V>
+	bool update(K&& key, V&& val){
+		bool updated=false;
+		data.update_fn(key,[&](bucket_type& bucket){
+			if(bucket.items->count(val)){
+				updated=true;
+				//ensure replacement
+				set_type& items=writable(bucket);
+				items.erase(val);
+				items.emplace(val);
+			}
+		});
+		return updated;
+	}
+
+	///Updates the expiration time of a category associated with \p key
+	///\tparam K type of the key
+	///\param key the key for which to update expiration time
+	///\param time the expiration time to update to
+	///\return true is the expiration time was updated, false if the key was not found
+	template <typename K>
+	bool update_expiration(K&& key, steady_clock::time_point time){
+		return data.update_fn(key,[&](bucket_type& bucket){
+			bucket.expiration=time;
+		});
+	}
+
+	///Sets the expiration time of the category associated with \p key,
+	///creating an empty category if the key is not in the table. This allows
+	///the knowledge that a key maps to no values to be cached.
+	///\tparam K type of the key
+	///\param key the key for which to set expiration time
+	///\param time the expiration time to set
+	template <typename K>
+	void set_expiration(K&& key, steady_clock::time_point time){
+		data.upsert(std::forward<K>(key),
+		            [&](bucket_type& bucket){ bucket.expiration=time; },
+		            empty_bucket(),time);
+	}
+
+	///Returns whether or not \p key is in the table.
+	///\tparam K type of the key
+	///\param k the key for which to search
+	///\return true if the key maps to at least one value in the table
+	template <typename K>
+	bool contains(const K& key) const{
+		return data.contains(key);
+	}
+
+	///Returns whether or not the pair \p key -> \p val is in the table.
+	///\tparam K type of the key
+	///\tparam V type of the value
+	///\param key the key for which to search
+	///\param val the value for which to search
+	///\return true if the key,value pair is in the table
+	template <typename K, typename V>
+	bool contains(const K& key, V&& val) const{
+		bool found=false;
+		data.find_fn(key,[&](const bucket_type& bucket){ found=bucket.items->count(val); });
+		return found;
+	}
+
+	///Get the number of values associated with a key
+	///\tparam K type of the key
+	///\param k the key for which to search
+	///\return the number of values associated with \p key; 0 if it is not in
+	///        the map
+	template <typename K>
+	size_type count(const K& k) const{
+		size_type n=0;
+		data.find_fn(k,[&n](const bucket_type& bucket){ n=bucket.items->size(); });
+		return n;
+	}
+
+	///Get the number of occurances of a key,value pair
+	///\tparam K type of the key
+	///\tparam V type of the value
+	///\param k the key for which to search
+	///\param v the value for which to search
+	///\return 1 if the pair is associated in the map, zero if not
+	template <typename K, typename V>
+	size_type count(const K& k, V&& v) const{
+		size_type n=0;
+		data.find_fn(k,[&](const bucket_type& bucket){ n=bucket.items->count(v); });
+		return n;
+	}
+
+	///Looks up the stored copy of a value associated with a key.
+	///\tparam K type of the key
+	///\tparam V type of the value
+	///\param key the key for which to search
+	///\param val the value for which to search, which is overwritten with the
+	///           stored value if it is found
+	///\return true if the key,value pair is in the table
+	template <typename K, typename V>
+	bool find(const K& key, V&& val) const{
+		bool found=false;
+		data.find_fn(key,[&](const bucket_type& bucket){
+			auto it=bucket.items->find(val);
+			found=(it!=bucket.items->end());
+			if(found)
+				val=*it;
+		});
+		return found;
+	}
+
+private:
+	Table data;
+
+	///Get a set of values which may be modified without affecting any
+	///snapshot. Must be called with the bucket's lock held.
+	static set_type& writable(bucket_type& bucket){
+		//Snapshots are only ever taken with the bucket lock held, so while we
+		//hold it the count cannot rise. It can fall concurrently, in which
+		//case we make a copy which was not needed.
+		if(bucket.items.use_count()>1)
+			bucket.items=std::make_shared<set_type>(*bucket.items);
+		else //order the last reader's accesses before our modifications
+			std::atomic_thread_fence(std::memory_order_acquire);
+		return *bucket.items;
+	}
+
+	///A shared empty set, so that snapshots are never null
+	static const snapshot_type& empty_snapshot(){
+		static const snapshot_type empty=std::make_shared<const set_type>();
+		return empty;
+	}
+};
+
+#endif //SLATE_SNAPSHOT_MULTIMAP_H
@@ -1,5 +1,7 @@
 #include "ApplicationCommands.h"
 
+#include <functional>
+
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
@@ -34,28 +36,7 @@ std::string getRepoName(Application::Repository repo){
 	}
 }
 
-///Remove all text contained between the strings
-///"### SLATE-START ###" and "### SLATE-END ###"
-std::string filterValuesFile(std::string data){
-	const static std::string startMarker="### SLATE-START ###";
-	const static std::string endMarker="### SLATE-END ###";
-	std::size_t pos=0;
-	while(true){
-		std::size_t startPos=data.find(startMarker,pos);
-		if(startPos==std::string::npos)
-			break;
-		std::size_t endPos=data.find(endMarker,startPos);
-		if(endPos==std::string::npos){
-			log_error("Unbalanced SLATE-internal markers in values data");
-			break;
-		}
-		data.erase(startPos,endPos-startPos + endMarker.size());
-		pos=startPos;
-	}
-	return data;
-}
-
-crow::response listApplications(PersistentStore& store, const crow::request& req){
+crow::response listApplications(PersistentStore& store, const HelmCatalog& catalog, const crow::request& req){
 	const User user=authenticateUser(store, req.url_params.get("token"));
 	log_info(user << " requested to list applications");
 	if(!user)
@@ -63,13 +44,7 @@ crow::response listApplications(PersistentStore& store, const crow::request& req
 	//All users are allowed to list applications
 
 	std::string repoName=getRepoName(selectRepo(req));
-	
-	auto commandResult=runCommand("helm", {"search",repoName+"/"});
-	if(commandResult.status){
-		log_error("helm search failed: " << commandResult.error);
-		return crow::response(500,generateError("helm search failed"));
-	}
-	std::vector<std::string> lines = string_split_lines(commandResult.output);
+	auto charts=catalog.listCharts(repoName);
 
 	rapidjson::Document result(rapidjson::kObjectType);
 	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
@@ -77,34 +52,18 @@ crow::response listApplications(PersistentStore& store, const crow::request& req
 	result.AddMember("apiVersion", "v1alpha1", alloc);
 
 	rapidjson::Value resultItems(rapidjson::kArrayType);
-        int n = 0;
-	while (n < lines.size()) {
-		if (n > 0) {
-			auto tokens = string_split_columns(lines[n], '\t');
-	  	    
-			rapidjson::Value applicationResult(rapidjson::kObjectType);
-			applicationResult.AddMember("apiVersion", "v1alpha1", alloc);
-			applicationResult.AddMember("kind", "Application", alloc);
-			rapidjson::Value applicationData(rapidjson::kObjectType);
-
-			rapidjson::Value name;
-			//strip the leading repository name and slash from the chart name
-			name.SetString(tokens[0].substr(repoName.size()+1), alloc);
-			applicationData.AddMember("name", name, alloc);
-			rapidjson::Value app_version;
-			app_version.SetString(tokens[2], alloc);
-			applicationData.AddMember("app_version", app_version, alloc);
-			rapidjson::Value chart_version;
-			chart_version.SetString(tokens[1], alloc);
-			applicationData.AddMember("chart_version", chart_version, alloc);
-			rapidjson::Value description;
-			description.SetString(tokens[3], alloc);
-			applicationData.AddMember("description", description, alloc);
-	    
-			applicationResult.AddMember("metadata", applicationData, alloc);
-			resultItems.PushBack(applicationResult, alloc);
-		}
-		n++;
+	resultItems.Reserve(charts->size(), alloc);
+	for(const auto& chart : *charts){
+		rapidjson::Value applicationResult(rapidjson::kObjectType);
+		applicationResult.AddMember("apiVersion", "v1alpha1", alloc);
+		applicationResult.AddMember("kind", "Application", alloc);
+		rapidjson::Value applicationData(rapidjson::kObjectType);
+		applicationData.AddMember("name", rapidjson::StringRef(chart.name.c_str()), alloc);
+		applicationData.AddMember("app_version", rapidjson::StringRef(chart.appVersion.c_str()), alloc);
+		applicationData.AddMember("chart_version", rapidjson::StringRef(chart.version.c_str()), alloc);
+		applicationData.AddMember("description", rapidjson::StringRef(chart.description.c_str()), alloc);
+		applicationResult.AddMember("metadata", applicationData, alloc);
+		resultItems.PushBack(applicationResult, alloc);
 	}
 
 	result.AddMember("items", resultItems, alloc);
@@ -112,35 +71,7 @@ crow::response listApplications(PersistentStore& store, const crow::request& req
 	return crow::response(to_string(result));
 }
 
-Application findApplication(std::string appName, Application::Repository repo){
-	std::string repoName=getRepoName(repo);
-	std::string target=repoName+"/"+appName;
-	auto result=runCommand("helm", {"search",target});
-	if(result.status){
-		log_error("Command failed: helm search " << target << ": " << result.error);
-		return Application();
-	}
-	
-	if(result.output.find("No results found")!=std::string::npos)
-		return Application();
-	
-	//Deal with the possibility of multiple results, which could happen if
-	//both "slate/stuff" and "slate/superduper" existed and the user requested
-	//the application "s". Multiple results might also not indicate ambiguity, 
-	//if the user searches for the full name of an application, which is also a
-	//prefix of the name another application which exists
-	std::vector<std::string> lines = string_split_lines(result.output);
-	//ignore initial header line printed by helm
-	for(size_t i=1; i<lines.size(); i++){
-		auto tokens=string_split_columns(lines[i], '\t');
-		if(trim(tokens.front())==target)
-			return Application(appName);
-	}
-	
-	return Application();
-}
-
-crow::response fetchApplicationConfig(PersistentStore& store, const crow::request& req, const std::string& appName){
+crow::response fetchApplicationConfig(PersistentStore& store, HelmCatalog& catalog, const crow::request& req, const std::string& appName){
 	const User user=authenticateUser(store, req.url_params.get("token"));
 	log_info(user << " requested to fetch configuration for application " << appName);
 	if(!user)
@@ -150,13 +81,14 @@ crow::response fetchApplicationConfig(PersistentStore& store, const crow::reques
 	auto repo=selectRepo(req);
 	std::string repoName=getRepoName(repo);
 		
-	const Application application=findApplication(appName,repo);
-	if(!application)
+	auto chart=catalog.findChart(repoName,appName);
+	if(!chart)
 		return crow::response(404,generateError("Application not found"));
 	
-	auto commandResult = runCommand("helm",{"inspect","values",repoName + "/" + appName});
-	if(commandResult.status){
-		log_error("Command failed: helm inspect " << (repoName + "/" + appName) << ": " << commandResult.error);
+	std::shared_ptr<const HelmCatalog::ChartDefaults> defaults;
+	try{
+		defaults=catalog.getDefaults(repoName,*chart);
+	}catch(std::runtime_error& err){
 		return crow::response(500, generateError("Unable to fetch application config"));
 	}
 
@@ -171,14 +103,18 @@ crow::response fetchApplicationConfig(PersistentStore& store, const crow::reques
 	result.AddMember("metadata", metadata, alloc);
 
 	rapidjson::Value spec(rapidjson::kObjectType);
-	spec.AddMember("body", filterValuesFile(commandResult.output), alloc);
+	spec.AddMember("body", rapidjson::StringRef(defaults->values.c_str()), alloc);
 	result.AddMember("spec", spec, alloc);
 
 	return crow::response(to_string(result));
 }
 
 ///Internal function which requires that initial authorization checks have already been performed
-crow::response installApplicationImpl(PersistentStore& store, const User& user, const std::string& appName, const std::string& installSrc, const rapidjson::Document& body){
+///\param getDefaults supplies the default values of the chart at installSrc, 
+///                   if they are needed
+crow::response installApplicationImpl(PersistentStore& store, const User& user, const std::string& appName, const std::string& installSrc, 
+                                      const std::function<std::shared_ptr<const HelmCatalog::ChartDefaults>()>& getDefaults,
+                                      const rapidjson::Document& body){
 	if(!body.HasMember("vo"))
 		return crow::response(400,generateError("Missing VO"));
 	if(!body["vo"].IsString())
@@ -200,37 +136,23 @@ crow::response installApplicationImpl(PersistentStore& store, const User& user,
 	std::string tag; //start by assuming this is empty
 	bool gotTag=false;
 	
-	//returns true if YAML parsing was successful
-	auto extractInstanceTag=[&tag,&gotTag](const std::string& config)->bool{
-		std::vector<YAML::Node> parsedConfig;
-		try{
-			parsedConfig=YAML::LoadAll(config);
-		}catch(const YAML::ParserException& ex){
-			return false;
-		}
-		for(const auto& document : parsedConfig){
-			if(document.IsMap() && document["Instance"] && document["Instance"].IsScalar()){
-				tag=document["Instance"].as<std::string>();
-				gotTag=true;
-			}
-		}
-		return true;
-	};
-	
 	if(!config.empty()){ //see if an instance tag is specified in the configuration
-		if(!extractInstanceTag(config))
+		if(!extractInstanceTag(config,gotTag,tag))
 			return crow::response(400,generateError("Configuration could not be parsed as YAML"));
 	}
-	//if the user did not specify a tag we must parse the base helm chart to 
+	//if the user did not specify a tag we must consult the base helm chart to 
 	//find out what the default value is
 	if(!gotTag){
-		auto commandResult = runCommand("helm",{"inspect","values",installSrc});
-		if(commandResult.status){
-			log_error("Command failed: helm inspect values " << installSrc << ": " << commandResult.error);
+		std::shared_ptr<const HelmCatalog::ChartDefaults> defaults;
+		try{
+			defaults=getDefaults();
+		}catch(std::runtime_error& err){
 			return crow::response(500, generateError("Unable to fetch default application config"));
 		}
-		if(!extractInstanceTag(commandResult.output))
+		if(!defaults->valid)
 			return crow::response(500,generateError("Default configuration could not be parsed as YAML"));
+		gotTag=defaults->hasTag;
+		tag=defaults->tag;
 	}
 	if(!gotTag){
 		log_error("Failed to determine instance tag for " << appName);
@@ -398,14 +320,15 @@ crow::response installApplicationImpl(PersistentStore& store, const User& user,
 	return crow::response(to_string(result));
 }
 
-crow::response installApplication(PersistentStore& store, const crow::request& req, const std::string& appName){
+crow::response installApplication(PersistentStore& store, HelmCatalog& catalog, const crow::request& req, const std::string& appName){
 	if(appName.find('\'')!=std::string::npos)
 		return crow::response(400,generateError("Application names cannot contain single quote characters"));
 	
-	auto repo=selectRepo(req);
-	const Application application=findApplication(appName,repo);
-	if(!application)
+	std::string repoName = getRepoName(selectRepo(req));
+	auto chart=catalog.findChart(repoName,appName);
+	if(!chart)
 		return crow::response(404,generateError("Application not found"));
+	const Application application(appName);
 	
 	const User user=authenticateUser(store, req.url_params.get("token"));
 	log_info(user << " requested to install an instance of " << application);
@@ -421,10 +344,9 @@ crow::response installApplication(PersistentStore& store, const crow::request& r
 	}
 	if(body.IsNull())
 		return crow::response(400,generateError("Invalid JSON in request body"));
-		
-	std::string repoName = getRepoName(repo);
 	
-	return installApplicationImpl(store, user, appName, repoName + "/" + appName, body);
+	return installApplicationImpl(store, user, appName, repoName + "/" + appName, 
+	                              [&]{ return catalog.getDefaults(repoName,*chart); }, body);
 }
 
 //return a pair consisting of either true and the chart's/application's name
@@ -446,7 +368,7 @@ std::pair<bool,std::string> extractChartName(const std::string& path){
 		return std::make_pair(false,result.error);
 }
 
-crow::response installAdHocApplication(PersistentStore& store, const crow::request& req){
+crow::response installAdHocApplication(PersistentStore& store, const crow::request& req, unsigned long long maxChartSize, ChartCache* chartCache){
 	const User user=authenticateUser(store, req.url_params.get("token"));
 	log_info(user << " requested to install an instance of an ad-hoc application");
 	if(!user)
@@ -467,6 +389,18 @@ crow::response installAdHocApplication(PersistentStore& store, const crow::reque
 	if(!body["chart"].IsString())
 		return crow::response(400,generateError("Incorrect type for chart"));
 	
+	//a chart which has been uploaded before can be used as it was extracted 
+	//and validated then
+	std::string cacheKey;
+	if(chartCache){
+		cacheKey=ChartCache::key(body["chart"].GetString(),body["chart"].GetStringLength());
+		if(auto chart=chartCache->find(cacheKey)){
+			log_info("Using cached chart " << chart->name << " at " << chart->path);
+			return installApplicationImpl(store, user, chart->name, chart->path, 
+			                              [&]{ return HelmCatalog::readDefaults(chart->path); }, body);
+		}
+	}
+	
 	FileHandle chartDir;
 	std::string appName;
 	struct DirCleaner{
@@ -477,12 +411,21 @@ crow::response installAdHocApplication(PersistentStore& store, const crow::reque
 		}
 	} dirCleaner{chartDir};
 	try{
-		chartDir=makeTemporaryDir("/tmp/slate_chart_");
-		std::stringstream gzipStream(decodeBase64(body["chart"].GetString())), tarStream;
-		gzipDecompress(gzipStream,tarStream);
+		chartDir=chartCache ? chartCache->makeStagingDir() : makeTemporaryDir("/tmp/slate_chart_");
+		//decode, decompress, and extract the chart in a single pass, so that
+		//no more than a few small buffers of it are in memory at once
+		Base64DecodingBuffer decoded(body["chart"].GetString(),body["chart"].GetStringLength());
+		std::istream gzipStream(&decoded);
+		gzipStream.exceptions(std::ios::badbit); //report decoding errors, rather than ending the stream
+		GzipDecompressingBuffer decompressed(gzipStream,maxChartSize);
+		std::istream tarStream(&decompressed);
+		tarStream.exceptions(std::ios::badbit);
 		TarReader tr(tarStream);
 		tr.extractToFileSystem(chartDir+"/");
 		log_info("Extracted chart to " << chartDir.path());
+	}catch(std::length_error& ex){
+		log_error("Unable to extract application chart: " << ex.what());
+		return crow::response(400,generateError("Chart exceeds the maximum allowed size"));
 	}catch(std::exception& ex){
 		log_error("Unable to extract application chart: " << ex.what());
 		return crow::response(500,generateError("Failed to extract application chart"));
@@ -490,7 +433,7 @@ crow::response installAdHocApplication(PersistentStore& store, const crow::reque
 	
 	directory_iterator dit(chartDir);
 	bool foundSubDir=false;
-	std::string chartSubDir;
+	std::string chartSubDir, chartSubDirName;
 	for(const directory_iterator end; dit!=end; dit++){
 		if(dit->path().name()=="." || dit->path().name()=="..")
 			continue;
@@ -498,6 +441,7 @@ crow::response installAdHocApplication(PersistentStore& store, const crow::reque
 			continue;
 		if(!foundSubDir){
 			chartSubDir=dit->path().str();
+			chartSubDirName=dit->path().name();
 			foundSubDir=true;
 		}
 		else
@@ -511,12 +455,18 @@ crow::response installAdHocApplication(PersistentStore& store, const crow::reque
 		return crow::response(400,generateError(nameInfo.second));
 	appName=nameInfo.second;
 	
-	return installApplicationImpl(store, user, appName, chartSubDir, body);
+	if(chartCache){
+		auto chart=chartCache->insert(cacheKey,std::move(chartDir),chartSubDirName,appName);
+		return installApplicationImpl(store, user, chart->name, chart->path, 
+		                              [&]{ return HelmCatalog::readDefaults(chart->path); }, body);
+	}
+	return installApplicationImpl(store, user, appName, chartSubDir, 
+	                              [&]{ return HelmCatalog::readDefaults(chartSubDir); }, body);
 
 	//return crow::response(500,generateError("Ad-hoc application installation is not implemented"));
 }
 
-crow::response updateCatalog(PersistentStore& store, const crow::request& req){
+crow::response updateCatalog(PersistentStore& store, HelmCatalog& catalog, const crow::request& req){
 	const User user=authenticateUser(store, req.url_params.get("token"));
 	log_info(user << " requested to update the application catalog");
 	if(!user)
@@ -527,5 +477,6 @@ crow::response updateCatalog(PersistentStore& store, const crow::request& req){
 		log_error("helm repo update failed: " << result.error);
 		return crow::response(500,generateError("helm repo update failed"));
 	}
+	catalog.reload();
 	return crow::response(200);
 }
@@ -11,11 +11,17 @@
 #include "yaml-cpp/node/detail/impl.h"
 #include <yaml-cpp/node/parse.h>
 
+#include "Executor.h"
 #include "KubeInterface.h"
 #include "Logging.h"
 #include "Utilities.h"
 
 #include <chrono>
+#include <mutex>
+
+///The maximum number of kubectl queries which a single request may have in 
+///progress at once
+const std::size_t kubeQueryConcurrency=8;
 
 crow::response listApplicationInstances(PersistentStore& store, const crow::request& req){
 	const User user=authenticateUser(store, req.url_params.get("token"));
@@ -24,6 +30,12 @@ crow::response listApplicationInstances(PersistentStore& store, const crow::requ
 		return crow::response(403,generateError("Not authorized"));
 	//All users are allowed to list application instances
 
+	bool paged;
+	std::size_t limit;
+	std::string cursor, nextCursor;
+	if(!getPageParameters(req,paged,limit,cursor))
+		return crow::response(400,generateError("Invalid page limit"));
+
 	std::vector<ApplicationInstance> instances;
 
 	auto vo = req.url_params.get("vo");
@@ -39,33 +51,54 @@ crow::response listApplicationInstances(PersistentStore& store, const crow::requ
 		  clusterFilter = cluster;
 		
 		instances=store.listApplicationInstancesByClusterOrVO(voFilter, clusterFilter);
+	} else if(paged){
+		ListPage<ApplicationInstance> page=store.listApplicationInstancesPage(limit,cursor);
+		if(page.status==PageStatus::InvalidCursor)
+			return crow::response(400,generateError("Invalid cursor"));
+		if(page.status!=PageStatus::Fetched)
+			return crow::response(500,generateError("Failed to list instances"));
+		instances=std::move(page.items);
+		nextCursor=std::move(page.nextCursor);
 	} else
 		instances=store.listApplicationInstances();
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
-	
-	result.AddMember("apiVersion", "v1alpha1", alloc);
-	rapidjson::Value resultItems(rapidjson::kArrayType);
-	resultItems.Reserve(instances.size(), alloc);
+	//resolve the names of all VOs and clusters involved up front, since many 
+	//instances will typically share each of them
+	std::vector<std::string> voIDs, clusterIDs;
+	voIDs.reserve(instances.size());
+	clusterIDs.reserve(instances.size());
 	for(const ApplicationInstance& instance : instances){
-		rapidjson::Value instanceResult(rapidjson::kObjectType);
-		instanceResult.AddMember("apiVersion", "v1alpha1", alloc);
-		instanceResult.AddMember("kind", "ApplicationInstance", alloc);
-		rapidjson::Value instanceData(rapidjson::kObjectType);
-		instanceData.AddMember("id", instance.id, alloc);
-		instanceData.AddMember("name", instance.name, alloc);
-		instanceData.AddMember("application", instance.application, alloc);
-		instanceData.AddMember("vo", store.getVO(instance.owningVO).name, alloc);
-		instanceData.AddMember("cluster", store.getCluster(instance.cluster).name, alloc);
-		instanceData.AddMember("created", instance.ctime, alloc);
-		instanceResult.AddMember("metadata", instanceData, alloc);
-		resultItems.PushBack(instanceResult, alloc);
-		//TODO: query helm to get current status (helm list {instance.name})?
+		voIDs.push_back(instance.owningVO);
+		clusterIDs.push_back(instance.cluster);
 	}
-	result.AddMember("items", resultItems, alloc);
-
-	return crow::response(to_string(result));
+	auto voNames=std::make_shared<std::unordered_map<std::string,std::string>>(store.getVONames(voIDs));
+	auto clusterNames=std::make_shared<std::unordered_map<std::string,std::string>>(store.getClusterNames(clusterIDs));
+	
+	return streamJSONList(std::move(instances),std::move(nextCursor),
+	  [voNames,clusterNames](JSONWriter& writer, const ApplicationInstance& instance){
+		writer.StartObject();
+		writer.Key("apiVersion");
+		writer.String("v1alpha1");
+		writer.Key("kind");
+		writer.String("ApplicationInstance");
+		writer.Key("metadata");
+		writer.StartObject();
+		writer.Key("id");
+		writer.String(instance.id);
+		writer.Key("name");
+		writer.String(instance.name);
+		writer.Key("application");
+		writer.String(instance.application);
+		writer.Key("vo");
+		writer.String((*voNames)[instance.owningVO]);
+		writer.Key("cluster");
+		writer.String((*clusterNames)[instance.cluster]);
+		writer.Key("created");
+		writer.String(instance.ctime);
+		writer.EndObject();
+		writer.EndObject();
+		//TODO: query helm to get current status (helm list {instance.name})?
+	});
 }
 
 struct ServiceInterface{
@@ -78,9 +111,99 @@ struct ServiceInterface{
 	std::string ports;
 };
 
+///The pods and services of an instance, each fetched with a single list query
+///selecting on the release label which helm charts apply to their objects, so 
+///that any number of them can then be examined without further round trips to
+///the cluster. Each kind is fetched the first time it is needed. 
+///Objects which lack the label are absent, and must be queried individually. 
+class ReleaseSnapshot{
+public:
+	ReleaseSnapshot(const std::string& configPath, const std::string& nspace, 
+	                const std::string& releaseName):
+	configPath(configPath),nspace(nspace),selector("release="+releaseName){}
+	
+	///\return the pod with the given name, or nullptr if it is not known
+	const rapidjson::Value* findPod(const std::string& name) const{
+		std::call_once(podsLoaded,[this]{ load("pods",pods,podsByName); });
+		auto it=podsByName.find(name);
+		return it==podsByName.end() ? nullptr : it->second;
+	}
+	
+	///\return the service with the given name, or nullptr if it is not known
+	const rapidjson::Value* findService(const std::string& name) const{
+		std::call_once(servicesLoaded,[this]{ load("services",services,servicesByName); });
+		auto it=servicesByName.find(name);
+		return it==servicesByName.end() ? nullptr : it->second;
+	}
+	
+	///\param selector a JSON object mapping label names to values
+	///\return the first pod which has all of the given labels, or nullptr if 
+	///        there is none
+	const rapidjson::Value* findPodMatching(const rapidjson::Value& selector) const{
+		std::call_once(podsLoaded,[this]{ load("pods",pods,podsByName); });
+		if(!selector.IsObject() || selector.MemberCount()==0 
+		   || !pods.IsObject() || !pods.HasMember("items"))
+			return nullptr;
+		for(const auto& pod : pods["items"].GetArray()){
+			if(!pod.HasMember("metadata") || !pod["metadata"].HasMember("labels"))
+				continue;
+			const auto& labels=pod["metadata"]["labels"];
+			bool matches=true;
+			for(const auto& label : selector.GetObject()){
+				auto value=labels.FindMember(label.name);
+				if(value==labels.MemberEnd() || value->value!=label.value){
+					matches=false;
+					break;
+				}
+			}
+			if(matches)
+				return &pod;
+		}
+		return nullptr;
+	}
+	
+private:
+	const std::string configPath;
+	const std::string nspace;
+	const std::string selector;
+	mutable std::once_flag podsLoaded;
+	mutable std::once_flag servicesLoaded;
+	mutable rapidjson::Document pods;
+	mutable rapidjson::Document services;
+	mutable std::map<std::string,const rapidjson::Value*> podsByName;
+	mutable std::map<std::string,const rapidjson::Value*> servicesByName;
+	
+	void load(const std::string& kind, rapidjson::Document& list, 
+	          std::map<std::string,const rapidjson::Value*>& index) const{
+		using namespace std::chrono;
+		high_resolution_clock::time_point t1 = high_resolution_clock::now();
+		auto result=kubernetes::kubectl(configPath,{"get",kind,"-l",selector,"--namespace",nspace,"-o=json"});
+		high_resolution_clock::time_point t2 = high_resolution_clock::now();
+		log_info("kubectl get " << kind << " -l " << selector << " completed in " << duration_cast<duration<double>>(t2-t1).count() << " seconds");
+		if(result.status){
+			log_error("kubectl get " << kind << " -l " << selector << " --namespace " 
+			          << nspace << " failed: " << result.error);
+			return;
+		}
+		list.Parse(result.output.c_str());
+		if(list.HasParseError() || !list.IsObject() || !list.HasMember("items") 
+		   || !list["items"].IsArray()){
+			log_error("Unable to parse kubectl get " << kind << " JSON output for " << nspace << "::" << selector);
+			list.SetObject();
+			return;
+		}
+		for(const auto& item : list["items"].GetArray()){
+			if(item.HasMember("metadata") && item["metadata"].HasMember("name") 
+			   && item["metadata"]["name"].IsString())
+				index.emplace(item["metadata"]["name"].GetString(),&item);
+		}
+	}
+};
+
 ///query helm and kubernetes to find out what services a given instance contains 
 ///and how to contact them
 std::map<std::string,ServiceInterface> getServices(const SharedFileHandle& configPath, 
+                                                   const ReleaseSnapshot& snapshot,
                                                    const std::string& releaseName, 
                                                    const std::string& nspace,
                                                    const std::string& systemNamespace){
@@ -116,34 +239,41 @@ std::map<std::string,ServiceInterface> getServices(const SharedFileHandle& confi
 			}
 		}
 	}
-	//next try to find out the interface of each service
-	std::map<std::string,ServiceInterface> services;
-	for(const auto& serviceName : serviceNames){
-		ServiceInterface interface;
+	//next try to find out the interface of each service, querying several at once
+	std::vector<ServiceInterface> interfaces(serviceNames.size());
+	std::vector<char> usable(serviceNames.size(),false);
+	parallelFor(serviceNames.size(),kubeQueryConcurrency,[&](std::size_t i){
+		const std::string& serviceName=serviceNames[i];
+		ServiceInterface& interface=interfaces[i];
 		
-		t1 = high_resolution_clock::now();
-		auto serviceResult=kubernetes::kubectl(*configPath,{"get","service",serviceName,"--namespace",nspace,"-o=json"});
-		t2 = high_resolution_clock::now();
-		log_info("kubectl get service completed in " << duration_cast<duration<double>>(t2-t1).count() << " seconds");
-		if(serviceResult.status){
-			log_error("kubectl get service '" << serviceName << "' --namespace '" 
-			          << nspace << "' failed: " << serviceResult.error);
-			continue;
-		}
-		rapidjson::Document serviceData;
-		try{
-			serviceData.Parse(serviceResult.output.c_str());
-		}catch(std::runtime_error& err){
-			log_error("Unable to parse kubectl get service JSON output for " << nspace << "::" << serviceName << ": " << err.what());
-			continue;
+		rapidjson::Document fetched;
+		const rapidjson::Value* found=snapshot.findService(serviceName);
+		if(!found){
+			auto t1 = high_resolution_clock::now();
+			auto serviceResult=kubernetes::kubectl(*configPath,{"get","service",serviceName,"--namespace",nspace,"-o=json"});
+			auto t2 = high_resolution_clock::now();
+			log_info("kubectl get service completed in " << duration_cast<duration<double>>(t2-t1).count() << " seconds");
+			if(serviceResult.status){
+				log_error("kubectl get service '" << serviceName << "' --namespace '" 
+				          << nspace << "' failed: " << serviceResult.error);
+				return;
+			}
+			try{
+				fetched.Parse(serviceResult.output.c_str());
+			}catch(std::runtime_error& err){
+				log_error("Unable to parse kubectl get service JSON output for " << nspace << "::" << serviceName << ": " << err.what());
+				return;
+			}
+			found=&fetched;
 		}
+		const rapidjson::Value& serviceData=*found;
 		
 		interface.clusterIP=serviceData["spec"]["clusterIP"].GetString();
 		
 		//TODO: generalize to lift this limitation?
 		if(serviceData["spec"]["ports"].GetArray().Size()!=1){
 			log_error(nspace << "::" << serviceName << " does not expose exactly one port");
-			continue;
+			return;
 		}
 		interface.ports="";
 		if(serviceData["spec"]["ports"][0].HasMember("port")
@@ -172,48 +302,57 @@ std::map<std::string,ServiceInterface> getServices(const SharedFileHandle& confi
 		}
 		else if(serviceType=="NodePort"){
 			//need to track down the pod to which the service is connected in order to find out the IP of its host (node)
-			//first accumulate the selector expression used to identify the pod
-			std::string filter;
-			for(const auto& selector : serviceData["spec"]["selector"].GetObject()){
-				if(!filter.empty())
-					filter+=",";
-				filter+=selector.name.GetString()+std::string("=")+selector.value.GetString();
-			}
-			//now try to locate the pod in question
-			t1 = high_resolution_clock::now();
-			auto podResult=kubernetes::kubectl(*configPath,{"get","pod","-l",filter,"--namespace",nspace,"-o=json"});
-			t2 = high_resolution_clock::now();
-			log_info("kubectl get pod completed in " << duration_cast<duration<double>>(t2-t1).count() << " seconds");
-			if(serviceResult.status){
-				log_error("kubectl get pod -l " << filter << " --namespace " 
-				          << nspace << " failed: " << podResult.error);
-				continue;
-			}
+			const rapidjson::Value* pod=snapshot.findPodMatching(serviceData["spec"]["selector"]);
 			rapidjson::Document podData;
-			try{
-				podData.Parse(podResult.output.c_str());
-			}catch(std::runtime_error& err){
-				log_error("Unable to parse kubectl get service JSON output for kubectl get pod -l " 
-				          << filter << " --namespace " << nspace << ": " << err.what());
-				continue;
-			}
-			if(podData["items"].GetArray().Size()==0){
-				log_error("Did not find any pods matching service selector for " << nspace << "::" << serviceName);
-				continue;
+			if(!pod){
+				//first accumulate the selector expression used to identify the pod
+				std::string filter;
+				for(const auto& selector : serviceData["spec"]["selector"].GetObject()){
+					if(!filter.empty())
+						filter+=",";
+					filter+=selector.name.GetString()+std::string("=")+selector.value.GetString();
+				}
+				//now try to locate the pod in question
+				auto t1 = high_resolution_clock::now();
+				auto podResult=kubernetes::kubectl(*configPath,{"get","pod","-l",filter,"--namespace",nspace,"-o=json"});
+				auto t2 = high_resolution_clock::now();
+				log_info("kubectl get pod completed in " << duration_cast<duration<double>>(t2-t1).count() << " seconds");
+				if(podResult.status){
+					log_error("kubectl get pod -l " << filter << " --namespace " 
+					          << nspace << " failed: " << podResult.error);
+					return;
+				}
+				try{
+					podData.Parse(podResult.output.c_str());
+				}catch(std::runtime_error& err){
+					log_error("Unable to parse kubectl get service JSON output for kubectl get pod -l " 
+					          << filter << " --namespace " << nspace << ": " << err.what());
+					return;
+				}
+				if(podData["items"].GetArray().Size()==0){
+					log_error("Did not find any pods matching service selector for " << nspace << "::" << serviceName);
+					return;
+				}
+				pod=&podData["items"][0];
 			}
-			if(podData["items"][0]["status"].HasMember("hostIP"))
-				interface.externalIP=podData["items"][0]["status"]["hostIP"].GetString();
+			if((*pod)["status"].HasMember("hostIP"))
+				interface.externalIP=(*pod)["status"]["hostIP"].GetString();
 			else
 				interface.externalIP="<none>";
 		}
 		else if(serviceType=="ClusterIP"){
 			log_info("Not reporting internal service " << serviceName);
-			continue;
+			return;
 		}
 		else{
 			log_error("Unexpected service type: "+serviceType);
 		}
-		services.emplace(std::make_pair(serviceName,interface));
+		usable[i]=true;
+	});
+	std::map<std::string,ServiceInterface> services;
+	for(std::size_t i=0; i<serviceNames.size(); i++){
+		if(usable[i])
+			services.emplace(serviceNames[i],interfaces[i]);
 	}
 	return services;
 }
@@ -263,6 +402,7 @@ std::vector<std::string> findInstancePods(const ApplicationInstance& instance,
 ///\throws std::runtime_error
 rapidjson::Value fetchInstanceDetails(PersistentStore& store, 
                                       const ApplicationInstance& instance, 
+                                      const ReleaseSnapshot& snapshot, 
                                       const std::string& systemNamespace, 
                                       rapidjson::Document::AllocatorType& alloc){
 	rapidjson::Value instanceDetails(rapidjson::kObjectType);
@@ -275,64 +415,78 @@ rapidjson::Value fetchInstanceDetails(PersistentStore& store,
 	pods=internal::findInstancePods(instance, systemNamespace, *configPath);
 	
 	using namespace std::chrono;
-	high_resolution_clock::time_point t1,t2;
+	
+	//look up any pods which are missing from the snapshot individually, several
+	//at once, but assemble the results in order, since the allocator cannot be 
+	//shared between threads
+	std::vector<commandResult> podResults(pods.size());
+	parallelFor(pods.size(),kubeQueryConcurrency,[&](std::size_t i){
+		if(snapshot.findPod(pods[i]))
+			return;
+		auto t1 = high_resolution_clock::now();
+		podResults[i]=kubernetes::kubectl(*configPath,{"get","pod",pods[i],"-n",nspace,"-o=json"});
+		auto t2 = high_resolution_clock::now();
+		log_info("kubectl get pod completed in " << duration_cast<duration<double>>(t2-t1).count() << " seconds");
+	});
 	
 	rapidjson::Value podDetails(rapidjson::kArrayType);
-	for(const auto& pod : pods){
+	for(std::size_t i=0; i<pods.size(); i++){
+		const std::string& pod=pods[i];
 		rapidjson::Value podInfo(rapidjson::kObjectType);
-		t1 = high_resolution_clock::now();
-		auto result=kubernetes::kubectl(*configPath,{"get","pod",pod,"-n",nspace,"-o=json"});
-		t2 = high_resolution_clock::now();
-		log_info("kubectl get pod completed in " << duration_cast<duration<double>>(t2-t1).count() << " seconds");
-		if(result.status){
-			podInfo.AddMember("kind", "Error", alloc);
-			podInfo.AddMember("message", "Failed to get information for pod "+pod, alloc);
-			podDetails.PushBack(podInfo,alloc);
-			continue;
-		}
-		
-		rapidjson::Document data(rapidjson::kObjectType,&alloc);
-		try{
-			data.Parse(result.output.c_str());
-		}catch(std::runtime_error& err){
-			podInfo.AddMember("kind", "Error", alloc);
-			podInfo.AddMember("message", "Failed to parse information for pod "+pod, alloc);
-			podDetails.PushBack(podInfo,alloc);
-			continue;
+		rapidjson::Document fetched(rapidjson::kObjectType,&alloc);
+		const rapidjson::Value* found=snapshot.findPod(pod);
+		if(!found){
+			const commandResult& result=podResults[i];
+			if(result.status){
+				podInfo.AddMember("kind", "Error", alloc);
+				podInfo.AddMember("message", "Failed to get information for pod "+pod, alloc);
+				podDetails.PushBack(podInfo,alloc);
+				continue;
+			}
+			try{
+				fetched.Parse(result.output.c_str());
+			}catch(std::runtime_error& err){
+				podInfo.AddMember("kind", "Error", alloc);
+				podInfo.AddMember("message", "Failed to parse information for pod "+pod, alloc);
+				podDetails.PushBack(podInfo,alloc);
+				continue;
+			}
+			found=&fetched;
 		}
+		const rapidjson::Value& data=*found;
 		
 		if(data.HasMember("metadata")){
 			if(data["metadata"].HasMember("creationTimestamp"))
-				podInfo.AddMember("created",data["metadata"]["creationTimestamp"],alloc);
+				podInfo.AddMember("created",rapidjson::Value(data["metadata"]["creationTimestamp"],alloc),alloc);
 			if(data["metadata"].HasMember("name"))
-				podInfo.AddMember("name",data["metadata"]["name"],alloc);
+				podInfo.AddMember("name",rapidjson::Value(data["metadata"]["name"],alloc),alloc);
 		}
 		if(data.HasMember("spec")){
 			if(data["spec"].HasMember("nodeName"))
-				podInfo.AddMember("hostName",data["spec"]["nodeName"],alloc);
+				podInfo.AddMember("hostName",rapidjson::Value(data["spec"]["nodeName"],alloc),alloc);
 		}
 		//ownerReferences?
 		if(data.HasMember("status")){
 			if(data["status"].HasMember("hostIP"))
-				podInfo.AddMember("hostIP",data["status"]["hostIP"],alloc);
+				podInfo.AddMember("hostIP",rapidjson::Value(data["status"]["hostIP"],alloc),alloc);
 			if(data["status"].HasMember("phase"))
-				podInfo.AddMember("status",data["status"]["phase"],alloc);
+				podInfo.AddMember("status",rapidjson::Value(data["status"]["phase"],alloc),alloc);
 			if(data["status"].HasMember("conditions"))
-				podInfo.AddMember("conditions",data["status"]["conditions"],alloc);
+				podInfo.AddMember("conditions",rapidjson::Value(data["status"]["conditions"],alloc),alloc);
 			if(data["status"].HasMember("containerStatuses")){
 				rapidjson::Value containers(rapidjson::kArrayType);
-				for(auto& item : data["status"]["containerStatuses"].GetArray()){
+				for(const auto& item : data["status"]["containerStatuses"].GetArray()){
 					rapidjson::Value container(rapidjson::kObjectType);
 					if(item.HasMember("image"))
-						container.AddMember("image",item["image"],alloc);
+						container.AddMember("image",rapidjson::Value(item["image"],alloc),alloc);
 					if(item.HasMember("name"))
-						container.AddMember("name",item["name"],alloc);
+						container.AddMember("name",rapidjson::Value(item["name"],alloc),alloc);
 					if(item.HasMember("ready"))
-						container.AddMember("ready",item["ready"],alloc);
+						container.AddMember("ready",rapidjson::Value(item["ready"],alloc),alloc);
 					if(item.HasMember("restartCount"))
-						container.AddMember("restartCount",item["restartCount"],alloc);
+						container.AddMember("restartCount",rapidjson::Value(item["restartCount"],alloc),alloc);
 					if(item.HasMember("state"))
-						container.AddMember("state",item["state"],alloc);
+						container.AddMember("state",rapidjson::Value(item["state"],alloc),alloc);
 					containers.PushBack(container,alloc);
 				}
 				podInfo.AddMember("containers",containers,alloc);
@@ -386,7 +540,8 @@ crow::response fetchApplicationInstanceInfo(PersistentStore& store, const crow::
 	
 	auto configPath=store.configPathForCluster(instance.cluster);
 	auto systemNamespace=store.getCluster(instance.cluster).systemNamespace;
-	auto services=getServices(configPath,instance.name,vo.namespaceName(),systemNamespace);
+	ReleaseSnapshot snapshot(*configPath,vo.namespaceName(),instance.name);
+	auto services=getServices(configPath,snapshot,instance.name,vo.namespaceName(),systemNamespace);
 	rapidjson::Value serviceData(rapidjson::kArrayType);
 	for(const auto& service : services){
 		rapidjson::Value serviceEntry(rapidjson::kObjectType);
@@ -402,7 +557,7 @@ crow::response fetchApplicationInstanceInfo(PersistentStore& store, const crow::
 	
 	if(req.url_params.get("detailed")){
 		try{
-			result.AddMember("details",fetchInstanceDetails(store,instance,systemNamespace,alloc),alloc);
+			result.AddMember("details",fetchInstanceDetails(store,instance,snapshot,systemNamespace,alloc),alloc);
 		}catch(std::runtime_error& err){
 			rapidjson::Value error(rapidjson::kObjectType);
 			error.AddMember("kind", "Error", alloc);
@@ -521,45 +676,87 @@ crow::response getApplicationInstanceLogs(PersistentStore& store,
 		return crow::response(500,generateError(err.what()));
 	}
 	
-	std::string logData;
-	auto collectLog=[&](const std::string& pod, const std::string& container){
-		logData+=std::string(40,'=')+"\nPod: "+pod+" Container: "+container+'\n';
-		std::vector<std::string> args={"logs",pod,"-c",container,"-n",nspace};
-		if(maxLines)
-			args.push_back("--tail="+std::to_string(maxLines));
-		if(previousLogs)
-			args.push_back("-p");
-		auto logResult=kubernetes::kubectl(*configPath,args);
-		if(logResult.status){
-			logData+="Failed to get logs: ";
-			logData+=logResult.error;
-			logData+='\n';
+	//find out what containers are in each pod, querying individually only 
+	//those pods which are missing from the snapshot
+	ReleaseSnapshot snapshot(*configPath,nspace,instance.name);
+	std::vector<std::vector<std::string>> podContainers(pods.size());
+	std::vector<char> podFailed(pods.size(),false);
+	parallelFor(pods.size(),kubeQueryConcurrency,[&](std::size_t i){
+		if(const rapidjson::Value* pod=snapshot.findPod(pods[i])){
+			if(pod->HasMember("spec") && (*pod)["spec"].HasMember("containers")){
+				for(const auto& container : (*pod)["spec"]["containers"].GetArray()){
+					if(container.HasMember("name"))
+						podContainers[i].push_back(container["name"].GetString());
+				}
+			}
+			return;
 		}
-		else
-			logData+=logResult.output;
-	};
-	for(const auto& pod : pods){
-		//find out what containers are in the pod
-		auto containersResult=kubernetes::kubectl(*configPath,{"get","pod",pod,
+		auto containersResult=kubernetes::kubectl(*configPath,{"get","pod",pods[i],
 			"-o=jsonpath={.spec.containers[*].name}","-n",nspace});
 		if(containersResult.status){
-			log_error("Failed to get pod " << pod << " instance " << instance << ": " << containersResult.error);
-			logData+="Failed to get pod "+pod+"\n";
+			log_error("Failed to get pod " << pods[i] << " instance " << instance << ": " << containersResult.error);
+			podFailed[i]=true;
 		}
-		const auto containers=string_split_columns(containersResult.output, ' ', false);
+		podContainers[i]=string_split_columns(containersResult.output, ' ', false);
+	});
+	
+	//work out which logs to fetch, keeping any other messages in their places 
+	//between them
+	struct LogSection{
+		std::string preamble;
+		std::string pod;
+		std::string container;
+		std::string log;
+	};
+	std::vector<LogSection> sections;
+	std::string pendingText;
+	auto addSection=[&](const std::string& pod, const std::string& container){
+		sections.push_back(LogSection{pendingText,pod,container,""});
+		pendingText.clear();
+	};
+	for(std::size_t i=0; i<pods.size(); i++){
+		const std::string& pod=pods[i];
+		if(podFailed[i])
+			pendingText+="Failed to get pod "+pod+"\n";
+		const auto& containers=podContainers[i];
 	
 		if(!container.empty()){
 			if(std::find(containers.begin(),containers.end(),container)!=containers.end())
-				collectLog(pod,container);
+				addSection(pod,container);
 			else
-				logData+="(Pod "+pod+" has no container "+container+")";
+				pendingText+="(Pod "+pod+" has no container "+container+")";
 		}
 		else{ //if not specified iterate over all containers
 			for(const auto& container : containers)
-				collectLog(pod,container);
+				addSection(pod,container);
 		}
 	}
 	
+	parallelFor(sections.size(),kubeQueryConcurrency,[&](std::size_t i){
+		LogSection& section=sections[i];
+		section.log=std::string(40,'=')+"\nPod: "+section.pod+" Container: "+section.container+'\n';
+		std::vector<std::string> args={"logs",section.pod,"-c",section.container,"-n",nspace};
+		if(maxLines)
+			args.push_back("--tail="+std::to_string(maxLines));
+		if(previousLogs)
+			args.push_back("-p");
+		auto logResult=kubernetes::kubectl(*configPath,args);
+		if(logResult.status){
+			section.log+="Failed to get logs: ";
+			section.log+=logResult.error;
+			section.log+='\n';
+		}
+		else
+			section.log+=logResult.output;
+	});
+	
+	std::string logData;
+	for(const auto& section : sections){
+		logData+=section.preamble;
+		logData+=section.log;
+	}
+	logData+=pendingText;
+	
 	rapidjson::Document result(rapidjson::kObjectType);
 	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
 	
@@ -5,6 +5,7 @@
 #include <climits>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <map>
@@ -22,86 +23,165 @@
 
 #include <FileSystem.h>
 
-std::string decodeBase64(const std::string& coded){
-	//table used by boost::archive::iterators::detail::to_6_bit
-	static const signed char lookupTable[] = {
-		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,62,-1,-1,-1,63,
-		52,53,54,55,56,57,58,59,60,61,-1,-1,-1, 0,-1,-1,
-		-1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,
-		15,16,17,18,19,20,21,22,23,24,25,-1,-1,-1,-1,-1,
-		-1,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,
-		41,42,43,44,45,46,47,48,49,50,51,-1,-1,-1,-1,-1
-	};
-	std:size_t outLen=(coded.size()*3)/4;
-	std::string decoded(outLen,'\0');
-	char* outData=&decoded.front();
-	unsigned char curBits=0;
-	for(const unsigned char next : coded){
-		if(next>=128 || lookupTable[next]==-1)
-			throw std::runtime_error("Illegal base64 character: '"+std::string(1,next)+"'");
-		unsigned char newBits=lookupTable[next];
-		unsigned char putBits=0;
-		//shove as many bits into the current byte as will fit
-		{
-			putBits=std::min(CHAR_BIT-curBits,6);
-			unsigned int mask=(((1u<<putBits)-1)<<(6-putBits));
-			*outData|=((newBits&mask)>>(6-putBits))<<(CHAR_BIT-curBits-putBits);
-			curBits+=putBits;
+namespace{
+
+///Lookup tables for one base64 alphabet. Encoding looks up two output 
+///characters at once for each 12 bits of input; decoding looks up each input 
+///character's 6 bits already shifted into place, so that a group of four 
+///characters is decoded by combining four lookups. 
+struct Base64Tables{
+	///An entry for an invalid character; the bits above the 24 used by a 
+	///group of four characters mark it, so that one test of the combined 
+	///lookups detects any invalid character in the group
+	static const uint32_t invalid=0xFF000000;
+	
+	char encodePairs[4096][2];
+	uint32_t decode[4][256];
+	
+	explicit Base64Tables(const char* alphabet){
+		for(unsigned int i=0; i<4096; i++){
+			encodePairs[i][0]=alphabet[i>>6];
+			encodePairs[i][1]=alphabet[i&0x3F];
 		}
-		if(curBits==CHAR_BIT){ //if the byte is full, advance to the next
-			curBits=0;
-			outData++;
-			//if more bits need to be written put them in now
-			if(putBits<6){
-				putBits=6-putBits;
-				unsigned int mask=(1u<<putBits)-1;
-				*outData|=(newBits&mask)<<(CHAR_BIT-putBits);
-				curBits=putBits;
-			}
+		for(unsigned int i=0; i<4; i++)
+			std::fill_n(decode[i],256,invalid);
+		for(uint32_t i=0; i<64; i++){
+			const unsigned char c=alphabet[i];
+			for(unsigned int j=0; j<4; j++)
+				decode[j][c]=i<<(6*(3-j));
 		}
 	}
+	
+	static const Base64Tables& get(Base64Alphabet alphabet){
+		static const Base64Tables standard(
+			"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/");
+		static const Base64Tables urlSafe(
+			"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_");
+		return alphabet==Base64Alphabet::URLSafe ? urlSafe : standard;
+	}
+};
+const uint32_t Base64Tables::invalid;
+
+[[noreturn]] void throwIllegalBase64(const Base64Tables& tables, const unsigned char* in, std::size_t length){
+	for(std::size_t i=0; i<length; i++){
+		if(tables.decode[0][in[i]]==Base64Tables::invalid)
+			throw std::runtime_error("Illegal base64 character: '"+std::string(1,in[i])+"'");
+	}
+	throw std::runtime_error("Illegal base64 data");
+}
+
+///Determine how encoded data divides into complete groups of four characters
+///and a final, partial group
+///\param length the length of the data, including any padding
+///\param tailLength the number of characters, excluding padding, in the 
+///                  partial group
+///\return the number of characters in complete groups
+std::size_t splitBase64(const char* in, std::size_t length, unsigned int& tailLength){
+	std::size_t padding=0;
+	while(padding<2 && padding<length && in[length-padding-1]=='=')
+		padding++;
+	if(padding && length%4)
+		throw std::runtime_error("Incorrect base64 padding");
+	length-=padding;
+	tailLength=length%4;
+	if(tailLength==1)
+		throw std::runtime_error("Invalid base64 data length");
+	if(padding && padding!=4-tailLength)
+		throw std::runtime_error("Incorrect base64 padding");
+	return length-tailLength;
+}
+
+///Decode complete groups of four characters
+///\return the number of bytes written
+std::size_t decodeBase64Groups(const Base64Tables& tables, const char* in, std::size_t length, char* out){
+	const unsigned char* data=(const unsigned char*)in;
+	char* const start=out;
+	for(std::size_t i=0; i<length; i+=4){
+		uint32_t bits=tables.decode[0][data[i]]
+		            | tables.decode[1][data[i+1]]
+		            | tables.decode[2][data[i+2]]
+		            | tables.decode[3][data[i+3]];
+		if(bits&Base64Tables::invalid)
+			throwIllegalBase64(tables,data+i,4);
+		out[0]=bits>>16;
+		out[1]=bits>>8;
+		out[2]=bits;
+		out+=3;
+	}
+	return out-start;
+}
+
+///Decode a final group of two or three characters
+///\return the number of bytes written
+std::size_t decodeBase64Tail(const Base64Tables& tables, const char* in, unsigned int length, char* out){
+	if(!length)
+		return 0;
+	const unsigned char* data=(const unsigned char*)in;
+	uint32_t bits=tables.decode[0][data[0]] | tables.decode[1][data[1]];
+	if(length==3)
+		bits|=tables.decode[2][data[2]];
+	if(bits&Base64Tables::invalid)
+		throwIllegalBase64(tables,data,length);
+	//the bits of the last character which do not form a whole byte must be 
+	//zero, or the data could not have been produced by an encoder
+	if(bits&(length==3 ? 0xFF : 0xFFFF))
+		throw std::runtime_error("Non-canonical base64 data");
+	out[0]=bits>>16;
+	if(length==3)
+		out[1]=bits>>8;
+	return length-1;
+}
+
+}
+
+std::string decodeBase64(const std::string& coded, Base64Alphabet alphabet){
+	const Base64Tables& tables=Base64Tables::get(alphabet);
+	unsigned int tailLength;
+	std::size_t groupsLength=splitBase64(coded.data(),coded.size(),tailLength);
+	std::string decoded(3*(groupsLength/4)+(tailLength ? tailLength-1 : 0),'\0');
+	if(decoded.empty())
+		return decoded;
+	std::size_t written=decodeBase64Groups(tables,coded.data(),groupsLength,&decoded[0]);
+	decodeBase64Tail(tables,coded.data()+groupsLength,tailLength,&decoded[written]);
 	return decoded;
 }
 
-std::string encodeBase64(const std::string& raw){
-	const char lookupTable[65]=
-		"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-		"abcdefghijklmnopqrstuvwxyz"
-		"0123456789"
-		"+/";
-	std:size_t outLen=std::ceil((raw.size()*4)/3.);
+std::string encodeBase64(const std::string& raw, Base64Alphabet alphabet){
+	const Base64Tables& tables=Base64Tables::get(alphabet);
+	const bool pad=(alphabet==Base64Alphabet::Standard);
+	const std::size_t groups=raw.size()/3, remainder=raw.size()%3;
+	std::size_t outLen=4*groups;
+	if(remainder)
+		outLen+=(pad ? 4 : remainder+1);
 	std::string encoded(outLen,'\0');
-	unsigned char availBits=CHAR_BIT;
-	size_t inputIdx=0;
-	for(size_t i=0; i<outLen; i++){
-		unsigned char getBits=0;
-		unsigned char lutIdx=0;
-		//grab as many bits as possible from the current byte
-		{
-			getBits=std::min((unsigned char)6,availBits);
-			unsigned int mask=((1u<<getBits)-1)<<(availBits-getBits);
-			lutIdx|=((raw[inputIdx]&mask)>>(availBits-getBits))<<(6-getBits);
-			availBits-=getBits;
-		}
-		if(availBits==0){ //if that byte is exhausted, advance to the next
-			inputIdx++;
-			availBits=CHAR_BIT;
-			//if more bits are needed get them now
-			if(getBits<6){
-				getBits=6-getBits;
-				unsigned int mask=((1u<<getBits)-1)<<(availBits-getBits);
-				lutIdx|=((raw[inputIdx]&mask)>>(availBits-getBits));
-				availBits-=getBits;
-			}
+	if(encoded.empty())
+		return encoded;
+	const unsigned char* in=(const unsigned char*)raw.data();
+	char* out=&encoded[0];
+	for(std::size_t i=0; i<groups; i++, in+=3, out+=4){
+		uint32_t bits=((uint32_t)in[0]<<16) | ((uint32_t)in[1]<<8) | in[2];
+		std::memcpy(out,tables.encodePairs[bits>>12],2);
+		std::memcpy(out+2,tables.encodePairs[bits&0xFFF],2);
+	}
+	if(remainder){
+		uint32_t bits=(uint32_t)in[0]<<16;
+		if(remainder==2)
+			bits|=(uint32_t)in[1]<<8;
+		std::memcpy(out,tables.encodePairs[bits>>12],2);
+		if(remainder==2)
+			out[2]=tables.encodePairs[bits&0xFFF][0];
+		if(pad){
+			out[3]='=';
+			if(remainder==1)
+				out[2]='=';
 		}
-		encoded[i]=lookupTable[lutIdx];
 	}
 	return encoded;
 }
 
-void gzipDecompress(std::istream& src, std::ostream& dest){
+///Read and check a gzip header, leaving src positioned at the start of the
+///compressed data
+static void readGzipHeader(std::istream& src){
 	//https://tools.ietf.org/html/rfc1952 section 2.2
 	unsigned char id[2];
 	src.read((char*)id,2);
@@ -145,7 +225,7 @@ void gzipDecompress(std::istream& src, std::ostream& dest){
 		if(src.eof() || src.fail())
 			throw std::runtime_error("Invalid gzip header");
 		xlen=((uint16_t)xlenRaw[0]) | ((uint16_t)xlenRaw[1]<<8);
-		src.seekg(src.tellg()+(std::streamoff)xlen);
+		src.ignore(xlen);
 	}
 	
 	if(flg&fnameMask){ //if the original filename is included, skip over it
@@ -173,67 +253,102 @@ void gzipDecompress(std::istream& src, std::ostream& dest){
 			throw std::runtime_error("Invalid gzip header");
 		//could check checksum here; not implemented
 	}
-	
-	const std::streamsize readBlockSize=1024;
-	//We expect the data to decompress, so we allocate the
-	//output buffer to be larger than the input buffer.
-	//According to Mark Adler (http://www.zlib.net/zlib_tech.html
-	//retrieved August 29, 2014) zlib has a theoretical maximum
-	//compression factor of 1032.
-	const std::streamsize decompSize=1032*readBlockSize;
-	std::unique_ptr<char[]> readBuffer(new char[readBlockSize]);
-	std::unique_ptr<char[]> decompBuffer(new char[decompSize]);
-	
-	z_stream zs;
-	zs.next_in = Z_NULL;
-	zs.avail_in = 0;
-	zs.next_out = (unsigned char*)decompBuffer.get();
-	zs.avail_out = decompSize;
-	zs.zalloc = Z_NULL; 
-	zs.zfree = Z_NULL; 
-	zs.opaque = Z_NULL;
-	
-	bool success=false;
+}
+
+Base64DecodingBuffer::Base64DecodingBuffer(const char* data, std::size_t length, 
+                                           Base64Alphabet alphabet):
+alphabet(alphabet),next(data){
+	groupsEnd=data+splitBase64(data,length,tailLength);
+	setg(buffer,buffer,buffer);
+}
+
+Base64DecodingBuffer::int_type Base64DecodingBuffer::underflow(){
+	if(gptr()<egptr())
+		return traits_type::to_int_type(*gptr());
+	const Base64Tables& tables=Base64Tables::get(alphabet);
+	std::size_t written=0;
+	if(next<groupsEnd){
+		//decode as many whole groups as will fit in the buffer
+		std::size_t length=std::min<std::size_t>(groupsEnd-next,4*(sizeof(buffer)/3));
+		written=decodeBase64Groups(tables,next,length,buffer);
+		next+=length;
+	}
+	else if(tailLength){
+		written=decodeBase64Tail(tables,next,tailLength,buffer);
+		tailLength=0;
+	}
+	if(!written)
+		return traits_type::eof();
+	setg(buffer,buffer,buffer+written);
+	return traits_type::to_int_type(*gptr());
+}
+
+namespace{
+	const std::size_t gzipInBufferSize=16*1024;
+	const std::size_t gzipOutBufferSize=64*1024;
+}
+
+GzipDecompressingBuffer::GzipDecompressingBuffer(std::istream& src, unsigned long long limit):
+src(src),limit(limit),total(0),finished(false),zs(new z_stream),
+inBuffer(new char[gzipInBufferSize]),outBuffer(new char[gzipOutBufferSize]){
+	readGzipHeader(src);
+	zs->next_in = Z_NULL;
+	zs->avail_in = 0;
+	zs->zalloc = Z_NULL; 
+	zs->zfree = Z_NULL; 
+	zs->opaque = Z_NULL;
 	const int default_window_bits = 15;
 	//invert window bits to indicate lack of header!
-	int result=inflateInit2(&zs, -default_window_bits);
-	if(result!=Z_OK)
+	if(inflateInit2(zs.get(), -default_window_bits)!=Z_OK)
 		throw std::runtime_error("Failed to initialize zlib decompression");
-	struct inflateCleanup{ //ensure that inflateEnd is always called on zs
-		z_stream* s;
-		inflateCleanup(z_stream* s):s(s){}
-		~inflateCleanup(){ inflateEnd(s); }
-	} c(&zs);
-	while(!success || !src.eof()){
-		if(!zs.avail_in){
-			zs.next_in = (unsigned char*)readBuffer.get();
-			//Collect more input
-			//(For the first read we need a substantial amount of data,
-			//because zlib wants to see the entire stream header at one time)
-			while(zs.avail_in<readBlockSize && !src.eof()){
-				src.read(readBuffer.get()+zs.avail_in,readBlockSize-zs.avail_in);
-				zs.avail_in+=src.gcount();
-			}
+	setg(outBuffer.get(),outBuffer.get(),outBuffer.get());
+}
+
+GzipDecompressingBuffer::~GzipDecompressingBuffer(){
+	inflateEnd(zs.get());
+}
+
+GzipDecompressingBuffer::int_type GzipDecompressingBuffer::underflow(){
+	if(gptr()<egptr())
+		return traits_type::to_int_type(*gptr());
+	while(!finished){
+		if(!zs->avail_in){
+			src.read(inBuffer.get(),gzipInBufferSize);
+			zs->avail_in=src.gcount();
+			zs->next_in=(unsigned char*)inBuffer.get();
+			if(!zs->avail_in)
+				throw std::runtime_error("Unexpected end of compressed stream");
+		}
+		zs->next_out=(unsigned char*)outBuffer.get();
+		zs->avail_out=gzipOutBufferSize;
+		int result=inflate(zs.get(),Z_NO_FLUSH);
+		if(result<Z_OK){
+			std::ostringstream ss;
+			ss << "Zlib decompression error: " << result;
+			if(zs->msg!=Z_NULL)
+				ss << " (" << zs->msg << ')';
+			throw std::runtime_error(ss.str());
 		}
-		do{
-			zs.next_out = (unsigned char*)decompBuffer.get();
-			zs.avail_out = decompSize;
-			result=inflate(&zs,Z_NO_FLUSH);
-			if(result<Z_OK){
-				std::ostringstream ss;
-				ss << "Zlib decompression error: " << result;
-				if(zs.msg!=Z_NULL)
-					ss << " (" << zs.msg << ')';
-				throw std::runtime_error(ss.str());
-			}
-			std::streamsize availData = decompSize-zs.avail_out;
-			dest.write(decompBuffer.get(),availData);
-		} while(zs.avail_out==0);
 		if(result==Z_STREAM_END)
-			success=true; //done!
+			finished=true;
+		std::size_t produced=gzipOutBufferSize-zs->avail_out;
+		if(produced){
+			total+=produced;
+			if(limit && total>limit)
+				throw std::length_error("Decompressed data exceeds the limit of "+std::to_string(limit)+" bytes");
+			setg(outBuffer.get(),outBuffer.get(),outBuffer.get()+produced);
+			return traits_type::to_int_type(*gptr());
+		}
 	}
-	if(!success)
-		throw std::runtime_error("Unexpected end of compressed stream");
+	return traits_type::eof();
+}
+
+void gzipDecompress(std::istream& src, std::ostream& dest){
+	GzipDecompressingBuffer decompressed(src);
+	std::unique_ptr<char[]> block(new char[gzipOutBufferSize]);
+	std::streamsize read;
+	while((read=decompressed.sgetn(block.get(),gzipOutBufferSize))>0)
+		dest.write(block.get(),read);
 }
 
 void gzipCompress(std::istream& src, std::ostream& dest){
@@ -626,24 +741,39 @@ bool TarReader::eof() const{
 }
 
 std::string TarReader::readFiles(const std::string& target){
+	EntryHeader header;
+	while(readHeader(header)){
+		if(header.type==FileRecord::REGULAR_FILE)
+			files.insert(std::make_pair(header.name,FileRecord(header.type,header.size,src,header.mode)));
+		else if(header.type == FileRecord::SYMBOLIC_LINK)
+			files.insert(std::make_pair(header.name,FileRecord(header.type,header.linkTarget,header.mode)));
+		else
+			files.insert(std::make_pair(header.name,FileRecord(header.type,header.mode)));
+		
+		skipPadding(header);
+		if(header.name==target || target=="")
+			return(header.name);
+	}
+	return("");
+}
+
+bool TarReader::readHeader(EntryHeader& header){
 	header_posix_ustar h;
 	long long size;
 	unsigned short nEmpty=0;
-	std::string name;
 	while(true){
-		name="";
 		src.read((char*)&h,sizeof(h));
 		
 		if(src.eof() || src.fail()){
 			fileEnded=true;
-			break;
+			return false;
 		}
 		
 		if(h.isEmpty()){
 			nEmpty++;
 			if(nEmpty==2){
 				fileEnded=true;
-				break;
+				return false;
 			}
 			else
 				continue;
@@ -670,22 +800,21 @@ std::string TarReader::readFiles(const std::string& target){
 		int mode;
 		sscanf(h.mode,"%o",&mode);
 		
-		FileRecord::fileType type = typeForTarTypeFlag(*h.typeflag);
-		name=h.getName();
-		
-		if(type==FileRecord::REGULAR_FILE)
-			files.insert(std::make_pair(name,FileRecord(type,size,src,mode)));
-		else if(type == FileRecord::SYMBOLIC_LINK)
-			files.insert(std::make_pair(name,FileRecord(type,h.linkname,mode)));
+		header.name=h.getName();
+		header.type=typeForTarTypeFlag(*h.typeflag);
+		header.size=size;
+		header.mode=mode;
+		if(header.type==FileRecord::SYMBOLIC_LINK)
+			header.linkTarget=std::string(h.linkname,strnlen(h.linkname,sizeof(h.linkname)));
 		else
-			files.insert(std::make_pair(name,FileRecord(type,mode)));
-		
-		if(size%512)
-			src.ignore(512-(size%512));
-		if(name==target || target=="")
-			break;
+			header.linkTarget.clear();
+		return true;
 	}
-	return(name);
+}
+
+void TarReader::skipPadding(const EntryHeader& header){
+	if(header.size%512)
+		src.ignore(512-(header.size%512));
 }
 
 ///A version of realpath(3) which can process paths which may not currently exist. 
@@ -820,7 +949,7 @@ std::string realpathHyp(std::string orig){
 	return assemble();
 }
 
-void TarReader::extractToFileSystem(const std::string& prefix, bool dropAfterExtracting){
+void TarReader::extractToFileSystem(const std::string& prefix){
 	//TODO: this won't play well with any previous calls to other extraction functions. 
 	//We can't just dump out the contents of files because the order of directories
 	//and their contents matters, and we don't store that. For now just error out. 
@@ -843,10 +972,11 @@ void TarReader::extractToFileSystem(const std::string& prefix, bool dropAfterExt
 		return std::string(rawPrefix.get());
 	}();
 	
-	while(!eof()){
-		std::string baseFileName=readFiles("");
-		if(baseFileName.empty())
-			break;
+	const std::size_t copyBufferSize=64*1024;
+	std::unique_ptr<char[]> copyBuffer(new char[copyBufferSize]);
+	EntryHeader header;
+	while(readHeader(header)){
+		const std::string& baseFileName=header.name;
 		std::string filePath=baseFileName;
 		if(!truePrefix.empty())
 			filePath=truePrefix+"/"+filePath;
@@ -860,22 +990,31 @@ void TarReader::extractToFileSystem(const std::string& prefix, bool dropAfterExt
 		if(filePath.find(truePrefix)!=0)
 			throw std::runtime_error("Refusing to extract "+baseFileName+" to "+filePath+" which is not within "+truePrefix);
 		
-		const FileRecord& file=files[baseFileName];
 		//TODO: set permissions on extracted files
-		switch(file.getType()){
+		switch(header.type){
 			case FileRecord::REGULAR_FILE:
 			{
 				std::ofstream outfile(filePath);
 				if(!outfile)
 					throw std::runtime_error("Unable to open "+filePath+" for writing");
-				std::ostreambuf_iterator<char> out_it (outfile);
-				const std::string& fileData=file.getData();
-				std::copy(fileData.begin(), fileData.end(), out_it);
+				//copy the data through a fixed-size buffer, so that large files
+				//are never held in memory
+				unsigned long long remaining=header.size;
+				while(remaining){
+					std::streamsize chunk=std::min<unsigned long long>(remaining,copyBufferSize);
+					src.read(copyBuffer.get(),chunk);
+					if(src.gcount()!=chunk)
+						throw std::runtime_error("Unexpected end of tar stream while reading "+baseFileName);
+					outfile.write(copyBuffer.get(),chunk);
+					remaining-=chunk;
+				}
+				if(!outfile)
+					throw std::runtime_error("Unable to write "+filePath);
 				break;
 			}
 			case FileRecord::SYMBOLIC_LINK:
 			{
-				std::string linkPath=realpathHyp(file.getData());
+				std::string linkPath=realpathHyp(header.linkTarget);
 				if(linkPath.find(truePrefix)!=0)
 					throw std::runtime_error("Refusing to extract symlink pointing to "+linkPath+" which is not within "+truePrefix);
 				int err=symlink(linkPath.c_str(),filePath.c_str());
@@ -891,10 +1030,9 @@ void TarReader::extractToFileSystem(const std::string& prefix, bool dropAfterExt
 				break;
 			}
 			default:
-				throw std::runtime_error("Extraction not implemented for file type "+std::to_string(file.getType()));
+				throw std::runtime_error("Extraction not implemented for file type "+std::to_string(header.type));
 		}
-		if(dropAfterExtracting)
-			dropFile(baseFileName);
+		skipPadding(header);
 	}
 }
 
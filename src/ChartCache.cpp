@@ -0,0 +1,133 @@
+#include "ChartCache.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C"{
+	#include <scrypt/alg/sha256.h>
+}
+
+#include "FileSystem.h"
+#include "Logging.h"
+
+namespace{
+
+///Remove a file or directory, and everything within it
+void removeAll(const std::string& path){
+	struct stat info;
+	if(lstat(path.c_str(),&info))
+		return;
+	if(S_ISDIR(info.st_mode)){
+		recursivelyDestroyDirectory(path);
+		rmdir(path.c_str());
+	}
+	else
+		unlink(path.c_str());
+}
+
+///Total the sizes of the files beneath a directory
+unsigned long long diskUsage(const std::string& path){
+	unsigned long long total=0;
+	for(directory_iterator it(path), end; it!=end; it++){
+		if(it->path().name()=="." || it->path().name()=="..")
+			continue;
+		if(is_directory(*it))
+			total+=diskUsage(it->path().str());
+		else{
+			struct stat info;
+			if(!lstat(it->path().str().c_str(),&info))
+				total+=info.st_size;
+		}
+	}
+	return total;
+}
+
+}
+
+ChartCache::Entry::~Entry(){
+	removeAll(directory);
+}
+
+ChartCache::ChartCache(const std::string& directory, unsigned long long capacity):
+directory(directory),capacity(capacity),size(0){
+	mkdir_p(directory,0700);
+	for(directory_iterator it(directory), end; it!=end; it++){
+		if(it->path().name()=="." || it->path().name()=="..")
+			continue;
+		removeAll(it->path().str());
+	}
+	log_info("Caching up to " << capacity << " bytes of ad-hoc charts in " << directory);
+}
+
+std::string ChartCache::key(const char* data, std::size_t length){
+	uint8_t digest[32];
+	SHA256_Buf(data,length,digest);
+	static const char hexDigits[]="0123456789abcdef";
+	std::string key(2*sizeof(digest),'\0');
+	for(std::size_t i=0; i<sizeof(digest); i++){
+		key[2*i]=hexDigits[digest[i]>>4];
+		key[2*i+1]=hexDigits[digest[i]&0xF];
+	}
+	return key;
+}
+
+FileHandle ChartCache::makeStagingDir() const{
+	return makeTemporaryDir(directory+"/staging_");
+}
+
+std::shared_ptr<const ChartCache::Chart> ChartCache::find(const std::string& key){
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it=entries.find(key);
+	if(it==entries.end())
+		return nullptr;
+	recency.splice(recency.begin(),recency,it->second.position);
+	const auto& entry=it->second.entry;
+	return std::shared_ptr<const Chart>(entry,&entry->chart);
+}
+
+std::shared_ptr<const ChartCache::Chart> ChartCache::insert(const std::string& key, FileHandle&& stagingDir,
+                                                            const std::string& chartSubDir, const std::string& name){
+	//take over the staging directory; from here on the entry is responsible
+	//for removing it
+	std::shared_ptr<Entry> entry=std::make_shared<Entry>();
+	entry->directory=stagingDir.release();
+	entry->size=diskUsage(entry->directory);
+	entry->chart.name=name;
+	entry->chart.path=entry->directory+"/"+chartSubDir;
+	std::shared_ptr<const Chart> chart(entry,&entry->chart);
+	if(entry->size>capacity)
+		return chart;
+
+	const std::string cachedDirectory=directory+"/"+key;
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it=entries.find(key);
+	if(it!=entries.end()){ //the same chart was inserted concurrently
+		recency.splice(recency.begin(),recency,it->second.position);
+		return std::shared_ptr<const Chart>(it->second.entry,&it->second.entry->chart);
+	}
+	if(rename(entry->directory.c_str(),cachedDirectory.c_str())){
+		int err=errno;
+		log_error("Failed to move chart into cache at " << cachedDirectory << ": " << strerror(err));
+		return chart;
+	}
+	entry->directory=cachedDirectory;
+	entry->chart.path=cachedDirectory+"/"+chartSubDir;
+	recency.push_front(key);
+	entries.emplace(key,Slot{entry,recency.begin()});
+	size+=entry->size;
+	//discard the least recently used charts until the cache fits. Charts
+	//which are still in use are removed from disk once they are released.
+	while(size>capacity){
+		auto victim=entries.find(recency.back());
+		size-=victim->second.entry->size;
+		entries.erase(victim);
+		recency.pop_back();
+	}
+	return chart;
+}
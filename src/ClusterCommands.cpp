@@ -22,10 +22,31 @@ crow::response listClusters(PersistentStore& store, const crow::request& req){
 		return crow::response(403,generateError("Not authorized"));
 	//All users are allowed to list clusters
 
+	bool paged;
+	std::size_t limit;
+	std::string cursor, nextCursor;
+	if(!getPageParameters(req,paged,limit,cursor))
+		return crow::response(400,generateError("Invalid page limit"));
+
 	if (auto vo = req.url_params.get("vo"))
 		clusters=store.listClustersByVO(vo);
+	else if(paged){
+		ListPage<Cluster> page=store.listClustersPage(limit,cursor);
+		if(page.status==PageStatus::InvalidCursor)
+			return crow::response(400,generateError("Invalid cursor"));
+		if(page.status!=PageStatus::Fetched)
+			return crow::response(500,generateError("Failed to list clusters"));
+		clusters=std::move(page.items);
+		nextCursor=std::move(page.nextCursor);
+	}
 	else
 		clusters=store.listClusters();
+	
+	std::vector<std::string> voIDs;
+	voIDs.reserve(clusters.size());
+	for(const Cluster& cluster : clusters)
+		voIDs.push_back(cluster.owningVO);
+	auto voNames=store.getVONames(voIDs);
 
 	rapidjson::Document result(rapidjson::kObjectType);
 	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
@@ -40,11 +61,13 @@ crow::response listClusters(PersistentStore& store, const crow::request& req){
 		rapidjson::Value clusterData(rapidjson::kObjectType);
 		clusterData.AddMember("id", cluster.id, alloc);
 		clusterData.AddMember("name", cluster.name, alloc);
-		clusterData.AddMember("owningVO", store.findVOByID(cluster.owningVO).name, alloc);
+		clusterData.AddMember("owningVO", voNames[cluster.owningVO], alloc);
 		clusterResult.AddMember("metadata", clusterData, alloc);
 		resultItems.PushBack(clusterResult, alloc);
 	}
 	result.AddMember("items", resultItems, alloc);
+	if(!nextCursor.empty())
+		result.AddMember("nextCursor", nextCursor, alloc);
 
 	return crow::response(to_string(result));
 }
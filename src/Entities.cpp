@@ -2,9 +2,7 @@
 
 #include <boost/lexical_cast.hpp>
 
-#include <boost/archive/iterators/base64_from_binary.hpp>
-#include <boost/archive/iterators/transform_width.hpp>
-#include <boost/archive/iterators/ostream_iterator.hpp>
+#include "Archive.h"
 
 bool operator==(const User& u1, const User& u2){
 	return(u1.valid==u2.valid && u1.id==u2.id);
@@ -93,15 +91,5 @@ std::string IDGenerator::generateRawID(){
 		std::lock_guard<std::mutex> lock(mut);
 		value=std::uniform_int_distribution<uint64_t>()(idSource);
 	}
-	std::ostringstream os;
-	using namespace boost::archive::iterators;
-	using base64_text=base64_from_binary<transform_width<const unsigned char*,6,8>>;
-	std::copy(base64_text((char*)&value),base64_text((char*)&value+sizeof(value)),ostream_iterator<char>(os));
-	std::string result=os.str();
-	//convert to RFC 4648 URL- and filename-safe base64
-	for(char& c : result){
-		if(c=='+') c='-';
-		if(c=='/') c='_';
-	}
-	return result;
+	return encodeBase64(std::string((const char*)&value,sizeof(value)),Base64Alphabet::URLSafe);
 }
@@ -0,0 +1,137 @@
+#include "Executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+
+#include "Logging.h"
+
+Executor::Executor(std::size_t threads, std::size_t maxQueued):
+maxQueued(maxQueued),stopping(false){
+	if(threads==0)
+		throw std::runtime_error("An Executor requires at least one thread");
+	workers.reserve(threads);
+	for(std::size_t i=0; i<threads; i++)
+		workers.emplace_back(&Executor::work,this);
+}
+
+Executor::~Executor(){
+	{
+		std::lock_guard<std::mutex> lock(mut);
+		stopping=true;
+	}
+	cond.notify_all();
+	for(auto& worker : workers)
+		worker.join();
+}
+
+bool Executor::submit(std::function<void()> task){
+	{
+		std::lock_guard<std::mutex> lock(mut);
+		if(stopping || tasks.size()>=maxQueued)
+			return false;
+		tasks.push_back(std::move(task));
+	}
+	cond.notify_one();
+	return true;
+}
+
+std::size_t Executor::queued() const{
+	std::lock_guard<std::mutex> lock(mut);
+	return tasks.size();
+}
+
+void Executor::work(){
+	while(true){
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mut);
+			cond.wait(lock,[this]{ return stopping || !tasks.empty(); });
+			if(tasks.empty()) //only possible when stopping
+				return;
+			task=std::move(tasks.front());
+			tasks.pop_front();
+		}
+		try{
+			task();
+		}catch(std::exception& ex){
+			log_error("Exception escaped from asynchronous task: " << ex.what());
+		}catch(...){
+			log_error("Unknown object thrown from asynchronous task");
+		}
+	}
+}
+
+namespace{
+///Threads which help the callers of parallelFor, so that each call does not
+///start threads of its own. Callers do any work which the helpers do not get
+///to, so a helper which is refused or runs late costs only speed.
+Executor& parallelHelpers(){
+	static Executor helpers(16,1024);
+	return helpers;
+}
+}
+
+void parallelFor(std::size_t count, std::size_t concurrency,
+                 const std::function<void(std::size_t)>& body){
+	//Helper tasks may still be queued after the call returns, so they share 
+	//this state rather than referring to the caller's stack. Once the call is
+	//closed, a helper which has not yet started does nothing. 
+	struct State{
+		State(const std::function<void(std::size_t)>& body):
+		body(body),next(0),active(0),closed(false){}
+		const std::function<void(std::size_t)>& body;
+		std::atomic<std::size_t> next;
+		std::mutex mut;
+		std::condition_variable cond;
+		std::size_t active;
+		bool closed;
+		std::exception_ptr error;
+	};
+	auto state=std::make_shared<State>(body);
+	auto work=[count](State& state){
+		for(std::size_t i=state.next++; i<count; i=state.next++){
+			try{
+				state.body(i);
+			}catch(...){
+				std::lock_guard<std::mutex> lock(state.mut);
+				if(!state.error)
+					state.error=std::current_exception();
+			}
+		}
+	};
+	std::size_t helpers=std::min(concurrency,count);
+	if(helpers>0)
+		helpers--; //the calling thread also does work
+	try{
+		for(std::size_t i=0; i<helpers; i++){
+			bool queued=parallelHelpers().submit([state,work]{
+				{
+					std::lock_guard<std::mutex> lock(state->mut);
+					if(state->closed)
+						return;
+					state->active++;
+				}
+				work(*state);
+				{
+					std::lock_guard<std::mutex> lock(state->mut);
+					state->active--;
+				}
+				state->cond.notify_all();
+			});
+			if(!queued)
+				break;
+		}
+	}catch(std::exception& ex){
+		//whatever could not be handed off is done by this thread
+		log_error("Unable to start parallel work: " << ex.what());
+	}
+	work(*state);
+	std::unique_lock<std::mutex> lock(state->mut);
+	state->closed=true;
+	state->cond.wait(lock,[&]{ return state->active==0; });
+	if(state->error)
+		std::rethrow_exception(state->error);
+}
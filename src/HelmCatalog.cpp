@@ -0,0 +1,272 @@
+#include "HelmCatalog.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <yaml-cpp/exceptions.h>
+#include <yaml-cpp/node/node.h>
+#include <yaml-cpp/node/impl.h>
+#include "yaml-cpp/node/convert.h"
+#include "yaml-cpp/node/detail/impl.h"
+#include "yaml-cpp/node/iterator.h"
+#include <yaml-cpp/node/parse.h>
+
+#include "Logging.h"
+#include "Process.h"
+
+std::string filterValuesFile(std::string data){
+	const static std::string startMarker="### SLATE-START ###";
+	const static std::string endMarker="### SLATE-END ###";
+	std::size_t pos=0;
+	while(true){
+		std::size_t startPos=data.find(startMarker,pos);
+		if(startPos==std::string::npos)
+			break;
+		std::size_t endPos=data.find(endMarker,startPos);
+		if(endPos==std::string::npos){
+			log_error("Unbalanced SLATE-internal markers in values data");
+			break;
+		}
+		data.erase(startPos,endPos-startPos + endMarker.size());
+		pos=startPos;
+	}
+	return data;
+}
+
+bool extractInstanceTag(const std::string& config, bool& gotTag, std::string& tag){
+	std::vector<YAML::Node> parsedConfig;
+	try{
+		parsedConfig=YAML::LoadAll(config);
+	}catch(const YAML::ParserException& ex){
+		return false;
+	}
+	for(const auto& document : parsedConfig){
+		if(document.IsMap() && document["Instance"] && document["Instance"].IsScalar()){
+			tag=document["Instance"].as<std::string>();
+			gotTag=true;
+		}
+	}
+	return true;
+}
+
+namespace{
+
+///A chart version, parsed according to the semantic versioning rules which
+///helm uses to order the versions in a repository
+struct Version{
+	bool valid;
+	unsigned long long numbers[3];
+	std::vector<std::string> prerelease;
+};
+
+bool isNumeric(const std::string& s){
+	return !s.empty() && std::all_of(s.begin(),s.end(),[](char c){ return std::isdigit((unsigned char)c); });
+}
+
+///Parse a version like 1.2.3-rc.1+build, tolerating a leading 'v' and missing
+///minor or patch numbers, as helm does
+Version parseVersion(std::string s){
+	Version v;
+	v.valid=false;
+	v.numbers[0]=v.numbers[1]=v.numbers[2]=0;
+	if(!s.empty() && s[0]=='v')
+		s.erase(0,1);
+	std::size_t end=s.find('+');
+	if(end!=std::string::npos) //build metadata does not affect ordering
+		s.erase(end);
+	end=s.find('-');
+	if(end!=std::string::npos){
+		std::size_t pos=end+1;
+		while(true){
+			std::size_t next=s.find('.',pos);
+			v.prerelease.push_back(s.substr(pos,next-pos));
+			if(next==std::string::npos)
+				break;
+			pos=next+1;
+		}
+		s.erase(end);
+	}
+	std::size_t pos=0;
+	for(unsigned int i=0; i<3; i++){
+		std::size_t next=s.find('.',pos);
+		std::string part=s.substr(pos,next-pos);
+		if(!isNumeric(part))
+			return v;
+		v.numbers[i]=std::strtoull(part.c_str(),nullptr,10);
+		if(next==std::string::npos)
+			break;
+		if(i==2) //too many components
+			return v;
+		pos=next+1;
+	}
+	v.valid=true;
+	return v;
+}
+
+///\return whether a is an earlier version than b. Versions which cannot be
+///        parsed are earlier than any which can.
+bool versionLess(const Version& a, const Version& b){
+	if(a.valid!=b.valid)
+		return b.valid;
+	for(unsigned int i=0; i<3; i++){
+		if(a.numbers[i]!=b.numbers[i])
+			return a.numbers[i]<b.numbers[i];
+	}
+	//a pre-release precedes the release
+	if(a.prerelease.empty() || b.prerelease.empty())
+		return !a.prerelease.empty() && b.prerelease.empty();
+	for(std::size_t i=0; i<a.prerelease.size() && i<b.prerelease.size(); i++){
+		const std::string& x=a.prerelease[i];
+		const std::string& y=b.prerelease[i];
+		if(x==y)
+			continue;
+		bool xNumeric=isNumeric(x), yNumeric=isNumeric(y);
+		if(xNumeric && yNumeric)
+			return std::strtoull(x.c_str(),nullptr,10)<std::strtoull(y.c_str(),nullptr,10);
+		if(xNumeric!=yNumeric) //numeric identifiers precede alphanumeric ones
+			return xNumeric;
+		return x<y;
+	}
+	return a.prerelease.size()<b.prerelease.size();
+}
+
+///Read a repository index file, keeping the latest version of each chart, as
+///`helm search` reports
+///\throws YAML::Exception if the file cannot be read or parsed
+std::vector<HelmCatalog::Chart> readIndexFile(const std::string& path){
+	std::vector<HelmCatalog::Chart> charts;
+	const YAML::Node index=YAML::LoadFile(path);
+	const YAML::Node entries=index["entries"];
+	if(!entries.IsMap())
+		return charts;
+	for(const auto& entry : entries){
+		const YAML::Node& versions=entry.second;
+		if(!versions.IsSequence() || versions.size()==0)
+			continue;
+		std::size_t latestIndex=0;
+		Version latestVersion=parseVersion(versions[0]["version"].as<std::string>(""));
+		for(std::size_t i=1; i<versions.size(); i++){
+			Version version=parseVersion(versions[i]["version"].as<std::string>(""));
+			if(versionLess(latestVersion,version)){
+				latestIndex=i;
+				latestVersion=version;
+			}
+		}
+		const YAML::Node latest=versions[latestIndex];
+		HelmCatalog::Chart chart;
+		chart.name=entry.first.as<std::string>();
+		chart.version=latest["version"].as<std::string>("");
+		chart.appVersion=latest["appVersion"].as<std::string>("");
+		chart.description=latest["description"].as<std::string>("");
+		charts.push_back(std::move(chart));
+	}
+	std::sort(charts.begin(),charts.end(),
+	          [](const HelmCatalog::Chart& a, const HelmCatalog::Chart& b){ return a.name<b.name; });
+	return charts;
+}
+
+}
+
+HelmCatalog::HelmCatalog(std::string helmHome):
+helmHome(std::move(helmHome)),index(std::make_shared<Index>()){
+	reload();
+}
+
+void HelmCatalog::reload(){
+	std::lock_guard<std::mutex> lock(reloadMutex);
+	const std::shared_ptr<Index> previous=currentIndex();
+	std::shared_ptr<Index> updated=std::make_shared<Index>();
+
+	const std::string repoDir=helmHome+"/repository";
+	YAML::Node repositories;
+	try{
+		repositories=YAML::LoadFile(repoDir+"/repositories.yaml")["repositories"];
+	}catch(YAML::Exception& ex){
+		log_error("Unable to read helm repository list: " << ex.what());
+		return;
+	}
+	if(repositories.IsSequence()){
+		for(const auto& repository : repositories){
+			const std::string name=repository["name"].as<std::string>("");
+			if(name.empty())
+				continue;
+			//older versions of helm record the full path to the index file,
+			//newer ones only its name within the cache directory
+			std::string indexPath=repository["cache"].as<std::string>(name+"-index.yaml");
+			if(indexPath.empty() || indexPath[0]!='/')
+				indexPath=repoDir+"/cache/"+indexPath;
+			try{
+				auto charts=std::make_shared<const std::vector<Chart>>(readIndexFile(indexPath));
+				log_info("Loaded " << charts->size() << " charts from helm repository " << name);
+				updated->repositories.emplace(name,std::move(charts));
+			}catch(YAML::Exception& ex){
+				log_error("Unable to read index for helm repository " << name << " from "
+				          << indexPath << ": " << ex.what());
+				//keep serving what we had, if anything
+				auto old=previous->repositories.find(name);
+				if(old!=previous->repositories.end())
+					updated->repositories.emplace(name,old->second);
+			}
+		}
+	}
+	std::atomic_store(&index,updated);
+}
+
+std::shared_ptr<HelmCatalog::Index> HelmCatalog::currentIndex() const{
+	return std::atomic_load(&index);
+}
+
+std::shared_ptr<const std::vector<HelmCatalog::Chart>> HelmCatalog::listCharts(const std::string& repo) const{
+	const std::shared_ptr<Index> current=currentIndex();
+	auto it=current->repositories.find(repo);
+	if(it==current->repositories.end())
+		return std::make_shared<const std::vector<Chart>>();
+	return it->second;
+}
+
+std::shared_ptr<const HelmCatalog::Chart> HelmCatalog::findChart(const std::string& repo, const std::string& name) const{
+	const auto charts=listCharts(repo);
+	auto it=std::lower_bound(charts->begin(),charts->end(),name,
+	                         [](const Chart& chart, const std::string& name){ return chart.name<name; });
+	if(it==charts->end() || it->name!=name)
+		return nullptr;
+	return std::shared_ptr<const Chart>(charts,&*it);
+}
+
+std::shared_ptr<const HelmCatalog::ChartDefaults> HelmCatalog::getDefaults(const std::string& repo, const Chart& chart){
+	const std::shared_ptr<Index> current=currentIndex();
+	const std::string key=repo+"/"+chart.name+":"+chart.version;
+	{
+		std::lock_guard<std::mutex> lock(current->defaultsMutex);
+		auto it=current->defaults.find(key);
+		if(it!=current->defaults.end())
+			return it->second;
+	}
+	return current->defaultsFetches.run(key,[&]{
+		auto defaults=readDefaults(repo+"/"+chart.name,chart.version);
+		std::lock_guard<std::mutex> lock(current->defaultsMutex);
+		current->defaults.emplace(key,defaults);
+		return defaults;
+	});
+}
+
+std::shared_ptr<const HelmCatalog::ChartDefaults> HelmCatalog::readDefaults(const std::string& source, const std::string& version){
+	std::vector<std::string> args={"inspect","values",source};
+	if(!version.empty()){
+		args.push_back("--version");
+		args.push_back(version);
+	}
+	auto result=runCommand("helm",args);
+	if(result.status){
+		log_error("Command failed: helm inspect values " << source 
+		          << (version.empty() ? "" : " --version "+version) << ": " << result.error);
+		throw std::runtime_error("Unable to fetch values for "+source);
+	}
+	auto defaults=std::make_shared<ChartDefaults>();
+	defaults->hasTag=false;
+	defaults->valid=extractInstanceTag(result.output,defaults->hasTag,defaults->tag);
+	defaults->values=filterValuesFile(std::move(result.output));
+	return defaults;
+}
@@ -0,0 +1,166 @@
+#include "InvalidationBus.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "FileSystem.h"
+#include "Logging.h"
+
+std::string serializeInvalidation(const Invalidation& invalidation){
+	std::string message=invalidation.kind;
+	message+='\0';
+	message+=invalidation.id;
+	for(const auto& key : invalidation.related){
+		message+='\0';
+		message+=key;
+	}
+	return message;
+}
+
+bool deserializeInvalidation(const std::string& message, Invalidation& invalidation){
+	std::vector<std::string> fields;
+	std::size_t start=0;
+	while(true){
+		std::size_t end=message.find('\0',start);
+		fields.push_back(message.substr(start,end-start));
+		if(end==std::string::npos)
+			break;
+		start=end+1;
+	}
+	if(fields.size()<2 || fields[0].empty() || fields[1].empty())
+		return false;
+	invalidation.kind=std::move(fields[0]);
+	invalidation.id=std::move(fields[1]);
+	invalidation.related.assign(std::make_move_iterator(fields.begin()+2),
+	                            std::make_move_iterator(fields.end()));
+	return true;
+}
+
+namespace{
+
+///How long a publisher waits for a replica which is not keeping up with its
+///invalidations to make room for another, before giving up on it
+const timeval sendTimeout={0,500000};
+
+bool makeAddress(const std::string& path, sockaddr_un& address){
+	if(path.size()>=sizeof(address.sun_path))
+		return false;
+	std::memset(&address,0,sizeof(address));
+	address.sun_family=AF_UNIX;
+	std::strcpy(address.sun_path,path.c_str());
+	return true;
+}
+
+}
+
+LocalInvalidationBus::LocalInvalidationBus(const std::string& directory):
+directory(directory),socketFD(-1),stopping(false){
+	mkdir_p(directory,0700);
+	socketPath=directory+"/"+std::to_string(getpid())+"-"+std::to_string(std::random_device()())+".sock";
+	sockaddr_un address;
+	if(!makeAddress(socketPath,address))
+		log_fatal("Invalidation socket path " << socketPath << " is too long");
+	socketFD=socket(AF_UNIX,SOCK_DGRAM,0);
+	if(socketFD<0){
+		int err=errno;
+		log_fatal("Failed to create invalidation socket: " << strerror(err));
+	}
+	if(bind(socketFD,(const sockaddr*)&address,sizeof(address))){
+		int err=errno;
+		close(socketFD);
+		log_fatal("Failed to bind invalidation socket " << socketPath << ": " << strerror(err));
+	}
+	//Sends block while the receiving replica's queue is full, so that a burst 
+	//of changes is not lost, but only briefly, so that a replica which has 
+	//stopped reading cannot stall the others
+	if(setsockopt(socketFD,SOL_SOCKET,SO_SNDTIMEO,&sendTimeout,sizeof(sendTimeout))){
+		int err=errno;
+		close(socketFD);
+		unlink(socketPath.c_str());
+		log_fatal("Failed to set timeout for invalidation socket: " << strerror(err));
+	}
+	log_info("Listening for cache invalidations on " << socketPath);
+}
+
+LocalInvalidationBus::~LocalInvalidationBus(){
+	stopping=true;
+	if(receiver.joinable()){
+		//wake the receiver, which is waiting for a message
+		sockaddr_un address;
+		makeAddress(socketPath,address);
+		sendto(socketFD,"",0,0,(const sockaddr*)&address,sizeof(address));
+		receiver.join();
+	}
+	close(socketFD);
+	unlink(socketPath.c_str());
+}
+
+void LocalInvalidationBus::publish(const Invalidation& invalidation){
+	const std::string message=serializeInvalidation(invalidation);
+	for(directory_iterator it(directory), end; it!=end; ++it){
+		auto path=it->path();
+		if(path.extension()!="sock" || path.str()==socketPath)
+			continue;
+		sockaddr_un address;
+		if(!makeAddress(path.str(),address))
+			continue;
+		ssize_t sent;
+		do{
+			sent=sendto(socketFD,message.data(),message.size(),0,
+			            (const sockaddr*)&address,sizeof(address));
+		}while(sent<0 && errno==EINTR);
+		if(sent>=0)
+			continue;
+		int err=errno;
+		if(err==ECONNREFUSED || err==ENOENT) //the replica has exited without cleaning up
+			unlink(path.str().c_str());
+		else if(err==EAGAIN || err==EWOULDBLOCK)
+			log_error("Cache invalidation of " << invalidation.kind << " " << invalidation.id 
+			          << " was not accepted by " << path.str() << " in time; it will serve a stale "
+			          "record until its cache entry expires");
+		else
+			log_error("Failed to send cache invalidation to " << path.str() << ": " << strerror(err));
+	}
+}
+
+void LocalInvalidationBus::subscribe(Handler handler){
+	if(receiver.joinable())
+		throw std::logic_error("LocalInvalidationBus::subscribe may only be called once");
+	receiver=std::thread(&LocalInvalidationBus::receive,this,std::move(handler));
+}
+
+void LocalInvalidationBus::receive(Handler handler){
+	const std::size_t bufferSize=65536;
+	std::unique_ptr<char[]> buffer(new char[bufferSize]);
+	while(!stopping){
+		ssize_t received=recv(socketFD,buffer.get(),bufferSize,0);
+		if(received<0){
+			int err=errno;
+			if(err==EINTR)
+				continue;
+			log_error("Failed to receive cache invalidation: " << strerror(err));
+			return;
+		}
+		if(stopping)
+			break;
+		Invalidation invalidation;
+		if(!deserializeInvalidation(std::string(buffer.get(),received),invalidation)){
+			log_error("Ignoring malformed cache invalidation");
+			continue;
+		}
+		try{
+			handler(invalidation);
+		}catch(std::exception& ex){
+			log_error("Failed to apply cache invalidation for " << invalidation.id << ": " << ex.what());
+		}
+	}
+}
@@ -0,0 +1,465 @@
+#include "KubeAPIClient.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+#include <curl/curl.h>
+#include <yaml-cpp/yaml.h>
+
+#include "Archive.h"
+#include "FileHandle.h"
+#include "Logging.h"
+#include "Utilities.h"
+
+namespace kubernetes{
+
+namespace{
+
+///The total time allowed for a request, matching the --request-timeout which
+///is passed when kubectl is run
+const long requestTimeoutSeconds=10;
+///The maximum number of idle handles (and so open connections) kept per cluster
+const std::size_t maxIdleHandles=4;
+
+size_t collectOutput(char* data, size_t size, size_t nmemb, void* userp){
+	static_cast<std::string*>(userp)->append(data,size*nmemb);
+	return size*nmemb;
+}
+
+std::string escape(CURL* handle, const std::string& raw){
+	std::unique_ptr<char,void(*)(void*)> escaped(curl_easy_escape(handle,raw.c_str(),(int)raw.size()),curl_free);
+	if(!escaped)
+		throw std::runtime_error("Failed to URL escape "+raw);
+	return escaped.get();
+}
+
+///Find the entry with a given name in one of the named lists in a kubeconfig
+YAML::Node findNamed(const YAML::Node& list, const std::string& name, const std::string& member){
+	if(list && list.IsSequence()){
+		for(const auto& entry : list){
+			if(entry["name"] && entry["name"].as<std::string>()==name)
+				return entry[member];
+		}
+	}
+	return YAML::Node();
+}
+
+bool fileExists(const std::string& path){
+	struct stat info;
+	return stat(path.c_str(),&info)==0;
+}
+
+///Describe an unsuccessful response in the way kubectl would
+std::string describeFailure(long code, const std::string& body){
+	rapidjson::Document status;
+	status.Parse(body.c_str());
+	if(!status.HasParseError() && status.IsObject() && status.HasMember("message")
+	   && status["message"].IsString()){
+		std::string reason;
+		if(status.HasMember("reason") && status["reason"].IsString())
+			reason=status["reason"].GetString();
+		return "Error from server"+(reason.empty()?std::string():" ("+reason+")")
+		       +": "+status["message"].GetString()+"\n";
+	}
+	return "Error from server (HTTP "+std::to_string(code)+"): "+body+"\n";
+}
+
+///Reshape a list returned by the API into the generic List which kubectl
+///prints, in which each item carries its own kind and apiVersion.
+std::string convertList(const std::string& body){
+	rapidjson::Document list;
+	list.Parse(body.c_str());
+	if(list.HasParseError() || !list.IsObject() || !list.HasMember("items")
+	   || !list["items"].IsArray())
+		return body;
+	auto& alloc=list.GetAllocator();
+	std::string itemKind;
+	if(list.HasMember("kind") && list["kind"].IsString()){
+		itemKind=list["kind"].GetString();
+		if(itemKind.size()>4 && itemKind.compare(itemKind.size()-4,4,"List")==0)
+			itemKind.erase(itemKind.size()-4);
+	}
+	std::string apiVersion;
+	if(list.HasMember("apiVersion") && list["apiVersion"].IsString())
+		apiVersion=list["apiVersion"].GetString();
+	for(auto& item : list["items"].GetArray()){
+		if(!item.IsObject())
+			continue;
+		if(!item.HasMember("apiVersion") && !apiVersion.empty())
+			item.AddMember("apiVersion",rapidjson::Value(apiVersion,alloc),alloc);
+		if(!item.HasMember("kind") && !itemKind.empty())
+			item.AddMember("kind",rapidjson::Value(itemKind,alloc),alloc);
+	}
+	if(list.HasMember("kind"))
+		list["kind"].SetString("List");
+	if(list.HasMember("apiVersion"))
+		list["apiVersion"].SetString("v1");
+	return to_string(list);
+}
+
+}
+
+///Everything needed to contact and authenticate to a single cluster
+struct APIClient::Connection{
+	///Whether the kubeconfig could be understood; if not, all operations
+	///must be performed by kubectl
+	bool usable;
+	///The base URL of the API server, without a trailing slash
+	std::string server;
+	bool verifyPeer;
+	std::string caPath;
+	std::string certPath;
+	std::string keyPath;
+	std::string token;
+	std::string username;
+	std::string password;
+	///Files holding credentials which were embedded in the kubeconfig
+	std::vector<FileHandle> credentialFiles;
+
+	std::mutex idleMutex;
+	///Handles not currently in use, each of which may hold an open connection
+	std::vector<CURL*> idle;
+
+	explicit Connection(const std::string& configPath);
+	~Connection();
+
+	///Get a handle configured for this cluster, preferring one which has
+	///already connected
+	CURL* acquire();
+	///Return a handle for reuse by a later request
+	void release(CURL* handle);
+
+private:
+	///Get the path to a file for a credential which may be given either
+	///inline, base64 encoded, or as a path relative to the kubeconfig
+	std::string credentialPath(const YAML::Node& entry, const std::string& name,
+	                           const std::string& configPath);
+};
+
+APIClient::Connection::Connection(const std::string& configPath):
+usable(false),verifyPeer(true){
+	try{
+		YAML::Node config=YAML::LoadFile(configPath);
+		if(!config["current-context"])
+			return;
+		std::string contextName=config["current-context"].as<std::string>();
+		YAML::Node context=findNamed(config["contexts"],contextName,"context");
+		if(!context.IsMap() || !context["cluster"] || !context["user"])
+			return;
+		YAML::Node cluster=findNamed(config["clusters"],context["cluster"].as<std::string>(),"cluster");
+		YAML::Node user=findNamed(config["users"],context["user"].as<std::string>(),"user");
+		if(!cluster.IsMap() || !cluster["server"])
+			return;
+		//proxies and plugin-based authentication are left to kubectl
+		if(cluster["proxy-url"] || (user.IsMap() && (user["exec"] || user["auth-provider"]
+		   || user["tokenFile"] || user["as"])))
+			return;
+
+		server=cluster["server"].as<std::string>();
+		while(!server.empty() && server.back()=='/')
+			server.pop_back();
+		if(cluster["insecure-skip-tls-verify"])
+			verifyPeer=!cluster["insecure-skip-tls-verify"].as<bool>();
+		caPath=credentialPath(cluster,"certificate-authority",configPath);
+		if(user.IsMap()){
+			certPath=credentialPath(user,"client-certificate",configPath);
+			keyPath=credentialPath(user,"client-key",configPath);
+			if(user["token"])
+				token=user["token"].as<std::string>();
+			if(user["username"])
+				username=user["username"].as<std::string>();
+			if(user["password"])
+				password=user["password"].as<std::string>();
+		}
+		usable=!server.empty();
+	}catch(std::exception& ex){
+		log_info("Unable to use " << configPath << " for direct API access: " << ex.what());
+		usable=false;
+	}
+}
+
+APIClient::Connection::~Connection(){
+	for(CURL* handle : idle)
+		curl_easy_cleanup(handle);
+}
+
+std::string APIClient::Connection::credentialPath(const YAML::Node& entry,
+                                                  const std::string& name,
+                                                  const std::string& configPath){
+	if(entry[name+"-data"]){
+		//keep the decoded data next to the kubeconfig, which already holds
+		//the same secrets
+		FileHandle file=makeTemporaryFile(configPath+"_"+name+"_");
+		std::ofstream out(file.path());
+		out << decodeBase64(entry[name+"-data"].as<std::string>());
+		if(!out)
+			throw std::runtime_error("Unable to write "+name+" to "+file.path());
+		std::string path=file.path();
+		credentialFiles.push_back(std::move(file));
+		return path;
+	}
+	if(entry[name]){
+		std::string path=entry[name].as<std::string>();
+		if(!path.empty() && path.front()!='/'){
+			auto slash=configPath.rfind('/');
+			if(slash!=std::string::npos)
+				path=configPath.substr(0,slash+1)+path;
+		}
+		return path;
+	}
+	return "";
+}
+
+CURL* APIClient::Connection::acquire(){
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+		if(!idle.empty()){
+			CURL* handle=idle.back();
+			idle.pop_back();
+			return handle;
+		}
+	}
+	CURL* handle=curl_easy_init();
+	if(!handle)
+		throw std::runtime_error("Failed to initialize curl handle");
+	curl_easy_setopt(handle,CURLOPT_NOSIGNAL,1L);
+	curl_easy_setopt(handle,CURLOPT_TIMEOUT,requestTimeoutSeconds);
+	curl_easy_setopt(handle,CURLOPT_TCP_KEEPALIVE,1L);
+	curl_easy_setopt(handle,CURLOPT_ACCEPT_ENCODING,"");
+	curl_easy_setopt(handle,CURLOPT_WRITEFUNCTION,collectOutput);
+	curl_easy_setopt(handle,CURLOPT_SSL_VERIFYPEER,verifyPeer?1L:0L);
+	curl_easy_setopt(handle,CURLOPT_SSL_VERIFYHOST,verifyPeer?2L:0L);
+	if(!caPath.empty())
+		curl_easy_setopt(handle,CURLOPT_CAINFO,caPath.c_str());
+	if(!certPath.empty())
+		curl_easy_setopt(handle,CURLOPT_SSLCERT,certPath.c_str());
+	if(!keyPath.empty())
+		curl_easy_setopt(handle,CURLOPT_SSLKEY,keyPath.c_str());
+	if(!token.empty()){
+		curl_easy_setopt(handle,CURLOPT_HTTPAUTH,CURLAUTH_BEARER);
+		curl_easy_setopt(handle,CURLOPT_XOAUTH2_BEARER,token.c_str());
+	}
+	else if(!username.empty()){
+		curl_easy_setopt(handle,CURLOPT_HTTPAUTH,CURLAUTH_BASIC);
+		curl_easy_setopt(handle,CURLOPT_USERNAME,username.c_str());
+		curl_easy_setopt(handle,CURLOPT_PASSWORD,password.c_str());
+	}
+	return handle;
+}
+
+void APIClient::Connection::release(CURL* handle){
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+		if(idle.size()<maxIdleHandles){
+			idle.push_back(handle);
+			return;
+		}
+	}
+	curl_easy_cleanup(handle);
+}
+
+///An API request equivalent to a kubectl operation
+struct APIClient::Request{
+	std::string apiPrefix;
+	std::string nspace;
+	std::string resource;
+	std::string name;
+	std::string subresource;
+	///Query parameters, not yet escaped
+	std::vector<std::pair<std::string,std::string>> query;
+	///Whether the result is a list which must be reshaped as kubectl would
+	bool isList;
+};
+
+APIClient::APIClient():connectionLimit(256){
+	curl_global_init(CURL_GLOBAL_DEFAULT);
+}
+
+APIClient::~APIClient(){
+	connections.clear();
+	curl_global_cleanup();
+}
+
+bool APIClient::translateArguments(const std::vector<std::string>& arguments,
+                                   Request& request){
+	static const std::map<std::string,std::string> flagNames={
+		{"-n","namespace"},{"--namespace","namespace"},
+		{"-l","selector"},{"--selector","selector"},
+		{"-o","output"},{"--output","output"},
+		{"-c","container"},{"--container","container"},
+		{"--tail","tail"},
+		{"-p","previous"},{"--previous","previous"},
+	};
+	//only core kinds whose resources live in a fixed API group are known here,
+	//anything else requires discovery and is left to kubectl
+	static const std::map<std::string,std::pair<std::string,std::string>> kinds={
+		{"pod",{"/api/v1","pods"}},{"pods",{"/api/v1","pods"}},{"po",{"/api/v1","pods"}},
+		{"service",{"/api/v1","services"}},{"services",{"/api/v1","services"}},{"svc",{"/api/v1","services"}},
+		{"secret",{"/api/v1","secrets"}},{"secrets",{"/api/v1","secrets"}},
+		{"configmap",{"/api/v1","configmaps"}},{"configmaps",{"/api/v1","configmaps"}},{"cm",{"/api/v1","configmaps"}},
+		{"deployment",{"/apis/apps/v1","deployments"}},{"deployments",{"/apis/apps/v1","deployments"}},{"deploy",{"/apis/apps/v1","deployments"}},
+		{"replicaset",{"/apis/apps/v1","replicasets"}},{"replicasets",{"/apis/apps/v1","replicasets"}},{"rs",{"/apis/apps/v1","replicasets"}},
+	};
+
+	std::vector<std::string> positional;
+	std::map<std::string,std::string> flags;
+	for(std::size_t i=0; i<arguments.size(); i++){
+		const std::string& arg=arguments[i];
+		if(arg.empty() || arg[0]!='-'){
+			positional.push_back(arg);
+			continue;
+		}
+		std::string flag=arg, value;
+		bool hasValue=false;
+		auto eq=arg.find('=');
+		if(eq!=std::string::npos){
+			flag=arg.substr(0,eq);
+			value=arg.substr(eq+1);
+			hasValue=true;
+		}
+		auto known=flagNames.find(flag);
+		if(known==flagNames.end())
+			return false;
+		if(known->second=="previous"){
+			if(hasValue && value!="true")
+				return false;
+			value="true";
+		}
+		else if(!hasValue){
+			if(++i>=arguments.size())
+				return false;
+			value=arguments[i];
+		}
+		flags[known->second]=value;
+	}
+	if(positional.empty() || !flags.count("namespace") || flags["namespace"].empty())
+		return false;
+	request.nspace=flags["namespace"];
+
+	if(positional[0]=="get"){
+		if(positional.size()<2 || positional.size()>3)
+			return false;
+		if(flags.count("container") || flags.count("tail") || flags.count("previous"))
+			return false;
+		if(!flags.count("output") || flags["output"]!="json")
+			return false;
+		auto kind=kinds.find(positional[1]);
+		if(kind==kinds.end())
+			return false;
+		request.apiPrefix=kind->second.first;
+		request.resource=kind->second.second;
+		if(positional.size()==3){
+			if(flags.count("selector"))
+				return false;
+			request.name=positional[2];
+			request.isList=false;
+		}
+		else{
+			if(flags.count("selector"))
+				request.query.emplace_back("labelSelector",flags["selector"]);
+			request.isList=true;
+		}
+		return true;
+	}
+	if(positional[0]=="logs"){
+		if(positional.size()!=2)
+			return false;
+		if(flags.count("selector") || flags.count("output"))
+			return false;
+		request.apiPrefix="/api/v1";
+		request.resource="pods";
+		request.name=positional[1];
+		request.subresource="log";
+		request.isList=false;
+		if(flags.count("container"))
+			request.query.emplace_back("container",flags["container"]);
+		if(flags.count("tail")){
+			const std::string& tail=flags["tail"];
+			if(tail!="-1"){
+				if(tail.empty() || tail.find_first_not_of("0123456789")!=std::string::npos)
+					return false;
+				request.query.emplace_back("tailLines",tail);
+			}
+		}
+		if(flags.count("previous"))
+			request.query.emplace_back("previous","true");
+		return true;
+	}
+	return false;
+}
+
+std::shared_ptr<APIClient::Connection> APIClient::getConnection(const std::string& configPath){
+	std::lock_guard<std::mutex> lock(connectionsMutex);
+	auto it=connections.find(configPath);
+	if(it!=connections.end())
+		return it->second;
+	//cluster configurations are written to new files whenever they change,
+	//so state for files which have since been removed can never be used again
+	if(connections.size()>=connectionLimit){
+		for(auto pos=connections.begin(); pos!=connections.end();){
+			if(!fileExists(pos->first))
+				pos=connections.erase(pos);
+			else
+				++pos;
+		}
+	}
+	auto connection=std::make_shared<Connection>(configPath);
+	connections.emplace(configPath,connection);
+	return connection;
+}
+
+bool APIClient::tryRequest(const std::string& configPath,
+                           const std::vector<std::string>& arguments,
+                           commandResult& result){
+	Request request;
+	if(!translateArguments(arguments,request))
+		return false;
+	auto connection=getConnection(configPath);
+	if(!connection->usable)
+		return false;
+
+	CURL* handle=connection->acquire();
+	std::string url=connection->server+request.apiPrefix
+	    +"/namespaces/"+escape(handle,request.nspace)+"/"+request.resource;
+	if(!request.name.empty())
+		url+="/"+escape(handle,request.name);
+	if(!request.subresource.empty())
+		url+="/"+request.subresource;
+	char separator='?';
+	for(const auto& param : request.query){
+		url+=separator+param.first+"="+escape(handle,param.second);
+		separator='&';
+	}
+
+	std::string body;
+	char errBuf[CURL_ERROR_SIZE];
+	errBuf[0]=0;
+	curl_easy_setopt(handle,CURLOPT_URL,url.c_str());
+	curl_easy_setopt(handle,CURLOPT_WRITEDATA,&body);
+	curl_easy_setopt(handle,CURLOPT_ERRORBUFFER,errBuf);
+	CURLcode err=curl_easy_perform(handle);
+	long code=0;
+	if(err==CURLE_OK)
+		curl_easy_getinfo(handle,CURLINFO_RESPONSE_CODE,&code);
+	curl_easy_setopt(handle,CURLOPT_ERRORBUFFER,nullptr);
+	curl_easy_setopt(handle,CURLOPT_WRITEDATA,nullptr);
+
+	if(err!=CURLE_OK){
+		//a handle in an unknown state should not be reused
+		curl_easy_cleanup(handle);
+		std::string message=errBuf[0]?errBuf:curl_easy_strerror(err);
+		result=commandResult{"","Unable to connect to the server: "+message+"\n",1};
+		return true;
+	}
+	connection->release(handle);
+
+	if(code>=200 && code<300)
+		result=commandResult{request.isList?convertList(body):body,"",0};
+	else
+		result=commandResult{"",describeFailure(code,body),1};
+	return true;
+}
+
+}
@@ -6,6 +6,7 @@
 #include "Logging.h"
 #include "Utilities.h"
 #include "FileHandle.h"
+#include "KubeAPIClient.h"
 
 ///Remove ANSI escape sequences from a string. 
 ///This is hard to do generally, for now only CSI SGR sequences are identified
@@ -27,6 +28,13 @@ namespace kubernetes{
 	
 commandResult kubectl(const std::string& configPath,
                       const std::vector<std::string>& arguments){
+	//simple queries are sent directly to the API server over a connection 
+	//which is kept open, other operations still require running kubectl
+	static APIClient apiClient;
+	commandResult direct;
+	if(apiClient.tryRequest(configPath,arguments,direct))
+		return direct;
+	
 	std::vector<std::string> fullArgs;
 	fullArgs.push_back("--request-timeout=10s");
 	fullArgs.push_back("--kubeconfig="+configPath);
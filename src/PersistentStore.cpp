@@ -1,15 +1,21 @@
 #include <PersistentStore.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
 #include <thread>
+#include <unordered_map>
 
 #include <unistd.h>
 
 #include <aws/core/utils/Outcome.h>
+#include <aws/dynamodb/model/BatchGetItemRequest.h>
 #include <aws/dynamodb/model/DeleteItemRequest.h>
 #include <aws/dynamodb/model/GetItemRequest.h>
 #include <aws/dynamodb/model/PutItemRequest.h>
@@ -21,7 +27,9 @@
 #include <aws/dynamodb/model/CreateTableRequest.h>
 #include <aws/dynamodb/model/DescribeTableRequest.h>
 #include <aws/dynamodb/model/UpdateTableRequest.h>
+#include <aws/dynamodb/model/UpdateTimeToLiveRequest.h>
 
+#include <Archive.h>
 #include <Logging.h>
 #include <Utilities.h>
 extern "C"{
@@ -151,44 +159,193 @@ void waitUntilIndexDeleted(Aws::DynamoDB::DynamoDBClient& dbClient,
 				  "Dynamo error: " << outcome.GetError().GetMessage());
 }
 	
+using DatabaseItem=Aws::Map<Aws::String,Aws::DynamoDB::Model::AttributeValue>;
+
+User userFromItem(const DatabaseItem& item){
+	User user;
+	user.valid=true;
+	user.id=findOrThrow(item,"ID","user record missing ID attribute").GetS();
+	user.name=findOrThrow(item,"name","user record missing name attribute").GetS();
+	user.email=findOrThrow(item,"email","user record missing email attribute").GetS();
+	user.token=findOrThrow(item,"token","user record missing token attribute").GetS();
+	user.globusID=findOrThrow(item,"globusID","user record missing globusID attribute").GetS();
+	user.admin=findOrThrow(item,"admin","user record missing admin attribute").GetBool();
+	return user;
+}
+
+VO voFromItem(const DatabaseItem& item){
+	VO vo;
+	vo.valid=true;
+	vo.id=findOrThrow(item,"ID","VO record missing ID attribute").GetS();
+	vo.name=findOrThrow(item,"name","VO record missing name attribute").GetS();
+	return vo;
+}
+
+Cluster clusterFromItem(const DatabaseItem& item){
+	Cluster cluster;
+	cluster.valid=true;
+	cluster.id=findOrThrow(item,"ID","Cluster record missing ID attribute").GetS();
+	cluster.name=findOrThrow(item,"name","Cluster record missing name attribute").GetS();
+	cluster.owningVO=findOrThrow(item,"owningVO","Cluster record missing owningVO attribute").GetS();
+	cluster.config=findOrThrow(item,"config","Cluster record missing config attribute").GetS();
+	cluster.systemNamespace=findOrThrow(item,"systemNamespace","Cluster record missing systemNamespace attribute").GetS();
+	return cluster;
+}
+
+ApplicationInstance instanceFromItem(const DatabaseItem& item){
+	ApplicationInstance inst;
+	inst.valid=true;
+	inst.id=findOrThrow(item,"ID","Instance record missing ID attribute").GetS();
+	inst.name=findOrThrow(item,"name","Instance record missing name attribute").GetS();
+	inst.application=findOrThrow(item,"application","Instance record missing application attribute").GetS();
+	inst.owningVO=findOrThrow(item,"owningVO","Instance record missing owningVO attribute").GetS();
+	inst.cluster=findOrThrow(item,"cluster","Instance record missing cluster attribute").GetS();
+	inst.ctime=findOrThrow(item,"ctime","Instance record missing ctime attribute").GetS();
+	return inst;
+}
+
+///Encode the key of the last item examined by a scan as an opaque string which
+///can be safely passed as a URL parameter
+std::string encodeCursor(const DatabaseItem& key){
+	rapidjson::Document json(rapidjson::kObjectType);
+	auto& alloc=json.GetAllocator();
+	for(const auto& attribute : key){
+		json.AddMember(rapidjson::Value(attribute.first.c_str(),alloc),
+		               rapidjson::Value(attribute.second.GetS().c_str(),alloc),alloc);
+	}
+	return encodeBase64(to_string(json),Base64Alphabet::URLSafe);
+}
+
+///Decode a cursor produced by encodeCursor
+///\param cursor the encoded key
+///\param key the key into which to decode
+///\return false if \p cursor is not a valid encoding of a primary key
+bool decodeCursor(const std::string& cursor, DatabaseItem& key){
+	std::string raw;
+	try{
+		raw=decodeBase64(cursor,Base64Alphabet::URLSafe);
+	}catch(std::runtime_error& err){
+		return false;
+	}
+	rapidjson::Document json;
+	json.Parse(raw.c_str());
+	if(json.HasParseError() || !json.IsObject() || json.MemberCount()!=2)
+		return false;
+	for(const auto& attribute : {"ID","sortKey"}){
+		if(!json.HasMember(attribute) || !json[attribute].IsString())
+			return false;
+		key[attribute]=Aws::DynamoDB::Model::AttributeValue(json[attribute].GetString());
+	}
+	return true;
+}
+
+///Format a time as the leading part of a change journal key, such that keys 
+///sort in chronological order
+std::string changeKey(std::chrono::system_clock::time_point time){
+	auto millis=std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+	std::string key=std::to_string(millis);
+	if(key.size()<15)
+		key.insert(0,15-key.size(),'0');
+	return key;
+}
+
+///Journal entries are keyed by their writers' clocks, so each synchronization 
+///looks this far back before the last one, to tolerate clock skew and writes 
+///which took a while to complete
+const std::chrono::seconds changeSkewAllowance(60);
+///Journal entries are discarded by the database after this long
+const std::chrono::hours changeRetention(24);
+
+///How long records are cached when other servers announce their changes
+const std::chrono::hours sharedCacheValidity(1);
+///How long the invalidation of a record is remembered. This must exceed the 
+///time a database request can take, so that any load which was in progress 
+///when the invalidation arrived can tell that what it read may be stale.
+const std::chrono::minutes invalidationMemory(2);
+	
 } //anonymous namespace
 
 const std::string PersistentStore::wildcard="*";
 const std::string PersistentStore::wildcardName="<all>";
+const unsigned int PersistentStore::maxScanSegments;
 
 PersistentStore::PersistentStore(Aws::Auth::AWSCredentials credentials, 
                                  Aws::Client::ClientConfiguration clientConfig,
                                  std::string bootstrapUserFile,
                                  std::string encryptionKeyFile,
                                  std::string appLoggingServerName,
-                                 unsigned int appLoggingServerPort):
+                                 unsigned int appLoggingServerPort,
+                                 unsigned int scanSegments,
+                                 unsigned int mirrorSyncInterval,
+                                 std::unique_ptr<InvalidationBus> invalidationBus):
 	dbClient(std::move(credentials),std::move(clientConfig)),
 	userTableName("SLATE_users"),
 	voTableName("SLATE_VOs"),
 	clusterTableName("SLATE_clusters"),
 	instanceTableName("SLATE_instances"),
 	secretTableName("SLATE_secrets"),
+	changeTableName("SLATE_changes"),
 	clusterConfigDir(createConfigTempDir()),
-	userCacheValidity(std::chrono::minutes(5)),
+	userCacheValidity(invalidationBus ? sharedCacheValidity : std::chrono::minutes(5)),
 	userCacheExpirationTime(std::chrono::steady_clock::now()),
-	voCacheValidity(std::chrono::minutes(30)),
+	voCacheValidity(invalidationBus ? sharedCacheValidity : std::chrono::minutes(30)),
 	voCacheExpirationTime(std::chrono::steady_clock::now()),
-	clusterCacheValidity(std::chrono::minutes(30)),
+	clusterCacheValidity(invalidationBus ? sharedCacheValidity : std::chrono::minutes(30)),
 	clusterCacheExpirationTime(std::chrono::steady_clock::now()),
-	instanceCacheValidity(std::chrono::minutes(5)),
+	instanceCacheValidity(invalidationBus ? sharedCacheValidity : std::chrono::minutes(5)),
 	instanceCacheExpirationTime(std::chrono::steady_clock::now()),
-	secretCacheValidity(std::chrono::minutes(5)),
+	secretCacheValidity(invalidationBus ? sharedCacheValidity : std::chrono::minutes(5)),
+	negativeCacheValidity(std::chrono::minutes(1)),
+	negativeCacheLimit(1UL<<16),
+	refreshAheadFraction(4),
+	scanSegments(std::min(std::max(scanSegments,1u),maxScanSegments)),
+	mirrorSyncInterval(mirrorSyncInterval),
+	changeOrigin(std::to_string(std::random_device()())),
+	changeSequence(0),
+	stopMirrorSync(false),
+	invalidationBus(std::move(invalidationBus)),
+	lastInvalidation(std::chrono::steady_clock::time_point()),
 	secretKey(1024),
 	appLoggingServerName(appLoggingServerName),
 	appLoggingServerPort(appLoggingServerPort),
-	cacheHits(0),databaseQueries(0),databaseScans(0)
+	cacheHits(0),negativeCacheHits(0),databaseQueries(0),databaseScans(0),
+	cacheRefreshes(0),cacheRefreshesDropped(0),
+	refresher(2,1024)
 {
 	loadEncyptionKey(encryptionKeyFile);
 	log_info("Starting database client");
 	InitializeTables(bootstrapUserFile);
+	if(this->invalidationBus)
+		this->invalidationBus->subscribe([this](const Invalidation& invalidation){
+			applyInvalidation(invalidation);
+		});
+	if(this->mirrorSyncInterval.count()){
+		//anything changed from here on will be picked up by the first 
+		//synchronization, even if the initial scans do not see it
+		changeSyncStart=std::chrono::system_clock::now();
+		log_info("Loading table mirrors");
+		listUsers();
+		listVOs();
+		listClusters();
+		listApplicationInstances();
+		mirrorSyncThread=std::thread(&PersistentStore::runMirrorSync,this);
+	}
 	log_info("Database client ready");
 }
 
+PersistentStore::~PersistentStore(){
+	//stop delivery of invalidations while the caches still exist
+	invalidationBus.reset();
+	if(mirrorSyncThread.joinable()){
+		{
+			std::lock_guard<std::mutex> lock(mirrorSyncMutex);
+			stopMirrorSync=true;
+		}
+		mirrorSyncCond.notify_all();
+		mirrorSyncThread.join();
+	}
+}
+
 void PersistentStore::InitializeUserTable(std::string bootstrapUserFile){
 	using namespace Aws::DynamoDB::Model;
 	using AttDef=Aws::DynamoDB::Model::AttributeDefinition;
@@ -752,12 +909,63 @@ void PersistentStore::InitializeSecretTable(){
 	}
 }
 
+void PersistentStore::InitializeChangeTable(){
+	using namespace Aws::DynamoDB::Model;
+	using AttDef=Aws::DynamoDB::Model::AttributeDefinition;
+	using SAT=Aws::DynamoDB::Model::ScalarAttributeType;
+	
+	//check status of the table
+	auto changeTableOut=dbClient.DescribeTable(DescribeTableRequest()
+	                                           .WithTableName(changeTableName));
+	if(!changeTableOut.IsSuccess() &&
+	   changeTableOut.GetError().GetErrorType()!=Aws::DynamoDB::DynamoDBErrors::RESOURCE_NOT_FOUND){
+		log_fatal("Unable to connect to DynamoDB: "
+		          << changeTableOut.GetError().GetMessage());
+	}
+	if(changeTableOut.IsSuccess())
+		return;
+	
+	log_info("Changes table does not exist; creating");
+	//Entries are partitioned by the table whose record changed, and sorted 
+	//by the time of the change
+	auto request=CreateTableRequest();
+	request.SetTableName(changeTableName);
+	request.SetAttributeDefinitions({
+		AttDef().WithAttributeName("ID").WithAttributeType(SAT::S),
+		AttDef().WithAttributeName("sortKey").WithAttributeType(SAT::S)
+	});
+	request.SetKeySchema({
+		KeySchemaElement().WithAttributeName("ID").WithKeyType(KeyType::HASH),
+		KeySchemaElement().WithAttributeName("sortKey").WithKeyType(KeyType::RANGE)
+	});
+	request.SetProvisionedThroughput(ProvisionedThroughput()
+	                                 .WithReadCapacityUnits(1)
+	                                 .WithWriteCapacityUnits(1));
+	
+	auto createOut=dbClient.CreateTable(request);
+	if(!createOut.IsSuccess())
+		log_fatal("Failed to create changes table: " + createOut.GetError().GetMessage());
+	
+	waitTableReadiness(dbClient,changeTableName);
+	
+	auto ttlOut=dbClient.UpdateTimeToLive(UpdateTimeToLiveRequest()
+	                                      .WithTableName(changeTableName)
+	                                      .WithTimeToLiveSpecification(TimeToLiveSpecification()
+	                                                                   .WithAttributeName("expires")
+	                                                                   .WithEnabled(true)));
+	if(!ttlOut.IsSuccess())
+		log_error("Failed to enable expiration of old changes: " << ttlOut.GetError().GetMessage());
+	log_info("Created changes table");
+}
+
 void PersistentStore::InitializeTables(std::string bootstrapUserFile){
 	InitializeUserTable(bootstrapUserFile);
 	InitializeVOTable();
 	InitializeClusterTable();
 	InitializeInstanceTable();
 	InitializeSecretTable();
+	if(mirrorSyncInterval.count())
+		InitializeChangeTable();
 }
 
 void PersistentStore::loadEncyptionKey(const std::string& fileName){
@@ -770,6 +978,506 @@ void PersistentStore::loadEncyptionKey(const std::string& fileName){
 	secretKey.dataSize=infile.gcount();
 }
 
+std::vector<Aws::Map<Aws::String,Aws::DynamoDB::Model::AttributeValue>> 
+PersistentStore::batchGetItems(const std::string& tableName, const std::vector<std::string>& ids){
+	using namespace Aws::DynamoDB::Model;
+	const std::size_t maxBatchSize=100; //the limit imposed by DynamoDB
+	const unsigned int maxAttempts=5;
+	//DynamoDB rejects a whole batch if any key appears in it more than once
+	const std::set<std::string> uniqueIDs(ids.begin(),ids.end());
+	std::vector<DatabaseItem> items;
+	for(auto next=uniqueIDs.begin(); next!=uniqueIDs.end(); ){
+		KeysAndAttributes keys;
+		for(std::size_t i=0; i<maxBatchSize && next!=uniqueIDs.end(); i++, next++)
+			keys.AddKeys({{"ID",AttributeValue(*next)},{"sortKey",AttributeValue(*next)}});
+		//the database may process only some of the keys, in which case we 
+		//must ask again for the rest, backing off to give it time to recover
+		for(unsigned int attempt=0; ; attempt++){
+			if(attempt)
+				std::this_thread::sleep_for(std::chrono::milliseconds(25<<attempt));
+			databaseQueries++;
+			auto outcome=dbClient.BatchGetItem(BatchGetItemRequest().AddRequestItems(tableName,keys));
+			if(!outcome.IsSuccess()){
+				auto err=outcome.GetError();
+				log_error("Failed to fetch records from " << tableName << ": " << err.GetMessage());
+				break;
+			}
+			const auto& result=outcome.GetResult();
+			auto found=result.GetResponses().find(tableName);
+			if(found!=result.GetResponses().end())
+				items.insert(items.end(),found->second.begin(),found->second.end());
+			auto unprocessed=result.GetUnprocessedKeys().find(tableName);
+			if(unprocessed==result.GetUnprocessedKeys().end() || unprocessed->second.GetKeys().empty())
+				break;
+			if(attempt+1==maxAttempts){
+				log_error("Giving up on fetching " << unprocessed->second.GetKeys().size() 
+				          << " records from " << tableName);
+				break;
+			}
+			keys=unprocessed->second;
+		}
+	}
+	return items;
+}
+
+Aws::DynamoDB::Model::QueryOutcome PersistentStore::queryAllPages(Aws::DynamoDB::Model::QueryRequest request){
+	using namespace Aws::DynamoDB::Model;
+	QueryOutcome outcome=dbClient.Query(request);
+	if(!outcome.IsSuccess())
+		return outcome;
+	QueryResult combined=outcome.GetResultWithOwnership();
+	while(!combined.GetLastEvaluatedKey().empty()){
+		databaseQueries++;
+		request.SetExclusiveStartKey(combined.GetLastEvaluatedKey());
+		QueryOutcome next=dbClient.Query(request);
+		if(!next.IsSuccess())
+			return next;
+		const QueryResult& page=next.GetResult();
+		for(const auto& item : page.GetItems())
+			combined.AddItems(item);
+		combined.SetCount(combined.GetCount()+page.GetCount());
+		combined.SetScannedCount(combined.GetScannedCount()+page.GetScannedCount());
+		combined.SetLastEvaluatedKey(page.GetLastEvaluatedKey());
+	}
+	return QueryOutcome(std::move(combined));
+}
+
+bool PersistentStore::parallelScan(Aws::DynamoDB::Model::ScanRequest request, 
+                                   const std::function<void(std::size_t,const DatabaseItem&)>& handleItem){
+	std::atomic<bool> complete(true);
+	request.SetTotalSegments(scanSegments);
+	parallelFor(scanSegments,scanSegments,[&](std::size_t segment){
+		Aws::DynamoDB::Model::ScanRequest segmentRequest=request;
+		segmentRequest.SetSegment(segment);
+		bool keepGoing=false;
+		do{
+			auto outcome=dbClient.Scan(segmentRequest);
+			if(!outcome.IsSuccess()){
+				auto err=outcome.GetError();
+				log_error("Failed to scan segment " << segment << " of " 
+				          << request.GetTableName() << ": " << err.GetMessage());
+				complete=false;
+				return;
+			}
+			const auto& result=outcome.GetResult();
+			//set up fetching the next page if necessary
+			if(!result.GetLastEvaluatedKey().empty()){
+				keepGoing=true;
+				segmentRequest.SetExclusiveStartKey(result.GetLastEvaluatedKey());
+			}
+			else
+				keepGoing=false;
+			for(const auto& item : result.GetItems())
+				handleItem(segment,item);
+		}while(keepGoing);
+	});
+	return complete;
+}
+
+PageStatus PersistentStore::scanPage(Aws::DynamoDB::Model::ScanRequest request, std::size_t limit, 
+                               const std::string& cursor, std::vector<DatabaseItem>& items,
+                               std::string& nextCursor){
+	nextCursor.clear();
+	if(!cursor.empty()){
+		DatabaseItem startKey;
+		if(!decodeCursor(cursor,startKey))
+			return PageStatus::InvalidCursor;
+		request.SetExclusiveStartKey(startKey);
+	}
+	if(limit)
+		request.SetLimit(limit);
+	databaseScans++;
+	auto outcome=dbClient.Scan(request);
+	if(!outcome.IsSuccess()){
+		auto err=outcome.GetError();
+		log_error("Failed to fetch records from " << request.GetTableName() << ": " << err.GetMessage());
+		return PageStatus::DatabaseError;
+	}
+	const auto& result=outcome.GetResult();
+	items.insert(items.end(),result.GetItems().begin(),result.GetItems().end());
+	if(!result.GetLastEvaluatedKey().empty())
+		nextCursor=encodeCursor(result.GetLastEvaluatedKey());
+	return PageStatus::Fetched;
+}
+
+template <typename RecordType>
+RecordType PersistentStore::fetchOnce(single_flight<RecordType>& fetches, 
+                                      const char* kind, const std::string& key, 
+                                      RecordType (PersistentStore::*load)(const std::string&)){
+	const auto requested=std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point started;
+	RecordType record=fetches.run(kind+(":"+key),[this,load,&key]{ return (this->*load)(key); },&started);
+	//A fetch which was already in progress when this call was made may have 
+	//read the record before a change which completed before this call, which 
+	//this call must not miss. Rather than working out which records the 
+	//lookup could have matched, read again if anything has changed since.
+	if(started<requested && lastInvalidation.load()>=started)
+		return (this->*load)(key);
+	return record;
+}
+
+template <typename RecordType>
+void PersistentStore::refreshIfExpiring(const CacheRecord<RecordType>& record, 
+                                        std::chrono::seconds validity, 
+                                        single_flight<RecordType>& fetches,
+                                        const char* kind, const std::string& key, 
+                                        RecordType (PersistentStore::*load)(const std::string&)){
+	if(record.expirationTime-std::chrono::steady_clock::now() > validity/refreshAheadFraction)
+		return;
+	scheduleRefresh(kind+(":"+key),[this,&fetches,kind,key,load]{ fetchOnce(fetches,kind,key,load); });
+}
+
+void PersistentStore::scheduleRefresh(const std::string& refreshKey, std::function<void()> load){
+	if(!pendingRefreshes.insert(refreshKey,true))
+		return; //this record is already due to be reloaded
+	bool queued=refresher.submit([this,refreshKey,load]{
+		struct cleanup{
+			cuckoohash_map<std::string,bool>& pending;
+			const std::string& key;
+			~cleanup(){ pending.erase(key); }
+		} c{pendingRefreshes,refreshKey};
+		load();
+		cacheRefreshes++;
+	});
+	if(!queued){
+		pendingRefreshes.erase(refreshKey);
+		cacheRefreshesDropped++;
+	}
+}
+
+std::chrono::steady_clock::time_point PersistentStore::listingExpiration(std::chrono::seconds validity) const{
+	if(mirrorSyncInterval.count())
+		return std::chrono::steady_clock::time_point::max();
+	return std::chrono::steady_clock::now()+validity;
+}
+
+void PersistentStore::uncacheUser(const std::string& id){
+	//Somewhat hacky: we can't erase the secondary cache entries unless we know 
+	//the keys. However, we keep the caches synchronized, so if there is 
+	//such an entry to delete there is also an entry in the main cache, so 
+	//we can grab that to get the name without having to read from the 
+	//database.
+	CacheRecord<User> record;
+	bool cached=userCache.find(id,record);
+	if(cached){
+		//don't particularly care whether the record is expired; if it is 
+		//all that will happen is that we will delete the equally stale 
+		//record in the other cache
+		userByTokenCache.erase(record.record.token);
+		userByGlobusIDCache.erase(record.record.globusID);
+		tokenIndex.erase(TokenIndex::digest(record.record.token));
+	}
+	userCache.erase(id);
+}
+
+void PersistentStore::uncacheVO(const std::string& voID){
+	//See uncacheUser regarding the secondary caches
+	CacheRecord<VO> record;
+	bool cached=voCache.find(voID,record);
+	if(cached)
+		voByNameCache.erase(record.record.name);
+	voCache.erase(voID);
+	voClusterAccessCache.erase(voID);
+}
+
+void PersistentStore::uncacheCluster(const std::string& cID){
+	//See uncacheUser regarding the secondary caches
+	CacheRecord<Cluster> record;
+	bool cached=clusterCache.find(cID,record);
+	if(cached){
+		clusterByNameCache.erase(record.record.name);
+		clusterByVOCache.erase(record.record.owningVO,record);
+	}
+	clusterCache.erase(cID);
+	clusterConfigs.erase(cID);
+}
+
+void PersistentStore::uncacheApplicationInstance(const std::string& id){
+	//See uncacheUser regarding the secondary caches
+	CacheRecord<ApplicationInstance> record;
+	bool cached=instanceCache.find(id,record);
+	if(cached){
+		instanceByVOCache.erase(record.record.owningVO,record);
+		instanceByNameCache.erase(record.record.name,record);
+		instanceByClusterCache.erase(record.record.cluster,record);
+		instanceByVOAndClusterCache.erase(record.record.owningVO+":"+record.record.cluster,record);
+	}
+	instanceCache.erase(id);
+	instanceConfigCache.erase(id);
+}
+
+void PersistentStore::uncacheSecret(const std::string& id){
+	//See uncacheUser regarding the secondary caches
+	CacheRecord<Secret> record;
+	bool cached=secretCache.find(id,record);
+	if(cached){
+		secretByVOCache.erase(record.record.vo,record);
+		secretByVOAndClusterCache.erase(record.record.vo+":"+record.record.cluster);
+	}
+	secretCache.erase(id);
+}
+
+void PersistentStore::publishInvalidation(Invalidation invalidation){
+	if(invalidationBus)
+		invalidationBus->publish(invalidation);
+}
+
+void PersistentStore::rememberInvalidation(const std::string& kind, const std::string& id){
+	const auto now=std::chrono::steady_clock::now();
+	invalidatedRecords.insert_or_assign(kind+":"+id,now);
+	//invalidations are remembered by many threads, and one which read the 
+	//clock earlier must not move this backwards
+	auto last=lastInvalidation.load();
+	while(last<now && !lastInvalidation.compare_exchange_strong(last,now));
+	std::unique_lock<std::mutex> lock(invalidationPruneMutex,std::try_to_lock);
+	if(!lock.owns_lock() || now-lastInvalidationPrune<invalidationMemory)
+		return;
+	auto table=invalidatedRecords.lock_table();
+	for(auto itr=table.begin(); itr!=table.end();){
+		if(now-itr->second>=invalidationMemory)
+			itr=table.erase(itr);
+		else
+			++itr;
+	}
+	lastInvalidationPrune=now;
+}
+
+bool PersistentStore::invalidatedSince(const std::string& kind, const std::string& id, 
+                                       std::chrono::steady_clock::time_point start) const{
+	if(lastInvalidation.load()<start)
+		return false;
+	std::chrono::steady_clock::time_point invalidated;
+	return invalidatedRecords.find(kind+":"+id,invalidated) && invalidated>=start;
+}
+
+void PersistentStore::applyInvalidation(const Invalidation& invalidation){
+	const std::string& id=invalidation.id;
+	const std::vector<std::string>& related=invalidation.related;
+	//Do this first, so that a load which reads the old version of the record 
+	//after its cache entries are erased does not put them back
+	rememberInvalidation(invalidation.kind,id);
+	//the table whose full listing may have changed, if any
+	std::string listedTable;
+	if(invalidation.kind=="user"){
+		uncacheUser(id);
+		voByUserCache.erase(id);
+		listedTable=userTableName;
+	}
+	else if(invalidation.kind=="vo"){
+		uncacheVO(id);
+		userByVOCache.erase(id);
+		listedTable=voTableName;
+	}
+	else if(invalidation.kind=="cluster"){
+		uncacheCluster(id);
+		//related: the owning VO
+		if(related.size()>=1)
+			clusterByVOCache.erase(related[0]);
+		listedTable=clusterTableName;
+	}
+	else if(invalidation.kind=="instance"){
+		uncacheApplicationInstance(id);
+		//related: the owning VO, the cluster, and the instance name
+		if(related.size()>=3){
+			instanceByVOCache.erase(related[0]);
+			instanceByClusterCache.erase(related[1]);
+			instanceByVOAndClusterCache.erase(related[0]+":"+related[1]);
+			instanceByNameCache.erase(related[2]);
+		}
+		listedTable=instanceTableName;
+	}
+	else if(invalidation.kind=="secret"){
+		uncacheSecret(id);
+		//related: the owning VO and the cluster
+		if(related.size()>=2){
+			secretByVOCache.erase(related[0]);
+			secretByVOAndClusterCache.erase(related[0]+":"+related[1]);
+		}
+	}
+	else if(invalidation.kind=="membership" && related.size()>=1){
+		//id: the user, related: the VO
+		voByUserCache.erase(id);
+		userByVOCache.erase(related[0]);
+		userNotInVOCache.erase(id+":"+related[0]);
+	}
+	else if(invalidation.kind=="access" && related.size()>=1){
+		//id: the cluster, related: the VO, or the wildcard
+		clusterVOAccessCache.erase(id);
+		voClusterAccessCache.erase(related[0]);
+		if(related[0]==wildcard)
+			voNotOnClusterCache.clear();
+		else
+			voNotOnClusterCache.erase(id+":"+related[0]);
+	}
+	else if(invalidation.kind=="applications" && related.size()>=1){
+		//id: the cluster, related: the VO
+		clusterVOApplicationCache.erase(id+":"+related[0]+":Applications");
+	}
+	else{
+		log_error("Ignoring unrecognized cache invalidation of " << invalidation.kind << " " << id);
+		return;
+	}
+	if(listedTable.empty())
+		return;
+	//A mirrored table must stay complete, so reload the record; otherwise the 
+	//next listing must rescan the table, since the record may be new
+	if(mirrorSyncInterval.count())
+		reloadChangedRecord(listedTable,id);
+	else if(listedTable==userTableName)
+		userCacheExpirationTime=std::chrono::steady_clock::now();
+	else if(listedTable==voTableName)
+		voCacheExpirationTime=std::chrono::steady_clock::now();
+	else if(listedTable==clusterTableName)
+		clusterCacheExpirationTime=std::chrono::steady_clock::now();
+	else if(listedTable==instanceTableName)
+		instanceCacheExpirationTime=std::chrono::steady_clock::now();
+}
+
+void PersistentStore::recordChange(const std::string& tableName, const std::string& id){
+	if(!mirrorSyncInterval.count())
+		return;
+	using Aws::DynamoDB::Model::AttributeValue;
+	auto now=std::chrono::system_clock::now();
+	auto expires=std::chrono::duration_cast<std::chrono::seconds>((now+changeRetention).time_since_epoch()).count();
+	auto outcome=dbClient.PutItem(Aws::DynamoDB::Model::PutItemRequest()
+	                              .WithTableName(changeTableName)
+	                              .WithItem({{"ID",AttributeValue(tableName)},
+	                                         {"sortKey",AttributeValue(changeKey(now)+":"+changeOrigin+":"+std::to_string(changeSequence++))},
+	                                         {"record",AttributeValue(id)},
+	                                         {"origin",AttributeValue(changeOrigin)},
+	                                         {"expires",AttributeValue().SetN(std::to_string(expires))}
+	                              }));
+	//The change itself has already been made, so this is not a failure of 
+	//the operation, but other servers will not see it until they restart
+	if(!outcome.IsSuccess())
+		log_error("Failed to journal change to " << id << ": " << outcome.GetError().GetMessage());
+}
+
+void PersistentStore::runMirrorSync(){
+	std::unique_lock<std::mutex> lock(mirrorSyncMutex);
+	while(!mirrorSyncCond.wait_for(lock,mirrorSyncInterval,[this]{ return stopMirrorSync; })){
+		lock.unlock();
+		try{
+			syncMirror();
+		}catch(std::exception& ex){
+			log_error("Failed to synchronize table mirrors: " << ex.what());
+		}
+		lock.lock();
+	}
+}
+
+void PersistentStore::syncMirror(){
+	using Aws::DynamoDB::Model::AttributeValue;
+	const auto syncStart=std::chrono::system_clock::now();
+	const std::string since=changeKey(changeSyncStart-changeSkewAllowance);
+	bool complete=true;
+	for(const std::string& tableName : {userTableName,voTableName,clusterTableName,instanceTableName}){
+		databaseQueries++;
+		auto outcome=queryAllPages(Aws::DynamoDB::Model::QueryRequest()
+		                           .WithTableName(changeTableName)
+		                           .WithConsistentRead(true)
+		                           .WithKeyConditionExpression("#table = :table AND #key > :since")
+		                           .WithExpressionAttributeNames({{"#table","ID"},{"#key","sortKey"}})
+		                           .WithExpressionAttributeValues({{":table",AttributeValue(tableName)},
+		                                                           {":since",AttributeValue(since)}}));
+		if(!outcome.IsSuccess()){
+			log_error("Failed to fetch changes to " << tableName << ": " << outcome.GetError().GetMessage());
+			complete=false;
+			continue;
+		}
+		//collect the keys of the new changes to each record, so that a record 
+		//changed several times is reloaded only once
+		std::map<std::string,std::vector<std::string>> changed;
+		for(const auto& item : outcome.GetResult().GetItems()){
+			std::string key=findOrThrow(item,"sortKey","Change record missing sortKey attribute").GetS();
+			if(!appliedChanges.insert(key).second)
+				continue;
+			//this server's own changes are already in its caches
+			if(findOrThrow(item,"origin","Change record missing origin attribute").GetS()==changeOrigin)
+				continue;
+			changed[findOrThrow(item,"record","Change record missing record attribute").GetS()].push_back(key);
+		}
+		for(const auto& change : changed){
+			if(reloadChangedRecord(tableName,change.first))
+				continue;
+			//try again next time
+			for(const auto& key : change.second)
+				appliedChanges.erase(key);
+			complete=false;
+		}
+		if(!changed.empty())
+			log_info("Applied changes to " << changed.size() << " records from " << tableName);
+	}
+	if(!complete)
+		return;
+	changeSyncStart=syncStart;
+	//forget changes which are too old to be returned again
+	appliedChanges.erase(appliedChanges.begin(),
+	                     appliedChanges.lower_bound(changeKey(changeSyncStart-changeSkewAllowance)));
+}
+
+bool PersistentStore::reloadChangedRecord(const std::string& tableName, const std::string& id){
+	using Aws::DynamoDB::Model::AttributeValue;
+	databaseQueries++;
+	auto outcome=dbClient.GetItem(Aws::DynamoDB::Model::GetItemRequest()
+	                              .WithTableName(tableName)
+	                              .WithConsistentRead(true)
+	                              .WithKey({{"ID",AttributeValue(id)},
+	                                        {"sortKey",AttributeValue(id)}}));
+	if(!outcome.IsSuccess()){
+		log_error("Failed to fetch changed record " << id << ": " << outcome.GetError().GetMessage());
+		return false;
+	}
+	//discard the old version, whose secondary keys may differ from the new 
+	//one's, then cache the new version if there is one. Loads which began 
+	//before this one may have read an older version, so they must not cache
+	//what they read. 
+	const auto& item=outcome.GetResult().GetItem();
+	if(tableName==userTableName){
+		rememberInvalidation("user",id);
+		uncacheUser(id);
+		if(item.empty())
+			return true;
+		CacheRecord<User> record(userFromItem(item),userCacheValidity);
+		userCache.insert_or_assign(id,record);
+		userByTokenCache.insert_or_assign(record.record.token,record);
+		userByGlobusIDCache.insert_or_assign(record.record.globusID,record);
+	}
+	else if(tableName==voTableName){
+		rememberInvalidation("vo",id);
+		uncacheVO(id);
+		if(item.empty())
+			return true;
+		CacheRecord<VO> record(voFromItem(item),voCacheValidity);
+		voCache.insert_or_assign(id,record);
+		voByNameCache.insert_or_assign(record.record.name,record);
+	}
+	else if(tableName==clusterTableName){
+		rememberInvalidation("cluster",id);
+		uncacheCluster(id);
+		if(item.empty())
+			return true;
+		CacheRecord<Cluster> record(clusterFromItem(item),clusterCacheValidity);
+		clusterCache.insert_or_assign(id,record);
+		clusterByNameCache.insert_or_assign(record.record.name,record);
+		clusterByVOCache.insert_or_assign(record.record.owningVO,record);
+		writeClusterConfigToDisk(record.record);
+	}
+	else if(tableName==instanceTableName){
+		rememberInvalidation("instance",id);
+		uncacheApplicationInstance(id);
+		if(item.empty())
+			return true;
+		CacheRecord<ApplicationInstance> record(instanceFromItem(item),instanceCacheValidity);
+		instanceCache.insert_or_assign(id,record);
+		instanceByVOCache.insert_or_assign(record.record.owningVO,record);
+		instanceByNameCache.insert_or_assign(record.record.name,record);
+		instanceByClusterCache.insert_or_assign(record.record.cluster,record);
+		instanceByVOAndClusterCache.insert_or_assign(record.record.owningVO+":"+record.record.cluster,record);
+	}
+	return true;
+}
+
 bool PersistentStore::addUser(const User& user){
 	using Aws::DynamoDB::Model::AttributeValue;
 	auto request=Aws::DynamoDB::Model::PutItemRequest()
@@ -789,12 +1497,15 @@ bool PersistentStore::addUser(const User& user){
 		log_error("Failed to add user record: " << err.GetMessage());
 		return false;
 	}
+	rememberInvalidation("user",user.id);
 	
 	//update caches
 	CacheRecord<User> record(user,userCacheValidity);
 	userCache.insert_or_assign(user.id,record);
 	userByTokenCache.insert_or_assign(user.token,record);
 	userByGlobusIDCache.insert_or_assign(user.globusID,record);
+	recordChange(userTableName,user.id);
+	publishInvalidation({"user",user.id,{}});
 	
 	return true;
 }
@@ -807,10 +1518,16 @@ User PersistentStore::getUser(const std::string& id){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
 				cacheHits++;
+				refreshIfExpiring(record,userCacheValidity,userFetches,"user",id,&PersistentStore::loadUser);
 				return record;
 			}
 		}
 	}
+	return fetchOnce(userFetches,"user",id,&PersistentStore::loadUser);
+}
+
+User PersistentStore::loadUser(const std::string& id){
+	const auto loadStart=std::chrono::steady_clock::now();
 	//need to query the database
 	databaseQueries++;
 	log_info("Querying database for user " << id);
@@ -827,14 +1544,11 @@ User PersistentStore::getUser(const std::string& id){
 	const auto& item=outcome.GetResult().GetItem();
 	if(item.empty()) //no match found
 		return User{};
-	User user;
-	user.valid=true;
-	user.id=id;
-	user.name=findOrThrow(item,"name","user record missing name attribute").GetS();
-	user.email=findOrThrow(item,"email","user record missing email attribute").GetS();
-	user.token=findOrThrow(item,"token","user record missing token attribute").GetS();
-	user.globusID=findOrThrow(item,"globusID","user record missing globusID attribute").GetS();
-	user.admin=findOrThrow(item,"admin","user record missing admin attribute").GetBool();
+	User user=userFromItem(item);
+	
+	//don't cache what another server changed while it was being read
+	if(invalidatedSince("user",user.id,loadStart))
+		return user;
 	
 	//update caches
 	CacheRecord<User> record(user,userCacheValidity);
@@ -845,6 +1559,49 @@ User PersistentStore::getUser(const std::string& id){
 	return user;
 }
 
+std::vector<User> PersistentStore::getUsers(const std::vector<std::string>& ids){
+	std::vector<User> users(ids.size());
+	//first see which users we have cached
+	std::vector<std::string> missing;
+	for(std::size_t i=0; i<ids.size(); i++){
+		CacheRecord<User> record;
+		if(userCache.find(ids[i],record) && record){
+			cacheHits++;
+			refreshIfExpiring(record,userCacheValidity,userFetches,"user",ids[i],&PersistentStore::loadUser);
+			users[i]=record;
+		}
+		else
+			missing.push_back(ids[i]);
+	}
+	if(missing.empty())
+		return users;
+	//query the database for the rest
+	log_info("Querying database for " << missing.size() << " users");
+	const auto loadStart=std::chrono::steady_clock::now();
+	std::unordered_map<std::string,User> fetched;
+	for(const auto& item : batchGetItems(userTableName,missing)){
+		User user=userFromItem(item);
+		if(invalidatedSince("user",user.id,loadStart)){
+			fetched.emplace(user.id,std::move(user));
+			continue;
+		}
+		//update caches
+		CacheRecord<User> record(user,userCacheValidity);
+		userCache.insert_or_assign(user.id,record);
+		userByTokenCache.insert_or_assign(user.token,record);
+		userByGlobusIDCache.insert_or_assign(user.globusID,record);
+		fetched.emplace(user.id,std::move(user));
+	}
+	for(std::size_t i=0; i<ids.size(); i++){
+		if(users[i])
+			continue;
+		auto it=fetched.find(ids[i]);
+		if(it!=fetched.end())
+			users[i]=it->second;
+	}
+	return users;
+}
+
 User PersistentStore::findUserByToken(const std::string& token){
 	//first see if we have this cached
 	{
@@ -853,10 +1610,65 @@ User PersistentStore::findUserByToken(const std::string& token){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
 				cacheHits++;
+				refreshIfExpiring(record,userCacheValidity,userFetches,"userToken",token,&PersistentStore::loadUserByToken);
 				return record;
 			}
 		}
 	}
+	return fetchOnce(userFetches,"userToken",token,&PersistentStore::loadUserByToken);
+}
+
+TokenIndex::Entry PersistentStore::authenticateToken(const char* token){
+	const TokenIndex::Digest digest=TokenIndex::digest(token,strlen(token));
+	TokenIndex::Entry entry=tokenIndex.find(digest);
+	if(entry){
+		cacheHits++;
+		//reload the owner before the entry expires, so that tokens in 
+		//continuous use never have to wait for the database
+		if(entry.expirationTime-std::chrono::steady_clock::now() <= userCacheValidity/refreshAheadFraction){
+			const std::string tokenString(token);
+			scheduleRefresh("tokenIndex:"+tokenString,[this,digest,tokenString]{
+				fetchOnce(userFetches,"userToken",tokenString,&PersistentStore::loadUserByToken);
+				indexToken(digest,tokenString);
+			});
+		}
+		return entry;
+	}
+	const std::string tokenString(token);
+	CacheRecord<User> record;
+	if(userByTokenCache.find(tokenString,record) && record)
+		cacheHits++;
+	else
+		record=CacheRecord<User>(fetchOnce(userFetches,"userToken",tokenString,&PersistentStore::loadUserByToken),userCacheValidity);
+	if(!record.record)
+		return entry;
+	entry=indexToken(digest,tokenString);
+	if(entry)
+		return entry;
+	//The record changed while it was being read, so it was not cached. This 
+	//request may still use it, as if the change had come just afterwards. 
+	return TokenIndex::Entry(record.record.id,record.record.admin,record.expirationTime);
+}
+
+TokenIndex::Entry PersistentStore::indexToken(const TokenIndex::Digest& digest, const std::string& token){
+	CacheRecord<User> record;
+	if(!(userByTokenCache.find(token,record) && record)){
+		//the token is gone, or its owner changed while being reloaded
+		tokenIndex.erase(digest);
+		return TokenIndex::Entry();
+	}
+	TokenIndex::Entry entry=tokenIndex.insert(digest,record.record.id,record.record.admin,record.expirationTime);
+	//an invalidation which arrived while the entry was being written may 
+	//have looked for it too early to remove it
+	if(!(userByTokenCache.find(token,record) && record)){
+		tokenIndex.erase(digest);
+		return TokenIndex::Entry();
+	}
+	return entry;
+}
+
+User PersistentStore::loadUserByToken(const std::string& token){
+	const auto loadStart=std::chrono::steady_clock::now();
 	//need to query the database
 	databaseQueries++;
 	using Aws::DynamoDB::Model::AttributeValue;
@@ -892,6 +1704,10 @@ User PersistentStore::findUserByToken(const std::string& token){
 	user.email=findOrThrow(item,"email","user record missing eamil attribute").GetS();
 	user.admin=findOrThrow(item,"admin","user record missing admin attribute").GetBool();
 	
+	//don't cache what another server changed while it was being read
+	if(invalidatedSince("user",user.id,loadStart))
+		return user;
+	
 	//update caches
 	CacheRecord<User> record(user,userCacheValidity);
 	userCache.insert_or_assign(user.id,record);
@@ -913,6 +1729,11 @@ User PersistentStore::findUserByGlobusID(const std::string& globusID){
 			}
 		}
 	}
+	return fetchOnce(userFetches,"userGlobusID",globusID,&PersistentStore::loadUserByGlobusID);
+}
+
+User PersistentStore::loadUserByGlobusID(const std::string& globusID){
+	const auto loadStart=std::chrono::steady_clock::now();
 	//need to query the database
 	databaseQueries++;
 	using AV=Aws::DynamoDB::Model::AttributeValue;
@@ -944,6 +1765,10 @@ User PersistentStore::findUserByGlobusID(const std::string& globusID){
 	user.email=findOrThrow(item,"email","user record missing eamil attribute").GetS();
 	user.admin=findOrThrow(item,"admin","user record missing admin attribute").GetBool();
 	
+	//don't cache what another server changed while it was being read
+	if(invalidatedSince("user",user.id,loadStart))
+		return user;
+	
 	//update caches
 	CacheRecord<User> record(user,userCacheValidity);
 	userCache.insert_or_assign(user.id,record);
@@ -972,38 +1797,29 @@ bool PersistentStore::updateUser(const User& user, const User& oldUser){
 		log_error("Failed to update user record: " << err.GetMessage());
 		return false;
 	}
+	//a load which read the old version must not cache it over the new one
+	rememberInvalidation("user",user.id);
 	
 	//update caches
 	CacheRecord<User> record(user,userCacheValidity);
 	userCache.insert_or_assign(user.id,record);
 	//if the token has changed, ensure that any old cache record is removed
-	if(oldUser.token!=user.token)
+	if(oldUser.token!=user.token){
 		userByTokenCache.erase(oldUser.token);
+		tokenIndex.erase(TokenIndex::digest(oldUser.token));
+	}
 	userByTokenCache.insert_or_assign(user.token,record);
+	//the admin flag may have changed
+	tokenIndex.erase(TokenIndex::digest(user.token));
 	userByGlobusIDCache.insert_or_assign(user.globusID,record);
+	recordChange(userTableName,user.id);
+	publishInvalidation({"user",user.id,{}});
 	
 	return true;
 }
 
 bool PersistentStore::removeUser(const std::string& id){
-	//erase cache entries
-	{
-		//Somewhat hacky: we can't erase the secondary cache entries unless we know 
-		//the keys. However, we keep the caches synchronized, so if there is 
-		//such an entry to delete there is also an entry in the main cache, so 
-		//we can grab that to get the name without having to read from the 
-		//database.
-		CacheRecord<User> record;
-		bool cached=userCache.find(id,record);
-		if(cached){
-			//don't particularly care whether the record is expired; if it is 
-			//all that will happen is that we will delete the equally stale 
-			//record in the other cache
-			userByTokenCache.erase(record.record.token);
-			userByGlobusIDCache.erase(record.record.globusID);
-		}
-		userCache.erase(id);
-	}
+	uncacheUser(id);
 	
 	using Aws::DynamoDB::Model::AttributeValue;
 	auto outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
@@ -1015,6 +1831,12 @@ bool PersistentStore::removeUser(const std::string& id){
 		log_error("Failed to delete user record: " << err.GetMessage());
 		return false;
 	}
+	//a load which read the record before it was deleted may have put it back
+	//in the cache, and any still in progress must not
+	rememberInvalidation("user",id);
+	uncacheUser(id);
+	recordChange(userTableName,id);
+	publishInvalidation({"user",id,{}});
 	return true;
 }
 
@@ -1032,59 +1854,64 @@ std::vector<User> PersistentStore::listUsers(){
 		return collected;
 	}
 	
+	const auto scanStart=std::chrono::steady_clock::now();
 	databaseScans++;
 	Aws::DynamoDB::Model::ScanRequest request;
 	request.SetTableName(userTableName);
-	//request.SetAttributesToGet({"ID","name","email"});
 	request.SetFilterExpression("attribute_not_exists(#voID)");
 	request.SetExpressionAttributeNames({{"#voID", "voID"}});
-	bool keepGoing=false;
-	
-	do{
-		auto outcome=dbClient.Scan(request);
-		if(!outcome.IsSuccess()){
-			//TODO: more principled logging or reporting of the nature of the error
-			auto err=outcome.GetError();
-			log_error("Failed to fetch user records: " << err.GetMessage());
-			return collected;
-		}
-		const auto& result=outcome.GetResult();
-		//set up fetching the next page if necessary
-		if(!result.GetLastEvaluatedKey().empty()){
-			keepGoing=true;
-			request.SetExclusiveStartKey(result.GetLastEvaluatedKey());
-		}
-		else
-			keepGoing=false;
-		//collect results from this page
-		for(const auto& item : result.GetItems()){
-			User user;
-			user.valid=true;
-			user.id=item.find("ID")->second.GetS();
-			user.globusID=item.find("globusID")->second.GetS();
-			user.token=item.find("token")->second.GetS();
-			user.name=item.find("name")->second.GetS();
-			user.email=item.find("email")->second.GetS();
-			user.admin=item.find("admin")->second.GetBool();
-			collected.push_back(user);
-
-			CacheRecord<User> record(user,userCacheValidity);
-			userCache.insert_or_assign(user.id,record);
-		}
-	}while(keepGoing);
-	userCacheExpirationTime=std::chrono::steady_clock::now()+userCacheValidity;
+	std::vector<std::vector<User>> segments(scanSegments);
+	bool complete=parallelScan(request,[&](std::size_t segment, const DatabaseItem& item){
+		User user=userFromItem(item);
+		segments[segment].push_back(user);
+		if(invalidatedSince("user",user.id,scanStart))
+			return;
+		
+		CacheRecord<User> record(user,userCacheValidity);
+		userCache.insert_or_assign(user.id,record);
+	});
+	for(auto& segment : segments)
+		std::move(segment.begin(),segment.end(),std::back_inserter(collected));
+	//a listing which may be missing changes announced during the scan must 
+	//not be served from the cache
+	if(!complete || lastInvalidation.load()>=scanStart)
+		return collected;
+	userCacheExpirationTime=listingExpiration(userCacheValidity);
 	
 	return collected;
 }
 
+ListPage<User> PersistentStore::listUsersPage(std::size_t limit, const std::string& cursor){
+	ListPage<User> page;
+	Aws::DynamoDB::Model::ScanRequest request;
+	request.SetTableName(userTableName);
+	request.SetFilterExpression("attribute_not_exists(#voID)");
+	request.SetExpressionAttributeNames({{"#voID", "voID"}});
+	const auto scanStart=std::chrono::steady_clock::now();
+	std::vector<DatabaseItem> items;
+	page.status=scanPage(request,limit,cursor,items,page.nextCursor);
+	if(page.status!=PageStatus::Fetched)
+		return page;
+	for(const auto& item : items){
+		User user=userFromItem(item);
+		page.items.push_back(user);
+		if(invalidatedSince("user",user.id,scanStart))
+			continue;
+		
+		CacheRecord<User> record(user,userCacheValidity);
+		userCache.insert_or_assign(user.id,record);
+	}
+	return page;
+}
+
 std::vector<User> PersistentStore::listUsersByVO(const std::string& vo){
 	//first check if list of users is cached
 	CacheRecord<std::string> record;
 	auto cached = userByVOCache.find(vo);
 	if (cached.second > std::chrono::steady_clock::now()) {
-		auto records = cached.first;
+		const auto& records = *cached.first;
 		std::vector<User> users;
-		for (auto record : records) {
+		for (const auto& record : records) {
 			cacheHits++;
 			auto user = getUser(record);
 			users.push_back(user);
@@ -1097,7 +1924,7 @@ std::vector<User> PersistentStore::listUsersByVO(const std::string& vo){
 	databaseQueries++;
 
 	Aws::DynamoDB::Model::QueryOutcome outcome;
-	outcome=dbClient.Query(Aws::DynamoDB::Model::QueryRequest()
+	outcome=queryAllPages(Aws::DynamoDB::Model::QueryRequest()
 			       .WithTableName(userTableName)
 			       .WithIndexName("ByVO")
 			       .WithKeyConditionExpression("#voID = :vo_val")
@@ -1157,10 +1984,12 @@ bool PersistentStore::addUserToVO(const std::string& uID, std::string voID){
 	}
 	
 	//update cache
+	userNotInVOCache.erase(uID+":"+voID);
 	CacheRecord<std::string> record(uID,userCacheValidity);
 	userByVOCache.insert_or_assign(voID,record);
 	CacheRecord<VO> VOrecord(vo,voCacheValidity); 
 	voByUserCache.insert_or_assign(user.id, VOrecord);
+	publishInvalidation({"membership",uID,{voID}});
 	
 	return true;
 }
@@ -1188,6 +2017,7 @@ bool PersistentStore::removeUserFromVO(const std::string& uID, std::string voID)
 		log_error("Failed to delete user VO membership record: " << err.GetMessage());
 		return false;
 	}
+	publishInvalidation({"membership",uID,{voID}});
 	return true;
 }
 
@@ -1206,7 +2036,7 @@ std::vector<std::string> PersistentStore::getUserVOMemberships(const std::string
 		{":id",AttributeValue(uID)},
 		{":prefix",AttributeValue(uID+":"+IDGenerator::voIDPrefix)}
 	});
-	auto outcome=dbClient.Query(request);
+	auto outcome=queryAllPages(request);
 	std::vector<std::string> vos;
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
@@ -1232,12 +2062,6 @@ std::vector<std::string> PersistentStore::getUserVOMemberships(const std::string
 }
 
 bool PersistentStore::userInVO(const std::string& uID, std::string voID){
-	//TODO: possible issue: We only store memberships, so repeated queries about
-	//a user's belonging to a VO to which that user does not in fact belong will
-	//never be in the cache, and will always incur a database query. This should
-	//not be a problem for normal/well intentioned use, but seems like a way to
-	//turn accident or malice into denial of service or a large AWS bill. 
-	
 	//check whether the 'ID' we got was actually a name
 	if(!normalizeVOID(voID))
 		return false;
@@ -1253,6 +2077,19 @@ bool PersistentStore::userInVO(const std::string& uID, std::string voID){
 			}
 		}
 	}
+	//we also remember recent negative results, so that repeated checks for 
+	//memberships which do not exist do not each cost a database query
+	const std::string negativeKey=uID+":"+voID;
+	{
+		CacheRecord<std::string> record;
+		if(userNotInVOCache.find(negativeKey,record)){
+			if(record){
+				negativeCacheHits++;
+				return false;
+			}
+			userNotInVOCache.erase(negativeKey);
+		}
+	}
 	//need to query the database
 	databaseQueries++;
 	log_info("Querying database for user " << uID << " membership in VO " << voID);
@@ -1260,15 +2097,17 @@ bool PersistentStore::userInVO(const std::string& uID, std::string voID){
 	auto outcome=dbClient.GetItem(Aws::DynamoDB::Model::GetItemRequest()
 								  .WithTableName(userTableName)
 								  .WithKey({{"ID",AttributeValue(uID)},
-	                                        {"sortKey",AttributeValue(uID+":"+voID)}}));
+	                                        {"sortKey",AttributeValue(negativeKey)}}));
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
 		log_error("Failed to fetch user VO membership record: " << err.GetMessage());
 		return false;
 	}
 	const auto& item=outcome.GetResult().GetItem();
-	if(item.empty()) //no match found
+	if(item.empty()){ //no match found
+		cacheNegativeResult(userNotInVOCache,negativeKey);
 		return false;
+	}
 	
 	//update cache
 	CacheRecord<std::string> record(uID,userCacheValidity);
@@ -1292,11 +2131,14 @@ bool PersistentStore::addVO(const VO& vo){
 		log_error("Failed to add VO record: " << err.GetMessage());
 		return false;
 	}
+	rememberInvalidation("vo",vo.id);
 	
 	//update caches
 	CacheRecord<VO> record(vo,voCacheValidity);
 	voCache.insert_or_assign(vo.id,record);
 	voByNameCache.insert_or_assign(vo.name,record);
+	recordChange(voTableName,vo.id);
+	publishInvalidation({"vo",vo.id,{}});
         
 	return true;
 }
@@ -1310,23 +2152,7 @@ bool PersistentStore::removeVO(const std::string& voID){
 			return false;
 	}
 	
-	//erase cache entries
-	{
-		//Somewhat hacky: we can't erase the secondary cache entries unless we know 
-		//the keys. However, we keep the caches synchronized, so if there is 
-		//such an entry to delete there is also an entry in the main cache, so 
-		//we can grab that to get the name without having to read from the 
-		//database.
-		CacheRecord<VO> record;
-		bool cached=voCache.find(voID,record);
-		if(cached){
-			//don't particularly care whether the record is expired; if it is 
-			//all that will happen is that we will delete the equally stale 
-			//record in the other cache
-			voByNameCache.erase(record.record.name);
-		}
-		voCache.erase(voID);
-	}
+	uncacheVO(voID);
 	
 	//delete the VO record itself
 	auto outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
@@ -1338,6 +2164,11 @@ bool PersistentStore::removeVO(const std::string& voID){
 		log_error("Failed to delete VO record: " << err.GetMessage());
 		return false;
 	}
+	//See removeUser regarding loads in progress
+	rememberInvalidation("vo",voID);
+	uncacheVO(voID);
+	recordChange(voTableName,voID);
+	publishInvalidation({"vo",voID,{}});
 	return true;
 }
 
@@ -1345,7 +2176,7 @@ std::vector<std::string> PersistentStore::getMembersOfVO(const std::string voID)
 	using Aws::DynamoDB::Model::AttributeValue;
 	databaseQueries++;
 	log_info("Querying database for members of VO " << voID);
-	auto outcome=dbClient.Query(Aws::DynamoDB::Model::QueryRequest()
+	auto outcome=queryAllPages(Aws::DynamoDB::Model::QueryRequest()
 	                            .WithTableName(userTableName)
 	                            .WithIndexName("ByVO")
 	                            .WithKeyConditionExpression("#voID = :id_val")
@@ -1370,7 +2201,7 @@ std::vector<std::string> PersistentStore::clustersOwnedByVO(const std::string vo
 	using Aws::DynamoDB::Model::AttributeValue;
 	databaseQueries++;
 	log_info("Querying database for clusters owned by VO " << voID);
-	auto outcome=dbClient.Query(Aws::DynamoDB::Model::QueryRequest()
+	auto outcome=queryAllPages(Aws::DynamoDB::Model::QueryRequest()
 	                            .WithTableName(clusterTableName)
 	                            .WithIndexName("ByVO")
 	                            .WithKeyConditionExpression("#voID = :id_val")
@@ -1406,55 +2237,66 @@ std::vector<VO> PersistentStore::listVOs(){
 		return collected;
 	}	
 
+	const auto scanStart=std::chrono::steady_clock::now();
 	databaseScans++;
 	Aws::DynamoDB::Model::ScanRequest request;
 	request.SetTableName(voTableName);
 	request.SetFilterExpression("attribute_exists(#name)");
 	request.SetExpressionAttributeNames({{"#name","name"}});
-	bool keepGoing=false;
-	
-	do{
-		auto outcome=dbClient.Scan(request);
-		if(!outcome.IsSuccess()){
-			//TODO: more principled logging or reporting of the nature of the error
-			auto err=outcome.GetError();
-			log_error("Failed to fetch VO records: " << err.GetMessage());
-			return collected;
-		}
-		const auto& result=outcome.GetResult();
-		//set up fetching the next page if necessary
-		if(!result.GetLastEvaluatedKey().empty()){
-			keepGoing=true;
-			request.SetExclusiveStartKey(result.GetLastEvaluatedKey());
-		}
-		else
-			keepGoing=false;
-		//collect results from this page
-		for(const auto& item : result.GetItems()){
-			VO vo;
-			vo.valid=true;
-			vo.id=item.find("ID")->second.GetS();
-			vo.name=item.find("name")->second.GetS();
-			collected.push_back(vo);
-
-			CacheRecord<VO> record(vo,voCacheValidity);
-			voCache.insert_or_assign(vo.id,record);
-			voByNameCache.insert_or_assign(vo.name,record);
-		}
-	}while(keepGoing);
-	voCacheExpirationTime=std::chrono::steady_clock::now()+voCacheValidity;
+	std::vector<std::vector<VO>> segments(scanSegments);
+	bool complete=parallelScan(request,[&](std::size_t segment, const DatabaseItem& item){
+		VO vo=voFromItem(item);
+		segments[segment].push_back(vo);
+		if(invalidatedSince("vo",vo.id,scanStart))
+			return;
+		
+		CacheRecord<VO> record(vo,voCacheValidity);
+		voCache.insert_or_assign(vo.id,record);
+		voByNameCache.insert_or_assign(vo.name,record);
+	});
+	for(auto& segment : segments)
+		std::move(segment.begin(),segment.end(),std::back_inserter(collected));
+	//a listing which may be missing changes announced during the scan must 
+	//not be served from the cache
+	if(!complete || lastInvalidation.load()>=scanStart)
+		return collected;
+	voCacheExpirationTime=listingExpiration(voCacheValidity);
 	
 	return collected;
 }
 
+ListPage<VO> PersistentStore::listVOsPage(std::size_t limit, const std::string& cursor){
+	ListPage<VO> page;
+	Aws::DynamoDB::Model::ScanRequest request;
+	request.SetTableName(voTableName);
+	request.SetFilterExpression("attribute_exists(#name)");
+	request.SetExpressionAttributeNames({{"#name","name"}});
+	const auto scanStart=std::chrono::steady_clock::now();
+	std::vector<DatabaseItem> items;
+	page.status=scanPage(request,limit,cursor,items,page.nextCursor);
+	if(page.status!=PageStatus::Fetched)
+		return page;
+	for(const auto& item : items){
+		VO vo=voFromItem(item);
+		page.items.push_back(vo);
+		if(invalidatedSince("vo",vo.id,scanStart))
+			continue;
+		
+		CacheRecord<VO> record(vo,voCacheValidity);
+		voCache.insert_or_assign(vo.id,record);
+		voByNameCache.insert_or_assign(vo.name,record);
+	}
+	return page;
+}
+
 std::vector<VO> PersistentStore::listVOsForUser(const std::string& user){
 	// first check if VOs list is cached
 	CacheRecord<VO> record;
 	auto cached = voByUserCache.find(user);
 	if (cached.second > std::chrono::steady_clock::now()) {
-		auto records = cached.first;
+		const auto& records = *cached.first;
 		std::vector<VO> vos;
-		for (auto record : records) {
+		for (const auto& record : records) {
 			cacheHits++;
 			vos.push_back(record);
 		}
@@ -1466,7 +2308,7 @@ std::vector<VO> PersistentStore::listVOsForUser(const std::string& user){
 	databaseQueries++;
 
 	Aws::DynamoDB::Model::QueryOutcome outcome;
-	outcome=dbClient.Query(Aws::DynamoDB::Model::QueryRequest()
+	outcome=queryAllPages(Aws::DynamoDB::Model::QueryRequest()
 			       .WithTableName(userTableName)
 			       .WithKeyConditionExpression("ID = :user_val")
 			       .WithFilterExpression("attribute_exists(#voID)")
@@ -1484,17 +2326,15 @@ std::vector<VO> PersistentStore::listVOsForUser(const std::string& user){
 	if(queryResult.GetCount()==0)
 		return vos;
 
-	for(const auto& item : queryResult.GetItems()){
-		std::string voID = findOrThrow(item, "voID", "User record missing voID attribute").GetS();
-		
-	  	VO vo = findVOByID(voID);
+	std::vector<std::string> voIDs;
+	voIDs.reserve(queryResult.GetItems().size());
+	for(const auto& item : queryResult.GetItems())
+		voIDs.push_back(findOrThrow(item, "voID", "User record missing voID attribute").GetS());
+	
+	for(const VO& vo : getVOs(voIDs)){
 		vos.push_back(vo);
-		
 		//update caches
-		CacheRecord<VO> record(vo,voCacheValidity);
-		voCache.insert_or_assign(vo.id,record);
-		voByNameCache.insert_or_assign(vo.name,record);
-		voByUserCache.insert_or_assign(user,record);
+		voByUserCache.insert_or_assign(user,CacheRecord<VO>(vo,voCacheValidity));
 	}
 	voByUserCache.update_expiration(user,std::chrono::steady_clock::now()+voCacheValidity);
 	
@@ -1509,10 +2349,16 @@ VO PersistentStore::findVOByID(const std::string& id){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
 				cacheHits++;
+				refreshIfExpiring(record,voCacheValidity,voFetches,"vo",id,&PersistentStore::loadVOByID);
 				return record;
 			}
 		}
 	}
+	return fetchOnce(voFetches,"vo",id,&PersistentStore::loadVOByID);
+}
+
+VO PersistentStore::loadVOByID(const std::string& id){
+	const auto loadStart=std::chrono::steady_clock::now();
 	//need to query the database
 	databaseQueries++;
 	log_info("Querying database for VO " << id);
@@ -1529,10 +2375,11 @@ VO PersistentStore::findVOByID(const std::string& id){
 	const auto& item=outcome.GetResult().GetItem();
 	if(item.empty()) //no match found
 		return VO{};
-	VO vo;
-	vo.valid=true;
-	vo.id=id;
-	vo.name=findOrThrow(item,"name","VO record missing name attribute").GetS();
+	VO vo=voFromItem(item);
+	
+	//don't cache what another server changed while it was being read
+	if(invalidatedSince("vo",vo.id,loadStart))
+		return vo;
 	
 	//update caches
 	CacheRecord<VO> record(vo,voCacheValidity);
@@ -1542,6 +2389,62 @@ VO PersistentStore::findVOByID(const std::string& id){
 	return vo;
 }
 
+std::vector<VO> PersistentStore::getVOs(const std::vector<std::string>& ids){
+	std::vector<VO> vos(ids.size());
+	//first see which VOs we have cached
+	std::vector<std::string> missing;
+	for(std::size_t i=0; i<ids.size(); i++){
+		CacheRecord<VO> record;
+		if(voCache.find(ids[i],record) && record){
+			cacheHits++;
+			refreshIfExpiring(record,voCacheValidity,voFetches,"vo",ids[i],&PersistentStore::loadVOByID);
+			vos[i]=record;
+		}
+		else
+			missing.push_back(ids[i]);
+	}
+	if(missing.empty())
+		return vos;
+	//query the database for the rest
+	log_info("Querying database for " << missing.size() << " VOs");
+	const auto loadStart=std::chrono::steady_clock::now();
+	std::unordered_map<std::string,VO> fetched;
+	for(const auto& item : batchGetItems(voTableName,missing)){
+		VO vo=voFromItem(item);
+		if(invalidatedSince("vo",vo.id,loadStart)){
+			fetched.emplace(vo.id,std::move(vo));
+			continue;
+		}
+		//update caches
+		CacheRecord<VO> record(vo,voCacheValidity);
+		voCache.insert_or_assign(vo.id,record);
+		voByNameCache.insert_or_assign(vo.name,record);
+		fetched.emplace(vo.id,std::move(vo));
+	}
+	for(std::size_t i=0; i<ids.size(); i++){
+		if(vos[i])
+			continue;
+		auto it=fetched.find(ids[i]);
+		if(it!=fetched.end())
+			vos[i]=it->second;
+	}
+	return vos;
+}
+
+std::unordered_map<std::string,std::string> PersistentStore::getVONames(const std::vector<std::string>& ids){
+	std::unordered_map<std::string,std::string> names;
+	std::vector<std::string> distinct;
+	for(const auto& id : ids){
+		if(names.emplace(id,std::string()).second)
+			distinct.push_back(id);
+	}
+	for(const VO& vo : getVOs(distinct)){
+		if(vo)
+			names[vo.id]=vo.name;
+	}
+	return names;
+}
+
 VO PersistentStore::findVOByName(const std::string& name){
 	//first see if we have this cached
 	{
@@ -1550,10 +2453,16 @@ VO PersistentStore::findVOByName(const std::string& name){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
 				cacheHits++;
+				refreshIfExpiring(record,voCacheValidity,voFetches,"voName",name,&PersistentStore::loadVOByName);
 				return record;
 			}
 		}
 	}
+	return fetchOnce(voFetches,"voName",name,&PersistentStore::loadVOByName);
+}
+
+VO PersistentStore::loadVOByName(const std::string& name){
+	const auto loadStart=std::chrono::steady_clock::now();
 	//need to query the database
 	databaseQueries++;
 	log_info("Querying database for VO " << name);
@@ -1581,6 +2490,10 @@ VO PersistentStore::findVOByName(const std::string& name){
 	vo.id=findOrThrow(queryResult.GetItems().front(),"ID","VO record missing ID attribute").GetS();
 	vo.name=name;
 	
+	//don't cache what another server changed while it was being read
+	if(invalidatedSince("vo",vo.id,loadStart))
+		return vo;
+	
 	//update caches
 	CacheRecord<VO> record(vo,voCacheValidity);
 	voCache.insert_or_assign(vo.id,record);
@@ -1598,8 +2511,14 @@ VO PersistentStore::getVO(const std::string& idOrName){
 //----
 
 SharedFileHandle PersistentStore::configPathForCluster(const std::string& cID){
-	if(!findClusterByID(cID)) //need to do this to ensure local data is fresh
+	const Cluster cluster=findClusterByID(cID); //need to do this to ensure local data is fresh
+	if(!cluster)
 		log_fatal(cID << " does not exist; cannot get config data");
+	SharedFileHandle config;
+	if(clusterConfigs.find(cID,config))
+		return config;
+	//the record was not cached, because it changed while it was being loaded
+	writeClusterConfigToDisk(cluster);
 	return clusterConfigs.find(cID);
 }
 
@@ -1621,12 +2540,15 @@ bool PersistentStore::addCluster(const Cluster& cluster){
 		log_error("Failed to add cluster record: " << err.GetMessage());
 		return false;
 	}
+	rememberInvalidation("cluster",cluster.id);
 	
 	CacheRecord<Cluster> record(cluster,clusterCacheValidity);
 	clusterCache.insert_or_assign(cluster.id,record);
 	clusterByNameCache.insert_or_assign(cluster.name,record);
 	clusterByVOCache.insert_or_assign(cluster.owningVO,record);
 	writeClusterConfigToDisk(cluster);
+	recordChange(clusterTableName,cluster.id);
+	publishInvalidation({"cluster",cluster.id,{cluster.owningVO}});
 	
 	return true;
 }
@@ -1651,10 +2573,16 @@ Cluster PersistentStore::findClusterByID(const std::string& cID){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
 				cacheHits++;
+				refreshIfExpiring(record,clusterCacheValidity,clusterFetches,"cluster",cID,&PersistentStore::loadClusterByID);
 				return record;
 			}
 		}
 	}
+	return fetchOnce(clusterFetches,"cluster",cID,&PersistentStore::loadClusterByID);
+}
+
+Cluster PersistentStore::loadClusterByID(const std::string& cID){
+	const auto loadStart=std::chrono::steady_clock::now();
 	//need to query the database
 	using Aws::DynamoDB::Model::AttributeValue;
 	databaseQueries++;
@@ -1671,13 +2599,11 @@ Cluster PersistentStore::findClusterByID(const std::string& cID){
 	const auto& item=outcome.GetResult().GetItem();
 	if(item.empty()) //no match found
 		return Cluster{};
-	Cluster cluster;
-	cluster.valid=true;
-	cluster.id=cID;
-	cluster.name=findOrThrow(item,"name","Cluster record missing name attribute").GetS();
-	cluster.owningVO=findOrThrow(item,"owningVO","Cluster record missing owningVO attribute").GetS();
-	cluster.config=findOrThrow(item,"config","Cluster record missing config attribute").GetS();
-	cluster.systemNamespace=findOrThrow(item,"systemNamespace","Cluster record missing systemNamespace attribute").GetS();
+	Cluster cluster=clusterFromItem(item);
+	
+	//don't cache what another server changed while it was being read
+	if(invalidatedSince("cluster",cluster.id,loadStart))
+		return cluster;
 	
 	//cache this result for reuse
 	CacheRecord<Cluster> record(cluster,clusterCacheValidity);
@@ -1689,6 +2615,64 @@ Cluster PersistentStore::findClusterByID(const std::string& cID){
 	return cluster;
 }
 
+std::vector<Cluster> PersistentStore::getClusters(const std::vector<std::string>& ids){
+	std::vector<Cluster> clusters(ids.size());
+	//first see which clusters we have cached
+	std::vector<std::string> missing;
+	for(std::size_t i=0; i<ids.size(); i++){
+		CacheRecord<Cluster> record;
+		if(clusterCache.find(ids[i],record) && record){
+			cacheHits++;
+			refreshIfExpiring(record,clusterCacheValidity,clusterFetches,"cluster",ids[i],&PersistentStore::loadClusterByID);
+			clusters[i]=record;
+		}
+		else
+			missing.push_back(ids[i]);
+	}
+	if(missing.empty())
+		return clusters;
+	//query the database for the rest
+	log_info("Querying database for " << missing.size() << " clusters");
+	const auto loadStart=std::chrono::steady_clock::now();
+	std::unordered_map<std::string,Cluster> fetched;
+	for(const auto& item : batchGetItems(clusterTableName,missing)){
+		Cluster cluster=clusterFromItem(item);
+		if(invalidatedSince("cluster",cluster.id,loadStart)){
+			fetched.emplace(cluster.id,std::move(cluster));
+			continue;
+		}
+		//cache this result for reuse
+		CacheRecord<Cluster> record(cluster,clusterCacheValidity);
+		clusterCache.insert_or_assign(cluster.id,record);
+		clusterByNameCache.insert_or_assign(cluster.name,record);
+		clusterByVOCache.insert_or_assign(cluster.owningVO,record);
+		writeClusterConfigToDisk(cluster);
+		fetched.emplace(cluster.id,std::move(cluster));
+	}
+	for(std::size_t i=0; i<ids.size(); i++){
+		if(clusters[i])
+			continue;
+		auto it=fetched.find(ids[i]);
+		if(it!=fetched.end())
+			clusters[i]=it->second;
+	}
+	return clusters;
+}
+
+std::unordered_map<std::string,std::string> PersistentStore::getClusterNames(const std::vector<std::string>& ids){
+	std::unordered_map<std::string,std::string> names;
+	std::vector<std::string> distinct;
+	for(const auto& id : ids){
+		if(names.emplace(id,std::string()).second)
+			distinct.push_back(id);
+	}
+	for(const Cluster& cluster : getClusters(distinct)){
+		if(cluster)
+			names[cluster.id]=cluster.name;
+	}
+	return names;
+}
+
 Cluster PersistentStore::findClusterByName(const std::string& name){
 	//first see if we have this cached
 	{
@@ -1697,10 +2681,16 @@ Cluster PersistentStore::findClusterByName(const std::string& name){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
 				cacheHits++;
+				refreshIfExpiring(record,clusterCacheValidity,clusterFetches,"clusterName",name,&PersistentStore::loadClusterByName);
 				return record;
 			}
 		}
 	}
+	return fetchOnce(clusterFetches,"clusterName",name,&PersistentStore::loadClusterByName);
+}
+
+Cluster PersistentStore::loadClusterByName(const std::string& name){
+	const auto loadStart=std::chrono::steady_clock::now();
 	//need to query the database
 	using AV=Aws::DynamoDB::Model::AttributeValue;
 	databaseQueries++;
@@ -1735,6 +2725,10 @@ Cluster PersistentStore::findClusterByName(const std::string& name){
 	cluster.systemNamespace=findOrThrow(queryResult.GetItems().front(),"systemNamespace",
 	                                    "Cluster record missing systemNamespace attribute").GetS();
 	
+	//don't cache what another server changed while it was being read
+	if(invalidatedSince("cluster",cluster.id,loadStart))
+		return cluster;
+	
 	//cache this result for reuse
 	CacheRecord<Cluster> record(cluster,clusterCacheValidity);
 	clusterCache.insert_or_assign(cluster.id,record);
@@ -1756,25 +2750,10 @@ bool PersistentStore::removeCluster(const std::string& cID){
 	for(const auto& guest : listVOsAllowedOnCluster(cID))
 		removeVOFromCluster(guest,cID);
 	
-	//erase cache entries
-	{
-		//Somewhat hacky: we can't erase the byName cache entry unless we know 
-		//the name. However, we keep the caches synchronized, so if there is 
-		//such an entry to delete there is also an entry in the main cache, so 
-		//we can grab that to get the name without having to read from the 
-		//database.
-		CacheRecord<Cluster> record;
-		bool cached=clusterCache.find(cID,record);
-		if(cached){
-			//don't particularly care whether the record is expired; if it is 
-			//all that will happen is that we will delete the equally stale 
-			//record in the other cache
-			clusterByNameCache.erase(record.record.name);
-			clusterByVOCache.erase(record.record.owningVO,record);
-		}
-	}
-	clusterCache.erase(cID);
-	clusterConfigs.erase(cID);
+	//other servers need the owning VO to find their cached listings of its 
+	//clusters, and it cannot be looked up once the record is gone
+	const Cluster cluster=findClusterByID(cID);
+	uncacheCluster(cID);
 	
 	using Aws::DynamoDB::Model::AttributeValue;
 	auto outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
@@ -1786,6 +2765,11 @@ bool PersistentStore::removeCluster(const std::string& cID){
 		log_error("Failed to delete cluster record: " << err.GetMessage());
 		return false;
 	}
+	//See removeUser regarding loads in progress
+	rememberInvalidation("cluster",cID);
+	uncacheCluster(cID);
+	recordChange(clusterTableName,cID);
+	publishInvalidation({"cluster",cID,{cluster.owningVO}});
 	return true;
 }
 
@@ -1807,6 +2791,7 @@ bool PersistentStore::updateCluster(const Cluster& cluster){
 		log_error("Failed to update cluster record: " << err.GetMessage());
 		return false;
 	}
+	rememberInvalidation("cluster",cluster.id);
 	
 	//update caches
 	CacheRecord<Cluster> record(cluster,clusterCacheValidity);
@@ -1814,6 +2799,8 @@ bool PersistentStore::updateCluster(const Cluster& cluster){
 	clusterByNameCache.insert_or_assign(cluster.name,record);
 	clusterByVOCache.insert_or_assign(cluster.owningVO,record);
 	writeClusterConfigToDisk(cluster);
+	recordChange(clusterTableName,cluster.id);
+	publishInvalidation({"cluster",cluster.id,{cluster.owningVO}});
 	
 	return true;
 }
@@ -1835,52 +2822,62 @@ std::vector<Cluster> PersistentStore::listClusters(){
 		return collected;
 	}
 
+	const auto scanStart=std::chrono::steady_clock::now();
 	databaseScans++;
 	Aws::DynamoDB::Model::ScanRequest request;
 	request.SetTableName(clusterTableName);
 	request.SetFilterExpression("attribute_not_exists(#voID) AND attribute_exists(#name)");
 	request.SetExpressionAttributeNames({{"#voID", "voID"},{"#name","name"}});
-	bool keepGoing=false;
-	
-	do{
-		auto outcome=dbClient.Scan(request);
-		if(!outcome.IsSuccess()){
-			//TODO: more principled logging or reporting of the nature of the error
-			auto err=outcome.GetError();
-			log_error("Failed to fetch cluster records: " << err.GetMessage());
-			return collected;
-		}
-		const auto& result=outcome.GetResult();
-		//set up fetching the next page if necessary
-		if(!result.GetLastEvaluatedKey().empty()){
-			keepGoing=true;
-			request.SetExclusiveStartKey(result.GetLastEvaluatedKey());
-		}
-		else
-			keepGoing=false;
-		//collect results from this page
-		for(const auto& item : result.GetItems()){
-			Cluster cluster;
-			cluster.valid=true;
-			cluster.id=findOrThrow(item,"ID","Cluster record missing ID attribute").GetS();
-			cluster.name=findOrThrow(item,"name","Cluster record missing name attribute").GetS();
-			cluster.owningVO=findOrThrow(item,"owningVO","Cluster record missing owningVO attribute").GetS();
-			cluster.config=findOrThrow(item,"config","Cluster record missing config attribute").GetS();
-			cluster.systemNamespace=findOrThrow(item,"systemNamespace","Cluster record missing systemNamespace attribute").GetS();
-			collected.push_back(cluster);
-			
-			CacheRecord<Cluster> record(cluster,clusterCacheValidity);
-			clusterCache.insert_or_assign(cluster.id,record);
-			clusterByNameCache.insert_or_assign(cluster.name,record);
-			clusterByVOCache.insert_or_assign(cluster.owningVO,record);
-			writeClusterConfigToDisk(cluster);
-		}
-	}while(keepGoing);
-	clusterCacheExpirationTime=std::chrono::steady_clock::now()+clusterCacheValidity;
+	std::vector<std::vector<Cluster>> segments(scanSegments);
+	bool complete=parallelScan(request,[&](std::size_t segment, const DatabaseItem& item){
+		Cluster cluster=clusterFromItem(item);
+		segments[segment].push_back(cluster);
+		if(invalidatedSince("cluster",cluster.id,scanStart))
+			return;
+		
+		CacheRecord<Cluster> record(cluster,clusterCacheValidity);
+		clusterCache.insert_or_assign(cluster.id,record);
+		clusterByNameCache.insert_or_assign(cluster.name,record);
+		clusterByVOCache.insert_or_assign(cluster.owningVO,record);
+		writeClusterConfigToDisk(cluster);
+	});
+	for(auto& segment : segments)
+		std::move(segment.begin(),segment.end(),std::back_inserter(collected));
+	//a listing which may be missing changes announced during the scan must 
+	//not be served from the cache
+	if(!complete || lastInvalidation.load()>=scanStart)
+		return collected;
+	clusterCacheExpirationTime=listingExpiration(clusterCacheValidity);
 	
 	return collected;
 }
 
+ListPage<Cluster> PersistentStore::listClustersPage(std::size_t limit, const std::string& cursor){
+	ListPage<Cluster> page;
+	Aws::DynamoDB::Model::ScanRequest request;
+	request.SetTableName(clusterTableName);
+	request.SetFilterExpression("attribute_not_exists(#voID) AND attribute_exists(#name)");
+	request.SetExpressionAttributeNames({{"#voID", "voID"},{"#name","name"}});
+	const auto scanStart=std::chrono::steady_clock::now();
+	std::vector<DatabaseItem> items;
+	page.status=scanPage(request,limit,cursor,items,page.nextCursor);
+	if(page.status!=PageStatus::Fetched)
+		return page;
+	for(const auto& item : items){
+		Cluster cluster=clusterFromItem(item);
+		page.items.push_back(cluster);
+		if(invalidatedSince("cluster",cluster.id,scanStart))
+			continue;
+		
+		CacheRecord<Cluster> record(cluster,clusterCacheValidity);
+		clusterCache.insert_or_assign(cluster.id,record);
+		clusterByNameCache.insert_or_assign(cluster.name,record);
+		clusterByVOCache.insert_or_assign(cluster.owningVO,record);
+		writeClusterConfigToDisk(cluster);
+	}
+	return page;
+}
+
 std::vector<Cluster> PersistentStore::listClustersByVO(std::string vo){
 	std::vector<Cluster> collected;
 
@@ -1895,15 +2892,68 @@ std::vector<Cluster> PersistentStore::listClustersByVO(std::string vo){
 		vo=vo_.id;
 	}
 
+	//rather than checking the VO's access to each cluster in turn, look up 
+	//the clusters to which it, or every VO, has been granted access
+	std::set<std::string> accessible=clustersAccessibleByVO(vo);
+	std::set<std::string> open=clustersAccessibleByVO(wildcard);
 	std::vector<Cluster> allClusters=listClusters();
 	for (auto cluster : allClusters) {
-		if (vo == cluster.owningVO || voAllowedOnCluster(vo, cluster.id))
+		if (vo == cluster.owningVO || accessible.count(cluster.id) || open.count(cluster.id))
 			collected.push_back(cluster);
 	}
 			
 	return collected;
 }
 
+std::set<std::string> PersistentStore::clustersAccessibleByVO(const std::string& voID){
+	std::set<std::string> clusters;
+	//first see if we have this cached
+	auto cached=voClusterAccessCache.find(voID);
+	if(cached.second>std::chrono::steady_clock::now()){
+		cacheHits++;
+		for(const auto& record : *cached.first)
+			clusters.insert(record.record);
+		return clusters;
+	}
+	
+	using Aws::DynamoDB::Model::AttributeValue;
+	databaseQueries++;
+	log_info("Querying database for clusters accessible by VO " << voID);
+	auto outcome=queryAllPages(Aws::DynamoDB::Model::QueryRequest()
+	                            .WithTableName(clusterTableName)
+	                            .WithIndexName("VOAccess")
+	                            .WithKeyConditionExpression("#voID = :id_val")
+	                            .WithExpressionAttributeNames({{"#voID","voID"}})
+	                            .WithExpressionAttributeValues({{":id_val",AttributeValue(voID)}})
+	                            );
+	if(!outcome.IsSuccess()){
+		auto err=outcome.GetError();
+		log_error("Failed to fetch VO cluster access records: " << err.GetMessage());
+		return clusters;
+	}
+	const auto& queryResult=outcome.GetResult();
+	for(const auto& item : queryResult.GetItems()){
+		const std::string cID=findOrThrow(item,"ID","Cluster access record missing ID attribute").GetS();
+		clusters.insert(cID);
+		//update caches in both directions
+		CacheRecord<std::string> clusterRecord(cID,clusterCacheValidity);
+		voClusterAccessCache.insert_or_assign(voID,clusterRecord);
+		CacheRecord<std::string> voRecord(voID,clusterCacheValidity);
+		clusterVOAccessCache.insert_or_assign(cID,voRecord);
+	}
+	//drop expired entries which the query did not return; unexpired ones may 
+	//have been added concurrently by addVOToCluster
+	for(const auto& record : *cached.first){
+		if(!clusters.count(record.record) && !record)
+			voClusterAccessCache.erase(voID,record);
+	}
+	//this also records a VO with no access to any cluster, so that the next 
+	//lookup need not query again; addVOToCluster adds to the same entry
+	voClusterAccessCache.set_expiration(voID,std::chrono::steady_clock::now()+clusterCacheValidity);
+	
+	return clusters;
+}
+
 bool PersistentStore::addVOToCluster(std::string voID, std::string cID){
 	//check whether the VO 'ID' we got was actually a name
 	if(!normalizeVOID(voID,true))
@@ -1928,8 +2978,18 @@ bool PersistentStore::addVOToCluster(std::string voID, std::string cID){
 	}
 	
 	//update cache
+	if(voID==wildcard) //any VO may now have access, so forget all denials
+		voNotOnClusterCache.clear();
+	else
+		voNotOnClusterCache.erase(cID+":"+voID);
 	CacheRecord<std::string> record(voID,clusterCacheValidity);
 	clusterVOAccessCache.insert_or_assign(cID,record);
+	//The VO's accessible clusters may be cached as known to be empty; adding 
+	//to the entry rather than erasing it keeps it correct even if a lookup 
+	//which began before the grant finishes afterwards and renews it.
+	CacheRecord<std::string> clusterRecord(cID,clusterCacheValidity);
+	voClusterAccessCache.insert_or_assign(voID,clusterRecord);
+	publishInvalidation({"access",cID,{voID}});
 	
 	return true;
 }
@@ -1942,8 +3002,9 @@ bool PersistentStore::removeVOFromCluster(std::string voID, std::string cID){
 	if(!normalizeClusterID(cID))
 		return false;
 	
-	//remove any cache entry
+	//remove any cache entries
 	clusterVOAccessCache.erase(cID,CacheRecord<std::string>(voID));
+	voClusterAccessCache.erase(voID,CacheRecord<std::string>(cID));
 	
 	using Aws::DynamoDB::Model::AttributeValue;
 	auto outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
@@ -1955,6 +3016,7 @@ bool PersistentStore::removeVOFromCluster(std::string voID, std::string cID){
 		log_error("Failed to delete VO cluster access record: " << err.GetMessage());
 		return false;
 	}
+	publishInvalidation({"access",cID,{voID}});
 	return true;
 }
 
@@ -1984,7 +3046,7 @@ std::vector<std::string> PersistentStore::listVOsAllowedOnCluster(std::string cI
 		{":id",AttributeValue(cID)},
 		{":prefix",AttributeValue(cID+":"+IDGenerator::voIDPrefix)}
 	});
-	auto outcome=dbClient.Query(request);
+	auto outcome=queryAllPages(request);
 	std::vector<std::string> vos;
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
@@ -2010,12 +3072,6 @@ std::vector<std::string> PersistentStore::listVOsAllowedOnCluster(std::string cI
 }
 
 bool PersistentStore::voAllowedOnCluster(std::string voID, std::string cID){
-	//TODO: possible issue: We only store memberships, so repeated queries about
-	//a VO's access to a cluster to which it does not have access belong will
-	//never be in the cache, and will always incur a database query. This should
-	//not be a problem for normal/well intentioned use, but seems like a way to
-	//turn accident or malice into denial of service or a large AWS bill. 
-	
 	//check whether the 'ID' we got was actually a name
 	if(!normalizeVOID(voID))
 		return false;
@@ -2038,6 +3094,18 @@ bool PersistentStore::voAllowedOnCluster(std::string voID, std::string cID){
 			}
 		}
 	}
+	//check whether we recently found that this VO does not have access
+	const std::string negativeKey=cID+":"+voID;
+	{
+		CacheRecord<std::string> record;
+		if(voNotOnClusterCache.find(negativeKey,record)){
+			if(record){
+				negativeCacheHits++;
+				return false;
+			}
+			voNotOnClusterCache.erase(negativeKey);
+		}
+	}
 	//need to query the database
 	databaseQueries++;
 	log_info("Querying database for VO " << voID << " access to cluster " << cID);
@@ -2045,15 +3113,17 @@ bool PersistentStore::voAllowedOnCluster(std::string voID, std::string cID){
 	auto outcome=dbClient.GetItem(Aws::DynamoDB::Model::GetItemRequest()
 								  .WithTableName(clusterTableName)
 								  .WithKey({{"ID",AttributeValue(cID)},
-	                                        {"sortKey",AttributeValue(cID+":"+voID)}}));
+	                                        {"sortKey",AttributeValue(negativeKey)}}));
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
 		log_error("Failed to fetch cluster VO access record: " << err.GetMessage());
 		return false;
 	}
 	const auto& item=outcome.GetResult().GetItem();
-	if(item.empty()) //no match found
+	if(item.empty()){ //no match found
+		cacheNegativeResult(voNotOnClusterCache,negativeKey);
 		return false;
+	}
 	
 	//update cache
 	CacheRecord<std::string> record(voID,clusterCacheValidity);
@@ -2073,6 +3143,18 @@ bool PersistentStore::clusterAllowsAllVOs(std::string cID){
 			}
 		}
 	}
+	//check whether we recently found that there is no wildcard record
+	const std::string negativeKey=cID+":"+wildcard;
+	{
+		CacheRecord<std::string> record;
+		if(voNotOnClusterCache.find(negativeKey,record)){
+			if(record){
+				negativeCacheHits++;
+				return false;
+			}
+			voNotOnClusterCache.erase(negativeKey);
+		}
+	}
 	//query the database
 	databaseQueries++;
 	log_info("Querying database for wildcard access to cluster " << cID);
@@ -2080,15 +3162,17 @@ bool PersistentStore::clusterAllowsAllVOs(std::string cID){
 	auto outcome=dbClient.GetItem(Aws::DynamoDB::Model::GetItemRequest()
 								  .WithTableName(clusterTableName)
 								  .WithKey({{"ID",AttributeValue(cID)},
-	                                        {"sortKey",AttributeValue(cID+":"+wildcard)}}));
+	                                        {"sortKey",AttributeValue(negativeKey)}}));
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
 		log_error("Failed to fetch cluster VO access record: " << err.GetMessage());
 		return false;
 	}
 	const auto& item=outcome.GetResult().GetItem();
-	if(item.empty()) //no match found
+	if(item.empty()){ //no match found
+		cacheNegativeResult(voNotOnClusterCache,negativeKey);
 		return false;
+	}
 	//update cache
 	CacheRecord<std::string> record(wildcard,clusterCacheValidity);
 	clusterVOAccessCache.insert_or_assign(cID,record);
@@ -2194,6 +3278,7 @@ bool PersistentStore::allowVoToUseApplication(std::string voID, std::string cID,
 	//update cache
 	CacheRecord<std::set<std::string>> record(allowed,clusterCacheValidity);
 	clusterVOApplicationCache.insert_or_assign(sortKey,record);
+	publishInvalidation({"applications",cID,{voID}});
 	
 	return true;
 }
@@ -2252,6 +3337,7 @@ bool PersistentStore::denyVOUseOfApplication(std::string voID, std::string cID,
 	//update cache
 	CacheRecord<std::set<std::string>> record(allowed,clusterCacheValidity);
 	clusterVOApplicationCache.insert_or_assign(sortKey,record);
+	publishInvalidation({"applications",cID,{voID}});
 	
 	return true;
 }
@@ -2299,6 +3385,7 @@ bool PersistentStore::addApplicationInstance(const ApplicationInstance& inst){
 		log_error("Failed to add application instance config record: " << err.GetMessage());
 		return false;
 	}
+	rememberInvalidation("instance",inst.id);
 	
 	//update caches
 	CacheRecord<ApplicationInstance> record(inst,instanceCacheValidity);
@@ -2308,32 +3395,16 @@ bool PersistentStore::addApplicationInstance(const ApplicationInstance& inst){
 	instanceByClusterCache.insert_or_assign(inst.cluster,record);
 	instanceByVOAndClusterCache.insert_or_assign(inst.owningVO+":"+inst.cluster,record);
 	instanceConfigCache.insert(inst.id,inst.config,instanceCacheValidity);
+	recordChange(instanceTableName,inst.id);
+	publishInvalidation({"instance",inst.id,{inst.owningVO,inst.cluster,inst.name}});
 	
 	return true;
 }
 
 bool PersistentStore::removeApplicationInstance(const std::string& id){
-	//erase cache entries
-	{
-		//Somewhat hacky: we can't erase the secondary cache entries unless we know 
-		//the keys. However, we keep the caches synchronized, so if there is 
-		//such an entry to delete there is also an entry in the main cache, so 
-		//we can grab that to get the name without having to read from the 
-		//database.
-		CacheRecord<ApplicationInstance> record;
-		bool cached=instanceCache.find(id,record);
-		if(cached){
-			//don't particularly care whether the record is expired; if it is 
-			//all that will happen is that we will delete the equally stale 
-			//record in the other cache
-			instanceByVOCache.erase(record.record.owningVO,record);
-			instanceByNameCache.erase(record.record.name,record);
-			instanceByClusterCache.erase(record.record.cluster,record);
-			instanceByVOAndClusterCache.erase(record.record.owningVO+":"+record.record.cluster,record);
-		}
-		instanceCache.erase(id);
-		instanceConfigCache.erase(id);
-	}
+	//See removeCluster regarding the related keys
+	const ApplicationInstance instance=getApplicationInstance(id);
+	uncacheApplicationInstance(id);
 	
 	using Aws::DynamoDB::Model::AttributeValue;
 	auto outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
@@ -2345,6 +3416,12 @@ bool PersistentStore::removeApplicationInstance(const std::string& id){
 		log_error("Failed to delete instance record: " << err.GetMessage());
 		return false;
 	}
+	//See removeUser regarding loads in progress
+	rememberInvalidation("instance",id);
+	uncacheApplicationInstance(id);
+	//the listing no longer includes the instance, even if its config remains
+	recordChange(instanceTableName,id);
+	publishInvalidation({"instance",id,{instance.owningVO,instance.cluster,instance.name}});
 	outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
 	                                      .WithTableName(instanceTableName)
 	                                      .WithKey({{"ID",AttributeValue(id)},
@@ -2365,10 +3442,16 @@ ApplicationInstance PersistentStore::getApplicationInstance(const std::string& i
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
 				cacheHits++;
+				refreshIfExpiring(record,instanceCacheValidity,instanceFetches,"instance",id,&PersistentStore::loadApplicationInstance);
 				return record;
 			}
 		}
 	}
+	return fetchOnce(instanceFetches,"instance",id,&PersistentStore::loadApplicationInstance);
+}
+
+ApplicationInstance PersistentStore::loadApplicationInstance(const std::string& id){
+	const auto loadStart=std::chrono::steady_clock::now();
 	//need to query the database
 	databaseQueries++;
 	log_info("Querying database for instance " << id);
@@ -2394,6 +3477,10 @@ ApplicationInstance PersistentStore::getApplicationInstance(const std::string& i
 	inst.cluster=findOrThrow(item,"cluster","Instance record missing cluster attribute").GetS();
 	inst.ctime=findOrThrow(item,"ctime","Instance record missing ctime attribute").GetS();
 	
+	//don't cache what another server changed while it was being read
+	if(invalidatedSince("instance",inst.id,loadStart))
+		return inst;
+	
 	//update caches
 	CacheRecord<ApplicationInstance> record(inst,instanceCacheValidity);
 	instanceCache.insert_or_assign(inst.id,record);
@@ -2416,6 +3503,11 @@ std::string PersistentStore::getApplicationInstanceConfig(const std::string& id)
 			}
 		}
 	}
+	return fetchOnce(instanceConfigFetches,"instanceConfig",id,&PersistentStore::loadApplicationInstanceConfig);
+}
+
+std::string PersistentStore::loadApplicationInstanceConfig(const std::string& id){
+	const auto loadStart=std::chrono::steady_clock::now();
 	//need to query the database
 	databaseQueries++;
 	log_info("Querying database for instance " << id << " config");
@@ -2434,6 +3526,10 @@ std::string PersistentStore::getApplicationInstanceConfig(const std::string& id)
 		return std::string{};
 	std::string config= findOrThrow(item,"config","Instance config record missing config attribute").GetS();
 	
+	//don't cache what another server changed while it was being read
+	if(invalidatedSince("instance",id,loadStart))
+		return config;
+	
 	//update cache
 	CacheRecord<std::string> record(config,instanceCacheValidity);
 	instanceConfigCache.insert_or_assign(id,record);
@@ -2456,53 +3552,62 @@ std::vector<ApplicationInstance> PersistentStore::listApplicationInstances(){
 		return collected;
 	}
 
+	const auto scanStart=std::chrono::steady_clock::now();
 	databaseScans++;
 	Aws::DynamoDB::Model::ScanRequest request;
 	request.SetTableName(instanceTableName);
 	request.SetFilterExpression("attribute_exists(ctime)");
-	bool keepGoing=false;
-	
-	do{
-		auto outcome=dbClient.Scan(request);
-		if(!outcome.IsSuccess()){
-			//TODO: more principled logging or reporting of the nature of the error
-			auto err=outcome.GetError();
-			log_error("Failed to fetch application instance records: " << err.GetMessage());
-			return collected;
-		}
-		const auto& result=outcome.GetResult();
-		//set up fetching the next page if necessary
-		if(!result.GetLastEvaluatedKey().empty()){
-			keepGoing=true;
-			request.SetExclusiveStartKey(result.GetLastEvaluatedKey());
-		}
-		else
-			keepGoing=false;
-		//collect results from this page
-		for(const auto& item : result.GetItems()){
-			ApplicationInstance inst;
-			inst.valid=true;
-			inst.id=findOrThrow(item,"ID","Instance record missing ID attribute").GetS();
-			inst.name=findOrThrow(item,"name","Instance record missing name attribute").GetS();
-			inst.application=findOrThrow(item,"application","Instance record missing application attribute").GetS();
-			inst.owningVO=findOrThrow(item,"owningVO","Instance record missing ID attribute").GetS();
-			inst.cluster=findOrThrow(item,"cluster","Instance record missing ID attribute").GetS();
-			inst.ctime=findOrThrow(item,"ctime","Instance record missing ID attribute").GetS();
-			collected.push_back(inst);
-
-			CacheRecord<ApplicationInstance> record(inst,instanceCacheValidity);
-			instanceCache.insert_or_assign(inst.id,record);
-			instanceByNameCache.insert_or_assign(inst.name,record);
-			instanceByVOCache.insert_or_assign(inst.owningVO,record);
-			instanceByClusterCache.insert_or_assign(inst.cluster,record);
-			instanceByVOAndClusterCache.insert_or_assign(inst.owningVO+":"+inst.cluster,record);
-		}
-	}while(keepGoing);
-	instanceCacheExpirationTime=std::chrono::steady_clock::now()+instanceCacheValidity;
+	std::vector<std::vector<ApplicationInstance>> segments(scanSegments);
+	bool complete=parallelScan(request,[&](std::size_t segment, const DatabaseItem& item){
+		ApplicationInstance inst=instanceFromItem(item);
+		segments[segment].push_back(inst);
+		if(invalidatedSince("instance",inst.id,scanStart))
+			return;
+		
+		CacheRecord<ApplicationInstance> record(inst,instanceCacheValidity);
+		instanceCache.insert_or_assign(inst.id,record);
+		instanceByNameCache.insert_or_assign(inst.name,record);
+		instanceByVOCache.insert_or_assign(inst.owningVO,record);
+		instanceByClusterCache.insert_or_assign(inst.cluster,record);
+		instanceByVOAndClusterCache.insert_or_assign(inst.owningVO+":"+inst.cluster,record);
+	});
+	for(auto& segment : segments)
+		std::move(segment.begin(),segment.end(),std::back_inserter(collected));
+	//a listing which may be missing changes announced during the scan must 
+	//not be served from the cache
+	if(!complete || lastInvalidation.load()>=scanStart)
+		return collected;
+	instanceCacheExpirationTime=listingExpiration(instanceCacheValidity);
 	
 	return collected;
 }
 
+ListPage<ApplicationInstance> PersistentStore::listApplicationInstancesPage(std::size_t limit, const std::string& cursor){
+	ListPage<ApplicationInstance> page;
+	Aws::DynamoDB::Model::ScanRequest request;
+	request.SetTableName(instanceTableName);
+	request.SetFilterExpression("attribute_exists(ctime)");
+	const auto scanStart=std::chrono::steady_clock::now();
+	std::vector<DatabaseItem> items;
+	page.status=scanPage(request,limit,cursor,items,page.nextCursor);
+	if(page.status!=PageStatus::Fetched)
+		return page;
+	for(const auto& item : items){
+		ApplicationInstance inst=instanceFromItem(item);
+		page.items.push_back(inst);
+		if(invalidatedSince("instance",inst.id,scanStart))
+			continue;
+		
+		CacheRecord<ApplicationInstance> record(inst,instanceCacheValidity);
+		instanceCache.insert_or_assign(inst.id,record);
+		instanceByNameCache.insert_or_assign(inst.name,record);
+		instanceByVOCache.insert_or_assign(inst.owningVO,record);
+		instanceByClusterCache.insert_or_assign(inst.cluster,record);
+		instanceByVOAndClusterCache.insert_or_assign(inst.owningVO+":"+inst.cluster,record);
+	}
+	return page;
+}
+
 std::vector<ApplicationInstance> PersistentStore::listApplicationInstancesByClusterOrVO(std::string vo, std::string cluster){
 	std::vector<ApplicationInstance> instances;
 	
@@ -2518,7 +3623,7 @@ std::vector<ApplicationInstance> PersistentStore::listApplicationInstancesByClus
 		CacheRecord<ApplicationInstance> record;
 		auto cached = instanceByVOAndClusterCache.find(vo+":"+cluster);
 		if(cached.second > std::chrono::steady_clock::now()){
-			auto records = cached.first;
+			const auto& records = *cached.first;
 			cacheHits+=records.size();
 			return std::vector<ApplicationInstance>(records.begin(),records.end());
 		}
@@ -2526,7 +3631,7 @@ std::vector<ApplicationInstance> PersistentStore::listApplicationInstancesByClus
 		CacheRecord<ApplicationInstance> record;
 		auto cached = instanceByVOCache.find(vo);
 		if(cached.second > std::chrono::steady_clock::now()){
-			auto records = cached.first;
+			const auto& records = *cached.first;
 			cacheHits+=records.size();
 			return std::vector<ApplicationInstance>(records.begin(),records.end());
 		}
@@ -2534,7 +3639,7 @@ std::vector<ApplicationInstance> PersistentStore::listApplicationInstancesByClus
 		CacheRecord<ApplicationInstance> record;
 		auto cached = instanceByClusterCache.find(cluster);
 		if(cached.second > std::chrono::steady_clock::now()){
-			auto records = cached.first;
+			const auto& records = *cached.first;
 			cacheHits+=records.size();
 			return std::vector<ApplicationInstance>(records.begin(),records.end());
 		}
@@ -2546,7 +3651,7 @@ std::vector<ApplicationInstance> PersistentStore::listApplicationInstancesByClus
 	Aws::DynamoDB::Model::QueryOutcome outcome;
 
 	if (!vo.empty() && !cluster.empty()) {
-		outcome=dbClient.Query(Aws::DynamoDB::Model::QueryRequest()
+		outcome=queryAllPages(Aws::DynamoDB::Model::QueryRequest()
 				       .WithTableName(instanceTableName)
 				       .WithIndexName("ByVO")
 				       .WithKeyConditionExpression("owningVO = :vo_val")
@@ -2555,14 +3660,14 @@ std::vector<ApplicationInstance> PersistentStore::listApplicationInstancesByClus
 				       .WithExpressionAttributeValues({{":vo_val", AV(vo)}, {":cluster_val", AV(cluster)}})
 				       );
 	} else if (!vo.empty()) {
-		outcome=dbClient.Query(Aws::DynamoDB::Model::QueryRequest()
+		outcome=queryAllPages(Aws::DynamoDB::Model::QueryRequest()
 				       .WithTableName(instanceTableName)
 				       .WithIndexName("ByVO")
 				       .WithKeyConditionExpression("owningVO = :vo_val")
 				       .WithExpressionAttributeValues({{":vo_val", AV(vo)}})
 				       );
 	} else if (!cluster.empty()) {
-		outcome=dbClient.Query(Aws::DynamoDB::Model::QueryRequest()
+		outcome=queryAllPages(Aws::DynamoDB::Model::QueryRequest()
 				       .WithTableName(instanceTableName)
 				       .WithIndexName("ByCluster")
 				       .WithKeyConditionExpression("#cluster = :cluster_val")
@@ -2619,7 +3724,7 @@ std::vector<ApplicationInstance> PersistentStore::findInstancesByName(const std:
 	using AV=Aws::DynamoDB::Model::AttributeValue;
 	databaseQueries++;
 	log_info("Querying database for instance with name " << name);
-	auto outcome=dbClient.Query(Aws::DynamoDB::Model::QueryRequest()
+	auto outcome=queryAllPages(Aws::DynamoDB::Model::QueryRequest()
 	                            .WithTableName(instanceTableName)
 	                            .WithIndexName("ByName")
 	                            .WithKeyConditionExpression("#name = :name_val")
@@ -2711,35 +3816,22 @@ bool PersistentStore::addSecret(const Secret& secret){
 		log_error("Failed to add secret record: " << err.GetMessage());
 		return false;
 	}
+	rememberInvalidation("secret",secret.id);
 	
 	//update caches
 	CacheRecord<Secret> record(secret,secretCacheValidity);
 	secretCache.insert_or_assign(secret.id,record);
 	secretByVOCache.insert_or_assign(secret.vo,record);
 	secretByVOAndClusterCache.insert_or_assign(secret.vo+":"+secret.cluster,record);
+	publishInvalidation({"secret",secret.id,{secret.vo,secret.cluster}});
 	
 	return true;
 }
 
 bool PersistentStore::removeSecret(const std::string& id){
-	//erase cache entries
-	{
-		//Somewhat hacky: we can't erase the secondary cache entries unless we know 
-		//the keys. However, we keep the caches synchronized, so if there is 
-		//such an entry to delete there is also an entry in the main cache, so 
-		//we can grab that to get the name without having to read from the 
-		//database.
-		CacheRecord<Secret> record;
-		bool cached=secretCache.find(id,record);
-		if(cached){
-			//don't particularly care whether the record is expired; if it is 
-			//all that will happen is that we will delete the equally stale 
-			//record in the other cache
-			secretByVOCache.erase(record.record.vo,record);
-			secretByVOAndClusterCache.erase(record.record.vo+":"+record.record.cluster);
-		}
-		secretCache.erase(id);
-	}
+	//See removeCluster regarding the related keys
+	const Secret secret=getSecret(id);
+	uncacheSecret(id);
 	
 	using Aws::DynamoDB::Model::AttributeValue;
 	auto outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
@@ -2751,6 +3843,10 @@ bool PersistentStore::removeSecret(const std::string& id){
 		log_error("Failed to delete secret record: " << err.GetMessage());
 		return false;
 	}
+	//See removeUser regarding loads in progress
+	rememberInvalidation("secret",id);
+	uncacheSecret(id);
+	publishInvalidation({"secret",id,{secret.vo,secret.cluster}});
 	
 	return true;
 }
@@ -2764,10 +3860,16 @@ Secret PersistentStore::getSecret(const std::string& id){
 			log_info("Found record of " << id << " in cache");
 			if(record){ //it is, just return it
 				cacheHits++;
+				refreshIfExpiring(record,secretCacheValidity,secretFetches,"secret",id,&PersistentStore::loadSecret);
 				return record;
 			}
 		}
 	}
+	return fetchOnce(secretFetches,"secret",id,&PersistentStore::loadSecret);
+}
+
+Secret PersistentStore::loadSecret(const std::string& id){
+	const auto loadStart=std::chrono::steady_clock::now();
 	//need to query the database
 	databaseQueries++;
 	log_info("Querying database for secret " << id);
@@ -2794,6 +3896,10 @@ Secret PersistentStore::getSecret(const std::string& id){
 	const auto& secret_data=findOrThrow(item,"contents","Secret record missing contents attribute").GetB();
 	secret.data=std::string((const std::string::value_type*)secret_data.GetUnderlyingData(),secret_data.GetLength());
 	
+	//don't cache what another server changed while it was being read
+	if(invalidatedSince("secret",secret.id,loadStart))
+		return secret;
+	
 	//update caches
 	CacheRecord<Secret> record(secret,secretCacheValidity);
 	secretCache.insert_or_assign(secret.id,record);
@@ -2820,7 +3926,7 @@ std::vector<Secret> PersistentStore::listSecrets(std::string vo, std::string clu
 		CacheRecord<ApplicationInstance> record;
 		auto cached = secretByVOAndClusterCache.find(vo+":"+cluster);
 		if(cached.second > std::chrono::steady_clock::now()){
-			auto records = cached.first;
+			const auto& records = *cached.first;
 			cacheHits+=records.size();
 			return std::vector<Secret>(records.begin(),records.end());
 		}
@@ -2828,7 +3934,7 @@ std::vector<Secret> PersistentStore::listSecrets(std::string vo, std::string clu
 		CacheRecord<ApplicationInstance> record;
 		auto cached = secretByVOCache.find(vo);
 		if(cached.second > std::chrono::steady_clock::now()){
-			auto records = cached.first;
+			const auto& records = *cached.first;
 			cacheHits+=records.size();
 			return std::vector<Secret>(records.begin(),records.end());
 		}
@@ -2853,10 +3959,10 @@ std::vector<Secret> PersistentStore::listSecrets(std::string vo, std::string clu
 			query.AddExpressionAttributeValues(":cluster_val", AV(cluster));
 		}
 		
-		outcome=dbClient.Query(query);
+		outcome=queryAllPages(query);
 	}
 	else if (!cluster.empty()) {
-		outcome=dbClient.Query(Aws::DynamoDB::Model::QueryRequest()
+		outcome=queryAllPages(Aws::DynamoDB::Model::QueryRequest()
 							   .WithTableName(secretTableName)
 							   .WithIndexName("ByCluster")
 							   .WithKeyConditionExpression("#cluster = :cluster_val")
@@ -2913,6 +4019,13 @@ Secret PersistentStore::findSecretByName(std::string vo, std::string cluster, st
 std::string PersistentStore::getStatistics() const{
 	std::ostringstream os;
 	os << "Cache hits: " << cacheHits.load() << "\n";
+	os << "Negative cache hits: " << negativeCacheHits.load() << "\n";
+	os << "Cache refreshes: " << cacheRefreshes.load() << "\n";
+	os << "Cache refreshes dropped: " << cacheRefreshesDropped.load() << "\n";
+	os << "Coalesced database fetches: " 
+	   << (userFetches.coalescedCount()+voFetches.coalescedCount()
+	       +clusterFetches.coalescedCount()+instanceFetches.coalescedCount()
+	       +instanceConfigFetches.coalescedCount()+secretFetches.coalescedCount()) << "\n";
 	os << "Database queries: " << databaseQueries.load() << "\n";
 	os << "Database scans: " << databaseScans.load() << "\n";
 	return os.str();
@@ -2952,8 +4065,24 @@ bool PersistentStore::normalizeClusterID(std::string& cID){
 	return true;
 }
 
+void PersistentStore::cacheNegativeResult(cuckoohash_map<std::string,CacheRecord<std::string>>& cache,
+                                          const std::string& key){
+	if(cache.size()>=negativeCacheLimit)
+		cache.clear();
+	cache.insert_or_assign(key,CacheRecord<std::string>(key,negativeCacheValidity));
+}
+
 const User authenticateUser(PersistentStore& store, const char* token){
 	if(token==nullptr) //no token => no way of identifying a valid user
 		return User{};
-	return store.findUserByToken(token);
+	TokenIndex::Entry entry=store.authenticateToken(token);
+	if(!entry)
+		return User{};
+	//Authorization needs only the ID and admin flag; anything which needs the 
+	//rest of the record can fetch it with getUser
+	User user;
+	user.valid=true;
+	user.id=entry.userID();
+	user.admin=entry.admin;
+	return user;
 }
@@ -4,12 +4,17 @@
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <condition_variable>
+#include <mutex>
 #include <stdexcept>
 #include <thread>
+#include <typeinfo>
 
 #include <fcntl.h>
 #include <paths.h>
+#include <poll.h>
 #include <signal.h>
+#include <spawn.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 
@@ -31,17 +36,30 @@ void setNonblocking(int fd){
 }
 
 namespace{
-sig_atomic_t reapFlag=0;
+volatile sig_atomic_t reapFlag=0;
+///A pipe written to by the SIGCHLD handler, so that the reaper thread can 
+///sleep until there is actually something to do
+int reapWakeup[2]={-1,-1};
 
-void handleSIGCHLD(int, siginfo_t* info, void* uap){
+void handleSIGCHLD(int, siginfo_t*, void*){
+	int savedErrno=errno;
 	reapFlag=1;
-	//const char msg[]="We get signal!\n";
-	//write(1,msg,sizeof(msg));
+	if(reapWakeup[1]!=-1){
+		//if the pipe is full a wakeup is already pending, so failure is fine
+		ssize_t unused=write(reapWakeup[1],"",1);
+		(void)unused;
+	}
+	errno=savedErrno;
 }
 	
 struct PrepareForSignals{
 	PrepareForSignals(){
+		if(pipe2(reapWakeup, O_CLOEXEC | O_NONBLOCK)){
+			auto err=errno;
+			throw std::runtime_error("reaper wakeup pipe: "+std::to_string(err));
+		}
 		struct sigaction act;
+		sigemptyset(&act.sa_mask);
 		act.sa_flags=SA_RESTART | SA_NOCLDSTOP | SA_SIGINFO;
 		act.sa_sigaction=handleSIGCHLD;
 		int res=sigaction(SIGCHLD, &act, &oact);
@@ -49,17 +67,41 @@ struct PrepareForSignals{
 			auto err=errno;
 			throw std::runtime_error("waitpid sigaction: "+std::to_string(err));
 		}
+		//writing to the stdin of a child which has exited should produce an 
+		//error, not kill this process
+		struct sigaction ignore;
+		sigemptyset(&ignore.sa_mask);
+		ignore.sa_flags=0;
+		ignore.sa_handler=SIG_IGN;
+		sigaction(SIGPIPE, &ignore, &opipe);
 	}
 	~PrepareForSignals(){
 		struct sigaction act;
 		sigaction(SIGCHLD, &oact, &act);
+		sigaction(SIGPIPE, &opipe, &act);
 		//if sigaction failed there's nothing useful to do about it
 	}
-	struct sigaction oact;
+	struct sigaction oact, opipe;
 } signalPrep;
 	
 std::atomic<bool> reaperStop;
 cuckoohash_map<pid_t,char> exitStatuses;
+///Protects notification of waiters when entries are added to exitStatuses
+std::mutex exitMutex;
+///Signaled whenever new entries are added to exitStatuses
+std::condition_variable exitCond;
+///Owner of the background reaping thread, which stops it if it is still
+///running at exit
+struct ReaperThread{
+	std::thread thread;
+	~ReaperThread(){ stopReaper(); }
+} reaper;
+
+///Wake the reaper thread, as if a SIGCHLD had arrived
+void wakeReaper(){
+	ssize_t unused=write(reapWakeup[1],"",1);
+	(void)unused;
+}
 } //anonymous namespace
 
 ProcessIOBuffer::ProcessIOBuffer():
@@ -254,23 +296,36 @@ char ProcessHandle::exitStatus() const{
 	return exitStatuses.find(child);
 }
 
+char ProcessHandle::wait() const{
+	assert(child && "child process must not be detatched");
+	std::unique_lock<std::mutex> lock(exitMutex);
+	exitCond.wait(lock,[this]{ return exitStatuses.contains(child); });
+	return exitStatuses.find(child);
+}
+
+bool ProcessHandle::waitUntil(std::chrono::steady_clock::time_point deadline) const{
+	assert(child && "child process must not be detatched");
+	std::unique_lock<std::mutex> lock(exitMutex);
+	return exitCond.wait_until(lock,deadline,[this]{ return exitStatuses.contains(child); });
+}
+
 void reapProcesses(){
 	if(!reapFlag)
 		return;
+	//clear the flag before reaping, so that a child which exits while we are 
+	//working will not be missed
+	reapFlag=0;
 	int stat;
 	pid_t p;
+	bool reaped=false;
 	while(true){
 		p=waitpid(-1,&stat,WNOHANG);
-		if(!p){ //great, done
-			reapFlag=0;
-			return;
-		}
+		if(!p) //great, done
+			break;
 		if(p==-1){
 			auto err=errno;
-			if(err==ECHILD){ //great, done
-				reapFlag=0;
-				return;
-			}
+			if(err==ECHILD) //great, done
+				break;
 			if(err==EINTR)
 				continue;
 			else
@@ -281,33 +336,193 @@ void reapProcesses(){
 				exitStatuses.insert(p,WEXITSTATUS(stat));
 			else //on termination by a signal or similar treat status as -1
 				exitStatuses.insert(p,-1);
+			reaped=true;
 		}
 	}
+	if(reaped){
+		//take the lock so that no waiter can miss this notification between 
+		//checking for its child and going to sleep
+		{ std::lock_guard<std::mutex> lock(exitMutex); }
+		exitCond.notify_all();
+	}
 }
 
 void startReaper(){
+	if(reaper.thread.joinable()) //already running
+		return;
 	reaperStop.store(false);
-	std::thread reaper([](){
+	reaper.thread=std::thread([](){
+		//children may have exited before we started
+		reapFlag=1;
+		reapProcesses();
+		pollfd wakeup;
+		wakeup.fd=reapWakeup[0];
+		wakeup.events=POLLIN;
 		while(!reaperStop.load()){
+			int res=poll(&wakeup,1,-1);
+			if(res==-1){
+				auto err=errno;
+				if(err==EINTR)
+					continue;
+				throw std::runtime_error("poll failed: "+std::to_string(err));
+			}
+			//drain the pipe before reaping so that no wakeup is lost
+			char buf[64];
+			while(read(reapWakeup[0],buf,sizeof(buf))>0);
 			reapProcesses();
-			std::this_thread::sleep_for(std::chrono::milliseconds(1));
 		}
-		//set the flag back to its original state to signal stopping
-		reaperStop.store(false);
 	});
-	reaper.detach();
 }
 
 void stopReaper(){
 	reaperStop.store(true);
-	//wait for background thread to signal that it has indeed stopped
-	while(!reaperStop.load()){
-		std::this_thread::sleep_for(std::chrono::milliseconds(500));
-	}
+	wakeReaper();
+	//wait for background thread to stop
+	if(reaper.thread.joinable())
+		reaper.thread.join();
 }
 
 extern char **environ;
 
+namespace{
+///A complete environment for a child process, in the form expected by execve
+struct EnvironmentBlock{
+	std::vector<std::string> entries;
+	std::vector<char*> pointers;
+};
+
+///Environments which have already been built, keyed by the serialized set of 
+///overrides from which they were constructed. The server only ever uses a 
+///small number of distinct overrides (e.g. one KUBECONFIG per cluster). 
+cuckoohash_map<std::string,std::shared_ptr<const EnvironmentBlock>> environmentCache;
+const std::size_t environmentCacheLimit=256;
+
+///Get the environment for a child process, consisting of this process's 
+///environment with the given variables added or replaced.
+std::shared_ptr<const EnvironmentBlock> getEnvironment(const std::map<std::string,std::string>& env){
+	std::string key;
+	for(const auto& entry : env){
+		key+=entry.first;
+		key+='=';
+		key+=entry.second;
+		key+='\0';
+	}
+	std::shared_ptr<const EnvironmentBlock> block;
+	if(environmentCache.find(key,block))
+		return block;
+	
+	std::shared_ptr<EnvironmentBlock> newBlock=std::make_shared<EnvironmentBlock>();
+	for(char** ptr=environ; *ptr; ptr++){
+		const char* eq=strchr(*ptr,'=');
+		std::string var(*ptr,eq?eq-*ptr:strlen(*ptr));
+		//variables which also appear in env will be replaced
+		if(!env.count(var))
+			newBlock->entries.emplace_back(*ptr);
+	}
+	for(const auto& entry : env)
+		newBlock->entries.push_back(entry.first+'='+entry.second);
+	newBlock->pointers.reserve(newBlock->entries.size()+1);
+	for(auto& entry : newBlock->entries)
+		newBlock->pointers.push_back(&entry[0]);
+	newBlock->pointers.push_back(nullptr);
+	
+	if(environmentCache.size()>=environmentCacheLimit)
+		environmentCache.clear();
+	environmentCache.insert(key,newBlock);
+	return newBlock;
+}
+
+///Full paths of executables which have been located via $PATH, keyed by the
+///search path and the executable name
+cuckoohash_map<std::string,std::string> executableCache;
+
+bool isExecutableFile(const std::string& path){
+	struct stat info;
+	if(stat(path.c_str(),&info))
+		return false;
+	return S_ISREG(info.st_mode) && (info.st_mode & (S_IXUSR|S_IXGRP|S_IXOTH));
+}
+
+///Find the full path to an executable.
+///\param exe the name of or path to the executable. If it contains a slash it 
+///           is used directly, otherwise $PATH is searched. 
+///\param useCache whether a previously found location may be used
+std::string resolveExecutable(const std::string& exe, bool useCache=true){
+	if(exe.find('/')!=std::string::npos){
+		//exe contains a slash, so we assume it a usable path. 
+		//Check that the file exists.
+		struct stat info;
+		int err=stat(exe.c_str(),&info);
+		if(err){
+			err=errno;
+			throw std::runtime_error("Cannot stat "+exe+": Error "+std::to_string(err));
+		}
+		return exe;
+	}
+	//no slash; search through the path
+	std::string defPath=_PATH_DEFPATH;
+	fetchFromEnvironment("PATH",defPath);
+	const std::string key=defPath+'\0'+exe;
+	std::string result;
+	if(useCache && executableCache.find(key,result))
+		return result;
+	std::size_t idx=0, next;
+	while(true){
+		next=defPath.find(':',idx);
+		std::string dir=defPath.substr(idx,next==std::string::npos?next:next-idx);
+		std::string posExe=dir+'/'+exe;
+		if(isExecutableFile(posExe)){
+			executableCache.insert_or_assign(key,posExe);
+			return posExe;
+		}
+		if(next==std::string::npos)
+			throw std::runtime_error("Unable to locate "+exe+" in default path ("+defPath+')');
+		idx=next+1;
+	}
+}
+
+///Start a child process using posix_spawn, which avoids copying this 
+///process's page tables, unlike fork. 
+///\return the child PID, or -1 on failure with errno set
+pid_t spawnChild(const std::string& exe, char* const* args, char* const* env, 
+                 bool detachable, const int* inpipe, const int* outpipe, const int* errpipe){
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attributes;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawnattr_init(&attributes);
+	if(detachable){
+		posix_spawn_file_actions_addopen(&actions,0,"/dev/null",O_RDWR,0);
+		posix_spawn_file_actions_adddup2(&actions,0,1);
+		posix_spawn_file_actions_adddup2(&actions,0,2);
+	}
+	else{
+		posix_spawn_file_actions_adddup2(&actions,inpipe[0],0);
+		posix_spawn_file_actions_adddup2(&actions,outpipe[1],1);
+		posix_spawn_file_actions_adddup2(&actions,errpipe[1],2);
+	}
+#if defined(__GLIBC__) && (__GLIBC__>2 || (__GLIBC__==2 && __GLIBC_MINOR__>=34))
+	//close all other fds which were not already marked close-on-exec
+	posix_spawn_file_actions_addclosefrom_np(&actions,3);
+#endif
+	//ignored signals stay ignored across exec, so restore the default
+	sigset_t defaultSignals;
+	sigemptyset(&defaultSignals);
+	sigaddset(&defaultSignals,SIGPIPE);
+	posix_spawnattr_setsigdefault(&attributes,&defaultSignals);
+	posix_spawnattr_setflags(&attributes,POSIX_SPAWN_SETSIGDEF);
+	
+	pid_t child;
+	int err=posix_spawn(&child,exe.c_str(),&actions,&attributes,args,env);
+	posix_spawn_file_actions_destroy(&actions);
+	posix_spawnattr_destroy(&attributes);
+	if(err){
+		errno=err;
+		return -1;
+	}
+	return child;
+}
+} //anonymous namespace
+
 ProcessHandle startProcessAsync(std::string exe, const std::vector<std::string>& args, 
                                 const std::map<std::string,std::string>& env, 
                                 ForkCallbacks&& callbacks, bool detachable){
@@ -319,134 +534,102 @@ ProcessHandle startProcessAsync(std::string exe, const std::vector<std::string>&
 	rawArgs[args.size()+1]=nullptr;
 	
 	//prepare environment variables
-	std::unique_ptr<char*[]> newEnvData;
-	std::vector<std::unique_ptr<char[]>> newEnvStrings;
+	std::shared_ptr<const EnvironmentBlock> newEnvData;
 	char** newEnv=environ;
 	if(!env.empty()){
-		//figure out how many unique variables there will be
-		std::size_t nVars=0;
-		for(char** ptr=environ; *ptr; ptr++){
-			std::string entry(*ptr);
-			std::string var=entry.substr(0,entry.find('='));
-			//variables which also appear in env will be replaced
-			if(!env.count(var))
-				nVars++;
-		}
-		nVars+=env.size();
-		//allocate space
-		newEnvData.reset(new char*[nVars+1]);
-		newEnvData[nVars]=nullptr;
-		//copy data
-		std::size_t idx=0;
-		for(char** ptr=environ; *ptr; ptr++){
-			std::string entry(*ptr);
-			std::string var=entry.substr(0,entry.find('='));
-			//variables which also appear in env will be replaced
-			if(!env.count(var)){
-				std::size_t len=strlen(*ptr)+1;
-				newEnvStrings.emplace_back(new char[len]);
-				strncpy(newEnvStrings.back().get(), *ptr, len);
-				newEnvData[idx++]=newEnvStrings.back().get();
-			}
-		}
-		for(const auto& entry : env){
-			std::size_t len=entry.first.size()+1+entry.second.size()+1;
-			newEnvStrings.emplace_back(new char[len]);
-			snprintf(newEnvStrings.back().get(),len,"%s=%s",entry.first.c_str(),entry.second.c_str());
-			newEnvData[idx++]=newEnvStrings.back().get();
-		}
-		assert(idx==nVars);
-		newEnv=newEnvData.get();
+		newEnvData=getEnvironment(env);
+		newEnv=const_cast<char**>(newEnvData->pointers.data());
 	}
 	//locate executable
-	if(exe.find('/')==std::string::npos){
-		//no slash; search through the path
-		std::string defPath=_PATH_DEFPATH;
-		fetchFromEnvironment("PATH",defPath);
-		std::size_t idx=0, next;
-		while(true){
-			next=defPath.find(':',idx);
-			std::string dir=defPath.substr(idx,next==std::string::npos?next:next-idx);
-			std::string posExe=dir+'/'+exe;
-			struct stat info;
-			int err=stat(posExe.c_str(),&info);
-			if(!err){
-				exe=posExe;
-				break;
-			}
-			if(next==std::string::npos)
-				throw std::runtime_error("Unable to locate "+exe+" in default path ("+defPath+')');
-			idx=next+1;
-		}
-	}
-	else{
-		//exe contains a slash, so we assume it a usable path. 
-		//Check that the file exists.
-		struct stat info;
-		int err=stat(exe.c_str(),&info);
-		if(err){
-			err=errno;
-			throw std::runtime_error("Cannot stat "+exe+": Error "+std::to_string(err));
-		}
-	}
+	const std::string exeName=exe;
+	exe=resolveExecutable(exeName);
 	//set argv[0] now that we are sure we know what it is
 	rawArgs[0]=exe.c_str();
 	
 	int err;
-	//create communication pipes
+	//create communication pipes, which should not be inherited by any other 
+	//children started concurrently by other threads
 	int inpipe[2];
 	int outpipe[2];
 	int errpipe[2];
 	if(!detachable){
-	err=pipe(inpipe);
+	err=pipe2(inpipe,O_CLOEXEC);
 		if(err){
 			err=errno;
 			throw std::runtime_error("Unable to allocate pipe: Error "+std::to_string(err));
 		}
-		err=pipe(outpipe);
+		err=pipe2(outpipe,O_CLOEXEC);
 		if(err){
 			err=errno;
 			throw std::runtime_error("Unable to allocate pipe: Error "+std::to_string(err));
 		}
-		err=pipe(errpipe);
+		err=pipe2(errpipe,O_CLOEXEC);
 		if(err){
 			err=errno;
 			throw std::runtime_error("Unable to allocate pipe: Error "+std::to_string(err));
 		}
 	}
 	
-	callbacks.beforeFork();
-	pid_t child=fork();
-	if(child<0){ //fork failed
-		auto err=errno;
-		std::cerr << "Failed to start child process: Error " << err << std::endl;
-		return ProcessHandle{};
+	pid_t child;
+	//Custom callbacks may need to run code in the child, which requires a real
+	//fork. Otherwise, use the much cheaper posix_spawn. 
+	if(typeid(callbacks)==typeid(ForkCallbacks)){
+		child=spawnChild(exe,(char *const *)rawArgs.get(),newEnv,detachable,inpipe,outpipe,errpipe);
+		if(child<0 && errno==ENOENT && exe!=exeName){
+			//a cached location may be stale; search again
+			exe=resolveExecutable(exeName,false);
+			rawArgs[0]=exe.c_str();
+			child=spawnChild(exe,(char *const *)rawArgs.get(),newEnv,detachable,inpipe,outpipe,errpipe);
+		}
+		if(child<0){
+			auto err=errno;
+			std::cerr << "Failed to start child process: Error " << err << std::endl;
+			if(!detachable){
+				for(int* p : {inpipe,outpipe,errpipe}){
+					close(p[0]);
+					close(p[1]);
+				}
+			}
+			return ProcessHandle{};
+		}
 	}
-	if(!child){ //if we don't know who the child is, it is us
-		callbacks.inChild();
-		//connect standard fds to pipes
-		if(detachable){
-			int nullfd=open("/dev/null",O_RDWR);
-			dup2(nullfd,0);
-			dup2(nullfd,1);
-			dup2(nullfd,2);
+	else{
+		callbacks.beforeFork();
+		child=fork();
+		if(child<0){ //fork failed
+			auto err=errno;
+			std::cerr << "Failed to start child process: Error " << err << std::endl;
+			return ProcessHandle{};
 		}
-		else{
-			dup2(inpipe[0],0);
-			dup2(outpipe[1],1);
-			dup2(errpipe[1],2);
+		if(!child){ //if we don't know who the child is, it is us
+			callbacks.inChild();
+			//ignored signals stay ignored across exec, so restore the default
+			signal(SIGPIPE,SIG_DFL);
+			//connect standard fds to pipes
+			if(detachable){
+				int nullfd=open("/dev/null",O_RDWR);
+				dup2(nullfd,0);
+				dup2(nullfd,1);
+				dup2(nullfd,2);
+			}
+			else{
+				dup2(inpipe[0],0);
+				dup2(outpipe[1],1);
+				dup2(errpipe[1],2);
+			}
+			//close all other fds
+			for(int i = 3; i<FOPEN_MAX; i++)
+				close(i);
+			//be the child process
+			execve(exe.c_str(),(char *const *)rawArgs.get(),(char *const *)newEnv);
+			int err=errno;
+			//not that this will be any help if we are detatchable
+			fprintf(stderr,"Exec failed: Error %i\n",err);
+			_exit(127);
 		}
-		//close all other fds
-		for(int i = 3; i<FOPEN_MAX; i++)
-			close(i);
-		//be the child process
-		execve(exe.c_str(),(char *const *)rawArgs.get(),(char *const *)newEnv);
-		int err=errno;
-		//not that this will be any help if we are detatchable
-		fprintf(stderr,"Exec failed: Error %i\n",err);
+		//otherwise, we are still the parent
+		callbacks.inParent();
 	}
-	//otherwise, we are still the parent
-	callbacks.inParent();
 	//close ends of pipes we will not use
 	if(!detachable){
 		close(inpipe[0]);
@@ -459,56 +642,126 @@ ProcessHandle startProcessAsync(std::string exe, const std::vector<std::string>&
 
 
 namespace{
-	void collectChildOutput(ProcessHandle& child, commandResult& result){
-		std::unique_ptr<char[]> buf(new char[1024]);
-		char* bufptr=buf.get();
-		//collect stdout
-		//std::cout << "collecting child stdout" << std::endl;
-		std::istream& child_stdout=child.getStdout();
-		while(!child_stdout.eof()){
-			char* ptr=bufptr;
-			child_stdout.read(ptr,1);
-			ptr+=child_stdout.gcount();
-			child_stdout.readsome(ptr,1023);
-			ptr+=child_stdout.gcount();
-			result.output.append(bufptr,ptr-bufptr);
+	///Feed input to a child process while draining its standard output and 
+	///error concurrently, then wait for it to exit. 
+	///\param input data to send to the child's standard input, or null if 
+	///             the child's input should simply be closed. 
+	void collectChildOutput(ProcessHandle& child, commandResult& result,
+	                        const std::string* input, const commandOptions& options){
+		using clock=std::chrono::steady_clock;
+		const bool useDeadline=options.timeout.count()>0;
+		const clock::time_point deadline=clock::now()+options.timeout;
+		const std::string timedOut="Command timed out after "+std::to_string(options.timeout.count())+" ms";
+		const std::size_t bufferSize=65536;
+		std::unique_ptr<char[]> buf(new char[bufferSize]);
+		
+		enum{IN,OUT,ERR};
+		pollfd fds[3];
+		fds[IN].fd=(input && !input->empty())?child.getStdinFD():-1;
+		fds[IN].events=POLLOUT;
+		fds[OUT].fd=child.getStdoutFD();
+		fds[OUT].events=POLLIN;
+		fds[ERR].fd=child.getStderrFD();
+		fds[ERR].events=POLLIN;
+		std::string* sinks[3]={nullptr,&result.output,&result.error};
+		std::size_t inputWritten=0;
+		if(fds[IN].fd==-1)
+			child.endInput();
+		
+		std::string failure;
+		while(fds[IN].fd!=-1 || fds[OUT].fd!=-1 || fds[ERR].fd!=-1){
+			int timeout=-1;
+			if(useDeadline){
+				auto remaining=std::chrono::duration_cast<std::chrono::milliseconds>(deadline-clock::now());
+				if(remaining.count()<=0){
+					failure=timedOut;
+					break;
+				}
+				timeout=remaining.count();
+			}
+			//poll ignores entries with negative fds
+			int res=poll(fds,3,timeout);
+			if(res==-1){
+				int err=errno;
+				if(err==EINTR)
+					continue;
+				throw std::runtime_error("poll failed: "+std::to_string(err));
+			}
+			if(fds[IN].fd!=-1 && fds[IN].revents){
+				ssize_t written=write(fds[IN].fd,input->data()+inputWritten,
+				                      input->size()-inputWritten);
+				if(written>0)
+					inputWritten+=written;
+				else if(written==-1 && errno!=EAGAIN && errno!=EINTR)
+					inputWritten=input->size(); //child will not read any more
+				if(inputWritten==input->size()){
+					child.endInput();
+					fds[IN].fd=-1;
+				}
+			}
+			for(int i : {OUT,ERR}){
+				if(fds[i].fd==-1 || !fds[i].revents)
+					continue;
+				//read as much as is available before polling again
+				while(true){
+					ssize_t amount=read(fds[i].fd,buf.get(),bufferSize);
+					if(amount>0){
+						sinks[i]->append(buf.get(),amount);
+						if(options.outputLimit && 
+						   result.output.size()+result.error.size()>options.outputLimit)
+							break;
+						continue;
+					}
+					if(amount==-1 && (errno==EAGAIN || errno==EINTR))
+						break;
+					fds[i].fd=-1; //EOF or error
+					break;
+				}
+			}
+			if(options.outputLimit && 
+			   result.output.size()+result.error.size()>options.outputLimit){
+				failure="Command output exceeded "+std::to_string(options.outputLimit)+" bytes";
+				break;
+			}
 		}
-		//collect stderr
-		//std::cout << "collecting child stderr" << std::endl;
-		std::istream& child_stderr=child.getStderr();
-		while(!child_stderr.eof()){
-			char* ptr=bufptr;
-			child_stderr.read(ptr,1);
-			ptr+=child_stderr.gcount();
-			child_stderr.readsome(ptr,1023);
-			ptr+=child_stderr.gcount();
-			result.error.append(bufptr,ptr-bufptr);
+		if(failure.empty()){
+			//the child may keep running after closing its output
+			if(!useDeadline){
+				result.status=child.wait();
+				return;
+			}
+			if(child.waitUntil(deadline)){
+				result.status=child.exitStatus();
+				return;
+			}
+			failure=timedOut;
 		}
-		//std::cout << "waiting for child exit" << std::endl;
-		while(!child.done())
-			std::this_thread::sleep_for(std::chrono::milliseconds(1));
-		result.status=child.exitStatus();
+		::kill(child.getPid(),SIGKILL);
+		child.wait();
+		result.status=-1;
+		if(!result.error.empty() && result.error.back()!='\n')
+			result.error+='\n';
+		result.error+=failure;
 	}
 }
 
 commandResult runCommand(const std::string& command, 
                          const std::vector<std::string>& args,
-                         const std::map<std::string,std::string>& env){
+                         const std::map<std::string,std::string>& env,
+                         const commandOptions& options){
 	commandResult result;
 	ProcessHandle child=startProcessAsync(command,args,env);
-	collectChildOutput(child,result);
+	collectChildOutput(child,result,nullptr,options);
 	return result;
 }
 
 commandResult runCommandWithInput(const std::string& command, 
                                   const std::string& input,
                                   const std::vector<std::string>& args,
-                                  const std::map<std::string,std::string>& env){
+                                  const std::map<std::string,std::string>& env,
+                                  const commandOptions& options){
 	commandResult result;
 	ProcessHandle child=startProcessAsync(command,args,env);
-	child.getStdin() << input;
-	child.getStdin().flush();
-	child.endInput();
-	collectChildOutput(child,result);
+	collectChildOutput(child,result,&input,options);
 	return result;
-}
\ No newline at end of file
+}
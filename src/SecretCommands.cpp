@@ -97,29 +97,37 @@ crow::response listSecrets(PersistentStore& store, const crow::request& req){
 	
 	std::vector<Secret> secrets=store.listSecrets(vo.id,cluster);
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
-	
-	result.AddMember("apiVersion", "v1alpha1", alloc);
-	rapidjson::Value resultItems(rapidjson::kArrayType);
-	resultItems.Reserve(secrets.size(), alloc);
-	
-	for(const Secret& secret : secrets){
-		rapidjson::Value secretResult(rapidjson::kObjectType);
-		secretResult.AddMember("apiVersion", "v1alpha1", alloc);
-		secretResult.AddMember("kind", "Secret", alloc);
-		rapidjson::Value secretData(rapidjson::kObjectType);
-		secretData.AddMember("id", secret.id, alloc);
-		secretData.AddMember("name", secret.name, alloc);
-		secretData.AddMember("vo", store.getVO(secret.vo).name, alloc);
-		secretData.AddMember("cluster", store.getCluster(secret.cluster).name, alloc);
-		secretData.AddMember("created", secret.ctime, alloc);
-		secretResult.AddMember("metadata", secretData, alloc);
-		resultItems.PushBack(secretResult, alloc);
-	}
-	result.AddMember("items", resultItems, alloc);
-	
-	return crow::response(to_string(result));
+	//all of the secrets belong to the same VO, but may be spread over many 
+	//clusters, whose names are resolved together
+	std::vector<std::string> clusterIDs;
+	clusterIDs.reserve(secrets.size());
+	for(const Secret& secret : secrets)
+		clusterIDs.push_back(secret.cluster);
+	auto clusterNames=std::make_shared<std::unordered_map<std::string,std::string>>(store.getClusterNames(clusterIDs));
+	const std::string voName=vo.name;
+	
+	return streamJSONList(std::move(secrets),"",
+	  [voName,clusterNames](JSONWriter& writer, const Secret& secret){
+		writer.StartObject();
+		writer.Key("apiVersion");
+		writer.String("v1alpha1");
+		writer.Key("kind");
+		writer.String("Secret");
+		writer.Key("metadata");
+		writer.StartObject();
+		writer.Key("id");
+		writer.String(secret.id);
+		writer.Key("name");
+		writer.String(secret.name);
+		writer.Key("vo");
+		writer.String(voName);
+		writer.Key("cluster");
+		writer.String((*clusterNames)[secret.cluster]);
+		writer.Key("created");
+		writer.String(secret.ctime);
+		writer.EndObject();
+		writer.EndObject();
+	});
 }
 
 crow::response createSecret(PersistentStore& store, const crow::request& req){
@@ -0,0 +1,227 @@
+#include "TokenIndex.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+extern "C"{
+	#include <scrypt/alg/sha256.h>
+}
+
+namespace{
+
+void toWords(const TokenIndex::Digest& digest, uint64_t* words){
+	std::memcpy(words,digest.data(),digest.size());
+}
+
+}
+
+TokenIndex::TokenIndex():table(new Table(16)),epoch(0),used(0),live(0){
+	readers[0].store(0);
+	readers[1].store(0);
+	current.store(table.get());
+}
+
+TokenIndex::Digest TokenIndex::digest(const char* token, std::size_t length){
+	Digest result;
+	SHA256_Buf(token,length,result.data());
+	return result;
+}
+
+TokenIndex::Entry::Entry(const std::string& userID, bool admin, 
+                         std::chrono::steady_clock::time_point expirationTime):
+admin(admin),expirationTime(expirationTime),userIDLength(userID.size()){
+	if(userID.size()>maxUserIDLength)
+		throw std::length_error("User ID "+userID+" is too long to be indexed");
+	std::memcpy(userIDData,userID.data(),userID.size());
+}
+
+TokenIndex::Entry TokenIndex::find(const Digest& digest) const{
+	uint64_t words[4];
+	toWords(digest,words);
+	//announce this lookup in the current epoch, so that a writer which 
+	//replaces the table waits for it before freeing the old one
+	uint32_t readEpoch;
+	while(true){
+		readEpoch=epoch.load();
+		readers[readEpoch&1].fetch_add(1);
+		if(epoch.load()==readEpoch)
+			break;
+		readers[readEpoch&1].fetch_sub(1);
+	}
+	struct ReadGuard{
+		std::atomic<uint32_t>& count;
+		~ReadGuard(){ count.fetch_sub(1,std::memory_order_release); }
+	} guard{readers[readEpoch&1]};
+	const Table* table=current.load();
+	const std::size_t mask=table->capacity-1;
+	std::size_t pos=words[0]&mask;
+	for(std::size_t i=0; i<table->capacity; i++, pos=(pos+1)&mask){
+		const Slot& slot=table->slots[pos];
+		uint32_t state;
+		bool match;
+		Entry entry;
+		std::chrono::steady_clock::rep expiration=0;
+		uint64_t userID[userIDWords];
+		uint32_t userIDLength=0;
+		while(true){
+			uint32_t version=slot.version.load(std::memory_order_acquire);
+			if(version&1) //a write is in progress
+				continue;
+			state=slot.state.load(std::memory_order_relaxed);
+			match=true;
+			for(unsigned int j=0; j<4; j++)
+				match&=(slot.digest[j].load(std::memory_order_relaxed)==words[j]);
+			if(state==full && match){
+				userIDLength=slot.userIDLength.load(std::memory_order_relaxed);
+				for(unsigned int j=0; j<userIDWords; j++)
+					userID[j]=slot.userID[j].load(std::memory_order_relaxed);
+				entry.admin=slot.admin.load(std::memory_order_relaxed);
+				expiration=slot.expiration.load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(slot.version.load(std::memory_order_relaxed)==version)
+				break;
+		}
+		if(state==empty) //the end of the probe sequence
+			break;
+		if(state!=full || !match)
+			continue;
+		std::memcpy(entry.userIDData,userID,userIDLength);
+		entry.userIDLength=userIDLength;
+		entry.expirationTime=std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(expiration));
+		if(std::chrono::steady_clock::now()>entry.expirationTime)
+			break;
+		return entry;
+	}
+	return Entry();
+}
+
+TokenIndex::Entry TokenIndex::insert(const Digest& digest, const std::string& userID, bool admin,
+                                     std::chrono::steady_clock::time_point expirationTime){
+	const Entry entry(userID,admin,expirationTime);
+	uint64_t words[4];
+	toWords(digest,words);
+	uint64_t idWords[userIDWords]={};
+	std::memcpy(idWords,userID.data(),userID.size());
+	const auto expiration=expirationTime.time_since_epoch().count();
+	std::lock_guard<std::mutex> lock(writeMutex);
+	std::size_t pos=probe(*table,words,false);
+	if(pos!=table->capacity){ //replace the existing entry
+		writeSlot(table->slots[pos],full,words,idWords,userID.size(),admin,expiration);
+		return entry;
+	}
+	//keep at least half of the slots empty, so that probe sequences stay short
+	if(2*(used+1)>table->capacity)
+		rebuild();
+	pos=probe(*table,words,true);
+	if(table->slots[pos].state.load(std::memory_order_relaxed)==empty)
+		used++;
+	live++;
+	writeSlot(table->slots[pos],full,words,idWords,userID.size(),admin,expiration);
+	return entry;
+}
+
+void TokenIndex::erase(const Digest& digest){
+	uint64_t words[4];
+	toWords(digest,words);
+	std::lock_guard<std::mutex> lock(writeMutex);
+	std::size_t pos=probe(*table,words,false);
+	if(pos==table->capacity)
+		return;
+	//the slot must stay occupied so that probe sequences which pass through
+	//it continue to the entries beyond it
+	const uint64_t noUserID[userIDWords]={};
+	writeSlot(table->slots[pos],removed,words,noUserID,0,false,0);
+	live--;
+}
+
+void TokenIndex::writeSlot(Slot& slot, uint32_t state, const uint64_t* words,
+                           const uint64_t* userID, uint32_t userIDLength, bool admin,
+                           std::chrono::steady_clock::rep expiration){
+	uint32_t version=slot.version.load(std::memory_order_relaxed);
+	slot.version.store(version+1,std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.state.store(state,std::memory_order_relaxed);
+	for(unsigned int j=0; j<4; j++)
+		slot.digest[j].store(words[j],std::memory_order_relaxed);
+	for(unsigned int j=0; j<userIDWords; j++)
+		slot.userID[j].store(userID[j],std::memory_order_relaxed);
+	slot.userIDLength.store(userIDLength,std::memory_order_relaxed);
+	slot.admin.store(admin,std::memory_order_relaxed);
+	slot.expiration.store(expiration,std::memory_order_relaxed);
+	slot.version.store(version+2,std::memory_order_release);
+}
+
+std::size_t TokenIndex::probe(const Table& table, const uint64_t* words, bool forInsertion){
+	const std::size_t mask=table.capacity-1;
+	std::size_t pos=words[0]&mask;
+	for(std::size_t i=0; i<table.capacity; i++, pos=(pos+1)&mask){
+		const Slot& slot=table.slots[pos];
+		uint32_t state=slot.state.load(std::memory_order_relaxed);
+		if(forInsertion){
+			if(state!=full)
+				return pos;
+			continue;
+		}
+		if(state==empty)
+			break;
+		if(state!=full)
+			continue;
+		bool match=true;
+		for(unsigned int j=0; j<4; j++)
+			match&=(slot.digest[j].load(std::memory_order_relaxed)==words[j]);
+		if(match)
+			return pos;
+	}
+	return table.capacity;
+}
+
+void TokenIndex::rebuild(){
+	const auto now=std::chrono::steady_clock::now().time_since_epoch().count();
+	auto keep=[now](const Slot& slot){
+		return slot.state.load(std::memory_order_relaxed)==full 
+		       && slot.expiration.load(std::memory_order_relaxed)>=now;
+	};
+	live=0;
+	for(std::size_t i=0; i<table->capacity; i++){
+		if(keep(table->slots[i]))
+			live++;
+	}
+	std::size_t capacity=16;
+	while(capacity<4*(live+1))
+		capacity*=2;
+	std::unique_ptr<Table> replacement(new Table(capacity));
+	for(std::size_t i=0; i<table->capacity; i++){
+		const Slot& slot=table->slots[i];
+		if(!keep(slot))
+			continue;
+		uint64_t words[4], userID[userIDWords];
+		for(unsigned int j=0; j<4; j++)
+			words[j]=slot.digest[j].load(std::memory_order_relaxed);
+		for(unsigned int j=0; j<userIDWords; j++)
+			userID[j]=slot.userID[j].load(std::memory_order_relaxed);
+		std::size_t pos=probe(*replacement,words,true);
+		writeSlot(replacement->slots[pos],full,words,userID,
+		          slot.userIDLength.load(std::memory_order_relaxed),
+		          slot.admin.load(std::memory_order_relaxed),
+		          slot.expiration.load(std::memory_order_relaxed));
+	}
+	used=live;
+	std::swap(table,replacement);
+	current.store(table.get());
+	waitForReaders();
+	//replacement now holds the old table, which no lookup can reach
+}
+
+void TokenIndex::waitForReaders(){
+	//Lookups which begin after the epoch changes see the new table. Those 
+	//which began before are counted under the old epoch's parity. Lookups 
+	//from two epochs ago share that count, but were waited for at the 
+	//previous change, so any which appear there now are about to retry in 
+	//the new epoch without reading a table.
+	const uint32_t oldEpoch=epoch.load();
+	epoch.store(oldEpoch+1);
+	while(readers[oldEpoch&1].load()!=0)
+		std::this_thread::yield();
+}
@@ -10,32 +10,44 @@ crow::response listUsers(PersistentStore& store, const crow::request& req){
 		return crow::response(403,generateError("Not authorized"));
 	//TODO: Are all users are allowed to list all users?
 
+	bool paged;
+	std::size_t limit;
+	std::string cursor, nextCursor;
+	if(!getPageParameters(req,paged,limit,cursor))
+		return crow::response(400,generateError("Invalid page limit"));
+
 	std::vector<User> users;
 	if (auto vo = req.url_params.get("vo"))
 		users = store.listUsersByVO(vo);
+	else if(paged){
+		ListPage<User> page=store.listUsersPage(limit,cursor);
+		if(page.status==PageStatus::InvalidCursor)
+			return crow::response(400,generateError("Invalid cursor"));
+		if(page.status!=PageStatus::Fetched)
+			return crow::response(500,generateError("Failed to list users"));
+		users=std::move(page.items);
+		nextCursor=std::move(page.nextCursor);
+	}
 	else
 		users = store.listUsers();
 
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
-	
-	result.AddMember("apiVersion", "v1alpha1", alloc);
-	rapidjson::Value resultItems(rapidjson::kArrayType);
-	resultItems.Reserve(users.size(), alloc);
-	for(const User& user : users){
-		rapidjson::Value userResult(rapidjson::kObjectType);
-		userResult.AddMember("apiVersion", "v1alpha1", alloc);
-		userResult.AddMember("kind", "User", alloc);
-		rapidjson::Value userData(rapidjson::kObjectType);
-		userData.AddMember("id", rapidjson::StringRef(user.id.c_str()), alloc);
-		userData.AddMember("name", rapidjson::StringRef(user.name.c_str()), alloc);
-		userData.AddMember("email", rapidjson::StringRef(user.email.c_str()), alloc);
-		userResult.AddMember("metadata", userData, alloc);
-		resultItems.PushBack(userResult, alloc);
-	}
-	result.AddMember("items", resultItems, alloc);
-	
-	return crow::response(to_string(result));
+	return streamJSONList(std::move(users),std::move(nextCursor),[](JSONWriter& writer, const User& user){
+		writer.StartObject();
+		writer.Key("apiVersion");
+		writer.String("v1alpha1");
+		writer.Key("kind");
+		writer.String("User");
+		writer.Key("metadata");
+		writer.StartObject();
+		writer.Key("id");
+		writer.String(user.id);
+		writer.Key("name");
+		writer.String(user.name);
+		writer.Key("email");
+		writer.String(user.email);
+		writer.EndObject();
+		writer.EndObject();
+	});
 }
 
 crow::response createUser(PersistentStore& store, const crow::request& req){
@@ -1,5 +1,7 @@
 #include "Utilities.h"
 
+#include <limits>
+
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 #include "Logging.h"
@@ -164,6 +166,29 @@ std::string reduceYAML(const std::string& input){
 	return output;
 }
 
+bool getPageParameters(const crow::request& req, bool& paged, std::size_t& limit, 
+                       std::string& cursor){
+	limit=0;
+	cursor.clear();
+	const char* rawLimit=req.url_params.get("limit");
+	const char* rawCursor=req.url_params.get("cursor");
+	paged=rawLimit || rawCursor;
+	if(rawCursor)
+		cursor=rawCursor;
+	if(rawLimit){
+		try{
+			std::size_t end;
+			unsigned long value=std::stoul(rawLimit,&end);
+			if(rawLimit[end]!='\0' || value==0 || value>std::numeric_limits<int>::max())
+				return false;
+			limit=value;
+		}catch(std::logic_error& err){
+			return false;
+		}
+	}
+	return true;
+}
+
 std::string trim(const std::string &s){
     auto wsfront = std::find_if_not(s.begin(),s.end(),[](int c){return std::isspace(c);});
     auto wsback = std::find_if_not(s.rbegin(),s.rend(),[](int c){return std::isspace(c);}).base();
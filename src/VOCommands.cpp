@@ -20,10 +20,25 @@ crow::response listVOs(PersistentStore& store, const crow::request& req){
 		return crow::response(403,generateError("Not authorized"));
 	//All users are allowed to list VOs
 
+	bool paged;
+	std::size_t limit;
+	std::string cursor, nextCursor;
+	if(!getPageParameters(req,paged,limit,cursor))
+		return crow::response(400,generateError("Invalid page limit"));
+
 	std::vector<VO> vos;
 
 	if (req.url_params.get("user"))
 		vos=store.listVOsForUser(user.id);
+	else if(paged){
+		ListPage<VO> page=store.listVOsPage(limit,cursor);
+		if(page.status==PageStatus::InvalidCursor)
+			return crow::response(400,generateError("Invalid cursor"));
+		if(page.status!=PageStatus::Fetched)
+			return crow::response(500,generateError("Failed to list VOs"));
+		vos=std::move(page.items);
+		nextCursor=std::move(page.nextCursor);
+	}
 	else
 		vos=store.listVOs();
 
@@ -45,6 +60,8 @@ crow::response listVOs(PersistentStore& store, const crow::request& req){
 		resultItems.PushBack(voResult, alloc);
 	}
 	result.AddMember("items", resultItems, alloc);
+	if(!nextCursor.empty())
+		result.AddMember("nextCursor", nextCursor, alloc);
 	
 	return crow::response(to_string(result));
 }
@@ -196,8 +213,7 @@ crow::response listVOMembers(PersistentStore& store, const crow::request& req, c
 	result.AddMember("apiVersion", "v1alpha1", alloc);
 	rapidjson::Value resultItems(rapidjson::kArrayType);
 	resultItems.Reserve(userIDs.size(), alloc);
-	for(const std::string& userID : userIDs){
-		User user=store.getUser(userID);
+	for(const User& user : store.getUsers(userIDs)){
 		rapidjson::Value userResult(rapidjson::kObjectType);
 		userResult.AddMember("apiVersion", "v1alpha1", alloc);
 		userResult.AddMember("kind", "User", alloc);
@@ -232,8 +248,7 @@ crow::response listVOClusters(PersistentStore& store, const crow::request& req,
 	result.AddMember("apiVersion", "v1alpha1", alloc);
 	rapidjson::Value resultItems(rapidjson::kArrayType);
 	resultItems.Reserve(clusterIDs.size(), alloc);
-	for(const std::string& clusterID : clusterIDs){
-		Cluster cluster=store.getCluster(clusterID);
+	for(const Cluster& cluster : store.getClusters(clusterIDs)){
 		rapidjson::Value clusterResult(rapidjson::kObjectType);
 		clusterResult.AddMember("apiVersion", "v1alpha1", alloc);
 		clusterResult.AddMember("kind", "Cluster", alloc);
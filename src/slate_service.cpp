@@ -1,5 +1,7 @@
 #include <cerrno>
+#include <functional>
 #include <iostream>
+#include <memory>
 
 #include <sys/stat.h>
 
@@ -7,6 +9,8 @@
 #include <crow.h>
 
 #include "Entities.h"
+#include "Executor.h"
+#include "InvalidationBus.h"
 #include "Logging.h"
 #include "PersistentStore.h"
 #include "Process.h"
@@ -20,7 +24,10 @@
 #include "VOCommands.h"
 #include "VersionCommands.h"
 
-void initializeHelm(){
+///Ensure that helm is ready to use, with the application repositories added
+///and up to date
+///\return helm's data directory
+std::string initializeHelm(){
 	const static std::string helmRepoBase="https://raw.githubusercontent.com/slateci/slate-catalog/master";
 	
 	try{
@@ -93,6 +100,36 @@ void initializeHelm(){
 		if(err)
 			log_fatal("helm repo update failed");
 	}
+	return helmHome;
+}
+
+///Run a request handler on the executor reserved for slow (subprocess-heavy)
+///requests, so that it does not occupy one of the server's network threads.
+///The response is completed on the thread which owns the request's connection.
+///\param executor the executor on which to run the handler
+///\param req the request being handled
+///\param res the response to be completed once the handler finishes
+///\param handler the function which actually produces the response
+void runDeferred(Executor& executor, const crow::request& req, crow::response& res,
+                 std::function<crow::response()> handler){
+	boost::asio::io_service* io=req.io_service;
+	bool queued=executor.submit([io,&res,handler](){
+		std::shared_ptr<crow::response> result;
+		try{
+			result=std::make_shared<crow::response>(handler());
+		}catch(std::exception& ex){
+			log_error("Exception while handling request: " << ex.what());
+			result=std::make_shared<crow::response>(500,generateError("Internal server error"));
+		}
+		io->post([&res,result](){
+			res=std::move(*result);
+			res.end();
+		});
+	});
+	if(!queued){
+		res=crow::response(503,generateError("Too many requests are in progress; try again later"));
+		res.end();
+	}
 }
 
 struct Configuration{
@@ -141,7 +178,15 @@ struct Configuration{
 	std::string encryptionKeyFile;
 	std::string appLoggingServerName;
 	std::string appLoggingServerPortString;
+	std::string slowRequestThreadsString;
+	std::string slowRequestQueueLengthString;
+	std::string scanSegmentsString;
+	std::string mirrorSyncIntervalString;
+	std::string invalidationSocketDir;
 	bool allowAdHocApps;
+	std::string maxAdHocChartSizeString;
+	std::string adHocChartCacheDir;
+	std::string adHocChartCacheSizeString;
 	
 	std::map<std::string,ParamRef> options;
 	
@@ -155,7 +200,13 @@ struct Configuration{
 	bootstrapUserFile("slate_portal_user"),
 	encryptionKeyFile("encryptionKey"),
 	appLoggingServerPortString("9200"),
+	slowRequestThreadsString("16"),
+	slowRequestQueueLengthString("256"),
+	scanSegmentsString("4"),
+	mirrorSyncIntervalString("0"),
 	allowAdHocApps(false),
+	maxAdHocChartSizeString("64"),
+	adHocChartCacheSizeString("256"),
 	options{
 		{"awsAccessKey",awsAccessKey},
 		{"awsSecretKey",awsSecretKey},
@@ -169,7 +220,15 @@ struct Configuration{
 		{"encryptionKeyFile",encryptionKeyFile},
 		{"appLoggingServerName",appLoggingServerName},
 		{"appLoggingServerPort",appLoggingServerPortString},
+		{"slowRequestThreads",slowRequestThreadsString},
+		{"slowRequestQueueLength",slowRequestQueueLengthString},
+		{"scanSegments",scanSegmentsString},
+		{"mirrorSyncInterval",mirrorSyncIntervalString},
+		{"invalidationSocketDir",invalidationSocketDir},
 		{"allowAdHocApps",allowAdHocApps},
+		{"maxAdHocChartSize",maxAdHocChartSizeString},
+		{"adHocChartCacheDir",adHocChartCacheDir},
+		{"adHocChartCacheSize",adHocChartCacheSizeString},
 	}
 	{
 		//check for environment variables
@@ -276,8 +335,60 @@ int main(int argc, char* argv[]){
 			log_fatal("Unable to parse \"" << config.appLoggingServerPortString << "\" as a valid port number");
 	}
 	
+	unsigned int slowRequestThreads=0;
+	{
+		std::istringstream is(config.slowRequestThreadsString);
+		is >> slowRequestThreads;
+		if(!slowRequestThreads || is.fail())
+			log_fatal("Unable to parse \"" << config.slowRequestThreadsString << "\" as a valid thread count");
+	}
+	unsigned int slowRequestQueueLength=0;
+	{
+		std::istringstream is(config.slowRequestQueueLengthString);
+		is >> slowRequestQueueLength;
+		if(is.fail())
+			log_fatal("Unable to parse \"" << config.slowRequestQueueLengthString << "\" as a valid queue length");
+	}
+	unsigned int scanSegments=0;
+	{
+		//read a signed value, since extracting "-1" as unsigned would wrap
+		long long segments=0;
+		std::istringstream is(config.scanSegmentsString);
+		is >> segments;
+		if(is.fail() || !(is >> std::ws).eof())
+			log_fatal("Unable to parse \"" << config.scanSegmentsString << "\" as a valid segment count");
+		if(segments<1 || segments>PersistentStore::maxScanSegments)
+			log_fatal("The number of scan segments must be between 1 and " << PersistentStore::maxScanSegments);
+		scanSegments=segments;
+	}
+	unsigned int mirrorSyncInterval=0;
+	{
+		std::istringstream is(config.mirrorSyncIntervalString);
+		is >> mirrorSyncInterval;
+		if(is.fail())
+			log_fatal("Unable to parse \"" << config.mirrorSyncIntervalString << "\" as a valid interval");
+	}
+	unsigned long long maxAdHocChartSize=0;
+	{
+		std::istringstream is(config.maxAdHocChartSizeString);
+		is >> maxAdHocChartSize;
+		if(is.fail())
+			log_fatal("Unable to parse \"" << config.maxAdHocChartSizeString << "\" as a valid size");
+		maxAdHocChartSize*=1024*1024; //convert from MiB to bytes
+	}
+	std::unique_ptr<ChartCache> chartCache;
+	if(!config.adHocChartCacheDir.empty()){
+		unsigned long long adHocChartCacheSize=0;
+		std::istringstream is(config.adHocChartCacheSizeString);
+		is >> adHocChartCacheSize;
+		if(is.fail())
+			log_fatal("Unable to parse \"" << config.adHocChartCacheSizeString << "\" as a valid size");
+		adHocChartCacheSize*=1024*1024; //convert from MiB to bytes
+		chartCache.reset(new ChartCache(config.adHocChartCacheDir,adHocChartCacheSize));
+	}
+	
 	startReaper();
-	initializeHelm();
+	HelmCatalog catalog(initializeHelm());
 	// DB client initialization
 	Aws::SDKOptions awsOptions;
 	Aws::InitAPI(awsOptions);
@@ -296,9 +407,18 @@ int main(int argc, char* argv[]){
 	else
 		log_fatal("Unrecognized URL scheme for AWS: '" << config.awsURLScheme << '\'');
 	clientConfig.endpointOverride=config.awsEndpoint;
+	std::unique_ptr<InvalidationBus> invalidationBus;
+	if(!config.invalidationSocketDir.empty())
+		invalidationBus.reset(new LocalInvalidationBus(config.invalidationSocketDir));
 	PersistentStore store(credentials,clientConfig,
 	                      config.bootstrapUserFile,config.encryptionKeyFile,
-	                      config.appLoggingServerName,appLoggingServerPort);
+	                      config.appLoggingServerName,appLoggingServerPort,
+	                      scanSegments,mirrorSyncInterval,std::move(invalidationBus));
+	
+	// Requests which run helm or kubectl can take seconds, so they are handled 
+	// by a separate pool of threads, leaving the server's own threads free to 
+	// quickly answer requests which only need the database or its cache. 
+	Executor slowRequests(slowRequestThreads,slowRequestQueueLength);
 	
 	// REST server initialization
 	crow::SimpleApp server;
@@ -329,13 +449,17 @@ int main(int argc, char* argv[]){
 	CROW_ROUTE(server, "/v1alpha2/clusters").methods("GET"_method)(
 	  [&](const crow::request& req){ return listClusters(store,req); });
 	CROW_ROUTE(server, "/v1alpha2/clusters").methods("POST"_method)(
-	  [&](const crow::request& req){ return createCluster(store,req); });
+	  [&](const crow::request& req, crow::response& res){
+		  runDeferred(slowRequests,req,res,[&]{ return createCluster(store,req); }); });
 	CROW_ROUTE(server, "/v1alpha2/clusters/<string>").methods("DELETE"_method)(
-	  [&](const crow::request& req, const std::string& cID){ return deleteCluster(store,req,cID); });
+	  [&](const crow::request& req, crow::response& res, const std::string& cID){
+		  runDeferred(slowRequests,req,res,[&,cID]{ return deleteCluster(store,req,cID); }); });
 	CROW_ROUTE(server, "/v1alpha2/clusters/<string>").methods("PUT"_method)(
-	  [&](const crow::request& req, const std::string& cID){ return updateCluster(store,req,cID); });
+	  [&](const crow::request& req, crow::response& res, const std::string& cID){
+		  runDeferred(slowRequests,req,res,[&,cID]{ return updateCluster(store,req,cID); }); });
 	CROW_ROUTE(server, "/v1alpha2/clusters/<string>/verify").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& cID){ return verifyCluster(store,req,cID); });
+	  [&](const crow::request& req, crow::response& res, const std::string& cID){
+		  runDeferred(slowRequests,req,res,[&,cID]{ return verifyCluster(store,req,cID); }); });
 	CROW_ROUTE(server, "/v1alpha2/clusters/<string>/allowed_vos").methods("GET"_method)(
 	  [&](const crow::request& req, const std::string& cID){ return listClusterAllowedVOs(store,req,cID); });
 	CROW_ROUTE(server, "/v1alpha2/clusters/<string>/allowed_vos/<string>").methods("PUT"_method)(
@@ -363,7 +487,8 @@ int main(int argc, char* argv[]){
 	CROW_ROUTE(server, "/v1alpha2/vos").methods("POST"_method)(
 	  [&](const crow::request& req){ return createVO(store,req); });
 	CROW_ROUTE(server, "/v1alpha2/vos/<string>").methods("DELETE"_method)(
-	  [&](const crow::request& req, const std::string& voID){ return deleteVO(store,req,voID); });
+	  [&](const crow::request& req, crow::response& res, const std::string& voID){
+		  runDeferred(slowRequests,req,res,[&,voID]{ return deleteVO(store,req,voID); }); });
 	CROW_ROUTE(server, "/v1alpha2/vos/<string>/members").methods("GET"_method)(
 	  [&](const crow::request& req, const std::string& voID){ return listVOMembers(store,req,voID); });
 	CROW_ROUTE(server, "/v1alpha2/vos/<string>/clusters").methods("GET"_method)(
@@ -371,41 +496,50 @@ int main(int argc, char* argv[]){
 	
 	// == Application commands ==
 	CROW_ROUTE(server, "/v1alpha2/apps").methods("GET"_method)(
-	  [&](const crow::request& req){ return listApplications(store,req); });
+	  [&](const crow::request& req){ return listApplications(store,catalog,req); });
 	CROW_ROUTE(server, "/v1alpha2/apps/<string>").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& aID){ return fetchApplicationConfig(store,req,aID); });
+	  [&](const crow::request& req, crow::response& res, const std::string& aID){
+		  runDeferred(slowRequests,req,res,[&,aID]{ return fetchApplicationConfig(store,catalog,req,aID); }); });
 	if(config.allowAdHocApps){
 		CROW_ROUTE(server, "/v1alpha2/apps/ad-hoc").methods("POST"_method)(
-		  [&](const crow::request& req){ return installAdHocApplication(store,req); });
+		  [&](const crow::request& req, crow::response& res){
+			  runDeferred(slowRequests,req,res,[&]{ return installAdHocApplication(store,req,maxAdHocChartSize,chartCache.get()); }); });
 	}
 	else{
 		CROW_ROUTE(server, "/v1alpha2/apps/ad-hoc").methods("POST"_method)(
 		  [&](const crow::request& req){ return crow::response(400,generateError("Ad-hoc application installation is not permitted")); });
 	}
 	CROW_ROUTE(server, "/v1alpha2/apps/<string>").methods("POST"_method)(
-	  [&](const crow::request& req, const std::string& aID){ return installApplication(store,req,aID); });
+	  [&](const crow::request& req, crow::response& res, const std::string& aID){
+		  runDeferred(slowRequests,req,res,[&,aID]{ return installApplication(store,catalog,req,aID); }); });
 	CROW_ROUTE(server, "/v1alpha2/update_apps").methods("POST"_method)(
-	  [&](const crow::request& req){ return updateCatalog(store,req); });
+	  [&](const crow::request& req, crow::response& res){
+		  runDeferred(slowRequests,req,res,[&]{ return updateCatalog(store,catalog,req); }); });
 	
 	// == Application Instance commands ==
 	CROW_ROUTE(server, "/v1alpha2/instances").methods("GET"_method)(
 	  [&](const crow::request& req){ return listApplicationInstances(store,req); });
 	CROW_ROUTE(server, "/v1alpha2/instances/<string>").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& iID){ return fetchApplicationInstanceInfo(store,req,iID); });
+	  [&](const crow::request& req, crow::response& res, const std::string& iID){
+		  runDeferred(slowRequests,req,res,[&,iID]{ return fetchApplicationInstanceInfo(store,req,iID); }); });
 	CROW_ROUTE(server, "/v1alpha2/instances/<string>").methods("DELETE"_method)(
-	  [&](const crow::request& req, const std::string& iID){ return deleteApplicationInstance(store,req,iID); });
+	  [&](const crow::request& req, crow::response& res, const std::string& iID){
+		  runDeferred(slowRequests,req,res,[&,iID]{ return deleteApplicationInstance(store,req,iID); }); });
 	CROW_ROUTE(server, "/v1alpha2/instances/<string>/logs").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& iID){ return getApplicationInstanceLogs(store,req,iID); });
+	  [&](const crow::request& req, crow::response& res, const std::string& iID){
+		  runDeferred(slowRequests,req,res,[&,iID]{ return getApplicationInstanceLogs(store,req,iID); }); });
 	
 	// == Secret commands ==
 	CROW_ROUTE(server, "/v1alpha2/secrets").methods("GET"_method)(
 	  [&](const crow::request& req){ return listSecrets(store,req); });
 	CROW_ROUTE(server, "/v1alpha2/secrets").methods("POST"_method)(
-	  [&](const crow::request& req){ return createSecret(store,req); });
+	  [&](const crow::request& req, crow::response& res){
+		  runDeferred(slowRequests,req,res,[&]{ return createSecret(store,req); }); });
 	CROW_ROUTE(server, "/v1alpha2/secrets/<string>").methods("GET"_method)(
 	  [&](const crow::request& req, const std::string& id){ return getSecret(store,req,id); });
 	CROW_ROUTE(server, "/v1alpha2/secrets/<string>").methods("DELETE"_method)(
-	  [&](const crow::request& req, const std::string& id){ return deleteSecret(store,req,id); });
+	  [&](const crow::request& req, crow::response& res, const std::string& id){
+		  runDeferred(slowRequests,req,res,[&,id]{ return deleteSecret(store,req,id); }); });
 	
 	CROW_ROUTE(server, "/v1alpha2/stats").methods("GET"_method)(
 	  [&](){ return(store.getStatistics()); });
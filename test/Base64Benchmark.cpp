@@ -0,0 +1,184 @@
+//Measures the throughput of the table-driven base64 codec in Archive.cpp
+//against the bit-at-a-time implementation it replaced (reproduced below), on
+//data the size of an uploaded chart, and the cost of encoding a raw ID
+//against the boost iterators IDGenerator used to use. This is not part of the
+//test suite; run it by hand:
+//    slate-base64-benchmark [megabytes] [rounds]
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <boost/archive/iterators/base64_from_binary.hpp>
+#include <boost/archive/iterators/transform_width.hpp>
+#include <boost/archive/iterators/ostream_iterator.hpp>
+
+#include "Archive.h"
+
+namespace{
+
+//The previous implementation, which moves the bits of one character at a time
+std::string legacyDecodeBase64(const std::string& coded){
+	//table used by boost::archive::iterators::detail::to_6_bit
+	static const signed char lookupTable[] = {
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,62,-1,-1,-1,63,
+		52,53,54,55,56,57,58,59,60,61,-1,-1,-1, 0,-1,-1,
+		-1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,
+		15,16,17,18,19,20,21,22,23,24,25,-1,-1,-1,-1,-1,
+		-1,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,
+		41,42,43,44,45,46,47,48,49,50,51,-1,-1,-1,-1,-1
+	};
+	std::size_t outLen=(coded.size()*3)/4;
+	std::string decoded(outLen,'\0');
+	char* outData=&decoded.front();
+	unsigned char curBits=0;
+	for(const unsigned char next : coded){
+		if(next>=128 || lookupTable[next]==-1)
+			throw std::runtime_error("Illegal base64 character: '"+std::string(1,next)+"'");
+		unsigned char newBits=lookupTable[next];
+		unsigned char putBits=0;
+		//shove as many bits into the current byte as will fit
+		{
+			putBits=std::min(CHAR_BIT-curBits,6);
+			unsigned int mask=(((1u<<putBits)-1)<<(6-putBits));
+			*outData|=((newBits&mask)>>(6-putBits))<<(CHAR_BIT-curBits-putBits);
+			curBits+=putBits;
+		}
+		if(curBits==CHAR_BIT){ //if the byte is full, advance to the next
+			curBits=0;
+			outData++;
+			//if more bits need to be written put them in now
+			if(putBits<6){
+				putBits=6-putBits;
+				unsigned int mask=(1u<<putBits)-1;
+				*outData|=(newBits&mask)<<(CHAR_BIT-putBits);
+				curBits=putBits;
+			}
+		}
+	}
+	return decoded;
+}
+
+std::string legacyEncodeBase64(const std::string& raw){
+	const char lookupTable[65]=
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"abcdefghijklmnopqrstuvwxyz"
+		"0123456789"
+		"+/";
+	std::size_t outLen=std::ceil((raw.size()*4)/3.);
+	std::string encoded(outLen,'\0');
+	unsigned char availBits=CHAR_BIT;
+	size_t inputIdx=0;
+	for(size_t i=0; i<outLen; i++){
+		unsigned char getBits=0;
+		unsigned char lutIdx=0;
+		//grab as many bits as possible from the current byte
+		{
+			getBits=std::min((unsigned char)6,availBits);
+			unsigned int mask=((1u<<getBits)-1)<<(availBits-getBits);
+			lutIdx|=((raw[inputIdx]&mask)>>(availBits-getBits))<<(6-getBits);
+			availBits-=getBits;
+		}
+		if(availBits==0){ //if that byte is exhausted, advance to the next
+			inputIdx++;
+			availBits=CHAR_BIT;
+			//if more bits are needed get them now
+			if(getBits<6){
+				getBits=6-getBits;
+				unsigned int mask=((1u<<getBits)-1)<<(availBits-getBits);
+				lutIdx|=((raw[inputIdx]&mask)>>(availBits-getBits));
+				availBits-=getBits;
+			}
+		}
+		encoded[i]=lookupTable[lutIdx];
+	}
+	return encoded;
+}
+
+
+std::string legacyGenerateRawID(uint64_t value){
+	std::ostringstream os;
+	using namespace boost::archive::iterators;
+	using base64_text=base64_from_binary<transform_width<const unsigned char*,6,8>>;
+	std::copy(base64_text((char*)&value),base64_text((char*)&value+sizeof(value)),ostream_iterator<char>(os));
+	std::string result=os.str();
+	for(char& c : result){
+		if(c=='+') c='-';
+		if(c=='/') c='_';
+	}
+	return result;
+}
+
+///Run an operation repeatedly
+///\return the best time for one round, in seconds
+double timeRounds(std::size_t rounds, const std::function<void()>& operation){
+	using clock=std::chrono::steady_clock;
+	double best=INFINITY;
+	for(std::size_t i=0; i<rounds; i++){
+		auto start=clock::now();
+		operation();
+		best=std::min(best,std::chrono::duration<double>(clock::now()-start).count());
+	}
+	return best;
+}
+
+void report(const std::string& name, std::size_t bytes, double seconds){
+	std::cout << std::setw(16) << std::left << name << std::right
+	          << std::setw(10) << bytes/seconds/(1024*1024) << " MiB/s" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]){
+	std::size_t megabytes=8, rounds=10;
+	if(argc>1)
+		megabytes=std::strtoul(argv[1],nullptr,10);
+	if(argc>2)
+		rounds=std::strtoul(argv[2],nullptr,10);
+	if(!megabytes || !rounds){
+		std::cerr << "Size and round count must be positive" << std::endl;
+		return 1;
+	}
+
+	std::mt19937_64 rng(1);
+	std::string raw(megabytes*1024*1024,'\0');
+	for(char& c : raw)
+		c=rng();
+	const std::string legacyEncoded=legacyEncodeBase64(raw), encoded=encodeBase64(raw);
+	if(decodeBase64(encoded)!=raw || decodeBase64(legacyEncoded)!=raw){
+		std::cerr << "Decoding does not reproduce the original data" << std::endl;
+		return 1;
+	}
+
+	std::size_t sink=0; //keeps results from being optimized away
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Encoding " << megabytes << " MiB, best of " << rounds << " rounds" << std::endl;
+	report("previous",raw.size(),timeRounds(rounds,[&]{ sink+=legacyEncodeBase64(raw).size(); }));
+	report("table-driven",raw.size(),timeRounds(rounds,[&]{ sink+=encodeBase64(raw).size(); }));
+	std::cout << "Decoding" << std::endl;
+	report("previous",raw.size(),timeRounds(rounds,[&]{ sink+=legacyDecodeBase64(legacyEncoded).size(); }));
+	report("table-driven",raw.size(),timeRounds(rounds,[&]{ sink+=decodeBase64(encoded).size(); }));
+
+	const std::size_t ids=100000;
+	std::cout << "Encoding " << ids << " raw IDs" << std::endl;
+	auto perID=[&](double seconds){ return seconds/ids*1e9; };
+	std::cout << std::setw(16) << std::left << "boost iterators" << std::right << std::setw(10)
+	          << perID(timeRounds(rounds,[&]{ for(std::size_t i=0; i<ids; i++) sink+=legacyGenerateRawID(i).size(); }))
+	          << " ns each" << std::endl;
+	std::cout << std::setw(16) << std::left << "table-driven" << std::right << std::setw(10)
+	          << perID(timeRounds(rounds,[&]{ for(std::size_t i=0; i<ids; i++) sink+=encodeBase64(std::string((const char*)&i,sizeof(i)),Base64Alphabet::URLSafe).size(); }))
+	          << " ns each" << std::endl;
+	return sink==0;
+}
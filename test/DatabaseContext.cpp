@@ -0,0 +1,134 @@
+#include "DatabaseContext.h"
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "test.h"
+
+namespace{
+///The AWS SDK must be initialized once per process, before any client is
+///created, and shut down only after all clients are gone
+struct AWSInitializer{
+	Aws::SDKOptions options;
+	AWSInitializer(){ Aws::InitAPI(options); }
+	~AWSInitializer(){ Aws::ShutdownAPI(options); }
+};
+
+sockaddr_in loopback(unsigned short port){
+	sockaddr_in address={};
+	address.sin_family=AF_INET;
+	address.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+	address.sin_port=htons(port);
+	return address;
+}
+}
+
+DatabaseContext::DatabaseContext(){
+	static AWSInitializer awsInitializer;
+	auto dbResp=httpRequests::httpGet("http://localhost:52000/dynamo/create");
+	ENSURE_EQUAL(dbResp.status,200);
+	dbPort=dbResp.body;
+}
+
+DatabaseContext::~DatabaseContext(){
+	httpRequests::httpDelete("http://localhost:52000/dynamo/"+dbPort);
+}
+
+Aws::Client::ClientConfiguration DatabaseContext::getClientConfig(const std::string& port) const{
+	Aws::Client::ClientConfiguration clientConfig;
+	clientConfig.region="us-east-1";
+	clientConfig.scheme=Aws::Http::Scheme::HTTP;
+	clientConfig.endpointOverride="localhost:"+(port.empty() ? dbPort : port);
+	return clientConfig;
+}
+
+std::unique_ptr<PersistentStore> DatabaseContext::makeStore(unsigned int mirrorSyncInterval,
+                                                            std::unique_ptr<InvalidationBus> invalidationBus,
+                                                            const std::string& port){
+	Aws::Auth::AWSCredentials credentials("foo","bar");
+	return std::unique_ptr<PersistentStore>(
+	  new PersistentStore(credentials,getClientConfig(port),
+	                      "slate_portal_user","encryptionKey","localhost",9200,
+	                      4,mirrorSyncInterval,std::move(invalidationBus)));
+}
+
+InterceptingProxy::InterceptingProxy(const std::string& targetPort, Hook hook):
+targetPort(std::stoi(targetPort)),hook(std::move(hook)),stop(false){
+	listenFD=socket(AF_INET,SOCK_STREAM,0);
+	ENSURE(listenFD>=0,"Creating the proxy socket should succeed");
+	sockaddr_in address=loopback(0);
+	ENSURE_EQUAL(bind(listenFD,(const sockaddr*)&address,sizeof(address)),0,
+	             "Binding the proxy socket should succeed");
+	ENSURE_EQUAL(listen(listenFD,16),0,"Listening on the proxy socket should succeed");
+	socklen_t length=sizeof(address);
+	getsockname(listenFD,(sockaddr*)&address,&length);
+	port=std::to_string(ntohs(address.sin_port));
+	acceptor=std::thread(&InterceptingProxy::acceptConnections,this);
+}
+
+InterceptingProxy::~InterceptingProxy(){
+	stop=true;
+	shutdown(listenFD,SHUT_RDWR);
+	acceptor.join();
+	close(listenFD);
+	for(auto& relay : relays)
+		relay.join();
+}
+
+void InterceptingProxy::acceptConnections(){
+	while(!stop){
+		int client=accept(listenFD,nullptr,nullptr);
+		if(client<0)
+			break;
+		relays.emplace_back(&InterceptingProxy::relay,this,client);
+	}
+}
+
+void InterceptingProxy::relay(int client){
+	int server=socket(AF_INET,SOCK_STREAM,0);
+	sockaddr_in address=loopback(targetPort);
+	if(server<0 || connect(server,(const sockaddr*)&address,sizeof(address))!=0){
+		close(client);
+		if(server>=0)
+			close(server);
+		return;
+	}
+	std::string request;
+	char buffer[65536];
+	pollfd fds[2]={{client,POLLIN,0},{server,POLLIN,0}};
+	while(!stop){
+		if(poll(fds,2,100)<=0)
+			continue;
+		if(fds[0].revents){
+			ssize_t count=read(client,buffer,sizeof(buffer));
+			if(count<=0 || write(server,buffer,count)!=count)
+				break;
+			request.append(buffer,count);
+		}
+		if(fds[1].revents){
+			ssize_t count=read(server,buffer,sizeof(buffer));
+			if(count<=0)
+				break;
+			if(!request.empty()){
+				hook(request);
+				request.clear();
+			}
+			if(write(client,buffer,count)!=count)
+				break;
+		}
+	}
+	close(client);
+	close(server);
+}
+
+User makeTestUser(const std::string& name){
+	User user(name);
+	user.id=idGenerator.generateUserID();
+	user.token=idGenerator.generateUserToken();
+	user.email=name+"@place.com";
+	user.globusID=name+"'s Globus ID";
+	user.admin=false;
+	return user;
+}
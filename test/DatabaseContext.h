@@ -0,0 +1,78 @@
+#ifndef SLATE_DATABASE_CONTEXT_H
+#define SLATE_DATABASE_CONTEXT_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PersistentStore.h"
+
+///A database instance for tests which use PersistentStores directly, rather
+///than through an API server. All stores made from the same context share the
+///database, as replicas of the server would.
+class DatabaseContext{
+public:
+	DatabaseContext();
+	~DatabaseContext();
+	DatabaseContext(const DatabaseContext&)=delete;
+	DatabaseContext& operator=(const DatabaseContext&)=delete;
+
+	///\return the port on which the database listens
+	const std::string& getPort() const{ return dbPort; }
+
+	///\param port the local port through which to reach the database, if not
+	///            the database's own
+	///\return a configuration for clients of this database
+	Aws::Client::ClientConfiguration getClientConfig(const std::string& port="") const;
+
+	///Construct a store which uses this database
+	///\param mirrorSyncInterval passed to the store; see PersistentStore
+	///\param invalidationBus passed to the store; see PersistentStore
+	///\param port the local port through which the store should reach the
+	///            database, if not the database's own
+	std::unique_ptr<PersistentStore> makeStore(unsigned int mirrorSyncInterval=0,
+	                                           std::unique_ptr<InvalidationBus> invalidationBus=nullptr,
+	                                           const std::string& port="");
+private:
+	std::string dbPort;
+};
+
+///Relays connections from a local port to the database, calling a hook with
+///each request just before its response is passed back. This lets a test
+///change the database after a read has been answered, but before the reader
+///sees the answer.
+class InterceptingProxy{
+public:
+	using Hook=std::function<void(const std::string& request)>;
+
+	///\param targetPort the port on which the database listens
+	///\param hook called with each complete request, on one of the proxy's
+	///            threads
+	InterceptingProxy(const std::string& targetPort, Hook hook);
+	~InterceptingProxy();
+	InterceptingProxy(const InterceptingProxy&)=delete;
+	InterceptingProxy& operator=(const InterceptingProxy&)=delete;
+
+	///\return the port on which the proxy listens
+	const std::string& getPort() const{ return port; }
+
+private:
+	const unsigned short targetPort;
+	const Hook hook;
+	std::atomic<bool> stop;
+	int listenFD;
+	std::string port;
+	std::thread acceptor;
+	std::vector<std::thread> relays;
+
+	void acceptConnections();
+	void relay(int client);
+};
+
+///\return a new, non-administrator user with unique ID and token
+User makeTestUser(const std::string& name);
+
+#endif //SLATE_DATABASE_CONTEXT_H
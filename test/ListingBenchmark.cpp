@@ -0,0 +1,134 @@
+//Measures the cost of resolving VO and cluster names while producing a listing
+//of many application instances, comparing a lookup per row with resolving
+//each distinct ID once. This is not part of the test suite; it needs a
+//DynamoDB instance (such as DynamoDB Local) to populate and run by hand:
+//    slate-listing-benchmark [endpoint] [instances] [vos] [clusters] [rounds]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "PersistentStore.h"
+#include "Utilities.h"
+
+int main(int argc, char* argv[]){
+	std::string endpoint="localhost:8000";
+	std::size_t instanceCount=10000, voCount=20, clusterCount=10, rounds=10;
+	if(argc>1)
+		endpoint=argv[1];
+	if(argc>2)
+		instanceCount=std::strtoul(argv[2],nullptr,10);
+	if(argc>3)
+		voCount=std::strtoul(argv[3],nullptr,10);
+	if(argc>4)
+		clusterCount=std::strtoul(argv[4],nullptr,10);
+	if(argc>5)
+		rounds=std::strtoul(argv[5],nullptr,10);
+	if(!instanceCount || !voCount || !clusterCount || !rounds){
+		std::cerr << "Counts must be positive" << std::endl;
+		return 1;
+	}
+
+	Aws::SDKOptions awsOptions;
+	Aws::InitAPI(awsOptions);
+	{
+		Aws::Auth::AWSCredentials credentials("foo","bar");
+		Aws::Client::ClientConfiguration clientConfig;
+		clientConfig.region="us-east-1";
+		clientConfig.scheme=Aws::Http::Scheme::HTTP;
+		clientConfig.endpointOverride=endpoint;
+		PersistentStore store(credentials,clientConfig,
+		                      "slate_portal_user","encryptionKey","localhost",9200);
+
+		std::cout << "Creating " << instanceCount << " instances across "
+		          << voCount << " VOs and " << clusterCount << " clusters" << std::endl;
+		std::vector<std::string> voIDs, clusterIDs;
+		for(std::size_t i=0; i<voCount; i++){
+			VO vo("bench-vo-"+std::to_string(i));
+			vo.id=idGenerator.generateVOID();
+			if(!store.addVO(vo)){
+				std::cerr << "Failed to create VO" << std::endl;
+				return 1;
+			}
+			voIDs.push_back(vo.id);
+		}
+		for(std::size_t i=0; i<clusterCount; i++){
+			Cluster cluster("bench-cluster-"+std::to_string(i));
+			cluster.id=idGenerator.generateClusterID();
+			cluster.config="{}";
+			cluster.systemNamespace="slate-system";
+			cluster.owningVO=voIDs[i%voCount];
+			if(!store.addCluster(cluster)){
+				std::cerr << "Failed to create cluster" << std::endl;
+				return 1;
+			}
+			clusterIDs.push_back(cluster.id);
+		}
+		for(std::size_t i=0; i<instanceCount; i++){
+			ApplicationInstance instance;
+			instance.valid=true;
+			instance.id=idGenerator.generateInstanceID();
+			instance.name="bench-"+std::to_string(i);
+			instance.application="test-app";
+			instance.owningVO=voIDs[i%voCount];
+			instance.cluster=clusterIDs[i%clusterCount];
+			instance.config="-";
+			instance.ctime=timestamp();
+			if(!store.addApplicationInstance(instance)){
+				std::cerr << "Failed to create instance" << std::endl;
+				return 1;
+			}
+		}
+		std::vector<ApplicationInstance> instances=store.listApplicationInstances();
+		std::cout << "Listing contains " << instances.size() << " instances" << std::endl;
+
+		using clock=std::chrono::steady_clock;
+		auto measure=[&](const std::string& label, const std::function<std::size_t()>& resolve){
+			std::vector<double> times;
+			std::size_t checksum=0;
+			for(std::size_t r=0; r<rounds; r++){
+				auto t0=clock::now();
+				checksum+=resolve();
+				auto t1=clock::now();
+				times.push_back(std::chrono::duration<double,std::milli>(t1-t0).count());
+			}
+			std::sort(times.begin(),times.end());
+			std::cout << label << ": median " << times[times.size()/2]
+			          << " ms, min " << times.front() << " ms, max " << times.back()
+			          << " ms (" << checksum/rounds << " bytes of names)" << std::endl;
+		};
+		std::cout << std::fixed << std::setprecision(2);
+		measure("Per-row lookups",[&]{
+			std::size_t total=0;
+			for(const ApplicationInstance& instance : instances){
+				total+=store.getVO(instance.owningVO).name.size();
+				total+=store.getCluster(instance.cluster).name.size();
+			}
+			return total;
+		});
+		measure("Name dictionary",[&]{
+			std::vector<std::string> instanceVOs, instanceClusters;
+			instanceVOs.reserve(instances.size());
+			instanceClusters.reserve(instances.size());
+			for(const ApplicationInstance& instance : instances){
+				instanceVOs.push_back(instance.owningVO);
+				instanceClusters.push_back(instance.cluster);
+			}
+			auto voNames=store.getVONames(instanceVOs);
+			auto clusterNames=store.getClusterNames(instanceClusters);
+			std::size_t total=0;
+			for(const ApplicationInstance& instance : instances){
+				total+=voNames[instance.owningVO].size();
+				total+=clusterNames[instance.cluster].size();
+			}
+			return total;
+		});
+		std::cout << store.getStatistics() << std::endl;
+	}
+	Aws::ShutdownAPI(awsOptions);
+}
@@ -0,0 +1,130 @@
+//Compares concurrent_multimap, which copies a key's values out on every
+//lookup, with snapshot_multimap, which shares them, for a cache of many
+//application instances under a single key (like a popular VO's entry in the
+//instance-by-VO cache). Readers repeatedly look up the key and walk the
+//values while a writer occasionally replaces one. This is not part of the test
+//suite; run it by hand:
+//    slate-multimap-benchmark [values] [readers] [seconds]
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent_multimap.h"
+#include "snapshot_multimap.h"
+#include "PersistentStore.h"
+
+namespace{
+
+using Record=CacheRecord<ApplicationInstance>;
+
+Record makeRecord(std::size_t i){
+	ApplicationInstance instance;
+	instance.valid=true;
+	instance.id="instance_"+std::to_string(i);
+	instance.name="bench-"+std::to_string(i);
+	instance.application="test-app";
+	instance.owningVO="vo_bench";
+	instance.cluster="cluster_bench";
+	instance.ctime="2019-01-01T00:00:00Z";
+	return Record(instance,std::chrono::hours(1));
+}
+
+struct Result{
+	double fillSeconds;
+	double lookupsPerSecond;
+	std::size_t writes;
+};
+
+//concurrent_multimap returns the set itself, snapshot_multimap a pointer to it
+template<typename Set>
+const Set* snapshot(const Set& set){ return &set; }
+template<typename Set>
+const Set* snapshot(const std::shared_ptr<const Set>& set){ return set.get(); }
+
+template<typename Map>
+Result run(const std::vector<Record>& records, std::size_t readers, double seconds){
+	using clock=std::chrono::steady_clock;
+	Map map;
+	const std::string key="vo_bench";
+	Result result;
+
+	auto start=clock::now();
+	for(const auto& record : records)
+		map.insert_or_assign(key,record);
+	map.update_expiration(key,clock::now()+std::chrono::hours(1));
+	result.fillSeconds=std::chrono::duration<double>(clock::now()-start).count();
+
+	std::atomic<bool> stop(false);
+	std::atomic<std::size_t> lookups(0);
+	std::vector<std::thread> threads;
+	for(std::size_t i=0; i<readers; i++){
+		threads.emplace_back([&]{
+			std::size_t n=0, length=0;
+			while(!stop.load(std::memory_order_relaxed)){
+				auto cached=map.find(key);
+				for(const auto& record : *snapshot(cached.first))
+					length+=record.record.name.size();
+				n++;
+			}
+			lookups+=n;
+			if(length==1) //keep the walk from being optimized away
+				std::cout << std::endl;
+		});
+	}
+	//replace one value every millisecond, as updates to instances would
+	result.writes=0;
+	start=clock::now();
+	auto end=start+std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+	while(clock::now()<end){
+		map.insert_or_assign(key,records[result.writes%records.size()]);
+		result.writes++;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	stop=true;
+	for(auto& thread : threads)
+		thread.join();
+	auto elapsed=std::chrono::duration<double>(clock::now()-start).count();
+	result.lookupsPerSecond=lookups/elapsed;
+	return result;
+}
+
+void report(const std::string& name, const Result& result){
+	std::cout << std::setw(20) << std::left << name << std::right
+	          << " fill " << std::setw(9) << result.fillSeconds*1000 << " ms,"
+	          << " lookups/s " << std::setw(12) << result.lookupsPerSecond
+	          << " (" << result.writes << " concurrent writes)" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]){
+	std::size_t valueCount=5000, readers=4;
+	double seconds=5;
+	if(argc>1)
+		valueCount=std::strtoul(argv[1],nullptr,10);
+	if(argc>2)
+		readers=std::strtoul(argv[2],nullptr,10);
+	if(argc>3)
+		seconds=std::strtod(argv[3],nullptr);
+	if(!valueCount || !readers || seconds<=0){
+		std::cerr << "Counts and duration must be positive" << std::endl;
+		return 1;
+	}
+
+	std::vector<Record> records;
+	records.reserve(valueCount);
+	for(std::size_t i=0; i<valueCount; i++)
+		records.push_back(makeRecord(i));
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << valueCount << " values under one key, " << readers
+	          << " reader threads, " << seconds << " s per run" << std::endl;
+	report("concurrent_multimap",run<concurrent_multimap<std::string,Record>>(records,readers,seconds));
+	report("snapshot_multimap",run<snapshot_multimap<std::string,Record>>(records,readers,seconds));
+}
@@ -0,0 +1,58 @@
+//Measures the latency from starting a child process with runCommand until its
+//result is available. This is not part of the test suite; run it by hand:
+//    slate-process-benchmark [iterations] [command [args...]]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Process.h"
+
+int main(int argc, char* argv[]){
+	std::size_t iterations=1000;
+	std::string command="true";
+	std::vector<std::string> args;
+	if(argc>1)
+		iterations=std::strtoul(argv[1],nullptr,10);
+	if(argc>2)
+		command=argv[2];
+	for(int i=3; i<argc; i++)
+		args.push_back(argv[i]);
+	if(!iterations){
+		std::cerr << "Iteration count must be positive" << std::endl;
+		return 1;
+	}
+
+	startReaper();
+	using clock=std::chrono::steady_clock;
+	std::vector<double> latencies;
+	latencies.reserve(iterations);
+	auto start=clock::now();
+	for(std::size_t i=0; i<iterations; i++){
+		auto t0=clock::now();
+		auto result=runCommand(command,args);
+		auto t1=clock::now();
+		if(result.status!=0){
+			std::cerr << command << " exited with status " << result.status << std::endl;
+			return 1;
+		}
+		latencies.push_back(std::chrono::duration<double,std::micro>(t1-t0).count());
+	}
+	auto total=std::chrono::duration<double>(clock::now()-start).count();
+	stopReaper();
+
+	std::sort(latencies.begin(),latencies.end());
+	auto percentile=[&](double p){
+		return latencies[std::min(latencies.size()-1,(std::size_t)(p*latencies.size()))];
+	};
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Ran " << command << ' ' << iterations << " times in " << total << " s\n";
+	std::cout << "Latency (us): median " << percentile(0.5)
+	          << ", p90 " << percentile(0.9)
+	          << ", p99 " << percentile(0.99)
+	          << ", max " << latencies.back() << std::endl;
+}
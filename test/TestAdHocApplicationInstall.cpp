@@ -1,6 +1,13 @@
 #include "test.h"
 
+#include <chrono>
+#include <thread>
+
+#include <sys/stat.h>
+
 #include <Archive.h>
+#include <ChartCache.h>
+#include <FileHandle.h>
 #include <Utilities.h>
 
 TEST(AdHocInstallForbiddenByDefault){
@@ -27,7 +34,9 @@ TEST(UnauthenticatedApplicationInstall){
 				 "Requests to fetch application config with invalid authentication should be rejected");
 }
 
-std::string getTestAppChart(){
+///\param padding if not empty, the contents of an extra file to include in the
+///                chart, to make it larger on disk
+std::string getTestAppChart(const std::string& padding=""){
 	std::string chartPath;
 	ENSURE(fetchFromEnvironment("TEST_SRC",chartPath),"The TEST_SRC environment variable must be set");
 	chartPath+="/test_helm_repo/test-app";
@@ -37,6 +46,8 @@ std::string getTestAppChart(){
 	while(dirPath.size()>1 && dirPath.back()=='/') //strip trailing slashes
 		dirPath=dirPath.substr(0,dirPath.size()-1);
 	recursivelyArchive(dirPath,tw,true);
+	if(!padding.empty())
+		tw.appendFile("test-app/padding.txt",padding);
 	tw.endStream();
 	gzipCompress(tarBuffer,gzipBuffer);
 	std::string encodedChart=encodeBase64(gzipBuffer.str());
@@ -678,4 +689,170 @@ data:
 		ENSURE_EQUAL(instResp.status,500,
 		             "Application install request with malformed chart (link to external file) should be rejected");
 	}
-}
\ No newline at end of file
+}
+TEST(OversizedChartTarball){
+	using namespace httpRequests;
+	TestContext tc({"--allowAdHocApps=1","--maxAdHocChartSize=1"});
+	
+	std::string adminKey=getPortalToken();
+	
+	//a chart which compresses well, but is larger than 1 MiB when decompressed
+	std::stringstream tarBuffer,gzipBuffer;
+	TarWriter tw(tarBuffer);
+	tw.appendDirectory("big-app");
+	tw.appendFile("big-app/Chart.yaml","apiVersion: \"v1\"\nname: \"big-app\"\nversion: 0.0.0\n");
+	tw.appendFile("big-app/values.yaml",std::string(2*1024*1024,'#'));
+	tw.endStream();
+	gzipCompress(tarBuffer,gzipBuffer);
+	std::string chart=encodeBase64(gzipBuffer.str());
+	
+	rapidjson::Document request(rapidjson::kObjectType);
+	auto& alloc = request.GetAllocator();
+	request.AddMember("apiVersion", currentAPIVersion, alloc);
+	request.AddMember("vo", "some-vo", alloc);
+	request.AddMember("cluster", "some-cluster", alloc);
+	request.AddMember("tag", "install1", alloc);
+	request.AddMember("chart",chart,alloc);
+	request.AddMember("configuration", "", alloc);
+	auto instResp=httpPost(tc.getAPIServerURL()+"/"+currentAPIVersion+"/apps/ad-hoc?test&token="+adminKey,to_string(request));
+	ENSURE_EQUAL(instResp.status,400,
+	             "Application install request with a chart larger than the limit should be rejected");
+}
+
+TEST(CachedChartReinstall){
+	using namespace httpRequests;
+	FileHandle cacheDir=makeTemporaryDir("/tmp/slate_test_chart_cache_");
+	TestContext tc({"--allowAdHocApps=1","--adHocChartCacheDir="+cacheDir.path()});
+	
+	std::string adminKey=getPortalToken();
+	auto schema=loadSchema(getSchemaDir()+"/AppInstallResultSchema.json");
+	
+	std::string voName="test-ad-hoc-app-install-cached";
+	std::string clusterName="testcluster";
+	
+	{ //create a VO
+		rapidjson::Document request(rapidjson::kObjectType);
+		auto& alloc = request.GetAllocator();
+		request.AddMember("apiVersion", currentAPIVersion, alloc);
+		rapidjson::Value metadata(rapidjson::kObjectType);
+		metadata.AddMember("name", voName, alloc);
+		request.AddMember("metadata", metadata, alloc);
+		auto createResp=httpPost(tc.getAPIServerURL()+"/"+currentAPIVersion+"/vos?token="+adminKey,to_string(request));
+		ENSURE_EQUAL(createResp.status,200,"VO creation request should succeed");
+	}
+	
+	{ //create a cluster
+		auto kubeConfig = tc.getKubeConfig();
+		rapidjson::Document request(rapidjson::kObjectType);
+		auto& alloc = request.GetAllocator();
+		request.AddMember("apiVersion", currentAPIVersion, alloc);
+		rapidjson::Value metadata(rapidjson::kObjectType);
+		metadata.AddMember("name", clusterName, alloc);
+		metadata.AddMember("vo", voName, alloc);
+		metadata.AddMember("kubeconfig", kubeConfig, alloc);
+		request.AddMember("metadata", metadata, alloc);
+		auto createResp=httpPost(tc.getAPIServerURL()+"/"+currentAPIVersion+"/clusters?token="+adminKey, to_string(request));
+		ENSURE_EQUAL(createResp.status,200,
+					 "Cluster creation request should succeed");
+		ENSURE(!createResp.body.empty());
+	}
+	
+	std::string instID1, instID2;
+	struct cleanupHelper{
+		TestContext& tc;
+		const std::string& id, key;
+		cleanupHelper(TestContext& tc, const std::string& id, const std::string& key):
+		tc(tc),id(id),key(key){}
+		~cleanupHelper(){
+			if(!id.empty())
+				auto delResp=httpDelete(tc.getAPIServerURL()+"/"+currentAPIVersion+"/instances/"+id+"?token="+key);
+		}
+	} cleanup1(tc,instID1,adminKey), cleanup2(tc,instID2,adminKey);
+	
+	auto install=[&](const std::string& tag, std::string& instID){
+		rapidjson::Document request(rapidjson::kObjectType);
+		auto& alloc = request.GetAllocator();
+		request.AddMember("apiVersion", currentAPIVersion, alloc);
+		request.AddMember("vo", voName, alloc);
+		request.AddMember("cluster", clusterName, alloc);
+		request.AddMember("tag", tag, alloc);
+		request.AddMember("chart",getTestAppChart(),alloc);
+		request.AddMember("configuration", "", alloc);
+		auto instResp=httpPost(tc.getAPIServerURL()+"/"+currentAPIVersion+"/apps/ad-hoc?test&token="+adminKey,to_string(request));
+		ENSURE_EQUAL(instResp.status,200,"Application install request should succeed");
+		rapidjson::Document data;
+		data.Parse(instResp.body);
+		ENSURE_CONFORMS(data,schema);
+		instID=data["metadata"]["id"].GetString();
+	};
+	
+	//the first installation extracts the chart and caches it
+	install("install1",instID1);
+	const std::string chart=getTestAppChart();
+	const std::string entry=cacheDir.path()+"/"+ChartCache::key(chart.data(),chart.size());
+	struct stat info;
+	ENSURE(stat(entry.c_str(),&info)==0 && S_ISDIR(info.st_mode),
+	       "The chart should be cached under the digest of the upload");
+	ENSURE(stat(cacheDir.path().c_str(),&info)==0);
+	const auto modified=info.st_mtim;
+	
+	//the second uses the cached copy, which must work just as well. Using it
+	//does not extract the chart again, which would create a staging directory
+	//in the cache.
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+	install("install2",instID2);
+	ENSURE(instID1!=instID2);
+	ENSURE(stat(cacheDir.path().c_str(),&info)==0);
+	ENSURE(info.st_mtim.tv_sec==modified.tv_sec && info.st_mtim.tv_nsec==modified.tv_nsec,
+	       "Reinstalling the same chart should use the cached copy");
+	ENSURE(stat(entry.c_str(),&info)==0 && S_ISDIR(info.st_mode),
+	       "The chart should remain cached");
+}
+
+TEST(CachedChartEviction){
+	using namespace httpRequests;
+	FileHandle cacheDir=makeTemporaryDir("/tmp/slate_test_chart_cache_");
+	TestContext tc({"--allowAdHocApps=1","--adHocChartCacheDir="+cacheDir.path(),
+	                "--adHocChartCacheSize=1"});
+	
+	std::string adminKey=getPortalToken();
+	
+	//two different charts, each taking most of the cache's 1 MiB when
+	//extracted, although they compress to almost nothing
+	const std::string chart1=getTestAppChart(std::string(700*1024,'1'));
+	const std::string chart2=getTestAppChart(std::string(700*1024,'2'));
+	const std::string entry1=cacheDir.path()+"/"+ChartCache::key(chart1.data(),chart1.size());
+	const std::string entry2=cacheDir.path()+"/"+ChartCache::key(chart2.data(),chart2.size());
+	
+	//Charts are cached once they have been validated, before the request is
+	//otherwise checked, so installing into a VO which does not exist is
+	//enough to fill the cache.
+	auto upload=[&](const std::string& chart){
+		rapidjson::Document request(rapidjson::kObjectType);
+		auto& alloc = request.GetAllocator();
+		request.AddMember("apiVersion", currentAPIVersion, alloc);
+		request.AddMember("vo", "some-vo", alloc);
+		request.AddMember("cluster", "some-cluster", alloc);
+		request.AddMember("tag", "install1", alloc);
+		request.AddMember("chart",chart,alloc);
+		request.AddMember("configuration", "", alloc);
+		httpPost(tc.getAPIServerURL()+"/"+currentAPIVersion+"/apps/ad-hoc?test&token="+adminKey,to_string(request));
+	};
+	auto cached=[](const std::string& entry){
+		struct stat info;
+		return stat(entry.c_str(),&info)==0 && S_ISDIR(info.st_mode);
+	};
+	
+	upload(chart1);
+	ENSURE(cached(entry1),"A chart smaller than the cache should be cached");
+	upload(chart2);
+	ENSURE(cached(entry2),"The most recently used chart should be cached");
+	ENSURE(!cached(entry1),"The least recently used chart should be discarded to keep the cache within its size");
+	
+	//a chart which does not fit at all is used, but not cached
+	const std::string chart3=getTestAppChart(std::string(2*1024*1024,'3'));
+	upload(chart3);
+	ENSURE(!cached(cacheDir.path()+"/"+ChartCache::key(chart3.data(),chart3.size())),
+	       "A chart larger than the cache should not be cached");
+	ENSURE(cached(entry2),"A chart too large to cache should not displace others");
+}
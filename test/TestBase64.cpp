@@ -0,0 +1,108 @@
+#include "test.h"
+
+#include <stdexcept>
+
+#include <Archive.h>
+
+namespace{
+
+///\return whether decoding the data was rejected
+bool rejected(const std::string& coded, Base64Alphabet alphabet=Base64Alphabet::Standard){
+	try{
+		decodeBase64(coded,alphabet);
+	}catch(std::runtime_error& err){
+		return true;
+	}
+	return false;
+}
+
+///\return every byte value, several times over, in an order which places
+///        each value at every position within a group of three
+std::string allBytes(){
+	std::string data;
+	for(unsigned int i=0; i<3*256+2; i++)
+		data+=(char)(i%257);
+	return data;
+}
+
+}
+
+TEST(Base64IllegalCharacters){
+	ENSURE(rejected("QU!D"),"Characters outside the alphabet should be rejected");
+	ENSURE(rejected("QUJD\nQUJD"),"Line breaks should be rejected");
+	ENSURE(rejected("QU-D"),"URL-safe characters should be rejected by the standard alphabet");
+	ENSURE(rejected("QU_D"),"URL-safe characters should be rejected by the standard alphabet");
+	ENSURE(rejected("QU+D",Base64Alphabet::URLSafe),"Standard characters should be rejected by the URL-safe alphabet");
+	ENSURE(rejected("QU/D",Base64Alphabet::URLSafe),"Standard characters should be rejected by the URL-safe alphabet");
+	ENSURE(rejected(std::string("QU\0D",4)),"Null characters should be rejected");
+	ENSURE(rejected("QU\xC3\x89"),"Non-ASCII characters should be rejected");
+	//in a partial final group
+	ENSURE(rejected("QUJDQ!"),"Characters outside the alphabet should be rejected");
+	ENSURE(rejected("QUJDQ!=="),"Characters outside the alphabet should be rejected");
+}
+
+TEST(Base64Padding){
+	ENSURE_EQUAL(decodeBase64("QQ=="),"A");
+	ENSURE_EQUAL(decodeBase64("QUI="),"AB");
+	ENSURE_EQUAL(decodeBase64("QQ"),"A","Padding should be optional");
+	ENSURE_EQUAL(decodeBase64("QUI"),"AB","Padding should be optional");
+
+	ENSURE(rejected("QQ="),"Too little padding should be rejected");
+	ENSURE(rejected("QUI=="),"Too much padding should be rejected");
+	ENSURE(rejected("QQ==="),"Too much padding should be rejected");
+	ENSURE(rejected("QUJD===="),"A whole group of padding should be rejected");
+	ENSURE(rejected("QUJD="),"Padding after a complete group should be rejected");
+	ENSURE(rejected("="),"Padding alone should be rejected");
+	ENSURE(rejected("=="),"Padding alone should be rejected");
+	ENSURE(rejected("Q=Q="),"Padding within the data should be rejected");
+	ENSURE(rejected("QQ==QUJD"),"Padding within the data should be rejected");
+	ENSURE(rejected("=QUJ"),"Padding at the start of the data should be rejected");
+}
+
+TEST(Base64Length){
+	ENSURE_EQUAL(decodeBase64(""),"","Empty data should decode to nothing");
+	ENSURE(rejected("Q"),"A single character cannot encode a byte");
+	ENSURE(rejected("QUJDQ"),"A final group of one character cannot encode a byte");
+	ENSURE(rejected("QUJDQ",Base64Alphabet::URLSafe),"A final group of one character cannot encode a byte");
+	ENSURE(rejected("QUJDQ==="),"A final group of one character cannot encode a byte");
+}
+
+TEST(Base64NonCanonical){
+	//'Q' followed by 'R' sets a bit which is not part of the encoded byte
+	ENSURE(rejected("QR=="),"Nonzero unused bits should be rejected");
+	ENSURE(rejected("QR"),"Nonzero unused bits should be rejected");
+	ENSURE(rejected("QUJ="),"Nonzero unused bits should be rejected");
+	ENSURE(rejected("QUJ"),"Nonzero unused bits should be rejected");
+	ENSURE(rejected("QUJDQR"),"Nonzero unused bits should be rejected after complete groups");
+	ENSURE(rejected("QR",Base64Alphabet::URLSafe),"Nonzero unused bits should be rejected");
+}
+
+TEST(Base64RoundTrip){
+	const std::string data=allBytes();
+	for(std::size_t length=0; length<=data.size(); length++){
+		const std::string raw=data.substr(0,length);
+		const std::string standard=encodeBase64(raw);
+		ENSURE(decodeBase64(standard)==raw,"Standard encoding should round trip");
+		const std::string urlSafe=encodeBase64(raw,Base64Alphabet::URLSafe);
+		ENSURE(decodeBase64(urlSafe,Base64Alphabet::URLSafe)==raw,"URL-safe encoding should round trip");
+		ENSURE(urlSafe.find_first_of("+/=")==std::string::npos,
+		       "URL-safe encoding should use no characters which need escaping in a URL");
+	}
+}
+
+TEST(Base64EncodedForms){
+	ENSURE_EQUAL(encodeBase64(""),"");
+	ENSURE_EQUAL(encodeBase64("A"),"QQ==","Standard encoding should be padded");
+	ENSURE_EQUAL(encodeBase64("AB"),"QUI=","Standard encoding should be padded");
+	ENSURE_EQUAL(encodeBase64("ABC"),"QUJD");
+	ENSURE_EQUAL(encodeBase64("A",Base64Alphabet::URLSafe),"QQ","URL-safe encoding should not be padded");
+	ENSURE_EQUAL(encodeBase64("AB",Base64Alphabet::URLSafe),"QUI","URL-safe encoding should not be padded");
+	ENSURE_EQUAL(encodeBase64("ABC",Base64Alphabet::URLSafe),"QUJD");
+
+	//the alphabets differ only in their last two characters
+	const std::string high("\xFB\xFF\xBF",3);
+	ENSURE_EQUAL(encodeBase64(high),"+/+/");
+	ENSURE_EQUAL(encodeBase64(high,Base64Alphabet::URLSafe),"-_-_");
+	ENSURE_EQUAL(encodeBase64(high.substr(0,2)),"+/8=");
+	ENSURE_EQUAL(encodeBase64(high.substr(0,2),Base64Alphabet::URLSafe),"-_8");
+}
@@ -3,6 +3,7 @@
 #include <set>
 #include <utility>
 
+#include <PersistentStore.h>
 #include <Utilities.h>
 
 TEST(UnauthenticatedAddClusterAllowedVO){
@@ -347,3 +348,59 @@ TEST(MalformedAllowVOAccessToCluster){
 		             "Request to grant access by a non-member of the owning VO should be rejected");
 	}
 }
+
+TEST(RepeatedDenialThenUniversalAccess){
+	auto dbResp=httpRequests::httpGet("http://localhost:52000/dynamo/create");
+	ENSURE_EQUAL(dbResp.status,200);
+	std::string dbPort=dbResp.body;
+	
+	const std::string awsAccessKey="foo";
+	const std::string awsSecretKey="bar";
+	Aws::SDKOptions options;
+	Aws::InitAPI(options);
+	using AWSOptionsHandle=std::unique_ptr<Aws::SDKOptions,void(*)(Aws::SDKOptions*)>;
+	AWSOptionsHandle opt_holder(&options,
+								[](Aws::SDKOptions* options){
+									Aws::ShutdownAPI(*options); 
+								});
+	Aws::Auth::AWSCredentials credentials(awsAccessKey,awsSecretKey);
+	Aws::Client::ClientConfiguration clientConfig;
+	clientConfig.scheme=Aws::Http::Scheme::HTTP;
+	clientConfig.endpointOverride="localhost:"+dbPort;
+	
+	PersistentStore store(credentials,clientConfig,
+	                      "slate_portal_user","encryptionKey",
+	                      "",9200);
+	
+	VO vo1;
+	vo1.id=idGenerator.generateVOID();
+	vo1.name="vo1";
+	vo1.valid=true;
+	ENSURE(store.addVO(vo1),"VO addition should succeed");
+	
+	VO vo2;
+	vo2.id=idGenerator.generateVOID();
+	vo2.name="vo2";
+	vo2.valid=true;
+	ENSURE(store.addVO(vo2),"VO addition should succeed");
+	
+	Cluster cluster1;
+	cluster1.id=idGenerator.generateClusterID();
+	cluster1.name="cluster1";
+	cluster1.config="-"; //Dynamo will get upset if this is empty, but it will not be used
+	cluster1.systemNamespace="-"; //Dynamo will get upset if this is empty, but it will not be used
+	cluster1.owningVO=vo1.id;
+	cluster1.valid=true;
+	ENSURE(store.addCluster(cluster1),"Cluster addition should succeed");
+	
+	ENSURE(!store.voAllowedOnCluster(vo2.id,cluster1.id),"A VO without a grant should not have access");
+	//both the absence of a wildcard grant and of the specific grant should 
+	//now be remembered
+	std::size_t queries=getStatistic(store.getStatistics(),"Database queries");
+	ENSURE(!store.voAllowedOnCluster(vo2.id,cluster1.id),"A VO without a grant should not have access");
+	ENSURE_EQUAL(getStatistic(store.getStatistics(),"Database queries"),queries,
+	             "A repeated denial should not query the database");
+	
+	ENSURE(store.addVOToCluster(PersistentStore::wildcard,cluster1.id),"Granting universal access should succeed");
+	ENSURE(store.voAllowedOnCluster(vo2.id,cluster1.id),"All VOs should have access after a universal grant");
+}
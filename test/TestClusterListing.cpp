@@ -1,5 +1,7 @@
 #include "test.h"
 
+#include <set>
+
 #include <Utilities.h>
 
 TEST(UnauthenticatedListClusters){
@@ -85,3 +87,72 @@ TEST(ListClusters){
 		     "Cluster name should match");
 	ENSURE(metadata.HasMember("id"));
 }
+
+TEST(ListClustersPaged){
+	using namespace httpRequests;
+	TestContext tc;
+	
+	std::string adminKey=getPortalToken();
+	std::string clusterURL=tc.getAPIServerURL()+"/"+currentAPIVersion+"/clusters?token="+adminKey;
+	
+	//add a VO to register the clusters with
+	rapidjson::Document createVO(rapidjson::kObjectType);
+	{
+		auto& alloc = createVO.GetAllocator();
+		createVO.AddMember("apiVersion", currentAPIVersion, alloc);
+		rapidjson::Value metadata(rapidjson::kObjectType);
+		metadata.AddMember("name", "testvo1", alloc);
+		createVO.AddMember("metadata", metadata, alloc);
+	}
+	auto voResp=httpPost(tc.getAPIServerURL()+"/"+currentAPIVersion+"/vos?token="+adminKey,
+			     to_string(createVO));
+	ENSURE_EQUAL(voResp.status,200, "VO creation request should succeed");
+	rapidjson::Document voData;
+	voData.Parse(voResp.body.c_str());
+	std::string voID=voData["metadata"]["id"].GetString();
+	
+	auto kubeConfig=tc.getKubeConfig();
+	std::set<std::string> expected;
+	for(const std::string name : {"testcluster1","testcluster2","testcluster3"}){
+		rapidjson::Document request(rapidjson::kObjectType);
+		auto& alloc = request.GetAllocator();
+		request.AddMember("apiVersion", currentAPIVersion, alloc);
+		rapidjson::Value metadata(rapidjson::kObjectType);
+		metadata.AddMember("name", name, alloc);
+		metadata.AddMember("vo", voID, alloc);
+		metadata.AddMember("kubeconfig", kubeConfig, alloc);
+		request.AddMember("metadata", metadata, alloc);
+		auto createResp=httpPost(clusterURL, to_string(request));
+		ENSURE_EQUAL(createResp.status,200, "Cluster creation should succeed");
+		rapidjson::Document data;
+		data.Parse(createResp.body.c_str());
+		expected.insert(data["metadata"]["id"].GetString());
+	}
+	
+	//following the cursor should visit every cluster exactly once
+	for(const std::string limit : {"1","2","1000"}){
+		std::vector<std::string> ids=fetchAllPages(clusterURL+"&limit="+limit);
+		std::set<std::string> seen(ids.begin(),ids.end());
+		ENSURE_EQUAL(ids.size(),seen.size(),"No cluster should be returned more than once");
+		ENSURE(seen==expected,"Every cluster should be returned");
+	}
+	
+	for(const std::string limit : {"0","-1","abc","1x","99999999999999999999"}){
+		auto listResp=httpGet(clusterURL+"&limit="+limit);
+		ENSURE_EQUAL(listResp.status,400,"A malformed page limit should be rejected");
+	}
+	
+	//neither invalid base64 nor valid base64 which does not contain a key is a cursor
+	for(const std::string cursor : {"not-a-cursor!","e30"}){
+		auto listResp=httpGet(clusterURL+"&limit=1&cursor="+cursor);
+		ENSURE_EQUAL(listResp.status,400,"A malformed cursor should be rejected");
+	}
+	
+	//listing the clusters a VO may use ignores paging
+	auto listResp=httpGet(clusterURL+"&vo="+voID+"&limit=1");
+	ENSURE_EQUAL(listResp.status,200, "Portal admin user should be able to list a VO's clusters");
+	rapidjson::Document data;
+	data.Parse(listResp.body.c_str());
+	ENSURE_EQUAL(data["items"].Size(),expected.size(),"All of the VO's clusters should be returned");
+	ENSURE(!data.HasMember("nextCursor"),"A filtered listing should not be paged");
+}
@@ -0,0 +1,52 @@
+#include "test.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+#include "Executor.h"
+
+TEST(ParallelForCallsEachIndexOnce){
+	const std::size_t count=1000;
+	std::vector<std::atomic<unsigned int>> calls(count);
+	for(auto& c : calls)
+		c=0;
+	parallelFor(count,8,[&](std::size_t i){ calls[i]++; });
+	for(std::size_t i=0; i<count; i++)
+		ENSURE_EQUAL(calls[i].load(),1,"Each index should be processed exactly once");
+
+	//degenerate cases
+	parallelFor(0,8,[&](std::size_t){ FAIL("No calls should be made for an empty range"); });
+	std::size_t single=0;
+	parallelFor(5,1,[&](std::size_t i){ single+=i; });
+	ENSURE_EQUAL(single,10,"A concurrency of one should process every index");
+}
+
+TEST(ParallelForPropagatesExceptions){
+	std::atomic<std::size_t> finished(0);
+	bool caught=false;
+	try{
+		parallelFor(100,4,[&](std::size_t i){
+			if(i==17)
+				throw std::runtime_error("failure");
+			finished++;
+		});
+	}catch(std::runtime_error& err){
+		caught=true;
+	}
+	ENSURE(caught,"An exception thrown by one call should be rethrown to the caller");
+	ENSURE_EQUAL(finished.load(),99,"All other calls should still be made");
+}
+
+TEST(ParallelForNested){
+	//calls which themselves use parallelFor must not wait on one another for
+	//helper threads, even when they outnumber the helpers
+	std::atomic<std::size_t> total(0);
+	parallelFor(64,64,[&](std::size_t){
+		parallelFor(64,64,[&](std::size_t){
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			total++;
+		});
+	});
+	ENSURE_EQUAL(total.load(),64*64,"Every nested call should be made");
+}
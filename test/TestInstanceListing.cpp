@@ -1,5 +1,7 @@
 #include "test.h"
 
+#include <set>
+
 #include <Utilities.h>
 
 TEST(UnauthenticatedInstanceList){
@@ -307,4 +309,101 @@ TEST(ScopedInstanceList){
 			             "Only instances belonging to the correct VO should be returned");
 		}
 	}
-}
\ No newline at end of file
+}
+TEST(PagedInstanceList){
+	using namespace httpRequests;
+	TestContext tc;
+	
+	std::string adminKey=getPortalToken();
+	std::string instanceURL=tc.getAPIServerURL()+"/"+currentAPIVersion+"/instances?token="+adminKey;
+	
+	const std::string voName="test-paged-inst-list";
+	const std::string clusterName="testcluster";
+	
+	{ //create a VO
+		rapidjson::Document request(rapidjson::kObjectType);
+		auto& alloc = request.GetAllocator();
+		request.AddMember("apiVersion", currentAPIVersion, alloc);
+		rapidjson::Value metadata(rapidjson::kObjectType);
+		metadata.AddMember("name", voName, alloc);
+		request.AddMember("metadata", metadata, alloc);
+		auto createResp=httpPost(tc.getAPIServerURL()+"/"+currentAPIVersion+"/vos?token="+adminKey,to_string(request));
+		ENSURE_EQUAL(createResp.status,200,"VO creation request should succeed");
+	}
+	
+	{ //create a cluster
+		auto kubeConfig = tc.getKubeConfig();
+		rapidjson::Document request(rapidjson::kObjectType);
+		auto& alloc = request.GetAllocator();
+		request.AddMember("apiVersion", currentAPIVersion, alloc);
+		rapidjson::Value metadata(rapidjson::kObjectType);
+		metadata.AddMember("name", clusterName, alloc);
+		metadata.AddMember("vo", voName, alloc);
+		metadata.AddMember("kubeconfig", kubeConfig, alloc);
+		request.AddMember("metadata", metadata, alloc);
+		auto createResp=httpPost(tc.getAPIServerURL()+"/"+currentAPIVersion+"/clusters?token="+adminKey, to_string(request));
+		ENSURE_EQUAL(createResp.status,200,
+					 "Cluster creation request should succeed");
+	}
+	
+	std::vector<std::string> instIDs;
+	struct cleanupHelper{
+		TestContext& tc;
+		const std::vector<std::string>& ids;
+		const std::string& key;
+		cleanupHelper(TestContext& tc, const std::vector<std::string>& ids, const std::string& key):
+		tc(tc),ids(ids),key(key){}
+		~cleanupHelper(){
+			for(const auto& id : ids)
+				auto delResp=httpDelete(tc.getAPIServerURL()+"/"+currentAPIVersion+"/instances/"+id+"?token="+key);
+		}
+	} cleanup(tc,instIDs,adminKey);
+	
+	for(unsigned int i=0; i<3; i++){ //install several things
+		rapidjson::Document request(rapidjson::kObjectType);
+		auto& alloc = request.GetAllocator();
+		request.AddMember("apiVersion", currentAPIVersion, alloc);
+		request.AddMember("vo", voName, alloc);
+		request.AddMember("cluster", clusterName, alloc);
+		request.AddMember("configuration", "Instance: paged"+std::to_string(i), alloc);
+		auto instResp=httpPost(tc.getAPIServerURL()+"/"+currentAPIVersion+"/apps/test-app?test&token="
+		                       +adminKey,to_string(request));
+		ENSURE_EQUAL(instResp.status,200,"Application install request should succeed");
+		rapidjson::Document data;
+		data.Parse(instResp.body);
+		if(data.HasMember("metadata") && data["metadata"].IsObject() && data["metadata"].HasMember("id"))
+			instIDs.push_back(data["metadata"]["id"].GetString());
+	}
+	const std::set<std::string> expected(instIDs.begin(),instIDs.end());
+	ENSURE_EQUAL(expected.size(),3,"Each installation should produce a distinct instance");
+	
+	//following the cursor should visit every instance exactly once
+	for(const std::string limit : {"1","2","1000"}){
+		std::vector<std::string> ids=fetchAllPages(instanceURL+"&limit="+limit);
+		std::set<std::string> seen(ids.begin(),ids.end());
+		ENSURE_EQUAL(ids.size(),seen.size(),"No instance should be returned more than once");
+		ENSURE(seen==expected,"Every instance should be returned");
+	}
+	
+	for(const std::string limit : {"0","-1","abc","1x","99999999999999999999"}){
+		auto listResp=httpGet(instanceURL+"&limit="+limit);
+		ENSURE_EQUAL(listResp.status,400,"A malformed page limit should be rejected");
+	}
+	
+	//neither invalid base64 nor valid base64 which does not contain a key is a cursor
+	for(const std::string cursor : {"not-a-cursor!","e30"}){
+		auto listResp=httpGet(instanceURL+"&limit=1&cursor="+cursor);
+		ENSURE_EQUAL(listResp.status,400,"A malformed cursor should be rejected");
+	}
+	
+	//listings restricted to a VO or cluster ignore paging
+	for(const std::string& filter : {"vo="+voName,"cluster="+clusterName}){
+		auto listResp=httpGet(instanceURL+"&"+filter+"&limit=1");
+		ENSURE_EQUAL(listResp.status,200,
+		             "Listing application instances should succeed");
+		rapidjson::Document data;
+		data.Parse(listResp.body);
+		ENSURE_EQUAL(data["items"].Size(),expected.size(),"All matching instances should be returned");
+		ENSURE(!data.HasMember("nextCursor"),"A filtered listing should not be paged");
+	}
+}
@@ -0,0 +1,116 @@
+#include "test.h"
+
+#include <chrono>
+#include <cstring>
+#include <condition_variable>
+#include <mutex>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <FileHandle.h>
+#include <InvalidationBus.h>
+
+namespace{
+
+///Collects the invalidations delivered to a bus's handler
+struct Receiver{
+	std::mutex mut;
+	std::condition_variable cond;
+	std::vector<Invalidation> received;
+
+	InvalidationBus::Handler handler(){
+		return [this](const Invalidation& invalidation){
+			std::lock_guard<std::mutex> lock(mut);
+			received.push_back(invalidation);
+			cond.notify_all();
+		};
+	}
+
+	///Wait until at least count invalidations have been delivered
+	///\return the invalidations delivered so far
+	std::vector<Invalidation> wait(std::size_t count){
+		std::unique_lock<std::mutex> lock(mut);
+		cond.wait_for(lock,std::chrono::seconds(5),[&]{ return received.size()>=count; });
+		return received;
+	}
+};
+
+}
+
+TEST(InvalidationSerialization){
+	const Invalidation original{"instance","Instance_1234",{"VO_5678","Cluster_9abc","test-app-inst"}};
+	Invalidation decoded;
+	ENSURE(deserializeInvalidation(serializeInvalidation(original),decoded),
+	       "A serialized invalidation should be decodable");
+	ENSURE_EQUAL(decoded.kind,original.kind,"Kind should be preserved");
+	ENSURE_EQUAL(decoded.id,original.id,"ID should be preserved");
+	ENSURE(decoded.related==original.related,"Related keys should be preserved in order");
+
+	const Invalidation bare{"user","User_1234",{}};
+	ENSURE(deserializeInvalidation(serializeInvalidation(bare),decoded),
+	       "An invalidation without related keys should be decodable");
+	ENSURE_EQUAL(decoded.kind,bare.kind,"Kind should be preserved");
+	ENSURE_EQUAL(decoded.id,bare.id,"ID should be preserved");
+	ENSURE(decoded.related.empty(),"No related keys should be decoded");
+
+	//an empty related key is still a key
+	const Invalidation emptyKey{"access","Cluster_1234",{""}};
+	ENSURE(deserializeInvalidation(serializeInvalidation(emptyKey),decoded));
+	ENSURE_EQUAL(decoded.related.size(),1,"An empty related key should be preserved");
+
+	ENSURE(!deserializeInvalidation("",decoded),"An empty message should be rejected");
+	ENSURE(!deserializeInvalidation("user",decoded),"A message without an ID should be rejected");
+	ENSURE(!deserializeInvalidation(std::string("user\0",5),decoded),
+	       "A message with an empty ID should be rejected");
+	ENSURE(!deserializeInvalidation(std::string("\0User_1234",10),decoded),
+	       "A message with an empty kind should be rejected");
+}
+
+TEST(LocalInvalidationBusDelivery){
+	FileHandle dir=makeTemporaryDir("/tmp/slate_invalidation_test_");
+
+	//leave behind the socket of a replica which exited without cleaning up
+	const std::string stalePath=dir+"/stale.sock";
+	{
+		int fd=socket(AF_UNIX,SOCK_DGRAM,0);
+		ENSURE(fd>=0,"Creating a socket should succeed");
+		sockaddr_un address={};
+		address.sun_family=AF_UNIX;
+		std::strcpy(address.sun_path,stalePath.c_str());
+		ENSURE_EQUAL(bind(fd,(const sockaddr*)&address,sizeof(address)),0,"Binding a socket should succeed");
+		close(fd);
+	}
+
+	Receiver receiverA, receiverB;
+	LocalInvalidationBus busA(dir.path()), busB(dir.path());
+	busA.subscribe(receiverA.handler());
+	busB.subscribe(receiverB.handler());
+
+	const Invalidation fromA{"cluster","Cluster_1234",{"VO_5678"}};
+	busA.publish(fromA);
+	auto received=receiverB.wait(1);
+	ENSURE_EQUAL(received.size(),1,"The other replica should receive the invalidation");
+	ENSURE_EQUAL(received.front().kind,fromA.kind,"Kind should be delivered");
+	ENSURE_EQUAL(received.front().id,fromA.id,"ID should be delivered");
+	ENSURE(received.front().related==fromA.related,"Related keys should be delivered");
+	ENSURE(access(stalePath.c_str(),F_OK)!=0,"Publishing should remove the socket of an exited replica");
+
+	//anything A had sent to itself would already be queued ahead of this
+	const Invalidation fromB{"secret","Secret_1234",{"VO_5678","Cluster_1234"}};
+	busB.publish(fromB);
+	received=receiverA.wait(1);
+	ENSURE_EQUAL(received.size(),1,"A replica should receive only invalidations from others");
+	ENSURE_EQUAL(received.front().id,fromB.id,"ID should be delivered");
+
+	//many invalidations published at once should all arrive, even though
+	//they exceed what the receiving socket can queue
+	const std::size_t burst=5000;
+	for(std::size_t i=0; i<burst; i++)
+		busA.publish(Invalidation{"user","User_"+std::to_string(i),{}});
+	received=receiverB.wait(burst+1);
+	ENSURE_EQUAL(received.size(),burst+1,"Every invalidation in a burst should be delivered");
+	ENSURE_EQUAL(received.back().id,"User_"+std::to_string(burst-1),
+	             "Invalidations should be delivered in order");
+}
@@ -0,0 +1,287 @@
+#include "test.h"
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <FileHandle.h>
+#include <KubeAPIClient.h>
+
+namespace{
+
+///A stand-in for a cluster's API server, which records the requests it
+///receives and answers each with the same canned response
+class FakeAPIServer{
+public:
+	///A request as received, without its body
+	struct Request{
+		std::string method;
+		std::string target;
+		std::string headers;
+	};
+
+	FakeAPIServer():stop(false),code(200){
+		listenFD=socket(AF_INET,SOCK_STREAM,0);
+		ENSURE(listenFD>=0,"Creating the server socket should succeed");
+		sockaddr_in address={};
+		address.sin_family=AF_INET;
+		address.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+		address.sin_port=0;
+		ENSURE_EQUAL(bind(listenFD,(const sockaddr*)&address,sizeof(address)),0,
+		             "Binding the server socket should succeed");
+		ENSURE_EQUAL(listen(listenFD,16),0,"Listening on the server socket should succeed");
+		socklen_t length=sizeof(address);
+		getsockname(listenFD,(sockaddr*)&address,&length);
+		port=std::to_string(ntohs(address.sin_port));
+		acceptor=std::thread(&FakeAPIServer::acceptConnections,this);
+	}
+
+	~FakeAPIServer(){
+		stop=true;
+		shutdown(listenFD,SHUT_RDWR);
+		acceptor.join();
+		close(listenFD);
+		for(auto& connection : connections)
+			connection.join();
+	}
+
+	std::string getURL() const{ return "http://127.0.0.1:"+port; }
+
+	///Set the response to be given to subsequent requests
+	void respond(long code, const std::string& body){
+		std::lock_guard<std::mutex> lock(mut);
+		this->code=code;
+		this->body=body;
+	}
+
+	///\return the requests received so far, and forget them
+	std::vector<Request> takeRequests(){
+		std::lock_guard<std::mutex> lock(mut);
+		std::vector<Request> taken;
+		taken.swap(requests);
+		return taken;
+	}
+
+private:
+	std::atomic<bool> stop;
+	int listenFD;
+	std::string port;
+	std::thread acceptor;
+	std::vector<std::thread> connections;
+	std::mutex mut;
+	long code;
+	std::string body;
+	std::vector<Request> requests;
+
+	void acceptConnections(){
+		while(!stop){
+			int client=accept(listenFD,nullptr,nullptr);
+			if(client<0)
+				break;
+			connections.emplace_back(&FakeAPIServer::serve,this,client);
+		}
+	}
+
+	///Answer requests on a connection until the client closes it
+	void serve(int client){
+		std::string buffer;
+		char chunk[4096];
+		pollfd fd={client,POLLIN,0};
+		while(!stop){
+			auto end=buffer.find("\r\n\r\n");
+			if(end==std::string::npos){
+				if(poll(&fd,1,100)<=0)
+					continue;
+				ssize_t count=read(client,chunk,sizeof(chunk));
+				if(count<=0)
+					break;
+				buffer.append(chunk,count);
+				continue;
+			}
+			//only bodiless requests are expected
+			std::string head=buffer.substr(0,end);
+			buffer.erase(0,end+4);
+			Request request;
+			auto lineEnd=head.find("\r\n");
+			std::string line=head.substr(0,lineEnd);
+			auto space=line.find(' ');
+			request.method=line.substr(0,space);
+			request.target=line.substr(space+1,line.rfind(' ')-space-1);
+			if(lineEnd!=std::string::npos)
+				request.headers=head.substr(lineEnd+2);
+			std::string response;
+			{
+				std::lock_guard<std::mutex> lock(mut);
+				requests.push_back(request);
+				response="HTTP/1.1 "+std::to_string(code)+" Canned\r\n"
+				         "Content-Type: application/json\r\n"
+				         "Content-Length: "+std::to_string(body.size())+"\r\n\r\n"+body;
+			}
+			if(write(client,response.data(),response.size())!=(ssize_t)response.size())
+				break;
+		}
+		close(client);
+	}
+};
+
+///Write a kubeconfig which directs requests to the given server
+///\param user the YAML mapping describing the user's credentials
+FileHandle writeKubeconfig(const std::string& server, const std::string& user="{token: secret-token}"){
+	FileHandle file=makeTemporaryFile("/tmp/slate_test_kubeconfig_");
+	std::ofstream out(file.path());
+	out << "apiVersion: v1\n"
+	       "kind: Config\n"
+	       "current-context: test\n"
+	       "clusters:\n"
+	       "- name: test-cluster\n"
+	       "  cluster: {server: \"" << server << "/\"}\n"
+	       "contexts:\n"
+	       "- name: test\n"
+	       "  context: {cluster: test-cluster, user: test-user}\n"
+	       "users:\n"
+	       "- name: test-user\n"
+	       "  user: " << user << "\n";
+	out.close();
+	return file;
+}
+
+}
+
+TEST(KubeAPIRequestConstruction){
+	FakeAPIServer server;
+	FileHandle config=writeKubeconfig(server.getURL());
+	kubernetes::APIClient client;
+	commandResult result;
+	server.respond(200,"{\"kind\":\"Pod\",\"apiVersion\":\"v1\",\"metadata\":{\"name\":\"my-pod\"}}");
+
+	auto expectRequest=[&](const std::vector<std::string>& arguments, const std::string& target){
+		ENSURE(client.tryRequest(config.path(),arguments,result),"The operation should be performed directly");
+		ENSURE_EQUAL(result.status,0,"The operation should succeed");
+		auto requests=server.takeRequests();
+		ENSURE_EQUAL(requests.size(),1,"The operation should make one request");
+		ENSURE_EQUAL(requests.front().method,"GET");
+		ENSURE_EQUAL(requests.front().target,target);
+		ENSURE(requests.front().headers.find("Authorization: Bearer secret-token")!=std::string::npos,
+		       "The request should carry the user's token");
+	};
+
+	expectRequest({"get","pod","my-pod","-n","some-ns","-o","json"},
+	              "/api/v1/namespaces/some-ns/pods/my-pod");
+	ENSURE_EQUAL(result.output,"{\"kind\":\"Pod\",\"apiVersion\":\"v1\",\"metadata\":{\"name\":\"my-pod\"}}",
+	             "A single object should be passed through unchanged");
+	expectRequest({"get","deploy","my-app","--namespace=some-ns","--output=json"},
+	              "/apis/apps/v1/namespaces/some-ns/deployments/my-app");
+	expectRequest({"get","pods","-n","some-ns","-l","app=my-app,release in (a,b)","-o","json"},
+	              "/api/v1/namespaces/some-ns/pods?labelSelector=app%3Dmy-app%2Crelease%20in%20%28a%2Cb%29");
+	expectRequest({"logs","my-pod","-n","some-ns","-c","main","--tail","10","-p"},
+	              "/api/v1/namespaces/some-ns/pods/my-pod/log?container=main&tailLines=10&previous=true");
+	expectRequest({"logs","my-pod","-n","some-ns","--tail=-1"},
+	              "/api/v1/namespaces/some-ns/pods/my-pod/log");
+	expectRequest({"get","secret","a/b","-n","some ns","-o","json"},
+	              "/api/v1/namespaces/some%20ns/secrets/a%2Fb");
+}
+
+TEST(KubeAPIListReshaping){
+	FakeAPIServer server;
+	FileHandle config=writeKubeconfig(server.getURL());
+	kubernetes::APIClient client;
+	commandResult result;
+	server.respond(200,"{\"kind\":\"PodList\",\"apiVersion\":\"v1\",\"metadata\":{},"
+	                   "\"items\":[{\"metadata\":{\"name\":\"a\"}},{\"metadata\":{\"name\":\"b\"}}]}");
+
+	ENSURE(client.tryRequest(config.path(),{"get","pods","-n","some-ns","-o","json"},result));
+	ENSURE_EQUAL(result.status,0);
+	rapidjson::Document list;
+	list.Parse(result.output.c_str());
+	ENSURE(!list.HasParseError() && list.IsObject(),"The output should be a JSON object");
+	ENSURE_EQUAL(std::string(list["kind"].GetString()),"List","A list should be reported as kubectl would");
+	ENSURE_EQUAL(std::string(list["apiVersion"].GetString()),"v1");
+	ENSURE_EQUAL(list["items"].Size(),2);
+	for(const auto& item : list["items"].GetArray()){
+		ENSURE(item.HasMember("kind") && std::string(item["kind"].GetString())=="Pod",
+		       "Each item should carry its own kind");
+		ENSURE(item.HasMember("apiVersion") && std::string(item["apiVersion"].GetString())=="v1",
+		       "Each item should carry its own API version");
+	}
+}
+
+TEST(KubeAPIErrorMapping){
+	FakeAPIServer server;
+	FileHandle config=writeKubeconfig(server.getURL());
+	kubernetes::APIClient client;
+	commandResult result;
+
+	server.respond(404,"{\"kind\":\"Status\",\"apiVersion\":\"v1\",\"status\":\"Failure\","
+	                   "\"message\":\"pods \\\"nope\\\" not found\",\"reason\":\"NotFound\",\"code\":404}");
+	ENSURE(client.tryRequest(config.path(),{"get","pod","nope","-n","some-ns","-o","json"},result),
+	       "A failed operation should still count as performed");
+	ENSURE_EQUAL(result.status,1,"A failed operation should report failure");
+	ENSURE(result.output.empty());
+	ENSURE_EQUAL(result.error,"Error from server (NotFound): pods \"nope\" not found\n",
+	             "A Status response should be described as kubectl would");
+
+	server.respond(403,"{\"kind\":\"Status\",\"message\":\"forbidden\"}");
+	ENSURE(client.tryRequest(config.path(),{"get","pod","x","-n","some-ns","-o","json"},result));
+	ENSURE_EQUAL(result.status,1);
+	ENSURE_EQUAL(result.error,"Error from server: forbidden\n","A Status without a reason should omit it");
+
+	server.respond(500,"oops");
+	ENSURE(client.tryRequest(config.path(),{"get","pod","x","-n","some-ns","-o","json"},result));
+	ENSURE_EQUAL(result.status,1);
+	ENSURE_EQUAL(result.error,"Error from server (HTTP 500): oops\n",
+	             "A response which is not a Status should be reported with its HTTP code");
+
+	//a server which cannot be reached
+	std::string unreachable;
+	{
+		FakeAPIServer closed;
+		unreachable=closed.getURL();
+	}
+	FileHandle badConfig=writeKubeconfig(unreachable);
+	ENSURE(client.tryRequest(badConfig.path(),{"get","pod","x","-n","some-ns","-o","json"},result));
+	ENSURE_EQUAL(result.status,1);
+	ENSURE(result.error.find("Unable to connect to the server: ")==0,
+	       "A connection failure should be reported as kubectl would");
+}
+
+TEST(KubeAPIDeclinesUnsupported){
+	FakeAPIServer server;
+	FileHandle config=writeKubeconfig(server.getURL());
+	kubernetes::APIClient client;
+	commandResult result;
+
+	const std::vector<std::vector<std::string>> unsupported={
+		{"get","pods","-o","json"}, //no namespace
+		{"get","pods","-n","some-ns"}, //not JSON output
+		{"get","pods","-n","some-ns","-o","yaml"},
+		{"get","nodes","-n","some-ns","-o","json"}, //unknown kind
+		{"get","pod","x","-n","some-ns","-l","a=b","-o","json"}, //selector with a name
+		{"get","pods","-n","some-ns","-o","json","--all-namespaces"}, //unknown flag
+		{"logs","x","-n","some-ns","--tail","ten"},
+		{"logs","x","-n","some-ns","-o","json"},
+		{"apply","-n","some-ns","-f","thing.yaml"},
+		{"get","pods","-n"}, //flag without value
+	};
+	for(const auto& arguments : unsupported)
+		ENSURE(!client.tryRequest(config.path(),arguments,result),"An unsupported operation should be left to kubectl");
+
+	//credentials which require running a plugin are left to kubectl
+	FileHandle execConfig=writeKubeconfig(server.getURL(),"{exec: {command: get-token, apiVersion: client.authentication.k8s.io/v1beta1}}");
+	ENSURE(!client.tryRequest(execConfig.path(),{"get","pods","-n","some-ns","-o","json"},result),
+	       "A cluster using plugin authentication should be left to kubectl");
+	FileHandle brokenConfig=makeTemporaryFile("/tmp/slate_test_kubeconfig_");
+	{
+		std::ofstream out(brokenConfig.path());
+		out << "not: [valid";
+	}
+	ENSURE(!client.tryRequest(brokenConfig.path(),{"get","pods","-n","some-ns","-o","json"},result),
+	       "A cluster whose configuration cannot be understood should be left to kubectl");
+	ENSURE(server.takeRequests().empty(),"No requests should be made for declined operations");
+}
@@ -0,0 +1,105 @@
+#include "test.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "DatabaseContext.h"
+
+TEST(UpdatedDuringLoad){
+	DatabaseContext db;
+	//another replica adds the user, so that the store under test must read it
+	auto writer=db.makeStore();
+	User user=makeTestUser("Fred");
+	ENSURE(writer->addUser(user),"Adding a user should succeed");
+	User updated=user;
+	updated.name="Frederick";
+
+	//update the user through the same store just after it has read the old
+	//record, without any invalidation arriving from elsewhere
+	std::unique_ptr<PersistentStore> store;
+	std::atomic<bool> armed(false), fired(false), succeeded(false);
+	InterceptingProxy proxy(db.getPort(),[&](const std::string& request){
+		if(!armed || request.find(user.id)==std::string::npos)
+			return;
+		armed=false;
+		succeeded=store->updateUser(updated,user);
+		fired=true;
+	});
+	store=db.makeStore(0,nullptr,proxy.getPort());
+
+	armed=true;
+	User loaded=store->getUser(user.id);
+	ENSURE(fired,"The user should have been updated while it was being loaded");
+	ENSURE(succeeded,"Updating the user should succeed");
+	ENSURE(loaded,"A load which read the user before the update may still return it");
+
+	ENSURE_EQUAL(store->getUser(user.id).name,updated.name,
+	             "A load which read the user before it was updated should not replace the updated record");
+}
+
+TEST(RemovedDuringLoad){
+	DatabaseContext db;
+	auto writer=db.makeStore();
+	User user=makeTestUser("Bob");
+	ENSURE(writer->addUser(user),"Adding a user should succeed");
+
+	std::unique_ptr<PersistentStore> store;
+	std::atomic<bool> armed(false), fired(false), succeeded(false);
+	InterceptingProxy proxy(db.getPort(),[&](const std::string& request){
+		if(!armed || request.find(user.id)==std::string::npos)
+			return;
+		armed=false;
+		succeeded=store->removeUser(user.id);
+		fired=true;
+	});
+	store=db.makeStore(0,nullptr,proxy.getPort());
+
+	armed=true;
+	store->getUser(user.id);
+	ENSURE(fired,"The user should have been removed while it was being loaded");
+	ENSURE(succeeded,"Removing the user should succeed");
+
+	ENSURE(!store->getUser(user.id),
+	       "A load which read the user before it was removed should not bring it back");
+	ENSURE(!store->findUserByToken(user.token),
+	       "A load which read the user before it was removed should not leave its token usable");
+}
+
+TEST(RemovedWhileLoadShared){
+	DatabaseContext db;
+	auto writer=db.makeStore();
+	User user=makeTestUser("Alice");
+	ENSURE(writer->addUser(user),"Adding a user should succeed");
+
+	//hold the first load of the user until a later lookup has joined it, or
+	//until it becomes clear that the later lookup did not wait for it
+	std::unique_ptr<PersistentStore> store;
+	std::atomic<bool> armed(false), held(false);
+	std::atomic<std::size_t> coalesced(0);
+	InterceptingProxy proxy(db.getPort(),[&](const std::string& request){
+		if(!armed || request.find(user.id)==std::string::npos)
+			return;
+		armed=false;
+		held=true;
+		auto deadline=std::chrono::steady_clock::now()+std::chrono::seconds(5);
+		while(getStatistic(store->getStatistics(),"Coalesced database fetches")==coalesced
+		      && std::chrono::steady_clock::now()<deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	});
+	store=db.makeStore(0,nullptr,proxy.getPort());
+	coalesced=getStatistic(store->getStatistics(),"Coalesced database fetches");
+
+	armed=true;
+	std::thread first([&]{ store->getUser(user.id); });
+	while(!held)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	bool removed=store->removeUser(user.id);
+	User found=store->getUser(user.id);
+	first.join();
+	ENSURE(removed,"Removing the user should succeed");
+	ENSURE(getStatistic(store->getStatistics(),"Coalesced database fetches")>coalesced,
+	       "The lookup after the removal should have found the earlier load in progress");
+	ENSURE(!found,"A lookup made after a user was removed should not return the user "
+	       "read by a load which began before the removal");
+}
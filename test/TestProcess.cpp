@@ -0,0 +1,72 @@
+#include "test.h"
+
+#include <chrono>
+
+namespace{
+	///Keeps the reaper running for the duration of a test, since waiting for
+	///child processes depends on it
+	struct ReaperGuard{
+		ReaperGuard(){ startReaper(); }
+		~ReaperGuard(){ stopReaper(); }
+	};
+
+	bool reportsTimeout(const commandResult& result){
+		return result.error.find("timed out")!=std::string::npos;
+	}
+}
+
+TEST(CommandOutputOnBothStreams){
+	ReaperGuard reaper;
+	//each stream receives several times what a pipe can buffer, with standard
+	//error filled first, so the command can only finish if both are drained
+	//while it runs
+	const std::size_t amount=1<<20;
+	auto result=runCommand("sh",{"-c","head -c "+std::to_string(amount)+" /dev/zero >&2; "
+	                                  "head -c "+std::to_string(amount)+" /dev/zero"});
+	ENSURE_EQUAL(result.status,0,"The command should succeed");
+	ENSURE_EQUAL(result.output.size(),amount,"All of the standard output should be collected");
+	ENSURE_EQUAL(result.error.size(),amount,"All of the standard error should be collected");
+
+	//the same must hold when input is sent too
+	const std::string input(amount,'x');
+	result=runCommandWithInput("sh",input,{"-c","cat; cat /dev/zero | head -c "+std::to_string(amount)+" >&2"});
+	ENSURE_EQUAL(result.status,0,"The command should succeed");
+	ENSURE(result.output==input,"The input should be echoed back in full");
+	ENSURE_EQUAL(result.error.size(),amount,"All of the standard error should be collected");
+}
+
+TEST(CommandOutputLimit){
+	ReaperGuard reaper;
+	commandOptions options;
+	options.outputLimit=4096;
+	auto result=runCommand("sh",{"-c","exec cat /dev/zero"},{},options);
+	ENSURE_EQUAL(result.status,-1,"A command producing too much output should be killed");
+	ENSURE(result.error.find("exceeded")!=std::string::npos,"The limit should be reported");
+}
+
+TEST(CommandTimeout){
+	ReaperGuard reaper;
+	using clock=std::chrono::steady_clock;
+	commandOptions options;
+	options.timeout=std::chrono::milliseconds(500);
+
+	auto start=clock::now();
+	auto result=runCommand("sleep",{"30"},{},options);
+	auto elapsed=clock::now()-start;
+	ENSURE_EQUAL(result.status,-1,"A command which runs too long should be killed");
+	ENSURE(reportsTimeout(result),"The timeout should be reported");
+	ENSURE(elapsed<std::chrono::seconds(10),"The command should not be waited for after the timeout");
+
+	//a command which no longer holds its output pipes must still be stopped
+	start=clock::now();
+	result=runCommand("sh",{"-c","exec >/dev/null 2>&1; sleep 30"},{},options);
+	elapsed=clock::now()-start;
+	ENSURE_EQUAL(result.status,-1,"A command which runs too long after closing its output should be killed");
+	ENSURE(reportsTimeout(result),"The timeout should be reported");
+	ENSURE(elapsed<std::chrono::seconds(10),"The command should not be waited for after the timeout");
+
+	//a command which finishes in time is unaffected
+	result=runCommand("sh",{"-c","echo done"},{},options);
+	ENSURE_EQUAL(result.status,0,"A command which finishes in time should succeed");
+	ENSURE_EQUAL(result.output,"done\n");
+}
@@ -0,0 +1,156 @@
+#include "test.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <snapshot_multimap.h>
+
+namespace{
+
+///A value whose identity is its ID, so that inserting one with an ID which
+///is already present replaces the stored version
+struct Versioned{
+	unsigned int id;
+	unsigned int version;
+};
+
+struct VersionedHash{
+	std::size_t operator()(const Versioned& v) const{ return std::hash<unsigned int>()(v.id); }
+};
+
+struct VersionedEqual{
+	bool operator()(const Versioned& a, const Versioned& b) const{ return a.id==b.id; }
+};
+
+using VersionedMap=snapshot_multimap<std::string,Versioned,std::hash<std::string>,std::equal_to<std::string>,
+                                     VersionedHash,VersionedEqual>;
+
+}
+
+TEST(SnapshotUnaffectedByModification){
+	snapshot_multimap<std::string,std::string> map;
+	map.insert("key","a");
+	map.insert("key","b");
+
+	auto before=map.find("key");
+	ENSURE_EQUAL(before.first->size(),2);
+	map.insert_or_assign("key","c");
+	map.erase("key","a");
+	ENSURE_EQUAL(before.first->size(),2,"A snapshot should not see later insertions or erasures");
+	ENSURE(before.first->count("a") && before.first->count("b") && !before.first->count("c"));
+
+	auto after=map.find("key");
+	ENSURE_EQUAL(after.first->size(),2);
+	ENSURE(!after.first->count("a") && after.first->count("b") && after.first->count("c"),
+	       "A new snapshot should see the modifications");
+
+	//erasing the whole key leaves existing snapshots intact
+	ENSURE_EQUAL(map.erase("key"),2);
+	ENSURE_EQUAL(after.first->size(),2,"A snapshot should outlive the erasure of its key");
+	ENSURE(map.find("key").first->empty());
+
+	//replacing a value does not alter the version held by a snapshot
+	VersionedMap versions;
+	versions.insert_or_assign("key",Versioned{1,1});
+	auto old=versions.find("key");
+	versions.insert_or_assign("key",Versioned{1,2});
+	ENSURE_EQUAL(old.first->begin()->version,1,"A snapshot should keep the replaced version");
+	ENSURE_EQUAL(versions.find("key").first->begin()->version,2,"A new snapshot should see the replacement");
+}
+
+TEST(EraseLastValueDropsKey){
+	snapshot_multimap<std::string,std::string> map;
+	map.insert("key","a");
+	map.insert("key","b");
+
+	ENSURE_EQUAL(map.erase("key","a"),1);
+	ENSURE(map.contains("key"),"A key with a remaining value should be kept");
+	ENSURE_EQUAL(map.erase("key","absent"),0,"Erasing a value which is not present should erase nothing");
+	ENSURE(map.contains("key"));
+	ENSURE_EQUAL(map.erase("key","b"),1);
+	ENSURE(!map.contains("key"),"Erasing a key's last value should drop the key");
+	ENSURE_EQUAL(map.count("key"),0);
+	ENSURE_EQUAL(map.erase("key","b"),0,"Erasing from an absent key should erase nothing");
+}
+
+TEST(SetExpirationCreatesEmptyCategory){
+	using clock=std::chrono::steady_clock;
+	snapshot_multimap<std::string,std::string> map;
+	const auto expiration=clock::now()+std::chrono::minutes(5);
+
+	ENSURE(!map.update_expiration("key",expiration),"Updating the expiration of an absent key should fail");
+	ENSURE(!map.contains("key"),"Updating the expiration of an absent key should not create it");
+	auto missing=map.find("key");
+	ENSURE(missing.first->empty() && missing.second<=clock::now(),
+	       "An absent key should yield an empty, expired category");
+
+	map.set_expiration("key",expiration);
+	ENSURE(map.contains("key"),"Setting the expiration of an absent key should create it");
+	auto category=map.find("key");
+	ENSURE(category.first->empty(),"The created category should be empty");
+	ENSURE(category.second==expiration,"The created category should expire when requested");
+
+	//values may then be added without changing the expiration
+	map.insert("key","a");
+	category=map.find("key");
+	ENSURE_EQUAL(category.first->size(),1);
+	ENSURE(category.second==expiration);
+}
+
+TEST(VisitWhileWriting){
+	//The writer replaces each of several values in turn with a newer version,
+	//so between any two of its operations the versions never increase with
+	//the ID and span at most two consecutive versions.
+	const unsigned int values=16, rounds=2000;
+	VersionedMap map;
+	for(unsigned int i=0; i<values; i++)
+		map.insert_or_assign("key",Versioned{i,0});
+
+	std::atomic<bool> done(false);
+	std::thread writer([&]{
+		for(unsigned int version=1; version<=rounds; version++){
+			for(unsigned int i=0; i<values; i++)
+				map.insert_or_assign("key",Versioned{i,version});
+		}
+		done=true;
+	});
+
+	std::size_t visits=0, inconsistent=0, changedSnapshots=0;
+	while(!done || visits==0){
+		std::vector<unsigned int> seen(values,rounds+1);
+		std::size_t count=0;
+		map.visit("key",[&](const Versioned& v){
+			if(v.id<values)
+				seen[v.id]=v.version;
+			count++;
+		});
+		bool consistent=(count==values);
+		for(unsigned int i=1; consistent && i<values; i++)
+			consistent=(seen[i]<=seen[i-1] && seen[0]-seen[i]<=1);
+		if(!consistent)
+			inconsistent++;
+		visits++;
+
+		//a snapshot taken concurrently must stay as it was
+		auto snapshot=map.find("key").first;
+		std::vector<unsigned int> first;
+		for(const auto& v : *snapshot)
+			first.push_back(v.version);
+		std::this_thread::yield();
+		std::size_t j=0;
+		for(const auto& v : *snapshot){
+			if(j>=first.size() || first[j++]!=v.version)
+				changedSnapshots++;
+		}
+	}
+	writer.join();
+	ENSURE_EQUAL(inconsistent,0,"Each visit should see the values as they were between two modifications");
+	ENSURE_EQUAL(changedSnapshots,0,"Snapshots should not change while the map is modified");
+
+	auto last=map.find("key").first;
+	ENSURE_EQUAL(last->size(),values);
+	for(const auto& v : *last)
+		ENSURE_EQUAL(v.version,rounds,"All values should end at the last version");
+}
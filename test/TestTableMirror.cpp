@@ -0,0 +1,181 @@
+#include "test.h"
+
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include <aws/dynamodb/model/PutItemRequest.h>
+#include <aws/dynamodb/model/UpdateItemRequest.h>
+
+#include "DatabaseContext.h"
+
+namespace{
+
+///How often the mirroring store applies journaled changes, in seconds
+const unsigned int syncInterval=1;
+
+///Wait for something which depends on the mirror being synchronized
+///\return whether the condition became true within several sync intervals
+bool eventually(const std::function<bool()>& condition){
+	auto deadline=std::chrono::steady_clock::now()+std::chrono::seconds(10*syncInterval);
+	while(!condition()){
+		if(std::chrono::steady_clock::now()>deadline)
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	return true;
+}
+
+///Wait for several sync intervals, to give the mirror the chance to apply
+///anything which it should not
+void waitForSyncs(){
+	std::this_thread::sleep_for(std::chrono::seconds(3*syncInterval)+std::chrono::milliseconds(500));
+}
+
+///\return the name of the listed user with the given ID, or an empty string
+///        if there is no such user
+std::string listedName(PersistentStore& store, const std::string& id){
+	for(const User& user : store.listUsers()){
+		if(user.id==id)
+			return user.name;
+	}
+	return "";
+}
+
+bool listsVO(PersistentStore& store, const std::string& id){
+	for(const VO& vo : store.listVOs()){
+		if(vo.id==id)
+			return true;
+	}
+	return false;
+}
+
+///Format a time as the store does when keying its change journal
+std::string changeKey(std::chrono::system_clock::time_point time){
+	auto millis=std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+	std::string key=std::to_string(millis);
+	if(key.size()<15)
+		key.insert(0,15-key.size(),'0');
+	return key;
+}
+
+}
+
+TEST(MirroredChanges){
+	DatabaseContext db;
+	//Every server sharing mirrored tables must journal its changes, so the
+	//writer mirrors too, but never gets around to synchronizing.
+	auto writer=db.makeStore(3600);
+	auto mirror=db.makeStore(syncInterval);
+
+	User user=makeTestUser("Bob");
+	ENSURE(writer->addUser(user),"Adding a user should succeed");
+	ENSURE(eventually([&]{ return listedName(*mirror,user.id)==user.name; }),
+	       "A user added by another server should be listed after a sync");
+
+	User updated=user;
+	updated.name="Robert";
+	ENSURE(writer->updateUser(updated,user),"Updating a user should succeed");
+	ENSURE(eventually([&]{ return listedName(*mirror,user.id)==updated.name; }),
+	       "A user updated by another server should be listed as updated after a sync");
+
+	ENSURE(writer->removeUser(user.id),"Removing a user should succeed");
+	ENSURE(eventually([&]{ return listedName(*mirror,user.id).empty(); }),
+	       "A user removed by another server should not be listed after a sync");
+
+	VO vo("mirrored-vo");
+	vo.id=idGenerator.generateVOID();
+	ENSURE(writer->addVO(vo),"Adding a VO should succeed");
+	ENSURE(eventually([&]{ return listsVO(*mirror,vo.id); }),
+	       "A VO added by another server should be listed after a sync");
+	ENSURE(writer->removeVO(vo.id),"Removing a VO should succeed");
+	ENSURE(eventually([&]{ return !listsVO(*mirror,vo.id); }),
+	       "A VO removed by another server should not be listed after a sync");
+}
+
+TEST(MirroredListingsDoNotExpire){
+	DatabaseContext db;
+	auto mirror=db.makeStore(syncInterval);
+
+	//the tables were scanned when the store started, and are not rescanned
+	const std::size_t scans=getStatistic(mirror->getStatistics(),"Database scans");
+	for(unsigned int i=0; i<3; i++){
+		mirror->listUsers();
+		mirror->listVOs();
+		mirror->listClusters();
+		mirror->listApplicationInstances();
+		waitForSyncs();
+	}
+	ENSURE_EQUAL(getStatistic(mirror->getStatistics(),"Database scans"),scans,
+	             "Mirrored tables should not be rescanned to be listed");
+
+	//so a record which reaches the database without being journaled is not
+	//seen, however long the mirror runs
+	Aws::DynamoDB::DynamoDBClient client(Aws::Auth::AWSCredentials("foo","bar"),db.getClientConfig());
+	using Aws::DynamoDB::Model::AttributeValue;
+	User hidden=makeTestUser("Hidden");
+	auto outcome=client.PutItem(Aws::DynamoDB::Model::PutItemRequest()
+	                            .WithTableName("SLATE_users")
+	                            .WithItem({{"ID",AttributeValue(hidden.id)},
+	                                       {"sortKey",AttributeValue(hidden.id)},
+	                                       {"name",AttributeValue(hidden.name)},
+	                                       {"globusID",AttributeValue(hidden.globusID)},
+	                                       {"token",AttributeValue(hidden.token)},
+	                                       {"email",AttributeValue(hidden.email)},
+	                                       {"admin",AttributeValue().SetBool(hidden.admin)}}));
+	ENSURE(outcome.IsSuccess(),"Writing directly to the database should succeed");
+	waitForSyncs();
+	ENSURE(listedName(*mirror,hidden.id).empty(),"An unjournaled record should not be listed");
+	ENSURE_EQUAL(getStatistic(mirror->getStatistics(),"Database scans"),scans,
+	             "Mirrored tables should not be rescanned to be listed");
+}
+
+TEST(MirroredChangesAppliedOnce){
+	DatabaseContext db;
+	auto writer=db.makeStore(3600);
+	auto mirror=db.makeStore(syncInterval);
+	Aws::DynamoDB::DynamoDBClient client(Aws::Auth::AWSCredentials("foo","bar"),db.getClientConfig());
+	using Aws::DynamoDB::Model::AttributeValue;
+	using Aws::DynamoDB::Model::AttributeValueUpdate;
+
+	User user=makeTestUser("Fred");
+	ENSURE(writer->addUser(user),"Adding a user should succeed");
+	ENSURE(eventually([&]{ return listedName(*mirror,user.id)==user.name; }),
+	       "A user added by another server should be listed after a sync");
+
+	//Each sync looks back over the skew allowance, so it fetches the journal
+	//entry for the addition again. If it applied it again, it would reload
+	//the record and pick up this unjournaled change.
+	auto update=client.UpdateItem(Aws::DynamoDB::Model::UpdateItemRequest()
+	                              .WithTableName("SLATE_users")
+	                              .WithKey({{"ID",AttributeValue(user.id)},
+	                                        {"sortKey",AttributeValue(user.id)}})
+	                              .WithAttributeUpdates({{"name",AttributeValueUpdate().WithValue(AttributeValue("Frederick"))}}));
+	ENSURE(update.IsSuccess(),"Writing directly to the database should succeed");
+	waitForSyncs();
+	ENSURE_EQUAL(listedName(*mirror,user.id),user.name,
+	             "A journaled change should be applied only once");
+
+	//An entry older than the skew allowance is never fetched, which is what
+	//makes it safe for the mirror to forget that it applied such entries.
+	auto old=client.PutItem(Aws::DynamoDB::Model::PutItemRequest()
+	                        .WithTableName("SLATE_changes")
+	                        .WithItem({{"ID",AttributeValue("SLATE_users")},
+	                                   {"sortKey",AttributeValue(changeKey(std::chrono::system_clock::now()-std::chrono::minutes(5))+":test:0")},
+	                                   {"record",AttributeValue(user.id)},
+	                                   {"origin",AttributeValue("test")},
+	                                   {"expires",AttributeValue().SetN(std::to_string(
+	                                     std::chrono::duration_cast<std::chrono::seconds>(
+	                                       (std::chrono::system_clock::now()+std::chrono::hours(1)).time_since_epoch()).count()))}}));
+	ENSURE(old.IsSuccess(),"Writing directly to the change journal should succeed");
+	waitForSyncs();
+	ENSURE_EQUAL(listedName(*mirror,user.id),user.name,
+	             "A journal entry older than the skew allowance should not be applied");
+
+	//a fresh change is still applied
+	User updated=user;
+	updated.name="Freddie";
+	ENSURE(writer->updateUser(updated,user),"Updating a user should succeed");
+	ENSURE(eventually([&]{ return listedName(*mirror,user.id)==updated.name; }),
+	       "A user updated by another server should be listed as updated after a sync");
+}
@@ -0,0 +1,75 @@
+#include "test.h"
+
+#include <atomic>
+
+#include "DatabaseContext.h"
+
+namespace{
+
+///Delivers invalidations only when the test hands them over
+struct ManualInvalidationBus : public InvalidationBus{
+	Handler handler;
+	void publish(const Invalidation&) override{}
+	void subscribe(Handler handler) override{ this->handler=std::move(handler); }
+};
+
+}
+
+TEST(AuthenticateToken){
+	DatabaseContext db;
+	auto store=db.makeStore();
+	User user=makeTestUser("Bob");
+	ENSURE(store->addUser(user),"Adding a user should succeed");
+
+	auto entry=store->authenticateToken(user.token.c_str());
+	ENSURE(entry,"A user's token should authenticate");
+	ENSURE_EQUAL(entry.userID(),user.id,"The token should identify its owner");
+	ENSURE(!entry.admin,"The owner is not an administrator");
+	ENSURE(!store->authenticateToken("not-a-token"),"An unknown token should not authenticate");
+
+	User replaced=user;
+	replaced.token=idGenerator.generateUserToken();
+	replaced.admin=true;
+	ENSURE(store->updateUser(replaced,user),"Updating a user should succeed");
+	ENSURE(!store->authenticateToken(user.token.c_str()),"A replaced token should no longer authenticate");
+	entry=store->authenticateToken(replaced.token.c_str());
+	ENSURE(entry,"The new token should authenticate");
+	ENSURE(entry.admin,"The owner's new admin flag should be reported");
+}
+
+TEST(TokenReplacedDuringLoad){
+	DatabaseContext db;
+	//another replica, which changes the user
+	auto writer=db.makeStore();
+	User user=makeTestUser("Fred");
+	ENSURE(writer->addUser(user),"Adding a user should succeed");
+	User replaced=user;
+	replaced.token=idGenerator.generateUserToken();
+
+	//replace the token just after this replica has read the old one, and
+	//deliver the other replica's invalidation before the read completes
+	ManualInvalidationBus* bus=new ManualInvalidationBus;
+	std::atomic<bool> armed(false), fired(false), updated(false);
+	InterceptingProxy proxy(db.getPort(),[&](const std::string& request){
+		if(!armed || request.find(user.token)==std::string::npos)
+			return;
+		armed=false;
+		updated=writer->updateUser(replaced,user);
+		bus->handler(Invalidation{"user",user.id,{}});
+		fired=true;
+	});
+	auto reader=db.makeStore(0,std::unique_ptr<InvalidationBus>(bus),proxy.getPort());
+
+	armed=true;
+	auto entry=reader->authenticateToken(user.token.c_str());
+	ENSURE(fired,"The token should have been replaced while it was being looked up");
+	ENSURE(updated,"Replacing the token should succeed");
+	ENSURE(entry,"A lookup which read the token before it was replaced may still use it");
+	ENSURE_EQUAL(entry.userID(),user.id);
+
+	ENSURE(!reader->authenticateToken(user.token.c_str()),
+	       "A token replaced while it was being looked up should not authenticate afterwards");
+	entry=reader->authenticateToken(replaced.token.c_str());
+	ENSURE(entry,"The new token should authenticate");
+	ENSURE_EQUAL(entry.userID(),user.id);
+}
@@ -0,0 +1,79 @@
+#include "test.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <TokenIndex.h>
+
+TEST(TokenIndexLookup){
+	TokenIndex index;
+	const auto later=std::chrono::steady_clock::now()+std::chrono::hours(1);
+	const std::string userID="User_12345678-9abc-def0-1234-56789abcdef0";
+
+	ENSURE(!index.find(TokenIndex::digest("token")),"An unknown token should not be found");
+
+	auto inserted=index.insert(TokenIndex::digest("token"),userID,true,later);
+	ENSURE_EQUAL(inserted.userID(),userID,"The inserted entry should report the user ID");
+	auto entry=index.find(TokenIndex::digest("token"));
+	ENSURE(entry,"An indexed token should be found");
+	ENSURE_EQUAL(entry.userID(),userID,"The entry should report the user ID");
+	ENSURE(entry.admin,"The entry should report the admin flag");
+
+	//the entry belongs to the lookup which returned it
+	index.erase(TokenIndex::digest("token"));
+	ENSURE_EQUAL(entry.userID(),userID,"An entry should remain usable after it is erased from the index");
+	ENSURE(!index.find(TokenIndex::digest("token")),"An erased token should not be found");
+
+	index.insert(TokenIndex::digest("stale"),userID,false,std::chrono::steady_clock::now()-std::chrono::seconds(1));
+	ENSURE(!index.find(TokenIndex::digest("stale")),"An expired entry should not be found");
+
+	bool rejected=false;
+	try{
+		index.insert(TokenIndex::digest("long"),std::string(TokenIndex::Entry::maxUserIDLength+1,'x'),false,later);
+	}catch(std::length_error& err){
+		rejected=true;
+	}
+	ENSURE(rejected,"A user ID which does not fit in an entry should be rejected");
+}
+
+TEST(TokenIndexChurn){
+	TokenIndex index;
+	const auto later=std::chrono::steady_clock::now()+std::chrono::hours(1);
+	const unsigned int tokens=1000;
+	auto token=[](unsigned int i){ return "token"+std::to_string(i); };
+	auto owner=[](unsigned int i){ return "User_"+std::to_string(i); };
+
+	//readers run throughout, while the table is rebuilt repeatedly
+	std::atomic<bool> stop(false);
+	std::atomic<unsigned long> mismatches(0);
+	std::vector<std::thread> readers;
+	for(unsigned int r=0; r<4; r++){
+		readers.emplace_back([&,r]{
+			for(unsigned int i=r; !stop; i=(i+1)%tokens){
+				auto entry=index.find(TokenIndex::digest(token(i)));
+				if(entry && entry.userID()!=owner(i))
+					mismatches++;
+			}
+		});
+	}
+	for(unsigned int round=0; round<50; round++){
+		for(unsigned int i=0; i<tokens; i++)
+			index.insert(TokenIndex::digest(token(i)),owner(i),false,later);
+		for(unsigned int i=0; i<tokens; i++)
+			index.erase(TokenIndex::digest(token(i)));
+	}
+	for(unsigned int i=0; i<tokens; i++)
+		index.insert(TokenIndex::digest(token(i)),owner(i),false,later);
+	stop=true;
+	for(auto& reader : readers)
+		reader.join();
+	ENSURE_EQUAL(mismatches.load(),0,"Lookups should never see another token's entry");
+	for(unsigned int i=0; i<tokens; i++){
+		auto entry=index.find(TokenIndex::digest(token(i)));
+		ENSURE(entry,"Every token inserted after the churn should be found");
+		ENSURE_EQUAL(entry.userID(),owner(i),"Each token should map to its own user");
+	}
+}
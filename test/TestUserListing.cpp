@@ -1,5 +1,7 @@
 #include "test.h"
 
+#include <set>
+
 #include <Utilities.h>
 
 TEST(UnauthenticatedListUsers){
@@ -154,3 +156,74 @@ TEST(ListUsersByVO){
 	             std::string("User_12345678-9abc-def0-1234-56789abcdef0"),
 	             "User ID should match");
 }
+
+TEST(ListUsersPaged){
+	using namespace httpRequests;
+	TestContext tc;
+	
+	std::string adminKey=getPortalToken();
+	std::string userURL=tc.getAPIServerURL()+"/"+currentAPIVersion+"/users?token="+adminKey;
+	
+	std::vector<std::string> created;
+	for(const std::string name : {"Alice","Bob","Carol"}){
+		rapidjson::Document request(rapidjson::kObjectType);
+		auto& alloc = request.GetAllocator();
+		request.AddMember("apiVersion", currentAPIVersion, alloc);
+		rapidjson::Value metadata(rapidjson::kObjectType);
+		metadata.AddMember("name", name, alloc);
+		metadata.AddMember("email", name+"@place.com", alloc);
+		metadata.AddMember("admin", false, alloc);
+		metadata.AddMember("globusID", name+"'s Globus ID", alloc);
+		request.AddMember("metadata", metadata, alloc);
+		auto createResp=httpPost(userURL,to_string(request));
+		ENSURE_EQUAL(createResp.status,200,"Portal admin user should be able to create a regular user");
+		rapidjson::Document data;
+		data.Parse(createResp.body.c_str());
+		created.push_back(data["metadata"]["id"].GetString());
+	}
+	std::set<std::string> expected(created.begin(),created.end());
+	expected.insert(getPortalUserID());
+	
+	//following the cursor should visit every user exactly once
+	for(const std::string limit : {"1","2","1000"}){
+		std::vector<std::string> ids=fetchAllPages(userURL+"&limit="+limit);
+		std::set<std::string> seen(ids.begin(),ids.end());
+		ENSURE_EQUAL(ids.size(),seen.size(),"No user should be returned more than once");
+		ENSURE(seen==expected,"Every user should be returned");
+	}
+	
+	for(const std::string limit : {"0","-1","abc","1x","99999999999999999999"}){
+		auto listResp=httpGet(userURL+"&limit="+limit);
+		ENSURE_EQUAL(listResp.status,400,"A malformed page limit should be rejected");
+	}
+	
+	//neither invalid base64 nor valid base64 which does not contain a key is a cursor
+	for(const std::string cursor : {"not-a-cursor!","e30"}){
+		auto listResp=httpGet(userURL+"&limit=1&cursor="+cursor);
+		ENSURE_EQUAL(listResp.status,400,"A malformed cursor should be rejected");
+	}
+	
+	//listing a VO's members ignores paging
+	rapidjson::Document createVO(rapidjson::kObjectType);
+	{
+		auto& alloc = createVO.GetAllocator();
+		createVO.AddMember("apiVersion", currentAPIVersion, alloc);
+		rapidjson::Value metadata(rapidjson::kObjectType);
+		metadata.AddMember("name", "testvo1", alloc);
+		createVO.AddMember("metadata", metadata, alloc);
+	}
+	auto voResp=httpPost(tc.getAPIServerURL()+"/"+currentAPIVersion+"/vos?token="+adminKey,to_string(createVO));
+	ENSURE_EQUAL(voResp.status,200,"Portal admin user should be able to create a VO");
+	rapidjson::Document voData;
+	voData.Parse(voResp.body.c_str());
+	std::string voID=voData["metadata"]["id"].GetString();
+	auto addResp=httpPut(tc.getAPIServerURL()+"/"+currentAPIVersion+"/users/"+created.front()+"/vos/"+voID+"?token="+adminKey,"");
+	ENSURE_EQUAL(addResp.status,200,"Portal admin user should be able to add a user to a VO");
+	
+	auto listResp=httpGet(userURL+"&vo="+voID+"&limit=1");
+	ENSURE_EQUAL(listResp.status,200,"Portal admin user should be able to list users in a VO");
+	rapidjson::Document data;
+	data.Parse(listResp.body.c_str());
+	ENSURE_EQUAL(data["items"].Size(),2,"All members of the VO should be returned");
+	ENSURE(!data.HasMember("nextCursor"),"A filtered listing should not be paged");
+}
@@ -1,5 +1,6 @@
 #include "test.h"
 
+#include <PersistentStore.h>
 #include <Utilities.h>
 
 TEST(UnauthenticatedListVOClusters){
@@ -92,4 +93,61 @@ TEST(ListVOClusters){
 		ENSURE_EQUAL(data["items"][0]["metadata"]["owningVO"].GetString(),voName,
 		             "Correct owning VO name should be listed");
 	}
-}
\ No newline at end of file
+}
+
+TEST(ListVOClustersWithoutGrantsIsCached){
+	auto dbResp=httpRequests::httpGet("http://localhost:52000/dynamo/create");
+	ENSURE_EQUAL(dbResp.status,200);
+	std::string dbPort=dbResp.body;
+	
+	const std::string awsAccessKey="foo";
+	const std::string awsSecretKey="bar";
+	Aws::SDKOptions options;
+	Aws::InitAPI(options);
+	using AWSOptionsHandle=std::unique_ptr<Aws::SDKOptions,void(*)(Aws::SDKOptions*)>;
+	AWSOptionsHandle opt_holder(&options,
+								[](Aws::SDKOptions* options){
+									Aws::ShutdownAPI(*options); 
+								});
+	Aws::Auth::AWSCredentials credentials(awsAccessKey,awsSecretKey);
+	Aws::Client::ClientConfiguration clientConfig;
+	clientConfig.scheme=Aws::Http::Scheme::HTTP;
+	clientConfig.endpointOverride="localhost:"+dbPort;
+	
+	PersistentStore store(credentials,clientConfig,
+	                      "slate_portal_user","encryptionKey",
+	                      "",9200);
+	
+	VO vo1;
+	vo1.id=idGenerator.generateVOID();
+	vo1.name="vo1";
+	vo1.valid=true;
+	ENSURE(store.addVO(vo1),"VO addition should succeed");
+	
+	VO vo2;
+	vo2.id=idGenerator.generateVOID();
+	vo2.name="vo2";
+	vo2.valid=true;
+	ENSURE(store.addVO(vo2),"VO addition should succeed");
+	
+	Cluster cluster1;
+	cluster1.id=idGenerator.generateClusterID();
+	cluster1.name="cluster1";
+	cluster1.config="-"; //Dynamo will get upset if this is empty, but it will not be used
+	cluster1.systemNamespace="-"; //Dynamo will get upset if this is empty, but it will not be used
+	cluster1.owningVO=vo1.id;
+	cluster1.valid=true;
+	ENSURE(store.addCluster(cluster1),"Cluster addition should succeed");
+	
+	//neither vo2 nor the wildcard has any grants
+	ENSURE(store.listClustersByVO(vo2.id).empty(),"A VO without grants should have no clusters");
+	std::size_t queries=getStatistic(store.getStatistics(),"Database queries");
+	ENSURE(store.listClustersByVO(vo2.id).empty(),"A VO without grants should have no clusters");
+	ENSURE_EQUAL(getStatistic(store.getStatistics(),"Database queries"),queries,
+	             "Known-empty access lists should be served from the cache");
+	
+	ENSURE(store.addVOToCluster(vo2.id,cluster1.id),"Granting access should succeed");
+	auto clusters=store.listClustersByVO(vo2.id);
+	ENSURE_EQUAL(clusters.size(),1,"A grant should be visible despite the cached empty list");
+	ENSURE_EQUAL(clusters.front().id,cluster1.id);
+}
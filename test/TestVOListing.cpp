@@ -1,5 +1,8 @@
 #include "test.h"
 
+#include <set>
+
+#include <PersistentStore.h>
 #include <Utilities.h>
 
 TEST(UnauthenticatedListVOs){
@@ -187,3 +190,102 @@ TEST(ListVOsForUser){
 	//should be no VOs
 	ENSURE_EQUAL(data["items"].Size(),0,"No VO records should be returned for regular user");
 }
+
+TEST(BulkVOLookupWithRepeatedIDs){
+	auto dbResp=httpRequests::httpGet("http://localhost:52000/dynamo/create");
+	ENSURE_EQUAL(dbResp.status,200);
+	std::string dbPort=dbResp.body;
+	
+	const std::string awsAccessKey="foo";
+	const std::string awsSecretKey="bar";
+	Aws::SDKOptions options;
+	Aws::InitAPI(options);
+	using AWSOptionsHandle=std::unique_ptr<Aws::SDKOptions,void(*)(Aws::SDKOptions*)>;
+	AWSOptionsHandle opt_holder(&options,
+								[](Aws::SDKOptions* options){
+									Aws::ShutdownAPI(*options); 
+								});
+	Aws::Auth::AWSCredentials credentials(awsAccessKey,awsSecretKey);
+	Aws::Client::ClientConfiguration clientConfig;
+	clientConfig.scheme=Aws::Http::Scheme::HTTP;
+	clientConfig.endpointOverride="localhost:"+dbPort;
+	
+	VO vo1, vo2;
+	{
+		PersistentStore store(credentials,clientConfig,
+		                      "slate_portal_user","encryptionKey",
+		                      "",9200);
+		vo1.id=idGenerator.generateVOID();
+		vo1.name="vo1";
+		vo1.valid=true;
+		ENSURE(store.addVO(vo1),"VO addition should succeed");
+		vo2.id=idGenerator.generateVOID();
+		vo2.name="vo2";
+		vo2.valid=true;
+		ENSURE(store.addVO(vo2),"VO addition should succeed");
+	}
+	
+	//use a second store, whose cache is empty, so that the records must be 
+	//fetched from the database in a batch
+	PersistentStore store(credentials,clientConfig,
+	                      "slate_portal_user","encryptionKey",
+	                      "",9200);
+	auto vos=store.getVOs({vo1.id,vo2.id,vo1.id,"nonexistent",vo1.id});
+	ENSURE_EQUAL(vos.size(),5,"One result should be returned per requested ID");
+	ENSURE(vos[0] && vos[2] && vos[4],"Every occurrence of a repeated ID should be found");
+	ENSURE_EQUAL(vos[0].name,vo1.name);
+	ENSURE_EQUAL(vos[4].name,vo1.name);
+	ENSURE(vos[1],"A VO requested once should be found");
+	ENSURE_EQUAL(vos[1].name,vo2.name);
+	ENSURE(!vos[3],"A nonexistent VO should not be found");
+}
+
+TEST(ListVOsPaged){
+	using namespace httpRequests;
+	TestContext tc;
+	
+	std::string adminKey=getPortalToken();
+	std::string voURL=tc.getAPIServerURL()+"/"+currentAPIVersion+"/vos?token="+adminKey;
+	
+	std::set<std::string> expected;
+	for(const std::string name : {"testvo1","testvo2","testvo3"}){
+		rapidjson::Document request(rapidjson::kObjectType);
+		auto& alloc = request.GetAllocator();
+		request.AddMember("apiVersion", currentAPIVersion, alloc);
+		rapidjson::Value metadata(rapidjson::kObjectType);
+		metadata.AddMember("name", name, alloc);
+		request.AddMember("metadata", metadata, alloc);
+		auto createResp=httpPost(voURL,to_string(request));
+		ENSURE_EQUAL(createResp.status,200,"Portal admin user should be able to create a VO");
+		rapidjson::Document data;
+		data.Parse(createResp.body.c_str());
+		expected.insert(data["metadata"]["id"].GetString());
+	}
+	
+	//following the cursor should visit every VO exactly once
+	for(const std::string limit : {"1","2","1000"}){
+		std::vector<std::string> ids=fetchAllPages(voURL+"&limit="+limit);
+		std::set<std::string> seen(ids.begin(),ids.end());
+		ENSURE_EQUAL(ids.size(),seen.size(),"No VO should be returned more than once");
+		ENSURE(seen==expected,"Every VO should be returned");
+	}
+	
+	for(const std::string limit : {"0","-1","abc","1x","99999999999999999999"}){
+		auto listResp=httpGet(voURL+"&limit="+limit);
+		ENSURE_EQUAL(listResp.status,400,"A malformed page limit should be rejected");
+	}
+	
+	//neither invalid base64 nor valid base64 which does not contain a key is a cursor
+	for(const std::string cursor : {"not-a-cursor!","e30"}){
+		auto listResp=httpGet(voURL+"&limit=1&cursor="+cursor);
+		ENSURE_EQUAL(listResp.status,400,"A malformed cursor should be rejected");
+	}
+	
+	//listing the user's own VOs ignores paging
+	auto listResp=httpGet(voURL+"&user=true&limit=1");
+	ENSURE_EQUAL(listResp.status,200,"Portal admin user should be able to list its VOs");
+	rapidjson::Document data;
+	data.Parse(listResp.body.c_str());
+	ENSURE_EQUAL(data["items"].Size(),expected.size(),"All of the user's VOs should be returned");
+	ENSURE(!data.HasMember("nextCursor"),"A filtered listing should not be paged");
+}
@@ -4,6 +4,7 @@
 #include <string>
 #include <sstream>
 #include <thread>
+#include <vector>
 
 #include <rapidjson/schema.h>
 
@@ -147,6 +148,19 @@ std::string getPortalToken();
 
 std::string getSchemaDir();
 
+///Fetch a listing one page at a time, following each page's nextCursor until
+///a page without one is returned
+///\param url the listing URL, including a query string with any parameters
+///           other than the cursor
+///\return the IDs of the listed items, in the order they were returned
+std::vector<std::string> fetchAllPages(const std::string& url);
+
 rapidjson::SchemaDocument loadSchema(const std::string& path);
 
+///Extract one of the counters reported by PersistentStore::getStatistics
+///\param statistics the statistics reported by a store
+///\param name the label of the counter, without the trailing colon
+///\return the counter's value, or zero if it is not reported
+std::size_t getStatistic(const std::string& statistics, const std::string& name);
+
 extern const std::string currentAPIVersion;
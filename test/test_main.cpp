@@ -222,6 +222,39 @@ std::string getSchemaDir(){
 	return schemaDir;
 }
 
+std::vector<std::string> fetchAllPages(const std::string& url){
+	using namespace httpRequests;
+	std::vector<std::string> ids;
+	std::string cursor;
+	do{
+		auto listResp=httpGet(url+(cursor.empty() ? "" : "&cursor="+cursor));
+		ENSURE_EQUAL(listResp.status,200,"Fetching a page of a listing should succeed");
+		rapidjson::Document data;
+		data.Parse(listResp.body.c_str());
+		ENSURE(data.IsObject() && data.HasMember("items") && data["items"].IsArray());
+		for(const auto& item : data["items"].GetArray())
+			ids.push_back(item["metadata"]["id"].GetString());
+		if(data.HasMember("nextCursor")){
+			std::string next=data["nextCursor"].GetString();
+			ENSURE(next!=cursor,"Each page should advance the cursor");
+			cursor=next;
+		}
+		else
+			cursor.clear();
+	}while(!cursor.empty());
+	return ids;
+}
+
+std::size_t getStatistic(const std::string& statistics, const std::string& name){
+	std::istringstream stats(statistics);
+	std::string line;
+	while(std::getline(stats,line)){
+		if(line.compare(0,name.size()+1,name+":")==0)
+			return std::stoul(line.substr(name.size()+1));
+	}
+	return 0;
+}
+
 rapidjson::SchemaDocument loadSchema(const std::string& path){
 	rapidjson::Document sd;
 	std::ifstream schemaStream(path);